@@ -299,6 +299,9 @@ public:
     bool buffered,
     int write_hint = WRITE_LIFE_NOT_SET) = 0;
   virtual int flush() = 0;
+  /// queue a flush behind the aios pending in ioc, so that their writes are
+  /// stable once ioc completes.  -EOPNOTSUPP if flush() is needed instead.
+  virtual int aio_flush(IOContext *ioc) { return -EOPNOTSUPP; }
   virtual bool try_discard(interval_set<uint64_t> &to_release,
                            bool async=true,
                            bool force=false) { return false; }
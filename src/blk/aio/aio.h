@@ -79,6 +79,19 @@ struct aio_t {
 #endif
   }
 
+#if defined(HAVE_LIBAIO)
+  /// flush the device cache; only io_uring queues it, see aio_flush()
+  void fdsync() {
+    offset = 0;
+    length = 0;
+    io_prep_fdsync(&iocb, fd);
+  }
+
+  bool is_fdsync() const {
+    return iocb.aio_lio_opcode == IO_CMD_FDSYNC;
+  }
+#endif
+
   long get_return_value() {
     return rval;
   }
@@ -104,6 +117,15 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end,
 			   void *priv, int *retries, int submit_retries, int initial_delay_us) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+  // Register memory for fixed buffer I/O; only supported by io_uring.
+  virtual int register_buffers(void *base, size_t len) {
+    return -EOPNOTSUPP;
+  }
+  // Whether an fdsync aio may follow the writes of a batch, and only starts
+  // once they have completed; only supported by io_uring.
+  virtual bool supports_linked_flush() const {
+    return false;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
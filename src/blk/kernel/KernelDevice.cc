@@ -111,6 +111,23 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
             "Number of discard ops issued to kernel device");
   b.add_u64_counter(l_blk_kernel_discard_threads, "discard_threads",
             "Number of discard threads running");
+  b.add_u64(l_blk_kernel_discard_queue_length, "discard_queue_length",
+            "Number of extents queued for async discard");
+  b.add_u64(l_blk_kernel_discard_queue_bytes, "discard_queue_bytes",
+            "Bytes queued for async discard", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_blk_kernel_discard_held_bytes, "discard_held_bytes",
+            "Bytes of small extents held back in case they coalesce",
+            NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_blk_kernel_discard_bytes, "discard_bytes",
+            "Bytes discarded", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_blk_kernel_discard_skipped_bytes, "discard_skipped_bytes",
+            "Bytes released without a discard as the extent was too small",
+            NULL, 0, unit_t(UNIT_BYTES));
+  b.add_time_avg(l_blk_kernel_discard_lat, "discard_lat",
+            "Average latency of a discard op issued to the kernel device");
+  b.add_u64_counter(l_blk_kernel_discard_throttled, "discard_throttled",
+            "Number of times async discard waited for "
+            "bdev_async_discard_max_bytes_per_sec");
 
   logger.reset(b.create_perf_counters());
   cct->get_perfcounters_collection()->add(logger.get());
@@ -577,6 +594,23 @@ int KernelDevice::flush()
   return r;
 }
 
+int KernelDevice::aio_flush(IOContext *ioc)
+{
+#ifdef HAVE_LIBAIO
+  // injected crashes happen in flush()
+  if (aio && dio && io_queue->supports_linked_flush() &&
+      !cct->_conf->bdev_inject_crash && ioc->has_pending_aios()) {
+    ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
+    ++ioc->num_pending;
+    auto& aio = ioc->pending_aios.back();
+    aio.fdsync();
+    dout(20) << __func__ << " ioc " << ioc << " aio " << &aio << dendl;
+    return 0;
+  }
+#endif
+  return -EOPNOTSUPP;
+}
+
 int KernelDevice::_aio_start()
 {
   if (aio) {
@@ -591,6 +625,7 @@ int KernelDevice::_aio_start()
       }
       return r;
     }
+    _aio_register_buffers();
     aio_thread.create("bstore_aio");
   }
   return 0;
@@ -617,6 +652,8 @@ void KernelDevice::_aio_stop()
 
     aio_stop = false;
     io_queue->shutdown();
+    // buffers still in use keep the pool mapped until they are released
+    registered_buffers.reset();
   }
 }
 
@@ -683,8 +720,10 @@ void KernelDevice::discard_drain()
 {
   dout(10) << __func__ << dendl;
   std::unique_lock l(discard_lock);
-  while (!discard_queued.empty() || (discard_running > 0)) {
+  while (!discard_queued.empty() || !discard_held.empty() ||
+         (discard_running > 0)) {
     need_notify = true;
+    discard_cond.notify_all(); // don't wait out the coalescing window
     discard_cond.wait(l);
   }
 }
@@ -721,7 +760,10 @@ void KernelDevice::_aio_thread()
       dout(30) << __func__ << " got " << r << " completed aios" << dendl;
       for (int i = 0; i < r; ++i) {
 	IOContext *ioc = static_cast<IOContext*>(aio[i]->priv);
-	_aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
+	if (aio[i]->length) {
+	  // not an aio_flush()
+	  _aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
+	}
 	if (aio[i]->queue_item.is_linked()) {
 	  std::lock_guard l(debug_queue_lock);
 	  debug_aio_unlink(*aio[i]);
@@ -827,6 +869,9 @@ void KernelDevice::_aio_thread()
 void KernelDevice::swap_discard_queued(interval_set<uint64_t>& other)
 {
   std::unique_lock l(discard_lock);
+  discard_queued.union_of(discard_held);
+  discard_held.clear();
+  logger->set(l_blk_kernel_discard_held_bytes, 0);
   discard_queued.swap(other);
 }
 
@@ -842,7 +887,7 @@ void KernelDevice::_discard_thread(DiscardThread* thr)
 
   while (true) {
     ceph_assert(discard_processing.empty());
-    if (discard_queued.empty()) {
+    if (discard_queued.empty() && discard_held.empty()) {
       if (thr->stop)
 	break;
       dout(20) << __func__ << " sleep" << dendl;
@@ -860,34 +905,115 @@ void KernelDevice::_discard_thread(DiscardThread* thr)
       if (thr->stop && !discard_threads.empty())
         break;
 
+      // Give adjacent extents released by later transactions a chance to
+      // merge with the queued ones, and keep to the rate limit, unless we
+      // are draining or stopping. Extents too small to discard are held
+      // for longer, in case later releases grow them, and are then released
+      // without a discard.
+      const bool flush = need_notify || thr->stop;
+      const auto now = mono_clock::now();
+      const auto held_until = discard_held_since +
+        std::chrono::milliseconds(cct->_conf->bdev_async_discard_hold_ms);
+      const bool release_held =
+        !discard_held.empty() && (flush || now >= held_until);
+      bool take_queued = !discard_queued.empty();
+      if (take_queued && !flush) {
+        auto ready = discard_queued_since +
+          std::chrono::milliseconds(cct->_conf->bdev_async_discard_coalesce_ms);
+        bool throttled = false;
+        if (cct->_conf->bdev_async_discard_max_bytes_per_sec &&
+            discard_next_allowed > std::max(ready, now)) {
+          ready = discard_next_allowed;
+          throttled = true;
+        }
+        if (now < ready) {
+          take_queued = false;
+          if (throttled) {
+            logger->inc(l_blk_kernel_discard_throttled);
+          }
+          if (!release_held) {
+            dout(20) << __func__ << " waiting to coalesce/throttle" << dendl;
+            discard_cond.wait_until(
+              l, discard_held.empty() ? ready : std::min(ready, held_until));
+            continue;
+          }
+        }
+      } else if (!take_queued && !release_held) {
+        dout(20) << __func__ << " waiting to release held extents" << dendl;
+        discard_cond.wait_until(l, held_until);
+        continue;
+      }
+
       if (cct->_conf->bdev_debug_discard_sleep > 0)
         std::this_thread::sleep_for(std::chrono::milliseconds(cct->_conf->bdev_debug_discard_sleep));
 
+      // Extents in discard_processing are all released once this pass is
+      // done; only those also in to_discard are discarded first.
+      interval_set<uint64_t> to_discard;
+      size_t bytes_taken = 0;
+      if (release_held) {
+        discard_processing.swap(discard_held);
+        bytes_taken += discard_processing.size();
+      }
+
       // Limit local processing to MAX_LOCAL_DISCARD items.
       // This will allow threads to work in parallel
       //      instead of a single thread taking over the whole discard_queued.
       // It will also allow threads to finish in a timely manner.
       constexpr unsigned MAX_LOCAL_DISCARD = 32;
+      const uint64_t min_size = cct->_conf->bdev_async_discard_min_size;
       unsigned count = 0;
-      size_t bytes_discarded = 0;
       for (auto it = discard_queued.begin();
-           it != discard_queued.end() && count < MAX_LOCAL_DISCARD;
+           take_queued && it != discard_queued.end() &&
+             count < MAX_LOCAL_DISCARD;
            ++count) {
-        discard_processing.insert(it.get_start(), it.get_len());
-	bytes_discarded += it.get_len();
+        if (it.get_len() >= min_size) {
+          to_discard.insert(it.get_start(), it.get_len());
+          discard_processing.insert(it.get_start(), it.get_len());
+          bytes_taken += it.get_len();
+        } else if (flush) {
+          discard_processing.insert(it.get_start(), it.get_len());
+          bytes_taken += it.get_len();
+        } else {
+          if (discard_held.empty()) {
+            discard_held_since = now;
+          }
+          discard_held.insert(it.get_start(), it.get_len());
+        }
         it = discard_queued.erase(it);
       }
-      discard_queue_bytes -= bytes_discarded;
-      discard_queue_length = discard_queued.num_intervals();
+      discard_queue_bytes -= bytes_taken;
+      discard_queue_length =
+        discard_queued.num_intervals() + discard_held.num_intervals();
+      logger->set(l_blk_kernel_discard_queue_length, discard_queue_length);
+      logger->set(l_blk_kernel_discard_queue_bytes, discard_queue_bytes);
+      logger->set(l_blk_kernel_discard_held_bytes, discard_held.size());
+      if (discard_processing.empty()) {
+        // everything taken is held for now
+        continue;
+      }
+      if (auto rate = cct->_conf->bdev_async_discard_max_bytes_per_sec; rate) {
+        discard_next_allowed =
+          std::max(discard_next_allowed, now) +
+          ceph::make_timespan((double)to_discard.size() / rate);
+      }
 
       // there are multiple active threads -> must use a counter instead of a flag
       discard_running ++;
       l.unlock();
       dout(20) << __func__ << " finishing" << dendl;
-      for (auto p = discard_processing.begin(); p != discard_processing.end(); ++p) {
+      // Small extents are released without a discard: the allocator is
+      // likely to hand them out again soon, and a discard of a fragment
+      // costs the device about as much as a large one.
+      for (auto p = to_discard.begin(); p != to_discard.end(); ++p) {
+        auto start = mono_clock::now();
         _discard(p.get_start(), p.get_len());
+        logger->tinc(l_blk_kernel_discard_lat, mono_clock::now() - start);
       }
-      logger->inc(l_blk_kernel_device_discard_op, discard_processing.num_intervals());
+      logger->inc(l_blk_kernel_device_discard_op, to_discard.num_intervals());
+      logger->inc(l_blk_kernel_discard_bytes, to_discard.size());
+      logger->inc(l_blk_kernel_discard_skipped_bytes,
+                  discard_processing.size() - to_discard.size());
 
       discard_callback(discard_callback_priv, static_cast<void*>(&discard_processing));
       discard_processing.clear();
@@ -921,6 +1047,10 @@ bool KernelDevice::_queue_discard(interval_set<uint64_t> &to_release)
     return false;
   }
 
+  if (discard_queued.empty()) {
+    discard_queued_since = mono_clock::now();
+  }
+  _unhold_discards(to_release);
   discard_queued.insert(to_release);
 
   size_t discarded_bytes = 0;
@@ -929,12 +1059,34 @@ bool KernelDevice::_queue_discard(interval_set<uint64_t> &to_release)
   }
   discard_queue_bytes += discarded_bytes;
 
-  discard_queue_length = discard_queued.num_intervals();
+  discard_queue_length =
+    discard_queued.num_intervals() + discard_held.num_intervals();
+  logger->set(l_blk_kernel_discard_queue_length, discard_queue_length);
+  logger->set(l_blk_kernel_discard_queue_bytes, discard_queue_bytes);
+  logger->set(l_blk_kernel_discard_held_bytes, discard_held.size());
 
   discard_cond.notify_one();
   return true;
 }
 
+// Move the held extents that touch to_release back to discard_queued, so
+// that they coalesce with it and are considered again.
+void KernelDevice::_unhold_discards(const interval_set<uint64_t>& to_release)
+{
+  if (discard_held.empty()) {
+    return;
+  }
+  for (auto p = to_release.begin(); p != to_release.end(); ++p) {
+    uint64_t start = p.get_start() ? p.get_start() - 1 : 0;
+    uint64_t end = p.get_start() + p.get_len() + 1;
+    for (auto h = discard_held.lower_bound(start);
+         h != discard_held.end() && h.get_start() < end; ) {
+      discard_queued.insert(h.get_start(), h.get_len());
+      h = discard_held.erase(h);
+    }
+  }
+}
+
 // return true only if discard was queued, so caller won't have to do
 // alloc->release, otherwise return false
 bool KernelDevice::try_discard(interval_set<uint64_t> &to_release,
@@ -1368,6 +1520,121 @@ private:
   region_queue_t region_q;
 };
 
+/* A slab of page aligned buffers registered with io_uring, so that reads
+ * into it are submitted as READ_FIXED. A read larger than a slot takes
+ * several, each read with its own aio. Each raw holds a reference to the
+ * pool, which is unmapped once the device and all its buffers are gone.
+ */
+struct RegisteredBufferPool
+  : public std::enable_shared_from_this<RegisteredBufferPool> {
+  using region_queue_t = boost::lockfree::queue<void*>;
+
+  struct registered_raw : public buffer::raw {
+    std::shared_ptr<RegisteredBufferPool> pool; // for recycling
+    void* region;
+
+    registered_raw(void* region, size_t len,
+		   std::shared_ptr<RegisteredBufferPool> pool)
+      : buffer::raw(static_cast<char*>(region), len),
+	pool(std::move(pool)), region(region) {
+    }
+    ~registered_raw() override {
+      pool->region_q.push(region);
+    }
+  };
+
+  RegisteredBufferPool(const size_t buffer_size, const size_t buffers_in_pool)
+    : buffer_size(buffer_size),
+      buffers_in_pool(buffers_in_pool),
+      length(buffer_size * buffers_in_pool),
+      region_q(buffers_in_pool) {
+    base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (base == MAP_FAILED) {
+      // the caller sees a null base and does without the pool
+      error = -errno;
+      base = nullptr;
+      return;
+    }
+    for (size_t i = 0; i < buffers_in_pool; ++i) {
+      region_q.push(static_cast<char*>(base) + i * buffer_size);
+    }
+  }
+  ~RegisteredBufferPool() {
+    if (base) {
+      ::munmap(base, length);
+    }
+  }
+
+  /// take the slots for a read of len bytes, either all of them or none
+  bool try_create(
+    const size_t len,
+    std::vector<ceph::unique_leakable_ptr<buffer::raw>>* raws) {
+    if (div_round_up(len, buffer_size) > buffers_in_pool) {
+      return false;
+    }
+    for (size_t pos = 0; pos < len; pos += buffer_size) {
+      void* region;
+      if (!region_q.pop(region)) {
+	// the slots taken so far go back to the pool
+	raws->clear();
+	return false;
+      }
+      raws->emplace_back(new registered_raw(
+	region, std::min(buffer_size, len - pos), shared_from_this()));
+    }
+    return true;
+  }
+
+  void* get_base() const {
+    return base;
+  }
+  int get_error() const {
+    return error;
+  }
+  size_t get_length() const {
+    return length;
+  }
+
+private:
+  const size_t buffer_size;
+  const size_t buffers_in_pool;
+  const size_t length;
+  void* base = nullptr;
+  int error = 0;
+  region_queue_t region_q;
+};
+
+void KernelDevice::_aio_register_buffers()
+{
+  uint64_t num = cct->_conf.get_val<uint64_t>("bdev_ioring_registered_buffers");
+  if (!num) {
+    return;
+  }
+  size_t size = p2roundup<size_t>(
+    cct->_conf.get_val<Option::size_t>("bdev_ioring_registered_buffer_size"),
+    CEPH_PAGE_SIZE);
+  auto pool = std::make_shared<RegisteredBufferPool>(size, num);
+  if (!pool->get_base()) {
+    derr << __func__ << " failed to allocate " << num << " buffers of "
+	 << size << " bytes: " << cpp_strerror(pool->get_error())
+	 << "; reading into unregistered buffers" << dendl;
+    return;
+  }
+  int r = io_queue->register_buffers(pool->get_base(), pool->get_length());
+  if (r == -EOPNOTSUPP) {
+    dout(10) << __func__ << " registered buffers need bdev_ioring" << dendl;
+  } else if (r < 0) {
+    derr << __func__ << " failed to register " << num << " buffers of "
+	 << size << " bytes: " << cpp_strerror(r)
+	 << "; check RLIMIT_MEMLOCK" << dendl;
+  } else {
+    dout(1) << __func__ << " registered " << num << " buffers of "
+	    << size << " bytes" << dendl;
+    registered_buffers = std::move(pool);
+  }
+}
+
 struct HugePagePoolOfPools {
   HugePagePoolOfPools(const std::map<size_t, size_t> conf)
     : pools(conf.size(), [conf] (size_t index, auto emplacer) {
@@ -1520,17 +1787,32 @@ int KernelDevice::aio_read(
   if (aio && dio) {
     ceph_assert(is_valid_io(off, len));
     _aio_log_start(ioc, off, len);
-    ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
-    ++ioc->num_pending;
-    aio_t& aio = ioc->pending_aios.back();
-    aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
-    aio.bl.prepare_iov(&aio.iov);
-    aio.preadv(off, len);
-    dout(30) << aio << dendl;
-    pbl->append(aio.bl);
-    dout(5) << __func__ << " 0x" << std::hex << off << "~" << len
-	    << std::dec << " aio " << &aio << dendl;
+    auto queue_read = [&](uint64_t pos, uint64_t pos_len,
+			  ceph::unique_leakable_ptr<buffer::raw> raw) {
+      ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
+      ++ioc->num_pending;
+      aio_t& aio = ioc->pending_aios.back();
+      aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(raw)));
+      aio.bl.prepare_iov(&aio.iov);
+      aio.preadv(pos, pos_len);
+      dout(30) << aio << dendl;
+      pbl->append(aio.bl);
+      dout(5) << __func__ << " 0x" << std::hex << pos << "~" << pos_len
+	      << std::dec << " aio " << &aio << dendl;
+    };
+    std::vector<ceph::unique_leakable_ptr<buffer::raw>> raws;
+    if (registered_buffers && registered_buffers->try_create(len, &raws)) {
+      // return the slots to the pool as soon as the caller is done
+      ioc->flags |= IOContext::FLAG_DONT_CACHE;
+      uint64_t pos = off;
+      for (auto& raw : raws) {
+	uint64_t pos_len = raw->get_len();
+	queue_read(pos, pos_len, std::move(raw));
+	pos += pos_len;
+      }
+    } else {
+      queue_read(off, len, create_custom_aligned(len, ioc));
+    }
   } else
 #endif
   {
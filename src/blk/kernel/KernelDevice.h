@@ -34,9 +34,18 @@ enum {
   l_blk_kernel_device_first = 1000,
   l_blk_kernel_device_discard_op,
   l_blk_kernel_discard_threads,
+  l_blk_kernel_discard_queue_length,
+  l_blk_kernel_discard_queue_bytes,
+  l_blk_kernel_discard_held_bytes,
+  l_blk_kernel_discard_bytes,
+  l_blk_kernel_discard_skipped_bytes,
+  l_blk_kernel_discard_lat,
+  l_blk_kernel_discard_throttled,
   l_blk_kernel_device_last,
 };
 
+struct RegisteredBufferPool;
+
 class KernelDevice : public BlockDevice,
                      public md_config_obs_t {
 protected:
@@ -57,6 +66,7 @@ private:
   ceph::mutex flush_mutex = ceph::make_mutex("KernelDevice::flush_mutex");
 
   std::unique_ptr<io_queue_t> io_queue;
+  std::shared_ptr<RegisteredBufferPool> registered_buffers; ///< io_uring fixed buffers
   aio_callback_t discard_callback;
   void *discard_callback_priv;
   bool aio_stop;
@@ -67,6 +77,11 @@ private:
   ceph::condition_variable discard_cond;
   int discard_running = 0;
   interval_set<uint64_t> discard_queued;
+  ceph::mono_time discard_queued_since;  ///< when discard_queued became non-empty
+  /// extents shorter than bdev_async_discard_min_size, waiting to coalesce
+  interval_set<uint64_t> discard_held;
+  ceph::mono_time discard_held_since;    ///< when discard_held became non-empty
+  ceph::mono_time discard_next_allowed;  ///< bdev_async_discard_max_bytes_per_sec
 
   struct AioCompletionThread : public Thread {
     KernelDevice *bdev;
@@ -97,6 +112,7 @@ private:
   void _aio_thread();
   void _discard_thread(DiscardThread* thr);
   bool _queue_discard(interval_set<uint64_t> &to_release);
+  void _unhold_discards(const interval_set<uint64_t>& to_release);
   bool try_discard(interval_set<uint64_t> &to_release,
                    bool async = true,
                    bool force = false) override;
@@ -130,6 +146,7 @@ private:
   int choose_fd(bool buffered, int write_hint) const;
 
   ceph::unique_leakable_ptr<buffer::raw> create_custom_aligned(size_t len, IOContext* ioc) const;
+  void _aio_register_buffers();
 
 public:
   KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb,
@@ -166,6 +183,7 @@ public:
 		bool buffered,
 		int write_hint = WRITE_LIFE_NOT_SET) override;
   int flush() override;
+  int aio_flush(IOContext *ioc) override;
   int _discard(uint64_t offset, uint64_t len);
 
   // for managing buffered readers/writers
@@ -18,6 +18,8 @@ struct ioring_data {
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  char *fixed_buf_base = nullptr;  ///< registered as buffer index 0
+  size_t fixed_buf_len = 0;
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -51,6 +53,16 @@ static int find_fixed_fd(struct ioring_data *d, int real_fd)
   return it->second;
 }
 
+static bool in_fixed_buf(struct ioring_data *d, struct aio_t *io)
+{
+  if (io->iov.size() != 1 || !d->fixed_buf_base)
+    return false;
+
+  const char *base = (const char *)io->iov[0].iov_base;
+  return base >= d->fixed_buf_base &&
+    base + io->iov[0].iov_len <= d->fixed_buf_base + d->fixed_buf_len;
+}
+
 static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 		     struct aio_t *io)
 {
@@ -58,13 +70,27 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
-    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
-			 io->iov.size(), io->offset);
-  else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
-    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
-			io->iov.size(), io->offset);
-  else
+  /* I/O to a registered buffer skips pinning the user pages on every
+   * submission. */
+  bool fixed_buf = in_fixed_buf(d, io);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    if (fixed_buf)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, 0);
+    else
+      io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			   io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+    if (fixed_buf)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, 0);
+    else
+      io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			  io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_FDSYNC) {
+    io_uring_prep_fsync(sqe, fixed_fd, IORING_FSYNC_DATASYNC);
+  } else
     ceph_assert(0);
 
   io_uring_sqe_set_data(sqe, io);
@@ -79,6 +105,17 @@ static int ioring_queue(struct ioring_data *d, void *priv,
 
   ceph_assert(beg != end);
 
+  /* An fdsync is linked behind everything queued ahead of it in the batch,
+   * so that it only starts once those have completed. The linked I/Os are
+   * run one after another, which is fine for the few writes that a flush
+   * follows. */
+  auto last_fdsync = end;
+  for (auto p = beg; p != end; ++p) {
+    if (p->is_fdsync())
+      last_fdsync = p;
+  }
+  bool link = last_fdsync != end;
+
   do {
     struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
     if (!sqe)
@@ -88,6 +125,10 @@ static int ioring_queue(struct ioring_data *d, void *priv,
     io->priv = priv;
 
     init_sqe(d, sqe, io);
+    if (beg == last_fdsync)
+      link = false;
+    if (link)
+      sqe->flags |= IOSQE_IO_LINK;
 
   } while (++beg != end);
 
@@ -172,6 +213,11 @@ close_ring_fd:
 
 void ioring_queue_t::shutdown()
 {
+  if (d->fixed_buf_base) {
+    io_uring_unregister_buffers(&d->io_uring);
+    d->fixed_buf_base = nullptr;
+    d->fixed_buf_len = 0;
+  }
   d->fixed_fds_map.clear();
   close(d->epoll_fd);
   d->epoll_fd = -1;
@@ -212,6 +258,28 @@ get_cqe:
   return events;
 }
 
+int ioring_queue_t::register_buffers(void *base, size_t len)
+{
+  struct iovec iov;
+  iov.iov_base = base;
+  iov.iov_len = len;
+
+  ceph_assert(!d->fixed_buf_base);
+  int ret = io_uring_register_buffers(&d->io_uring, &iov, 1);
+  if (ret < 0)
+    return ret;
+
+  d->fixed_buf_base = (char *)base;
+  d->fixed_buf_len = len;
+  return 0;
+}
+
+bool ioring_queue_t::supports_linked_flush() const
+{
+  /* fsync can't be polled for */
+  return !hipri;
+}
+
 bool ioring_queue_t::supported()
 {
   struct io_uring ring;
@@ -259,6 +327,16 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+int ioring_queue_t::register_buffers(void *base, size_t len)
+{
+  ceph_assert(0);
+}
+
+bool ioring_queue_t::supports_linked_flush() const
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
@@ -34,4 +34,6 @@ struct ioring_queue_t final : public io_queue_t {
   int submit_batch(aio_iter begin, aio_iter end,
                    void *priv, int *retries, int submit_retries, int initial_delay_us) final;
   int get_next_completed(int timeout_ms, aio_t **paio, int max) final;
+  int register_buffers(void *base, size_t len) final;
+  bool supports_linked_flush() const final;
 };
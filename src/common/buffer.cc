@@ -629,6 +629,34 @@ static ceph::spinlock debug_lock;
     memset(c_str(), 0, _len);
   }
 
+  void buffer::ptr::set_crc32c(uint32_t seed, uint32_t crc)
+  {
+    _raw->set_crc(std::make_pair(_off, _off + _len),
+                  std::make_pair(seed, crc));
+  }
+
+  bool buffer::ptr::get_crc32c(uint32_t seed, uint32_t *crc) const
+  {
+    pair<uint32_t, uint32_t> ccrc;
+    if (!_raw || !_raw->get_crc(make_pair(_off, _off + _len), &ccrc)) {
+      return false;
+    }
+    if (ccrc.first == seed) {
+      *crc = ccrc.second;
+    } else {
+      // see list::crc32c() for the adjustment to a different seed
+      *crc = ccrc.second ^ ceph_crc32c(ccrc.first ^ seed, NULL, _len);
+    }
+    return true;
+  }
+
+  void buffer::ptr::invalidate_crc()
+  {
+    if (_raw) {
+      _raw->invalidate_crc();
+    }
+  }
+
   void buffer::ptr::zero(unsigned o, unsigned l, bool crc_reset)
   {
     ceph_assert(o+l <= _len);
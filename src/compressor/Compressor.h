@@ -16,10 +16,12 @@
 #ifndef CEPH_COMPRESSOR_H
 #define CEPH_COMPRESSOR_H
 
+#include <cerrno>
 #include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include "include/ceph_assert.h"    // boost clobbers this
 #include "include/common_fwd.h"
 #include "include/buffer.h"
@@ -89,6 +91,36 @@ public:
   // alignment with decode methods
   virtual int decompress(ceph::bufferlist::const_iterator &p, size_t compressed_len, ceph::bufferlist &out, std::optional<int32_t> compressor_message) = 0;
 
+  // Trained dictionaries.  A caller trains a dictionary once from sample
+  // data, stores it, and passes the loaded form on every (de)compress call
+  // for data of the same kind; the compressor itself keeps no state.
+  class Dictionary {
+  public:
+    virtual ~Dictionary() {}
+  };
+  typedef std::shared_ptr<Dictionary> DictionaryRef;
+
+  virtual bool supports_dictionary() const {
+    return false;
+  }
+  /// build a dictionary of at most max_len bytes from samples
+  virtual int train_dictionary(const std::vector<ceph::bufferlist> &samples,
+			       size_t max_len, ceph::bufferlist &dict) {
+    return -EOPNOTSUPP;
+  }
+  /// prepare a dictionary built by train_dictionary() for use, either
+  /// for compression or for decompression only
+  virtual DictionaryRef load_dictionary(const ceph::bufferlist &dict,
+					bool compress) {
+    return DictionaryRef();
+  }
+  virtual int compress(const ceph::bufferlist &in, ceph::bufferlist &out, const Dictionary &dict) {
+    return -EOPNOTSUPP;
+  }
+  virtual int decompress(ceph::bufferlist::const_iterator &p, size_t compressed_len, ceph::bufferlist &out, const Dictionary &dict) {
+    return -EOPNOTSUPP;
+  }
+
   static CompressorRef create(CephContext *cct, const std::string &type);
   static CompressorRef create(CephContext *cct, int alg);
 
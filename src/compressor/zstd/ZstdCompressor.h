@@ -18,6 +18,7 @@
 
 #define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
+#include <zdict.h>
 
 #include "include/buffer.h"
 #include "include/encoding.h"
@@ -28,6 +29,96 @@ class ZstdCompressor : public Compressor {
   ZstdCompressor(CephContext *cct) : Compressor(COMP_ALG_ZSTD, "zstd"), cct(cct) {}
 
   int compress(const ceph::buffer::list &src, ceph::buffer::list &dst, std::optional<int32_t> &compressor_message) override {
+    return _compress(src, dst, nullptr);
+  }
+
+  int decompress(const ceph::buffer::list &src, ceph::buffer::list &dst, std::optional<int32_t> compressor_message) override {
+    auto i = std::cbegin(src);
+    return decompress(i, src.length(), dst, compressor_message);
+  }
+
+  int decompress(ceph::buffer::list::const_iterator &p,
+		 size_t compressed_len,
+		 ceph::buffer::list &dst,
+		 std::optional<int32_t> compressor_message) override {
+    return _decompress(p, compressed_len, dst, nullptr);
+  }
+
+  class ZstdDictionary : public Dictionary {
+  public:
+    ZSTD_CDict *cdict = nullptr;
+    ZSTD_DDict *ddict = nullptr;
+    ~ZstdDictionary() override {
+      ZSTD_freeCDict(cdict);
+      ZSTD_freeDDict(ddict);
+    }
+  };
+
+  bool supports_dictionary() const override {
+    return true;
+  }
+
+  int train_dictionary(const std::vector<ceph::buffer::list> &samples,
+		       size_t max_len, ceph::buffer::list &dict) override {
+    ceph::buffer::list flat;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (auto& s : samples) {
+      flat.append(s);
+      sizes.push_back(s.length());
+    }
+    ceph::buffer::ptr out = ceph::buffer::create(max_len);
+    size_t r = ZDICT_trainFromBuffer(out.c_str(), max_len, flat.c_str(),
+				     sizes.data(), sizes.size());
+    if (ZDICT_isError(r)) {
+      return -EINVAL;
+    }
+    dict.append(out, 0, r);
+    return 0;
+  }
+
+  DictionaryRef load_dictionary(const ceph::buffer::list &dict,
+				bool compress) override {
+    ceph::buffer::list d = dict;
+    auto z = std::make_shared<ZstdDictionary>();
+    if (compress) {
+      z->cdict = ZSTD_createCDict(d.c_str(), d.length(),
+				  cct->_conf->compressor_zstd_level);
+      if (!z->cdict) {
+	return DictionaryRef();
+      }
+    } else {
+      z->ddict = ZSTD_createDDict(d.c_str(), d.length());
+      if (!z->ddict) {
+	return DictionaryRef();
+      }
+    }
+    return z;
+  }
+
+  int compress(const ceph::buffer::list &src, ceph::buffer::list &dst,
+	       const Dictionary &dict) override {
+    auto cdict = static_cast<const ZstdDictionary&>(dict).cdict;
+    if (!cdict) {
+      return -EINVAL;
+    }
+    return _compress(src, dst, cdict);
+  }
+
+  int decompress(ceph::buffer::list::const_iterator &p,
+		 size_t compressed_len,
+		 ceph::buffer::list &dst,
+		 const Dictionary &dict) override {
+    auto ddict = static_cast<const ZstdDictionary&>(dict).ddict;
+    if (!ddict) {
+      return -EINVAL;
+    }
+    return _decompress(p, compressed_len, dst, ddict);
+  }
+
+ private:
+  int _compress(const ceph::buffer::list &src, ceph::buffer::list &dst,
+		const ZSTD_CDict *cdict) {
     ZSTD_CCtx *s = ZSTD_createCCtx();
     if (!s) {
       return -ENOMEM;
@@ -37,7 +128,12 @@ class ZstdCompressor : public Compressor {
       ZSTD_freeCCtx(s);
       return -EINVAL;
     }
-    res = ZSTD_CCtx_setParameter(s, ZSTD_c_compressionLevel, cct->_conf->compressor_zstd_level);
+    if (cdict) {
+      // the level was fixed when the dictionary was loaded
+      res = ZSTD_CCtx_refCDict(s, cdict);
+    } else {
+      res = ZSTD_CCtx_setParameter(s, ZSTD_c_compressionLevel, cct->_conf->compressor_zstd_level);
+    }
     if (ZSTD_isError(res)) {
       ZSTD_freeCCtx(s);
       return -EINVAL;
@@ -80,15 +176,10 @@ class ZstdCompressor : public Compressor {
     return 0;
   }
 
-  int decompress(const ceph::buffer::list &src, ceph::buffer::list &dst, std::optional<int32_t> compressor_message) override {
-    auto i = std::cbegin(src);
-    return decompress(i, src.length(), dst, compressor_message);
-  }
-
-  int decompress(ceph::buffer::list::const_iterator &p,
-		 size_t compressed_len,
-		 ceph::buffer::list &dst,
-		 std::optional<int32_t> compressor_message) override {
+  int _decompress(ceph::buffer::list::const_iterator &p,
+		  size_t compressed_len,
+		  ceph::buffer::list &dst,
+		  const ZSTD_DDict *ddict) {
     if (compressed_len < 4) {
       return -1;
     }
@@ -103,15 +194,24 @@ class ZstdCompressor : public Compressor {
     outbuf.pos = 0;
     ZSTD_DStream *s = ZSTD_createDStream();
     ZSTD_initDStream(s);
+    if (ddict && ZSTD_isError(ZSTD_DCtx_refDDict(s, ddict))) {
+      ZSTD_freeDStream(s);
+      return -1;
+    }
     while (compressed_len > 0) {
       if (p.end()) {
+	ZSTD_freeDStream(s);
 	return -1;
       }
       ZSTD_inBuffer_s inbuf;
       inbuf.pos = 0;
       inbuf.size = p.get_ptr_and_advance(compressed_len,
 					 (const char**)&inbuf.src);
-      ZSTD_decompressStream(s, &outbuf, &inbuf);
+      size_t r = ZSTD_decompressStream(s, &outbuf, &inbuf);
+      if (ZSTD_isError(r)) {
+	ZSTD_freeDStream(s);
+	return -1;
+      }
       compressed_len -= inbuf.size;
     }
     ZSTD_freeDStream(s);
@@ -119,7 +219,7 @@ class ZstdCompressor : public Compressor {
     dst.append(dstptr, 0, outbuf.pos);
     return 0;
   }
- private:
+
   CephContext *const cct;
 };
 
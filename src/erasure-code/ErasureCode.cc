@@ -42,6 +42,48 @@ using ceph::bufferlist;
 namespace ceph {
 const unsigned ErasureCode::SIMD_ALIGN = 64;
 
+uint64_t ErasureCode::encode_chunks_t::set(const shard_id_map<bufferptr> &in,
+                                           shard_id_map<bufferptr> &out)
+{
+  std::fill(chunks.begin(), chunks.end(), nullptr);
+  uint64_t size = 0;
+
+  for (auto &&[shard, ptr] : in) {
+    if (size == 0) {
+      size = ptr.length();
+    } else {
+      ceph_assert(size == ptr.length());
+    }
+    // the encode routines only read the data chunks
+    chunks[static_cast<int>(shard)] = const_cast<char*>(ptr.c_str());
+  }
+
+  for (auto &&[shard, ptr] : out) {
+    if (size == 0) {
+      size = ptr.length();
+    } else {
+      ceph_assert(size == ptr.length());
+    }
+    // parity is written through the raw pointer, so drop any crc32c
+    // cached for the old contents of the buffer
+    ptr.invalidate_crc();
+    chunks[static_cast<int>(shard)] = ptr.c_str();
+  }
+
+  for (auto &chunk : chunks) {
+    if (chunk != nullptr) {
+      continue;
+    }
+    if (zeros.length() < size) {
+      zeros = buffer::create_aligned(size, SIMD_ALIGN);
+      zeros.zero();
+    }
+    chunk = zeros.c_str();
+  }
+
+  return size;
+}
+
 int ErasureCode::init(
   ErasureCodeProfile &profile,
   std::ostream *ss)
@@ -23,6 +23,8 @@
 
  */
 
+#include <boost/container/small_vector.hpp>
+
 #include "ErasureCodeInterface.h"
  #include "include/ceph_assert.h"
 
@@ -174,6 +176,28 @@ class ErasureCode : public ErasureCodeInterface {
  protected:
   int parse(const ErasureCodeProfile &profile, std::ostream *ss);
 
+  /**
+   * The k + m chunk pointers passed to a plugin's encode routine. Shards
+   * that are in neither the in nor the out map of a stripe are read as
+   * zeros, from a buffer that is shared by every stripe set on this object,
+   * so a batch of stripes needs at most one such buffer.
+   */
+  class encode_chunks_t {
+   public:
+    explicit encode_chunks_t(unsigned chunk_count) : chunks(chunk_count) {}
+
+    /// point at the buffers of one stripe; returns their common length
+    uint64_t set(const shard_id_map<bufferptr> &in,
+                 shard_id_map<bufferptr> &out);
+
+    char **data() { return chunks.data(); }
+    char **coding(unsigned k) { return chunks.data() + k; }
+
+   private:
+    boost::container::small_vector<char*, 32> chunks;
+    bufferptr zeros;
+  };
+
  private:
   [[deprecated]]
   unsigned int chunk_index(unsigned int i) const;
@@ -0,0 +1,183 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include "ErasureCodeDecodeCache.h"
+
+#include "common/ceph_context.h"
+#include "common/debug.h"
+#include "common/perf_counters.h"
+#include "common/perf_counters_collection.h"
+
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << "ErasureCodeDecodeCache: "
+
+using std::string;
+
+enum {
+  l_ec_decode_cache_first = 621000,
+  l_ec_decode_cache_hit,
+  l_ec_decode_cache_miss,
+  l_ec_decode_cache_eviction,
+  l_ec_decode_cache_bytes,
+  l_ec_decode_cache_count,
+  l_ec_decode_cache_last,
+};
+
+namespace ceph {
+
+ErasureCodeDecodeCache::ErasureCodeDecodeCache(const string &name,
+                                               size_t max_bytes)
+  : name(name), max_bytes(max_bytes)
+{
+}
+
+// The logger is left to the context's perf counter collection, which
+// deletes it with the context. Plugins are only destroyed when the
+// registry is torn down at exit, by which time the context may be gone.
+ErasureCodeDecodeCache::~ErasureCodeDecodeCache() = default;
+
+void ErasureCodeDecodeCache::set_context(CephContext *_cct)
+{
+  std::lock_guard l{lock};
+  ceph_assert(cct == nullptr);
+  cct = _cct;
+  max_bytes = cct->_conf.get_val<Option::size_t>(
+    "erasure_code_decode_cache_size");
+
+  PerfCountersBuilder b(cct, "erasure_code_decode_cache_" + name,
+                        l_ec_decode_cache_first, l_ec_decode_cache_last);
+  b.add_u64_counter(l_ec_decode_cache_hit, "hit",
+                    "Decodes that found their decoding table in the cache");
+  b.add_u64_counter(l_ec_decode_cache_miss, "miss",
+                    "Decodes that had to calculate their decoding table");
+  b.add_u64_counter(l_ec_decode_cache_eviction, "eviction",
+                    "Decoding tables evicted from the cache");
+  b.add_u64(l_ec_decode_cache_bytes, "bytes",
+            "Size of the cached decoding tables", nullptr,
+            PerfCountersBuilder::PRIO_DEBUGONLY, unit_t(UNIT_BYTES));
+  b.add_u64(l_ec_decode_cache_count, "count",
+            "Number of cached decoding tables");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+  trim();
+}
+
+bool ErasureCodeDecodeCache::enabled() const
+{
+  std::lock_guard l{lock};
+  return max_bytes > 0;
+}
+
+ErasureCodeDecodeCache::table_ref_t
+ErasureCodeDecodeCache::get(const string &signature)
+{
+  std::lock_guard l{lock};
+  if (max_bytes == 0) {
+    return nullptr;
+  }
+  auto it = tables.find(signature);
+  if (it == tables.end()) {
+    ++misses;
+    if (logger) {
+      logger->inc(l_ec_decode_cache_miss);
+    }
+    return nullptr;
+  }
+
+  ++hits;
+  if (logger) {
+    logger->inc(l_ec_decode_cache_hit);
+  }
+  lru.splice(lru.end(), lru, it->second);
+  return it->second->second;
+}
+
+ErasureCodeDecodeCache::table_ref_t
+ErasureCodeDecodeCache::put(const string &signature, table_t &&table)
+{
+  std::lock_guard l{lock};
+  if (max_bytes == 0) {
+    return std::make_shared<const table_t>(std::move(table));
+  }
+  auto it = tables.find(signature);
+  if (it != tables.end()) {
+    lru.splice(lru.end(), lru, it->second);
+    return it->second->second;
+  }
+
+  auto ref = std::make_shared<const table_t>(std::move(table));
+  bytes += entry_bytes(signature, *ref);
+  lru.emplace_back(signature, ref);
+  tables.emplace(signature, std::prev(lru.end()));
+  trim();
+  return ref;
+}
+
+void ErasureCodeDecodeCache::trim()
+{
+  ceph_assert(ceph_mutex_is_locked(lock));
+  // Always keep the newest table, even if it alone exceeds the limit, unless
+  // the cache has been disabled.
+  const size_t keep = max_bytes > 0 ? 1 : 0;
+  while (bytes > max_bytes && lru.size() > keep) {
+    auto &&[old_signature, old_table] = lru.front();
+    if (cct) {
+      ldout(cct, 20) << __func__ << " evict " << old_signature << dendl;
+    }
+    bytes -= entry_bytes(old_signature, *old_table);
+    tables.erase(old_signature);
+    lru.pop_front();
+    ++evictions;
+    if (logger) {
+      logger->inc(l_ec_decode_cache_eviction);
+    }
+  }
+
+  if (logger) {
+    logger->set(l_ec_decode_cache_bytes, bytes);
+    logger->set(l_ec_decode_cache_count, lru.size());
+  }
+}
+
+uint64_t ErasureCodeDecodeCache::get_hits() const
+{
+  std::lock_guard l{lock};
+  return hits;
+}
+
+uint64_t ErasureCodeDecodeCache::get_misses() const
+{
+  std::lock_guard l{lock};
+  return misses;
+}
+
+uint64_t ErasureCodeDecodeCache::get_evictions() const
+{
+  std::lock_guard l{lock};
+  return evictions;
+}
+
+size_t ErasureCodeDecodeCache::get_bytes() const
+{
+  std::lock_guard l{lock};
+  return bytes;
+}
+
+size_t ErasureCodeDecodeCache::get_count() const
+{
+  std::lock_guard l{lock};
+  return lru.size();
+}
+
+}
@@ -0,0 +1,108 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_ERASURE_CODE_DECODE_CACHE_H
+#define CEPH_ERASURE_CODE_DECODE_CACHE_H
+
+/*! @file ErasureCodeDecodeCache.h
+    @brief LRU cache of decoding tables, for use by any plugin
+
+    Working out how to recover a set of lost chunks (inverting the
+    coding matrix, building an XOR schedule, ...) depends only on the
+    code and on which chunks are lost. When an OSD is down, every degraded
+    read of a PG hits the same erasure signature, so plugins can keep the
+    result here rather than repeating the work for every stripe.
+
+    Tables are vectors of int, the unit jerasure and SHEC work in. They
+    are accounted to the ec_decode_cache mempool and the cache is bounded
+    by the total bytes held. Hits, misses and evictions are reported in
+    the erasure_code_decode_cache_<name> perf counters.
+
+    Plugins do not have a CephContext when they are constructed, so the
+    cache starts with DEFAULT_MAX_BYTES and no perf counters. Once the
+    plugin registry is given a context, set_context() sizes the cache from
+    erasure_code_decode_cache_size and registers the counters.
+ */
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "common/ceph_mutex.h"
+#include "include/mempool.h"
+
+class CephContext;
+class PerfCounters;
+
+namespace ceph {
+
+class ErasureCodeDecodeCache {
+public:
+  typedef mempool::ec_decode_cache::vector<int> table_t;
+  typedef std::shared_ptr<const table_t> table_ref_t;
+
+  static constexpr size_t DEFAULT_MAX_BYTES = 4 << 20;
+
+  explicit ErasureCodeDecodeCache(const std::string &name,
+                                  size_t max_bytes = DEFAULT_MAX_BYTES);
+  ~ErasureCodeDecodeCache();
+
+  /// size the cache from **cct**'s configuration and report the perf
+  /// counters to it. The counters are owned by **cct**'s collection.
+  void set_context(CephContext *cct);
+
+  /// false if the cache was configured to hold nothing
+  bool enabled() const;
+
+  /// return the table for **signature**, or nullptr if it is not cached
+  table_ref_t get(const std::string &signature);
+
+  /// cache **table** for **signature** and return a reference to it. If
+  /// another thread got there first, the table already cached is returned.
+  table_ref_t put(const std::string &signature, table_t &&table);
+
+  uint64_t get_hits() const;
+  uint64_t get_misses() const;
+  uint64_t get_evictions() const;
+  size_t get_bytes() const;
+  size_t get_count() const;
+
+private:
+  typedef std::list<std::pair<std::string, table_ref_t>> lru_list_t;
+
+  mutable ceph::mutex lock =
+    ceph::make_mutex("ErasureCodeDecodeCache::lock");
+  lru_list_t lru;
+  std::unordered_map<std::string, lru_list_t::iterator> tables;
+  const std::string name;
+  size_t max_bytes;
+  size_t bytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+
+  CephContext *cct = nullptr;
+  PerfCounters *logger = nullptr;
+
+  void trim();
+
+  static size_t entry_bytes(const std::string &signature,
+                            const table_t &table) {
+    return signature.size() + table.size() * sizeof(int);
+  }
+};
+
+}
+
+#endif
@@ -448,6 +448,74 @@ namespace ceph {
     virtual int encode_chunks(const shard_id_map<bufferptr> &in,
                               shard_id_map<bufferptr> &out) = 0;
 
+    typedef std::vector<std::pair<shard_id_map<bufferptr>,
+                                  shard_id_map<bufferptr>>> encode_batch_t;
+
+    /**
+     * Encode a batch of stripes, such as all of the extents touched by a
+     * single transaction. Each entry of **batch** holds the in and out maps
+     * for one call to encode_chunks(in, out) and has the same requirements
+     * on its buffers. Different entries may have different lengths.
+     *
+     * Plugins can override this to set up once for the whole batch rather
+     * than once per stripe. Unlike encode_chunks, the plugin must not
+     * replace any of the out bufferptrs, since the caller may be holding
+     * its own copy of them.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in,out] batch in and out maps of each stripe to be encoded
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_chunks_batch(encode_batch_t &batch) {
+      for (auto &&[in, out] : batch) {
+        if (int r = encode_chunks(in, out)) {
+          return r;
+        }
+      }
+      return 0;
+    }
+
+    /**
+     * Encode as encode_chunks(in, out) and also calculate the crc32c of the
+     * buffers of the shards in **crcs**, so that the caller does not need to
+     * walk the same memory again later.
+     *
+     * On entry **crcs** holds the seed for each shard whose crc32c is
+     * wanted and on return it holds the crc32c of that shard's buffer. An
+     * entry for a shard that is in neither **in** nor **out** is left
+     * untouched.
+     *
+     * The default implementation calculates the crc32cs after encoding is
+     * complete. Plugins can override this to calculate them while the
+     * data is still in cache. The same restriction on replacing the out
+     * bufferptrs as for encode_chunks_batch applies.
+     *
+     * @param [in] in map of data shards to be encoded
+     * @param [in,out] out map of empty buffers for parity to be written to
+     * @param [in,out] crcs map of shard to crc32c seed, replaced by result
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_chunks_with_crcs(const shard_id_map<bufferptr> &in,
+                                        shard_id_map<bufferptr> &out,
+                                        shard_id_map<uint32_t> &crcs) {
+      if (int r = encode_chunks(in, out)) {
+        return r;
+      }
+      for (auto &&[shard, crc] : crcs) {
+        const bufferptr *ptr = nullptr;
+        if (in.contains(shard)) {
+          ptr = &in.at(shard);
+        } else if (out.contains(shard)) {
+          ptr = &out.at(shard);
+        } else {
+          continue;
+        }
+        crc = ceph_crc32c(crc, (unsigned char*)ptr->c_str(), ptr->length());
+      }
+      return 0;
+    }
+
     /**
      * Calculate the delta between the old_data and new_data buffers using xor,
      * (or plugin-specific implementation) and returns the result in the
@@ -147,6 +147,9 @@ int ErasureCodePluginRegistry::load(const std::string &plugin_name,
     int r = add(plugin_name, it->second());
     if (r == 0) {
       *plugin = get(plugin_name);
+      if (cct) {
+	(*plugin)->set_context(cct);
+      }
     }
     return r;
   }
@@ -199,6 +202,9 @@ int ErasureCodePluginRegistry::load(const std::string &plugin_name,
   }
 
   (*plugin)->library = library;
+  if (cct) {
+    (*plugin)->set_context(cct);
+  }
 
   *ss << __func__ << ": " << plugin_name << " ";
 
@@ -207,9 +213,16 @@ int ErasureCodePluginRegistry::load(const std::string &plugin_name,
 
 int ErasureCodePluginRegistry::preload(const std::string &plugins,
 				       const std::string &directory,
-				       ostream *ss)
+				       ostream *ss,
+				       CephContext *_cct)
 {
   std::lock_guard l{lock};
+  if (_cct && !cct) {
+    cct = _cct;
+    for (auto &&[name, plugin] : this->plugins) {
+      plugin->set_context(cct);
+    }
+  }
   list<string> plugins_list;
   get_str_list(plugins, plugins_list);
   for (list<string>::iterator i = plugins_list.begin();
@@ -24,6 +24,8 @@
 #include "common/ceph_mutex.h"
 #include "ErasureCodeInterface.h"
 
+class CephContext;
+
 extern "C" {
   const char *__erasure_code_version();
   int __erasure_code_init(char *plugin_name, char *directory);
@@ -43,6 +45,10 @@ namespace ceph {
 			ErasureCodeProfile &profile,
                         ErasureCodeInterfaceRef *erasure_code,
 			std::ostream *ss) = 0;
+
+    /// called once, when the registry has a context to configure the
+    /// plugin and report its perf counters to
+    virtual void set_context(CephContext *cct) {}
   };
 
   class ErasureCodePluginRegistry {
@@ -51,6 +57,8 @@ namespace ceph {
     bool loading = false;
     bool disable_dlclose = false;
     std::map<std::string,ErasureCodePlugin*> plugins;
+    /// set by preload(), passed to every plugin loaded from then on
+    CephContext *cct = nullptr;
 
     static ErasureCodePluginRegistry singleton;
 
@@ -82,7 +90,8 @@ namespace ceph {
 
     int preload(const std::string &plugins,
 		const std::string &directory,
-		std::ostream *ss);
+		std::ostream *ss,
+		CephContext *cct = nullptr);
   };
 }
 
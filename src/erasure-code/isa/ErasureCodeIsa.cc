@@ -118,47 +118,60 @@ int ErasureCodeIsa::decode_chunks(const set<int> &want_to_read,
 int ErasureCodeIsa::encode_chunks(const shard_id_map<bufferptr> &in,
                                        shard_id_map<bufferptr> &out)
 {
-  char *chunks[k + m]; //TODO don't use variable length arrays
-  memset(chunks, 0, sizeof(char*) * (k + m));
-  uint64_t size = 0;
+  encode_chunks_t chunks(k + m);
+  uint64_t size = chunks.set(in, out);
+  isa_encode(chunks.data(), chunks.coding(k), size);
+  return 0;
+}
 
-  for (auto &&[shard, ptr] : in) {
-    if (size == 0) {
-      size = ptr.length();
-    } else {
-      ceph_assert(size == ptr.length());
-    }
-    chunks[static_cast<int>(shard)] = const_cast<char*>(ptr.c_str());
+/* Encode every stripe of the batch in turn, sharing a single buffer of zeros
+ * for any shards that are missing from the stripes, rather than allocating
+ * and clearing one per stripe.
+ */
+int ErasureCodeIsa::encode_chunks_batch(encode_batch_t &batch)
+{
+  encode_chunks_t chunks(k + m);
+  for (auto &&[in, out] : batch) {
+    uint64_t size = chunks.set(in, out);
+    isa_encode(chunks.data(), chunks.coding(k), size);
   }
+  return 0;
+}
 
-  for (auto &&[shard, ptr] : out) {
-    if (size == 0) {
-      size = ptr.length();
-    } else {
-      ceph_assert(size == ptr.length());
+/* Encode the chunks a block at a time, calculating the crc32c of each block
+ * of the requested shards straight after it has been encoded, while it is
+ * still in cache. The crc32c of a shard is chained from block to block, so
+ * the result is the same as a single crc32c of the whole buffer.
+ */
+int ErasureCodeIsa::encode_chunks_with_crcs(const shard_id_map<bufferptr> &in,
+                                            shard_id_map<bufferptr> &out,
+                                            shard_id_map<uint32_t> &crcs)
+{
+  boost::container::small_vector<char*, 32> blocks(k + m);
+  encode_chunks_t encode_chunks(k + m);
+  uint64_t size = encode_chunks.set(in, out);
+  char **chunks = encode_chunks.data();
+  shard_id_set crc_shards;
+
+  for (auto &&[shard, _] : crcs) {
+    if (in.contains(shard) || out.contains(shard)) {
+      crc_shards.insert(shard);
     }
-    chunks[static_cast<int>(shard)] = ptr.c_str();
   }
 
-  char *zeros = nullptr;
-
-  for (shard_id_t i; i < k + m; ++i) {
-    if (in.contains(i) || out.contains(i)) {
-      continue;
-    }
-
-    if (zeros == nullptr) {
-      zeros = (char*)malloc(size);
-      memset(zeros, 0, size);
+  for (uint64_t off = 0; off < size; off += EC_ISA_CRC_BLOCK_SIZE) {
+    uint64_t len = std::min<uint64_t>(size - off, EC_ISA_CRC_BLOCK_SIZE);
+    for (int i = 0; i < k + m; i++) {
+      blocks[i] = chunks[i] + off;
     }
 
-    chunks[static_cast<int>(i)] = zeros;
-  }
-
-  isa_encode(&chunks[0], &chunks[k], size);
+    isa_encode(&blocks[0], &blocks[k], len);
 
-  if (zeros != nullptr) {
-    free(zeros);
+    for (auto shard : crc_shards) {
+      uint32_t &crc = crcs.at(shard);
+      crc = ceph_crc32c(crc, (unsigned char*)blocks[static_cast<int>(shard)],
+                        len);
+    }
   }
 
   return 0;
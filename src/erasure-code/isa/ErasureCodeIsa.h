@@ -34,6 +34,9 @@
 using namespace std::literals;
 
 #define EC_ISA_ADDRESS_ALIGNMENT 32u
+// encode_chunks_with_crcs works through the chunks in blocks of this size,
+// so that each block is still in cache when its crc32c is calculated
+#define EC_ISA_CRC_BLOCK_SIZE (32u * 1024u)
 
 #define is_aligned(POINTER, BYTE_COUNT) \
   (((uintptr_t)(const void *)(POINTER)) % (BYTE_COUNT) == 0)
@@ -107,6 +110,10 @@ public:
                     std::map<int, ceph::buffer::list> *encoded) override;
   int encode_chunks(const shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int encode_chunks_batch(encode_batch_t &batch) override;
+  int encode_chunks_with_crcs(const shard_id_map<bufferptr> &in,
+                              shard_id_map<bufferptr> &out,
+                              shard_id_map<uint32_t> &crcs) override;
 
   [[deprecated]]
   int decode_chunks(const std::set<int> &want_to_read,
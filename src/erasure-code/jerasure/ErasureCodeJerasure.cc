@@ -121,45 +121,23 @@ int ErasureCodeJerasure::encode_chunks(const set<int> &want_to_encode,
 int ErasureCodeJerasure::encode_chunks(const shard_id_map<bufferptr> &in,
                                        shard_id_map<bufferptr> &out)
 {
-  char *chunks[k + m]; //TODO don't use variable length arrays
-  memset(chunks, 0, sizeof(char*) * (k + m));
-  uint64_t size = 0;
-
-  for (auto &&[shard, ptr] : in) {
-    if (size == 0) {
-      size = ptr.length();
-    } else {
-      ceph_assert(size == ptr.length());
-    }
-    chunks[static_cast<int>(shard)] = const_cast<char*>(ptr.c_str());
-  }
-
-  for (auto &&[shard, ptr] : out) {
-    if (size == 0) {
-      size = ptr.length();
-    } else {
-      ceph_assert(size == ptr.length());
-    }
-    chunks[static_cast<int>(shard)] = ptr.c_str();
-  }
-
-  char *zeros = nullptr;
-
-  for (shard_id_t i; i < k + m; ++i) {
-    if (in.contains(i) || out.contains(i)) continue;
-
-    if (zeros == nullptr) {
-      zeros = (char*)malloc(size);
-      memset(zeros, 0, size);
-    }
+  encode_chunks_t chunks(k + m);
+  uint64_t size = chunks.set(in, out);
+  jerasure_encode(chunks.data(), chunks.coding(k), size);
+  return 0;
+}
 
-    chunks[static_cast<int>(i)] = zeros;
+/* Encode every stripe of the batch in turn, sharing a single buffer of zeros
+ * for any shards that are missing from the stripes, rather than allocating
+ * and clearing one per stripe.
+ */
+int ErasureCodeJerasure::encode_chunks_batch(encode_batch_t &batch)
+{
+  encode_chunks_t chunks(k + m);
+  for (auto &&[in, out] : batch) {
+    uint64_t size = chunks.set(in, out);
+    jerasure_encode(chunks.data(), chunks.coding(k), size);
   }
-
-  jerasure_encode(&chunks[0], &chunks[k], size);
-
-  if (zeros != nullptr) free(zeros);
-
   return 0;
 }
 
@@ -376,6 +354,103 @@ void ErasureCodeJerasure::schedule_apply_delta(const shard_id_map<bufferptr> &in
   }
 }
 
+/* Equivalent to jerasure_matrix_decode(k, m, w, matrix, 1, erasures, ...),
+ * except that the decoding matrix, which needs an O(k^3) inversion, is
+ * kept in the plugin's decode cache. The decoding matrix depends only on the
+ * code and on which chunks are lost, so while an OSD is down every degraded
+ * read of the PG can reuse it.
+ */
+int ErasureCodeJerasure::matrix_decode(int *matrix, int *erasures,
+                                       char **data, char **coding,
+                                       int blocksize)
+{
+  if (decode_cache == nullptr) {
+    return jerasure_matrix_decode(k, m, w, matrix, 1,
+                                  erasures, data, coding, blocksize);
+  }
+  if (w != 8 && w != 16 && w != 32) {
+    return -1;
+  }
+
+  int erased[k + m]; //TODO don't use variable length arrays
+  memset(erased, 0, sizeof(erased));
+  int erasures_count = 0;
+  for (int i = 0; erasures[i] != -1; i++) {
+    if (!erased[erasures[i]]) {
+      erased[erasures[i]] = 1;
+      erasures_count++;
+    }
+  }
+  if (erasures_count > m) {
+    return -1;
+  }
+
+  int lost_data = 0;
+  int last_data = k;
+  for (int i = 0; i < k; i++) {
+    if (erased[i]) {
+      lost_data++;
+      last_data = i;
+    }
+  }
+
+  // The first coding chunk is the xor of the data (row_k_ones), so a single
+  // lost data chunk can be recovered from it without a decoding matrix.
+  if (erased[k]) {
+    last_data = k;
+  }
+
+  ErasureCodeDecodeCache::table_ref_t table;
+  int *decoding_matrix = nullptr;
+  int *dm_ids = nullptr;
+  if (lost_data > 1 || (lost_data > 0 && erased[k])) {
+    std::string signature = std::string(technique) + " k=" +
+      std::to_string(k) + " m=" + std::to_string(m) + " w=" +
+      std::to_string(w) + " erased=";
+    for (int i = 0; i < k + m; i++) {
+      signature += erased[i] ? '1' : '0';
+    }
+
+    table = decode_cache->get(signature);
+    if (!table) {
+      ErasureCodeDecodeCache::table_t t(k * k + k);
+      if (jerasure_make_decoding_matrix(k, m, w, matrix, erased,
+                                        t.data(), t.data() + k * k) < 0) {
+        return -1;
+      }
+      table = decode_cache->put(signature, std::move(t));
+    }
+    decoding_matrix = const_cast<int*>(table->data());
+    dm_ids = decoding_matrix + k * k;
+  }
+
+  for (int i = 0; lost_data > 0 && i < last_data; i++) {
+    if (erased[i]) {
+      jerasure_matrix_dotprod(k, w, decoding_matrix + (i * k), dm_ids, i,
+                              data, coding, blocksize);
+      lost_data--;
+    }
+  }
+
+  if (lost_data > 0) {
+    int ids[k]; //TODO don't use variable length arrays
+    for (int i = 0; i < k; i++) {
+      ids[i] = (i < last_data) ? i : i + 1;
+    }
+    jerasure_matrix_dotprod(k, w, matrix, ids, last_data,
+                            data, coding, blocksize);
+  }
+
+  for (int i = 0; i < m; i++) {
+    if (erased[k + i]) {
+      jerasure_matrix_dotprod(k, w, matrix + (i * k), nullptr, i + k,
+                              data, coding, blocksize);
+    }
+  }
+
+  return 0;
+}
+
 //
 // ErasureCodeJerasureReedSolomonVandermonde
 //
@@ -391,8 +466,7 @@ int ErasureCodeJerasureReedSolomonVandermonde::jerasure_decode(int *erasures,
                                                                 char **coding,
                                                                 int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1,
-                                erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 void ErasureCodeJerasureReedSolomonVandermonde::apply_delta(const shard_id_map<bufferptr> &in,
@@ -449,7 +523,7 @@ int ErasureCodeJerasureReedSolomonRAID6::jerasure_decode(int *erasures,
                                                          char **coding,
                                                          int blocksize)
 {
-  return jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, coding, blocksize);
+  return matrix_decode(matrix, erasures, data, coding, blocksize);
 }
 
 void ErasureCodeJerasureReedSolomonRAID6::apply_delta(const shard_id_map<bufferptr> &in,
@@ -23,6 +23,7 @@
 
 #include "common/ceph_mutex.h"
 #include "erasure-code/ErasureCode.h"
+#include "erasure-code/ErasureCodeDecodeCache.h"
 
 using namespace std::literals;
 
@@ -39,6 +40,8 @@ public:
   std::string rule_failure_domain;
   bool per_chunk_alignment;
   uint64_t flags;
+  // decoding matrices, shared by all the instances of the plugin
+  ceph::ErasureCodeDecodeCache *decode_cache;
 
   explicit ErasureCodeJerasure(const char *_technique)
       : k(0),
@@ -48,7 +51,8 @@ public:
         w(0),
         DEFAULT_W("8"),
         technique(_technique),
-        per_chunk_alignment(false) {
+        per_chunk_alignment(false),
+        decode_cache(nullptr) {
     flags = FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
       FLAG_EC_PLUGIN_PARTIAL_WRITE_OPTIMIZATION |
       FLAG_EC_PLUGIN_ZERO_INPUT_ZERO_OUTPUT_OPTIMIZATION |
@@ -83,6 +87,7 @@ public:
         std::map<int, ceph::buffer::list> *encoded) override;
   int encode_chunks(const shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
+  int encode_chunks_batch(encode_batch_t &batch) override;
 
   [[deprecated]]
   int decode_chunks(const std::set<int> &want_to_read,
@@ -123,6 +128,9 @@ public:
 
   void do_scheduled_ops(char **ptrs, int **operations, int packetsize, int s, int d);
 
+  int matrix_decode(int *matrix, int *erasures,
+                    char **data, char **coding, int blocksize);
+
 protected:
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
 
@@ -61,6 +61,9 @@ int ErasureCodePluginJerasure::factory(const std::string& directory,
 	   << "cauchy_good, liberation, blaum_roth, liber8tion";
       return -ENOENT;
     }
+    if (decode_cache.enabled()) {
+      interface->decode_cache = &decode_cache;
+    }
     dout(20) << __func__ << ": " << profile << dendl;
     int r = interface->init(profile, ss);
     if (r) {
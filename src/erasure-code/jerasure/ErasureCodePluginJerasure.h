@@ -20,13 +20,20 @@
 #define CEPH_ERASURE_CODE_PLUGIN_JERASURE_H
 
 #include "erasure-code/ErasureCodePlugin.h"
+#include "erasure-code/ErasureCodeDecodeCache.h"
 
 class ErasureCodePluginJerasure : public ceph::ErasureCodePlugin {
 public:
+  ceph::ErasureCodeDecodeCache decode_cache{"jerasure"};
+
   int factory(const std::string& directory,
 	      ceph::ErasureCodeProfile &profile,
 	      ceph::ErasureCodeInterfaceRef *erasure_code,
 	      std::ostream *ss) override;
+
+  void set_context(CephContext *cct) override {
+    decode_cache.set_context(cct);
+  }
 };
 
 #endif
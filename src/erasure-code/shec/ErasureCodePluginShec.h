@@ -30,6 +30,10 @@ public:
 	      ceph::ErasureCodeProfile &profile,
 	      ceph::ErasureCodeInterfaceRef *erasure_code,
 	      std::ostream *ss) override;
+
+  void set_context(CephContext *cct) override {
+    tcache.set_context(cct);
+  }
 };
 
 #endif
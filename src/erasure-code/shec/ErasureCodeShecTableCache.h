@@ -23,61 +23,29 @@
 
 // -----------------------------------------------------------------------------
 #include "common/ceph_mutex.h"
+#include "erasure-code/ErasureCodeDecodeCache.h"
 #include "erasure-code/ErasureCodeInterface.h"
 // -----------------------------------------------------------------------------
-#include <list>
+#include <map>
+#include <string>
 // -----------------------------------------------------------------------------
 
 class ErasureCodeShecTableCache {
   // ---------------------------------------------------------------------------
   // This class implements a table cache for encoding and decoding matrices.
   // Encoding matrices are shared for the same (k,m,c,w) combination.
-  // It supplies a decoding matrix lru cache which is shared for identical
-  // matrix types e.g. there is one cache (lru-list + lru-map)
+  // It supplies a decoding matrix lru cache which is shared by all matrix
+  // types, with the matrix type as part of the key
   // ---------------------------------------------------------------------------
 
-  class DecodingCacheParameter {
-   public:
-    int* decoding_matrix;  // size: k*k
-    int* dm_row;  // size: k
-    int* dm_column;  // size: k
-    int* minimum;  // size: k+m
-    DecodingCacheParameter() {
-      decoding_matrix = nullptr;
-      dm_row = nullptr;
-      dm_column = nullptr;
-      minimum = nullptr;
-    }
-    ~DecodingCacheParameter() {
-      if (decoding_matrix) {
-        delete[] decoding_matrix;
-      }
-      if (dm_row) {
-        delete[] dm_row;
-      }
-      if (dm_column) {
-        delete[] dm_column;
-      }
-      if (minimum) {
-        delete[] minimum;
-      }
-    }
-  };
-
  public:
 
-  static const int decoding_tables_lru_length = 10000;
-  typedef std::pair<std::list<uint64_t>::iterator,
-                    DecodingCacheParameter> lru_entry_t;
   typedef std::map< int, int** > codec_table_t;
   typedef std::map< int, codec_table_t > codec_tables_t__;
   typedef std::map< int, codec_tables_t__ > codec_tables_t_;
   typedef std::map< int, codec_tables_t_ > codec_tables_t;
   typedef std::map< int, codec_tables_t > codec_technique_tables_t;
   // int** matrix = codec_technique_tables_t[technique][k][m][c][w]
-  
-  typedef std::map< uint64_t, lru_entry_t > lru_map_t;
-  typedef std::list< uint64_t > lru_list_t;
 
   ErasureCodeShecTableCache()  = default;
   virtual ~ErasureCodeShecTableCache();
@@ -98,22 +66,24 @@ class ErasureCodeShecTableCache {
                                int k, int m, int c, int w,
                                int* want, int* avails);
 
+  void set_context(CephContext *cct) {
+    decoding_cache.set_context(cct);
+  }
+
   int** getEncodingTable(int technique, int k, int m, int c, int w);
   int** getEncodingTableNoLock(int technique, int k, int m, int c, int w);
   int* setEncodingTable(int technique, int k, int m, int c, int w, int*);
   
  private:
   // encoding table accessed via table[matrix][k][m][c][w]
-  // decoding table cache accessed via map[matrixtype]
-  // decoding table lru list accessed via list[matrixtype]
+  // decoding tables are kept in the decode cache, keyed by matrix type and
+  // the decoding cache signature
   codec_technique_tables_t encoding_table;
-  std::map<int, lru_map_t*> decoding_tables;
-  std::map<int, lru_list_t*> decoding_tables_lru;
+  ceph::ErasureCodeDecodeCache decoding_cache{"shec"};
 
-  lru_map_t* getDecodingTables(int technique);
-  lru_list_t* getDecodingTablesLru(int technique);
-  uint64_t getDecodingCacheSignature(int k, int m, int c, int w,
-                                     int *want, int *avails);
+  std::string getDecodingCacheSignature(int technique,
+                                        int k, int m, int c, int w,
+                                        int *want, int *avails);
 
   ceph::mutex* getLock();
 };
@@ -629,7 +629,7 @@ int global_init_shutdown_stderr(CephContext *cct)
   return 0;
 }
 
-int global_init_preload_erasure_code(const CephContext *cct)
+int global_init_preload_erasure_code(CephContext *cct)
 {
   const auto& conf = cct->_conf;
   string plugins = conf->osd_erasure_code_plugins;
@@ -665,7 +665,8 @@ int global_init_preload_erasure_code(const CephContext *cct)
   int r = ceph::ErasureCodePluginRegistry::instance().preload(
     plugins,
     conf.get_val<std::string>("erasure_code_dir"),
-    &ss);
+    &ss,
+    cct);
   if (r)
     derr << ss.str() << dendl;
   else
@@ -91,9 +91,10 @@ int global_init_shutdown_stderr(CephContext *cct);
 
 /*
  * Preload the erasure coding libraries to detect early issues with
- * configuration.
+ * configuration, and give the plugins cct to configure their caches and
+ * report perf counters to.
  */
-int global_init_preload_erasure_code(const CephContext *cct);
+int global_init_preload_erasure_code(CephContext *cct);
 
 /**
  * print daemon startup banner/warning
@@ -340,6 +340,15 @@ struct error_code;
     void zero(bool crc_reset = true);
     void zero(unsigned o, unsigned l, bool crc_reset = true);
     unsigned append_zeros(unsigned l);
+    /// record crc32c(seed) of this ptr's data, calculated elsewhere, so
+    /// that list::crc32c() need not read the data again
+    void set_crc32c(uint32_t seed, uint32_t crc);
+    /// look up the cached crc32c(seed) of exactly this ptr's data, as
+    /// recorded by set_crc32c() or list::crc32c(); false if there is none
+    bool get_crc32c(uint32_t seed, uint32_t *crc) const;
+    /// forget any crc32c cached for the raw buffer; call this after writing
+    /// to the data through c_str()
+    void invalidate_crc();
 
 #ifdef WITH_CRIMSON
     /// create a temporary_buffer, copying the ptr as its deleter
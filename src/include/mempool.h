@@ -180,6 +180,7 @@ namespace mempool {
   f(pgmap)			      \
   f(mds_co)			      \
   f(ec_extent_cache)                  \
+  f(ec_decode_cache)                  \
   f(unittest_1)			      \
   f(unittest_2)
 
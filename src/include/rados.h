@@ -507,6 +507,8 @@ enum {
 									 * and handle them separately from normal ops,
 									 * apply scrub-specific behavior (e.g. bypassing clean cache)
 									 */
+	CEPH_OSD_OP_FLAG_EC_PARITY = 0x200, /* indata carries client-computed
+					     * EC parity after the data */
 };
 
 #define EOLDSNAPC    85  /* ORDERSNAP flag set; writer has old snapc*/
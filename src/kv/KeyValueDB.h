@@ -384,6 +384,8 @@ protected:
 public:
   typedef uint32_t IteratorOpts;
   static const uint32_t ITERATOR_NOCACHE = 1;
+  /// long forward scan; the backend may read ahead in the background
+  static const uint32_t ITERATOR_PREFETCH = 2;
 
   struct IteratorBounds {
     std::optional<std::string> lower_bound;
@@ -11,6 +11,7 @@
 #include <unordered_map>
 #include <errno.h>
 #include <unistd.h>
+#include <boost/container/small_vector.hpp>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -83,8 +84,10 @@ static bufferlist to_bufferlist(rocksdb::Slice in) {
   return bl;
 }
 
+typedef boost::container::small_vector<rocksdb::Slice, 4> slice_vector_t;
+
 static rocksdb::SliceParts prepare_sliceparts(const bufferlist &bl,
-					      vector<rocksdb::Slice> *slices)
+					      slice_vector_t *slices)
 {
   unsigned n = 0;
   for (auto& buf : bl.buffers()) {
@@ -95,6 +98,21 @@ static rocksdb::SliceParts prepare_sliceparts(const bufferlist &bl,
   return rocksdb::SliceParts(slices->data(), slices->size());
 }
 
+// The key of @p k under @p prefix in the default column family, as
+// slices of the caller's buffers; WriteBatch assembles it in place, so
+// no combined key is ever allocated.
+class combined_key_parts {
+  rocksdb::Slice parts[3];
+public:
+  combined_key_parts(const string& prefix, const char *k, size_t keylen)
+    : parts{rocksdb::Slice(prefix), rocksdb::Slice("\0", 1),
+	    rocksdb::Slice(k, keylen)} {}
+  combined_key_parts(const string& prefix, std::string_view k)
+    : combined_key_parts(prefix, k.data(), k.size()) {}
+  operator rocksdb::SliceParts() const {
+    return rocksdb::SliceParts(parts, 3);
+  }
+};
 
 //
 // One of these for the default rocksdb column family, routing each prefix
@@ -1275,6 +1293,15 @@ int RocksDBStore::do_open(ostream &out,
   plb.add_time_avg(l_rocksdb_write_delay_time, "rocksdb_write_delay_time", "Rocksdb write delay time");
   plb.add_time_avg(l_rocksdb_write_pre_and_post_process_time, 
       "rocksdb_write_pre_and_post_time", "total time spent on writing a record, excluding write process");
+  plb.add_u64_counter(l_rocksdb_rm_range_keys, "rm_range_keys", "Range removals");
+  plb.add_u64_counter(l_rocksdb_rm_range_delete_range, "rm_range_delete_range",
+    "Range removals done with a DeleteRange tombstone");
+  plb.add_u64_counter(l_rocksdb_iter_tombstones_skipped, "iter_tombstones_skipped",
+    "Tombstones skipped by iterators");
+  plb.add_u64_counter(l_rocksdb_tombstone_compact, "tombstone_compact",
+    "Compactions queued for ranges dense with tombstones");
+  plb.add_u64_counter(l_rocksdb_iter_prefetch_batches, "iter_prefetch_batches",
+    "Batches read ahead by prefetching shard iterators");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -1320,6 +1347,22 @@ void RocksDBStore::close()
     compact_queue_lock.unlock();
   }
 
+  // stop prefetch threads
+  prefetch_lock.lock();
+  prefetch_stop = true;
+  prefetch_cond.notify_all();
+  prefetch_lock.unlock();
+  for (auto& t : prefetch_threads) {
+    t->join();
+  }
+  prefetch_threads.clear();
+  // the workers drain the queue before exiting, so this only drops tasks
+  // with no thread to run them; their futures report broken_promise
+  prefetch_lock.lock();
+  prefetch_queue.clear();
+  prefetch_stop = false;
+  prefetch_lock.unlock();
+
   if (logger) {
     cct->get_perfcounters_collection()->remove(logger);
     delete logger;
@@ -1528,6 +1571,7 @@ void RocksDBStore::get_statistics(Formatter *f)
     f->open_object_section("rocksdbstore_perf_counters");
     logger->dump_formatted(f, false, select_labeled_t::unlabeled);
     f->close_section();
+    dump_tombstone_stats(f);
   }
   if (cct->_conf->rocksdb_collect_memory_stats) {
     f->open_object_section("rocksdb_memtable_statistics");
@@ -1567,6 +1611,14 @@ int RocksDBStore::submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Tra
   *_dout << " Rocksdb transaction: " << bat_txc.get_seen() << dendl;
   
   rocksdb::Status s = db->Write(woptions, &_t->bat);
+  // size new batches after the recent ones, so their buffer is not
+  // regrown key by key
+  // concurrent submitters must not lose each other's samples
+  size_t avg = batch_size_avg.load(std::memory_order_relaxed);
+  while (!batch_size_avg.compare_exchange_weak(
+	   avg, (avg * 7 + _t->bat.GetDataSize()) / 8,
+	   std::memory_order_relaxed)) {
+  }
   if (!s.ok()) {
     RocksWBHandler rocks_txc(*this, true);
     _t->bat.Iterate(&rocks_txc);
@@ -1626,6 +1678,7 @@ int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
 }
 
 RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
+  : bat(_db->get_batch_reserve())
 {
   db = _db;
 }
@@ -1633,21 +1686,17 @@ RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
 void RocksDBStore::RocksDBTransactionImpl::put_bat(
   rocksdb::WriteBatch& bat,
   rocksdb::ColumnFamilyHandle *cf,
-  const string &key,
+  const rocksdb::SliceParts &key,
   const bufferlist &to_set_bl)
 {
   // bufferlist::c_str() is non-constant, so we can't call c_str()
   if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-    bat.Put(cf,
-	    rocksdb::Slice(key),
-	    rocksdb::Slice(to_set_bl.buffers().front().c_str(),
-			   to_set_bl.length()));
+    rocksdb::Slice value(to_set_bl.buffers().front().c_str(),
+			 to_set_bl.length());
+    bat.Put(cf, key, rocksdb::SliceParts(&value, 1));
   } else {
-    rocksdb::Slice key_slice(key);
-    vector<rocksdb::Slice> value_slices(to_set_bl.get_num_buffers());
-    bat.Put(cf,
-	    rocksdb::SliceParts(&key_slice, 1),
-            prepare_sliceparts(to_set_bl, &value_slices));
+    slice_vector_t value_slices(to_set_bl.get_num_buffers());
+    bat.Put(cf, key, prepare_sliceparts(to_set_bl, &value_slices));
   }
 }
 
@@ -1667,10 +1716,10 @@ void RocksDBStore::RocksDBTransactionImpl::set(
 {
   auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
-    put_bat(bat, cf, k, to_set_bl);
+    rocksdb::Slice key(k);
+    put_bat(bat, cf, rocksdb::SliceParts(&key, 1), to_set_bl);
   } else {
-    string key = combine_strings(prefix, k);
-    put_bat(bat, db->default_cf, key, to_set_bl);
+    put_bat(bat, db->default_cf, combined_key_parts(prefix, k), to_set_bl);
   }
 }
 
@@ -1681,12 +1730,10 @@ void RocksDBStore::RocksDBTransactionImpl::set(
 {
   auto cf = db->get_cf_handle(prefix, k, keylen);
   if (cf) {
-    string key(k, keylen);  // fixme?
-    put_bat(bat, cf, key, to_set_bl);
+    rocksdb::Slice key(k, keylen);
+    put_bat(bat, cf, rocksdb::SliceParts(&key, 1), to_set_bl);
   } else {
-    string key;
-    combine_strings(prefix, k, keylen, &key);
-    put_bat(bat, cf, key, to_set_bl);
+    put_bat(bat, db->default_cf, combined_key_parts(prefix, k, keylen), to_set_bl);
   }
 }
 
@@ -1697,7 +1744,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k));
   } else {
-    bat.Delete(db->default_cf, combine_strings(prefix, k));
+    bat.Delete(db->default_cf, combined_key_parts(prefix, k));
   }
 }
 
@@ -1709,9 +1756,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k, keylen));
   } else {
-    string key;
-    combine_strings(prefix, k, keylen, &key);
-    bat.Delete(db->default_cf, rocksdb::Slice(key));
+    bat.Delete(db->default_cf, combined_key_parts(prefix, k, keylen));
   }
 }
 
@@ -1722,7 +1767,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
   if (cf) {
     bat.SingleDelete(cf, k);
   } else {
-    bat.SingleDelete(db->default_cf, combine_strings(prefix, k));
+    bat.SingleDelete(db->default_cf, combined_key_parts(prefix, k));
   }
 }
 
@@ -1734,7 +1779,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix
     bat.SetSavePoint();
     auto it = db->get_iterator(prefix);
     for (it->seek_to_first(); it->valid() && (--cnt) != 0; it->next()) {
-      bat.Delete(db->default_cf, combine_strings(prefix, it->key()));
+      bat.Delete(db->default_cf, combined_key_parts(prefix, it->key_as_sv()));
     }
     if (cnt == 0) {
 	bat.RollbackToSavePoint();
@@ -1774,6 +1819,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
                      << " enter prefix=" << prefix
                      << " start=" << pretty_binary_string(start)
 		     << " end=" << pretty_binary_string(end) << dendl;
+  db->logger->inc(l_rocksdb_rm_range_keys);
   auto p_iter = db->cf_handles.find(prefix);
   uint64_t cnt = db->get_delete_range_threshold();
   if (p_iter == db->cf_handles.end()) {
@@ -1783,7 +1829,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
     for (it->lower_bound(start);
 	 it->valid() && db->comparator->Compare(it->key(), end) < 0 && (--cnt) != 0;
 	 it->next()) {
-      bat.Delete(db->default_cf, combine_strings(prefix, it->key()));
+      bat.Delete(db->default_cf, combined_key_parts(prefix, it->key_as_sv()));
     }
     ldout(db->cct, 15) << __func__
                        << " count = " << cnt0 - cnt
@@ -1792,6 +1838,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
       ldout(db->cct, 10) << __func__ << " p_iter == end(), resorting to DeleteRange"
 			 << dendl;
       bat.RollbackToSavePoint();
+      db->logger->inc(l_rocksdb_rm_range_delete_range);
       bat.DeleteRange(db->default_cf,
 		      rocksdb::Slice(combine_strings(prefix, start)),
 		      rocksdb::Slice(combine_strings(prefix, end)));
@@ -1803,6 +1850,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
     for (auto cf : p_iter->second.handles) {
       ldout(db->cct, 10) << __func__ << " p_iter != end(), resorting to DeleteRange"
 			   << dendl;
+	db->logger->inc(l_rocksdb_rm_range_delete_range);
 	bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
     }
   } else {
@@ -1827,6 +1875,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
         ldout(db->cct, 10) << __func__ << " p_iter != end(), resorting to DeleteRange"
 			   << dendl;
 	bat.RollbackToSavePoint();
+	db->logger->inc(l_rocksdb_rm_range_delete_range);
 	bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
       } else {
 	bat.PopSavePoint();
@@ -1842,37 +1891,21 @@ void RocksDBStore::RocksDBTransactionImpl::merge(
   const bufferlist &to_set_bl)
 {
   auto cf = db->get_cf_handle(prefix, k);
-  if (cf) {
-    // bufferlist::c_str() is non-constant, so we can't call c_str()
-    if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-      bat.Merge(
-	cf,
-	rocksdb::Slice(k),
-	rocksdb::Slice(to_set_bl.buffers().front().c_str(), to_set_bl.length()));
-    } else {
-      // make a copy
-      rocksdb::Slice key_slice(k);
-      vector<rocksdb::Slice> value_slices(to_set_bl.get_num_buffers());
-      bat.Merge(cf, rocksdb::SliceParts(&key_slice, 1),
-		prepare_sliceparts(to_set_bl, &value_slices));
-    }
+  rocksdb::Slice key_slice(k);
+  rocksdb::SliceParts key(&key_slice, 1);
+  combined_key_parts combined_key(prefix, k);
+  if (!cf) {
+    cf = db->default_cf;
+    key = combined_key;
+  }
+  // bufferlist::c_str() is non-constant, so we can't call c_str()
+  if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
+    rocksdb::Slice value(to_set_bl.buffers().front().c_str(),
+			 to_set_bl.length());
+    bat.Merge(cf, key, rocksdb::SliceParts(&value, 1));
   } else {
-    string key = combine_strings(prefix, k);
-    // bufferlist::c_str() is non-constant, so we can't call c_str()
-    if (to_set_bl.is_contiguous() && to_set_bl.length() > 0) {
-      bat.Merge(
-	db->default_cf,
-	rocksdb::Slice(key),
-	rocksdb::Slice(to_set_bl.buffers().front().c_str(), to_set_bl.length()));
-    } else {
-      // make a copy
-      rocksdb::Slice key_slice(key);
-      vector<rocksdb::Slice> value_slices(to_set_bl.get_num_buffers());
-      bat.Merge(
-	db->default_cf,
-	rocksdb::SliceParts(&key_slice, 1),
-	prepare_sliceparts(to_set_bl, &value_slices));
-    }
+    slice_vector_t value_slices(to_set_bl.get_num_buffers());
+    bat.Merge(cf, key, prepare_sliceparts(to_set_bl, &value_slices));
   }
 }
 
@@ -2349,9 +2382,53 @@ void RocksDBStore::compact_thread_entry()
   dout(10) << __func__ << " exit" << dendl;
 }
 
+void RocksDBStore::prefetch_thread_entry()
+{
+  std::unique_lock l{prefetch_lock};
+  // drain the queue before stopping: iterators block on the futures of
+  // their queued reads
+  while (!prefetch_stop || !prefetch_queue.empty()) {
+    if (!prefetch_queue.empty()) {
+      auto task = std::move(prefetch_queue.front());
+      prefetch_queue.pop_front();
+      l.unlock();
+      task();
+      l.lock();
+      continue;
+    }
+    prefetch_cond.wait(l);
+  }
+}
+
+std::future<void> RocksDBStore::queue_prefetch(std::function<void()>&& f)
+{
+  std::packaged_task<void()> task(std::move(f));
+  auto ret = task.get_future();
+  std::lock_guard l(prefetch_lock);
+  if (prefetch_threads.empty()) {
+    uint64_t n = std::max<uint64_t>(
+      cct->_conf->rocksdb_iterator_prefetch_threads, 1);
+    dout(10) << __func__ << " starting " << n << " threads" << dendl;
+    for (uint64_t i = 0; i < n; ++i) {
+      prefetch_threads.emplace_back(std::make_unique<PrefetchThread>(this));
+      prefetch_threads.back()->create("rstore_prefetch");
+    }
+  }
+  prefetch_queue.push_back(std::move(task));
+  prefetch_cond.notify_one();
+  return ret;
+}
+
 void RocksDBStore::compact_range_async(const string& start, const string& end)
 {
   std::lock_guard l(compact_queue_lock);
+  if (compact_queue_stop) {
+    // close() already joined the compaction thread; an iterator that
+    // outlived it must not start a new one
+    dout(10) << __func__ << " stopped, dropping " << pretty_binary_string(start)
+	     << " .. " << pretty_binary_string(end) << dendl;
+    return;
+  }
 
   // try to merge adjacent ranges.  this is O(n), but the queue should
   // be short.  note that we do not cover all overlap cases and merge
@@ -2446,26 +2523,168 @@ void RocksDBStore::compact_range(const string& start, const string& end)
   }
 }
 
+RocksDBStore::TombstoneTracker::TombstoneTracker(RocksDBStore *db,
+						 const std::string& prefix,
+						 bool enable)
+  : db(db),
+    prefix(prefix),
+    threshold(enable ?
+	      db->cct->_conf->rocksdb_iterator_tombstone_compact_threshold : 0),
+    stat_prefix(prefix)
+{
+}
+
+std::string RocksDBStore::TombstoneTracker::combined(const rocksdb::Slice& key) const
+{
+  return prefix.empty() ? key.ToString() : combine_strings(prefix, key.ToString());
+}
+
+std::string RocksDBStore::TombstoneTracker::edge(bool upper) const
+{
+  if (stat_prefix.empty()) {
+    return upper ? string("\xff\xff\xff\xff") : string();  // cheating, see compact_range
+  }
+  return upper ? past_prefix(stat_prefix) : combine_strings(stat_prefix, string());
+}
+
+uint64_t RocksDBStore::TombstoneTracker::count()
+{
+  auto pc = rocksdb::get_perf_context();
+  // a range tombstone costs the iterator one reseek over the keys it
+  // covers; those keys are not counted one by one
+  return pc->internal_delete_skipped_count + pc->internal_range_del_reseek_count;
+}
+
+void RocksDBStore::TombstoneTracker::_begin()
+{
+  // the perf level is thread-local; raise it only for the duration of
+  // the op so that we do not leave the caller's thread counting
+  saved_level = rocksdb::GetPerfLevel();
+  level_raised = saved_level < rocksdb::PerfLevel::kEnableCount;
+  if (level_raised) {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+  }
+  base = count();
+}
+
+void RocksDBStore::TombstoneTracker::_cancel()
+{
+  if (level_raised) {
+    rocksdb::SetPerfLevel(saved_level);
+    level_raised = false;
+  }
+}
+
+void RocksDBStore::TombstoneTracker::_end(const rocksdb::Iterator *it,
+					  op_t op,
+					  const std::string& target)
+{
+  uint64_t now = count();
+  _cancel();
+  // submit_common() may have reset the perf context under us
+  uint64_t delta = now > base ? now - base : 0;
+  bool valid = it->Valid();
+  if (op == SEEK || op == SEEK_LAST) {
+    // a seek opens a new window
+    flush(false);
+    if (prefix.empty()) {
+      stat_prefix.clear();
+      if (split_key(target, &stat_prefix, nullptr) < 0 && valid) {
+	split_key(it->key(), &stat_prefix, nullptr);
+      }
+    }
+    start = (op == SEEK_LAST && target.empty()) ? edge(true) : combined(target);
+  }
+  if (valid) {
+    ++visited;
+  }
+  if (delta == 0) {
+    return;
+  }
+  skipped += delta;
+  db->logger->inc(l_rocksdb_iter_tombstones_skipped, delta);
+  if (skipped < threshold) {
+    return;
+  }
+  string here = valid ? combined(it->key()) : edge(op == SEEK || op == NEXT);
+  const string& lo = std::min(start, here);
+  const string& hi = std::max(start, here);
+  if (lo != hi) {
+    ldout(db->cct, 10) << __func__ << " " << skipped << " tombstones over "
+		       << pretty_binary_string(lo) << " .. "
+		       << pretty_binary_string(hi) << ", compacting" << dendl;
+    db->compact_range_async(lo, hi);
+    db->logger->inc(l_rocksdb_tombstone_compact);
+  }
+  flush(lo != hi);
+  start = std::move(here);
+}
+
+void RocksDBStore::TombstoneTracker::flush(bool compacted)
+{
+  if (skipped) {
+    db->note_tombstones(stat_prefix, skipped, visited, compacted);
+  }
+  skipped = 0;
+  visited = 0;
+}
+
+void RocksDBStore::note_tombstones(const std::string& prefix,
+				   uint64_t skipped,
+				   uint64_t visited,
+				   bool compacted)
+{
+  std::lock_guard l(tombstone_stats_lock);
+  auto& s = tombstone_stats[prefix];
+  s.skipped += skipped;
+  s.visited += visited;
+  if (compacted) {
+    ++s.compactions;
+  }
+}
+
+void RocksDBStore::dump_tombstone_stats(Formatter *f)
+{
+  std::lock_guard l(tombstone_stats_lock);
+  f->open_array_section("iterator_tombstones");
+  for (auto& [prefix, s] : tombstone_stats) {
+    f->open_object_section("prefix");
+    f->dump_string("prefix", pretty_binary_string(prefix));
+    f->dump_unsigned("skipped", s.skipped);
+    f->dump_unsigned("visited", s.visited);
+    f->dump_float("density", (double)s.skipped / (s.skipped + s.visited));
+    f->dump_unsigned("compactions", s.compactions);
+    f->close_section();
+  }
+  f->close_section();
+}
+
 RocksDBStore::RocksDBWholeSpaceIteratorImpl::~RocksDBWholeSpaceIteratorImpl()
 {
   delete dbiter;
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_first()
 {
+  tombstones.begin();
   dbiter->SeekToFirst();
+  tombstones.end(dbiter, TombstoneTracker::SEEK);
   ceph_assert(!dbiter->status().IsIOError());
   return dbiter->status().ok() ? 0 : -1;
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_first(const string &prefix)
 {
   rocksdb::Slice slice_prefix(prefix);
+  tombstones.begin();
   dbiter->Seek(slice_prefix);
+  tombstones.end(dbiter, TombstoneTracker::SEEK, prefix);
   ceph_assert(!dbiter->status().IsIOError());
   return dbiter->status().ok() ? 0 : -1;
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_last()
 {
+  tombstones.begin();
   dbiter->SeekToLast();
+  tombstones.end(dbiter, TombstoneTracker::SEEK_LAST);
   ceph_assert(!dbiter->status().IsIOError());
   return dbiter->status().ok() ? 0 : -1;
 }
@@ -2473,6 +2692,7 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_last(const string &pref
 {
   string limit = past_prefix(prefix);
   rocksdb::Slice slice_limit(limit);
+  tombstones.begin();
   dbiter->Seek(slice_limit);
 
   if (!dbiter->Valid()) {
@@ -2480,6 +2700,7 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_last(const string &pref
   } else {
     dbiter->Prev();
   }
+  tombstones.end(dbiter, TombstoneTracker::SEEK_LAST, limit);
   return dbiter->status().ok() ? 0 : -1;
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::upper_bound(const string &prefix, const string &after)
@@ -2496,7 +2717,9 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::lower_bound(const string &prefi
 {
   string bound = combine_strings(prefix, to);
   rocksdb::Slice slice_bound(bound);
+  tombstones.begin();
   dbiter->Seek(slice_bound);
+  tombstones.end(dbiter, TombstoneTracker::SEEK, bound);
   return dbiter->status().ok() ? 0 : -1;
 }
 bool RocksDBStore::RocksDBWholeSpaceIteratorImpl::valid()
@@ -2506,7 +2729,9 @@ bool RocksDBStore::RocksDBWholeSpaceIteratorImpl::valid()
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::next()
 {
   if (valid()) {
+    tombstones.begin();
     dbiter->Next();
+    tombstones.end(dbiter, TombstoneTracker::NEXT);
   }
   ceph_assert(!dbiter->status().IsIOError());
   return dbiter->status().ok() ? 0 : -1;
@@ -2514,7 +2739,9 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::next()
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::prev()
 {
   if (valid()) {
+    tombstones.begin();
     dbiter->Prev();
+    tombstones.end(dbiter, TombstoneTracker::PREV);
   }
   ceph_assert(!dbiter->status().IsIOError());
   return dbiter->status().ok() ? 0 : -1;
@@ -2600,14 +2827,16 @@ protected:
   const KeyValueDB::IteratorBounds bounds;
   const rocksdb::Slice iterate_lower_bound;
   const rocksdb::Slice iterate_upper_bound;
+  RocksDBStore::TombstoneTracker tombstones;
 public:
-  explicit CFIteratorImpl(const RocksDBStore* db,
+  explicit CFIteratorImpl(RocksDBStore* db,
                           const std::string& p,
                           rocksdb::ColumnFamilyHandle* cf,
                           KeyValueDB::IteratorBounds bounds_)
     : prefix(p), bounds(std::move(bounds_)),
       iterate_lower_bound(make_slice(bounds.lower_bound)),
-      iterate_upper_bound(make_slice(bounds.upper_bound))
+      iterate_upper_bound(make_slice(bounds.upper_bound)),
+      tombstones(db, p)
       {
       auto options = rocksdb::ReadOptions();
       if (db->cct->_conf->osd_rocksdb_iterator_bounds_enabled) {
@@ -2625,11 +2854,15 @@ public:
   }
 
   int seek_to_first() override {
+    tombstones.begin();
     dbiter->SeekToFirst();
+    tombstones.end(dbiter, RocksDBStore::TombstoneTracker::SEEK);
     return dbiter->status().ok() ? 0 : -1;
   }
   int seek_to_last() override {
+    tombstones.begin();
     dbiter->SeekToLast();
+    tombstones.end(dbiter, RocksDBStore::TombstoneTracker::SEEK_LAST);
     return dbiter->status().ok() ? 0 : -1;
   }
   int upper_bound(const string &after) override {
@@ -2641,18 +2874,24 @@ public:
   }
   int lower_bound(const string &to) override {
     rocksdb::Slice slice_bound(to);
+    tombstones.begin();
     dbiter->Seek(slice_bound);
+    tombstones.end(dbiter, RocksDBStore::TombstoneTracker::SEEK, to);
     return dbiter->status().ok() ? 0 : -1;
   }
   int next() override {
     if (valid()) {
+      tombstones.begin();
       dbiter->Next();
+      tombstones.end(dbiter, RocksDBStore::TombstoneTracker::NEXT);
     }
     return dbiter->status().ok() ? 0 : -1;
   }
   int prev() override {
     if (valid()) {
+      tombstones.begin();
       dbiter->Prev();
+      tombstones.end(dbiter, RocksDBStore::TombstoneTracker::PREV);
     }
     return dbiter->status().ok() ? 0 : -1;
   }
@@ -3192,17 +3431,21 @@ private:
   const rocksdb::Slice iterate_lower_bound;
   const rocksdb::Slice iterate_upper_bound;
   std::vector<rocksdb::Iterator*> iters;
+  RocksDBStore::TombstoneTracker tombstones;
 public:
-  explicit ShardMergeIteratorImpl(const RocksDBStore* db,
+  explicit ShardMergeIteratorImpl(RocksDBStore* db,
 				  const std::string& prefix,
 				  const std::vector<rocksdb::ColumnFamilyHandle*>& shards,
-                  KeyValueDB::IteratorBounds bounds_)
+                  KeyValueDB::IteratorBounds bounds_,
+				  const rocksdb::Snapshot* snapshot = nullptr)
     : db(db), keyless(db->comparator), prefix(prefix), bounds(std::move(bounds_)),
       iterate_lower_bound(make_slice(bounds.lower_bound)),
-      iterate_upper_bound(make_slice(bounds.upper_bound))
+      iterate_upper_bound(make_slice(bounds.upper_bound)),
+      tombstones(db, prefix)
   {
     iters.reserve(shards.size());
     auto options = rocksdb::ReadOptions();
+    options.snapshot = snapshot;
     if (db->cct->_conf->osd_rocksdb_iterator_bounds_enabled) {
       if (bounds.lower_bound) {
         options.iterate_lower_bound = &iterate_lower_bound;
@@ -3221,20 +3464,25 @@ public:
     }
   }
   int seek_to_first() override {
+    tombstones.begin();
     for (auto& it : iters) {
       it->SeekToFirst();
       if (!it->status().ok()) {
+	tombstones.cancel();
 	return -1;
       }
     }
     //all iterators seeked, sort
     std::sort(iters.begin(), iters.end(), keyless);
+    tombstones.end(iters[0], RocksDBStore::TombstoneTracker::SEEK);
     return 0;
   }
   int seek_to_last() override {
+    tombstones.begin();
     for (auto& it : iters) {
       it->SeekToLast();
       if (!it->status().ok()) {
+	tombstones.cancel();
 	return -1;
       }
     }
@@ -3258,36 +3506,44 @@ public:
       }
     }
     //no need to sort, as at most 1 iterator is valid now
+    tombstones.end(iters[0], RocksDBStore::TombstoneTracker::SEEK_LAST);
     return 0;
   }
   int upper_bound(const string &after) override {
     rocksdb::Slice slice_bound(after);
+    tombstones.begin();
     for (auto& it : iters) {
       it->Seek(slice_bound);
       if (it->Valid() && it->key() == after) {
 	it->Next();
       }
       if (!it->status().ok()) {
+	tombstones.cancel();
 	return -1;
       }
     }
     std::sort(iters.begin(), iters.end(), keyless);
+    tombstones.end(iters[0], RocksDBStore::TombstoneTracker::SEEK, after);
     return 0;
   }
   int lower_bound(const string &to) override {
     rocksdb::Slice slice_bound(to);
+    tombstones.begin();
     for (auto& it : iters) {
       it->Seek(slice_bound);
       if (!it->status().ok()) {
+	tombstones.cancel();
 	return -1;
       }
     }
     std::sort(iters.begin(), iters.end(), keyless);
+    tombstones.end(iters[0], RocksDBStore::TombstoneTracker::SEEK, to);
     return 0;
   }
   int next() override {
     int r = -1;
     if (iters[0]->Valid()) {
+      tombstones.begin();
       iters[0]->Next();
       if (iters[0]->status().ok()) {
 	r = 0;
@@ -3300,6 +3556,7 @@ public:
 	  std::swap(iters[i], iters[i + 1]);
 	}
       }
+      tombstones.end(iters[0], RocksDBStore::TombstoneTracker::NEXT);
     }
     return r;
   }
@@ -3317,6 +3574,7 @@ public:
   // 4. sort
   int prev() override {
     std::vector<rocksdb::Iterator*> prev_done;
+    tombstones.begin();
     //1
     for (auto it: iters) {
       if (it->Valid()) {
@@ -3339,6 +3597,7 @@ public:
 	iters[0]->Prev();
 	ceph_assert(!iters[0]->Valid());
       }
+      tombstones.end(iters[0], RocksDBStore::TombstoneTracker::PREV);
       return 0;
     }
     //2,3
@@ -3360,6 +3619,7 @@ public:
       if (hold == highest) break;
     }
     ceph_assert(hold == highest);
+    tombstones.end(iters[0], RocksDBStore::TombstoneTracker::PREV);
     return 0;
   }
   bool valid() override {
@@ -3393,6 +3653,259 @@ public:
   }
 };
 
+// Merges the shards of a prefix like ShardMergeIteratorImpl, but each
+// shard is read in batches, and the next batch of every shard is fetched
+// by RocksDBStore's prefetch threads while the current ones are merged.
+// A long forward scan then waits for the slowest shard instead of for
+// each shard's block reads in turn.  Moving backwards is handed over to
+// a plain ShardMergeIteratorImpl positioned at the current key.
+class ShardPrefetchIteratorImpl : public KeyValueDB::IteratorImpl {
+private:
+  typedef std::vector<std::pair<string, bufferptr>> batch_t;
+  struct shard_t {
+    rocksdb::Iterator* it = nullptr;
+    batch_t cur;       ///< batch being merged
+    size_t pos = 0;    ///< position in cur
+    batch_t next;      ///< batch being read ahead
+    bool eof = false;  ///< it has nothing past the last batch read
+    bool ok = true;
+    std::future<void> pending;
+  };
+
+  RocksDBStore* db;
+  string prefix;
+  const std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  const KeyValueDB::IteratorBounds bounds;
+  const rocksdb::Slice iterate_lower_bound;
+  const rocksdb::Slice iterate_upper_bound;
+  const size_t batch;
+  std::vector<shard_t> shards;
+  shard_t* current = nullptr;  ///< shard holding the smallest key
+  bool backward = false;
+  /// shared by the shard iterators and the fallback, so that turning
+  /// backward does not let in writes made since we were created
+  const rocksdb::Snapshot* snapshot;
+  std::unique_ptr<ShardMergeIteratorImpl> fallback;
+
+  void read_batch(shard_t& s, batch_t& out) {
+    out.clear();
+    while (out.size() < batch && s.it->Valid()) {
+      rocksdb::Slice v = s.it->value();
+      out.emplace_back(s.it->key().ToString(), bufferptr(v.data(), v.size()));
+      s.it->Next();
+    }
+    s.ok = s.it->status().ok();
+    s.eof = !s.it->Valid();
+    if (!out.empty()) {
+      db->logger->inc(l_rocksdb_iter_prefetch_batches);
+    }
+  }
+  void read_ahead(shard_t& s) {
+    if (!s.eof) {
+      s.pending = db->queue_prefetch([this, &s] { read_batch(s, s.next); });
+    }
+  }
+  void wait() {
+    for (auto& s : shards) {
+      if (s.pending.valid()) {
+	s.pending.get();
+      }
+    }
+  }
+  void wait_noexcept() noexcept {
+    for (auto& s : shards) {
+      if (s.pending.valid()) {
+	try {
+	  s.pending.get();
+	} catch (const std::future_error&) {
+	  // the task was dropped unrun (broken_promise); nothing to wait for
+	}
+      }
+    }
+  }
+  void pick() {
+    current = nullptr;
+    for (auto& s : shards) {
+      if (s.pos < s.cur.size() &&
+	  (!current ||
+	   db->comparator->Compare(s.cur[s.pos].first,
+				   current->cur[current->pos].first) < 0)) {
+	current = &s;
+      }
+    }
+  }
+  template <typename Seek>
+  int seek(Seek&& how) {
+    backward = false;
+    wait();
+    // position all shards in parallel, then start reading ahead
+    std::vector<std::future<void>> seeks;
+    seeks.reserve(shards.size());
+    for (auto& s : shards) {
+      s.pos = 0;
+      seeks.push_back(db->queue_prefetch([this, &s, &how] {
+	how(s.it);
+	read_batch(s, s.cur);
+      }));
+    }
+    for (auto& f : seeks) {
+      f.get();
+    }
+    int r = 0;
+    for (auto& s : shards) {
+      if (!s.ok) {
+	r = -1;
+      }
+      read_ahead(s);
+    }
+    pick();
+    return r;
+  }
+  ShardMergeIteratorImpl* turn_backward() {
+    if (!fallback) {
+      fallback = std::make_unique<ShardMergeIteratorImpl>(
+	db, prefix, handles, bounds, snapshot);
+    }
+    backward = true;
+    return fallback.get();
+  }
+  const std::pair<string, bufferptr>& cur() const {
+    return current->cur[current->pos];
+  }
+
+public:
+  ShardPrefetchIteratorImpl(RocksDBStore* db,
+			    const std::string& prefix,
+			    const std::vector<rocksdb::ColumnFamilyHandle*>& handles,
+			    KeyValueDB::IteratorOpts opts,
+			    KeyValueDB::IteratorBounds bounds_)
+    : db(db), prefix(prefix), handles(handles), bounds(std::move(bounds_)),
+      iterate_lower_bound(make_slice(bounds.lower_bound)),
+      iterate_upper_bound(make_slice(bounds.upper_bound)),
+      batch(std::max<uint64_t>(db->cct->_conf->rocksdb_iterator_prefetch_batch, 1)),
+      shards(handles.size()),
+      snapshot(db->db->GetSnapshot())
+  {
+    auto options = rocksdb::ReadOptions();
+    options.snapshot = snapshot;
+    if (opts & KeyValueDB::ITERATOR_NOCACHE) {
+      options.fill_cache = false;
+    }
+    if (db->cct->_conf->osd_rocksdb_iterator_bounds_enabled) {
+      if (bounds.lower_bound) {
+        options.iterate_lower_bound = &iterate_lower_bound;
+      }
+      if (bounds.upper_bound) {
+        options.iterate_upper_bound = &iterate_upper_bound;
+      }
+    }
+    for (size_t i = 0; i < handles.size(); i++) {
+      shards[i].it = db->db->NewIterator(options, handles[i]);
+    }
+  }
+  ~ShardPrefetchIteratorImpl() {
+    wait_noexcept();
+    fallback.reset();
+    for (auto& s : shards) {
+      delete s.it;
+    }
+    db->db->ReleaseSnapshot(snapshot);
+  }
+  int seek_to_first() override {
+    return seek([](rocksdb::Iterator* it) { it->SeekToFirst(); });
+  }
+  int seek_to_last() override {
+    return turn_backward()->seek_to_last();
+  }
+  int upper_bound(const string &after) override {
+    int r = lower_bound(after);
+    if (r == 0 && valid() && key() == after) {
+      r = next();
+    }
+    return r;
+  }
+  int lower_bound(const string &to) override {
+    rocksdb::Slice slice_bound(to);
+    return seek([&slice_bound](rocksdb::Iterator* it) { it->Seek(slice_bound); });
+  }
+  int next() override {
+    if (backward) {
+      return fallback->next();
+    }
+    if (!current) {
+      return -1;
+    }
+    shard_t& s = *current;
+    if (++s.pos == s.cur.size()) {
+      s.cur.clear();
+      s.pos = 0;
+      if (s.pending.valid()) {
+	s.pending.get();
+	s.cur.swap(s.next);
+	read_ahead(s);
+      }
+    }
+    pick();
+    return s.ok ? 0 : -1;
+  }
+  int prev() override {
+    if (backward) {
+      return fallback->prev();
+    }
+    if (!current) {
+      // past the end; prev() is the last key
+      return turn_backward()->seek_to_last();
+    }
+    string k = cur().first;
+    auto f = turn_backward();
+    int r = f->lower_bound(k);
+    return r == 0 ? f->prev() : r;
+  }
+  bool valid() override {
+    return backward ? fallback->valid() : current != nullptr;
+  }
+  string key() override {
+    return backward ? fallback->key() : cur().first;
+  }
+  string_view key_as_sv() override {
+    return backward ? fallback->key_as_sv() : string_view(cur().first);
+  }
+  std::pair<std::string, std::string> raw_key() override {
+    return make_pair(prefix, key());
+  }
+  std::pair<std::string_view, std::string_view> raw_key_as_sv() override {
+    return make_pair(prefix, key_as_sv());
+  }
+  bufferlist value() override {
+    if (backward) {
+      return fallback->value();
+    }
+    bufferlist bl;
+    bl.append(cur().second);
+    return bl;
+  }
+  bufferptr value_as_ptr() override {
+    return backward ? fallback->value_as_ptr() : cur().second;
+  }
+  std::string_view value_as_sv() override {
+    if (backward) {
+      return fallback->value_as_sv();
+    }
+    return std::string_view{cur().second.c_str(), cur().second.length()};
+  }
+  int status() override {
+    if (backward) {
+      return fallback->status();
+    }
+    for (auto& s : shards) {
+      if (!s.ok) {
+	return -1;
+      }
+    }
+    return 0;
+  }
+};
+
 KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix, IteratorOpts opts, IteratorBounds bounds)
 {
   auto cf_it = cf_handles.find(prefix);
@@ -3409,6 +3922,14 @@ KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix, Itera
               prefix,
               cf,
               std::move(bounds));
+    } else if ((opts & ITERATOR_PREFETCH) &&
+	       cct->_conf->rocksdb_iterator_prefetch_threads > 0) {
+      return std::make_shared<ShardPrefetchIteratorImpl>(
+        this,
+        prefix,
+        cf_it->second.handles,
+        opts,
+        std::move(bounds));
     } else {
       return std::make_shared<ShardMergeIteratorImpl>(
         this,
@@ -10,6 +10,10 @@
 #include "include/types.h"
 #include "include/buffer_fwd.h"
 #include "KeyValueDB.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
 #include <set>
 #include <map>
 #include <string>
@@ -49,6 +53,11 @@ enum {
   l_rocksdb_write_memtable_time,
   l_rocksdb_write_delay_time,
   l_rocksdb_write_pre_and_post_process_time,
+  l_rocksdb_rm_range_keys,
+  l_rocksdb_rm_range_delete_range,
+  l_rocksdb_iter_tombstones_skipped,
+  l_rocksdb_tombstone_compact,
+  l_rocksdb_iter_prefetch_batches,
   l_rocksdb_last,
 };
 
@@ -99,6 +108,7 @@ class RocksDBStore : public KeyValueDB {
   uint64_t cache_size = 0;
   bool set_cache_flag = false;
   friend class ShardMergeIteratorImpl;
+  friend class ShardPrefetchIteratorImpl;
   friend class CFIteratorImpl;
   friend class WholeMergeIteratorImpl;
   friend struct RocksWBHandler;
@@ -205,11 +215,48 @@ private:
 
   void compact_thread_entry();
 
+  // read-ahead workers shared by ShardPrefetchIteratorImpl
+  ceph::mutex prefetch_lock =
+    ceph::make_mutex("RocksDBStore::prefetch_lock");
+  ceph::condition_variable prefetch_cond;
+  std::deque<std::packaged_task<void()>> prefetch_queue;
+  bool prefetch_stop = false;
+  class PrefetchThread : public Thread {
+    RocksDBStore *db;
+  public:
+    explicit PrefetchThread(RocksDBStore *d) : db(d) {}
+    void *entry() override {
+      db->prefetch_thread_entry();
+      return NULL;
+    }
+  };
+  std::vector<std::unique_ptr<PrefetchThread>> prefetch_threads;
+
+  void prefetch_thread_entry();
+  std::future<void> queue_prefetch(std::function<void()>&& f);
+
   void compact_range(const std::string& start, const std::string& end);
   void compact_range_async(const std::string& start, const std::string& end);
+
+  // tombstones seen by iterators, per prefix
+  struct tombstone_stat_t {
+    uint64_t skipped = 0;      ///< tombstones stepped over
+    uint64_t visited = 0;      ///< live keys landed on in the same windows
+    uint64_t compactions = 0;  ///< compactions queued because of them
+  };
+  ceph::mutex tombstone_stats_lock =
+    ceph::make_mutex("RocksDBStore::tombstone_stats_lock");
+  std::map<std::string, tombstone_stat_t> tombstone_stats;
+  void note_tombstones(const std::string& prefix, uint64_t skipped,
+		       uint64_t visited, bool compacted);
+  void dump_tombstone_stats(ceph::Formatter *f);
+
   int tryInterpret(const std::string& key, const std::string& val,
 		   rocksdb::Options& opt);
 
+  /// running average of submitted WriteBatch sizes
+  std::atomic<size_t> batch_size_avg = {0};
+
 public:
   /// compact the underlying rocksdb store
   bool compact_on_mount;
@@ -217,6 +264,11 @@ public:
   uint64_t get_delete_range_threshold() const {
     return cct->_conf.get_val<uint64_t>("rocksdb_delete_range_threshold");
   }
+  /// bytes to reserve up front in a new transaction's WriteBatch
+  size_t get_batch_reserve() const {
+    return std::min<size_t>(batch_size_avg.load(std::memory_order_relaxed),
+			    cct->_conf->rocksdb_write_batch_reserve_max);
+  }
 
   KeyValueDB::BackupStats backup(const std::string &path) override;
   KeyValueDB::BackupCleanupStats backup_cleanup(const std::string &path,
@@ -327,7 +379,7 @@ public:
     void put_bat(
       rocksdb::WriteBatch& bat,
       rocksdb::ColumnFamilyHandle *cf,
-      const std::string &k,
+      const rocksdb::SliceParts &k,
       const ceph::bufferlist &to_set_bl);
 
   public:
@@ -393,14 +445,77 @@ public:
     ceph::bufferlist *out) override;
 
 
+  /**
+   * Counts the tombstones an iterator steps over, using rocksdb's
+   * thread-local perf context, and queues a compaction of the range it
+   * has just crawled through once rocksdb_iterator_tombstone_compact_threshold
+   * of them piled up since the last seek (or the last such compaction).
+   *
+   * A range tombstone counts once per reseek past it, not once per key it
+   * covers, so ranges removed with DeleteRange contribute little.
+   */
+  class TombstoneTracker {
+  public:
+    enum op_t { SEEK, SEEK_LAST, NEXT, PREV };
+  private:
+    RocksDBStore *db;
+    const std::string prefix;  ///< column prefix, empty if keys are combined
+    const uint64_t threshold;  ///< 0 if tracking is disabled
+    uint64_t base = 0;         ///< perf context count before the current op
+    rocksdb::PerfLevel saved_level = rocksdb::PerfLevel::kDisable;
+    bool level_raised = false; ///< perf level bumped to kEnableCount by us
+    uint64_t skipped = 0;      ///< tombstones skipped in this window
+    uint64_t visited = 0;      ///< keys landed on in this window
+    std::string start;         ///< combined key the window began at
+    std::string stat_prefix;   ///< prefix the window is accounted to
+
+    std::string combined(const rocksdb::Slice& key) const;
+    std::string edge(bool upper) const;
+    static uint64_t count();
+    void _begin();
+    void _cancel();
+    void _end(const rocksdb::Iterator *it, op_t op, const std::string& target);
+    void flush(bool compacted);
+  public:
+    TombstoneTracker(RocksDBStore *db, const std::string& prefix,
+                     bool enable = true);
+    ~TombstoneTracker() {
+      if (threshold) {
+        flush(false);
+      }
+    }
+    /// call before repositioning the underlying rocksdb iterator(s)
+    void begin() {
+      if (threshold) {
+        _begin();
+      }
+    }
+    /// call instead of end() if the op bails out on an error
+    void cancel() {
+      if (threshold) {
+        _cancel();
+      }
+    }
+    /// call after; @p it is the iterator now holding the current key and
+    /// @p target the key a seek was aimed at
+    void end(const rocksdb::Iterator *it, op_t op,
+             const std::string& target = std::string()) {
+      if (threshold) {
+        _end(it, op, target);
+      }
+    }
+  };
+
   class RocksDBWholeSpaceIteratorImpl :
     public KeyValueDB::WholeSpaceIteratorImpl {
   protected:
     rocksdb::Iterator *dbiter;
+    TombstoneTracker tombstones;
   public:
-    explicit RocksDBWholeSpaceIteratorImpl(const RocksDBStore* db,
+    explicit RocksDBWholeSpaceIteratorImpl(RocksDBStore* db,
                                            rocksdb::ColumnFamilyHandle* cf,
                                            const KeyValueDB::IteratorOpts opts)
+      : tombstones(db, std::string(), cf == db->default_cf)
       {
         rocksdb::ReadOptions options = rocksdb::ReadOptions();
         if (opts & ITERATOR_NOCACHE)
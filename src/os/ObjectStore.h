@@ -45,6 +45,10 @@ namespace ceph {
   class Formatter;
 }
 
+namespace PriorityCache {
+  struct PriCache;
+}
+
 /*
  * low-level interface to the local OSD file system
  */
@@ -289,6 +293,17 @@ public:
 
   virtual void set_cache_shards(unsigned num) { }
 
+  /**
+   * Let a cache owned by the caller take part in the store's cache memory
+   * autotuning, if the store does any.  The store keeps a reference to the
+   * cache until it is removed or the store is unmounted, so this must be
+   * called after mount().
+   */
+  virtual void add_priority_cache(
+    const std::string& name,
+    std::shared_ptr<PriorityCache::PriCache> cache) { }
+  virtual void remove_priority_cache(const std::string& name) { }
+
   /**
    * Returns 0 if the hobject is valid, -error otherwise
    *
@@ -517,7 +532,8 @@ public:
    * caller must call fiemap to fill in the extent-map first.
    *
    * Note: if reading from an offset past the end of the object, we
-   * return 0 (not, say, -EINVAL). Also the default version of readv
+   * return 0 (not, say, -EINVAL), and intervals past the end of the
+   * object are trimmed from m. Also the default version of readv
    * reads each extent separately synchronously, which can become horribly
    * inefficient if the physical layout of the pushing object get massively
    * fragmented and hence should be overridden by any real os that
@@ -59,6 +59,7 @@ Allocator *Allocator::create(
     return new HybridBtree2Allocator(cct, size, block_size,
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       cct->_conf.get_val<double>("bluestore_btree2_alloc_weight_factor"),
+      cct->_conf.get_val<bool>("bluestore_btree2_alloc_size_classes"),
       name);
   }
   if (alloc == nullptr) {
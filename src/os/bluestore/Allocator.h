@@ -71,6 +71,12 @@ public:
     return 0.0;
   }
   virtual double get_fragmentation_score();
+  /*
+   * Merge free space kept outside of the main free index (e.g. recently
+   * released extents cached for reuse) back into it, so that it can
+   * coalesce with its neighbours. Called periodically from the background.
+   */
+  virtual void defrag_free_space() {}
   virtual void shutdown() = 0;
 
   static Allocator *create(
@@ -256,6 +256,16 @@ protected:
         buckets[i].foreach(cb);
       }
     }
+    // takes every cached extent out
+    void drain(std::function<void(uint64_t offset, uint64_t length)> notify) {
+      std::unique_lock _lock(lock);
+      for (uint64_t i = 0; i < buckets.size(); i++) {
+        uint64_t o;
+        while (buckets[i].try_get(o)) {
+          notify(o, i << myTraits.base_bits);
+        }
+      }
+    }
   };
 
 public:
@@ -82,6 +82,22 @@ BlueStore::SocketHook::SocketHook(BlueStore& store)
       this,
       "print RocksDB sharding");
     ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag start "
+      "name=collection,type=CephString,req=false",
+      this,
+      "rewrite fragmented objects in the background, optionally only in one collection");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag stop",
+      this,
+      "stop the running defrag pass");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag status",
+      this,
+      "print progress of the current or last defrag pass");
+    ceph_assert(r == 0);
     r = admin_socket->register_command("bluestore bluefs-bdev-expand",
                                        this,
                                        "Instruct BlueFS to check the size of its block devices"
@@ -296,6 +312,16 @@ int BlueStore::SocketHook::call(
       }
     }
     return 0;
+  } else if (command == "bluestore defrag start") {
+    std::string coll;
+    cmd_getval(cmdmap, "collection", coll);
+    return store.defrag_start(coll, ss);
+  } else if (command == "bluestore defrag stop") {
+    store._defrag_stop();
+    return 0;
+  } else if (command == "bluestore defrag status") {
+    store.defrag_dump(f);
+    return 0;
   } else if (command == "bluestore bluefs-bdev-expand"){
     std::stringstream result;
     int ret = store.expand_devices(result);
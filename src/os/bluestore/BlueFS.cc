@@ -19,6 +19,8 @@
 #include "include/intarith.h"
 #include "include/stringify.h"
 #include "common/admin_socket.h"
+#include "common/Thread.h"
+#include "include/crc32c.h"
 #include "os/bluestore/bluefs_types.h"
 
 #ifdef WITH_CRIMSON
@@ -77,6 +79,95 @@ static void slow_discard_cb(void *priv, void* priv2) {
   bluefs->handle_discard(BlueFS::BDEV_SLOW, *tmp);
 }
 
+// Computes the crc32c of log records' op_bl, seeded the way
+// bluefs_transaction_t encodes it. Large records (i.e. the metadata dump
+// written by log compaction) are split into slices, checksummed in
+// parallel and stitched together. The worker threads are started on the
+// first large record and are reused until the end of the replay.
+class ReplayVerifier {
+  static constexpr uint64_t min_slice = 1 << 20;
+
+  const unsigned max_threads;
+  ceph::mutex lock = ceph::make_mutex("BlueFS::ReplayVerifier::lock");
+  ceph::condition_variable cond;       ///< jobs queued or stopping
+  ceph::condition_variable done_cond;  ///< pending dropped to 0
+  std::deque<std::function<void()>> jobs;
+  unsigned pending = 0;
+  bool stopping = false;
+  vector<std::thread> workers;
+
+  void worker() {
+    std::unique_lock l(lock);
+    while (true) {
+      cond.wait(l, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+	return;
+      }
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+      l.unlock();
+      job();
+      l.lock();
+      if (--pending == 0) {
+	done_cond.notify_all();
+      }
+    }
+  }
+
+public:
+  explicit ReplayVerifier(unsigned threads) : max_threads(threads) {}
+  ~ReplayVerifier() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+    }
+    cond.notify_all();
+    for (auto& w : workers) {
+      w.join();
+    }
+  }
+
+  uint32_t crc32c(const bufferlist& bl) {
+    uint64_t len = bl.length();
+    unsigned n = std::min<uint64_t>(max_threads, len / min_slice);
+    if (n <= 1) {
+      return bl.crc32c(-1);
+    }
+    uint64_t slice = len / n;
+    vector<bufferlist> slices(n);
+    vector<uint32_t> crcs(n);
+    for (unsigned i = 0; i < n; ++i) {
+      uint64_t off = i * slice;
+      slices[i].substr_of(bl, off, i == n - 1 ? len - off : slice);
+    }
+    {
+      std::lock_guard l(lock);
+      while (workers.size() < n - 1) {
+	workers.push_back(make_named_thread("bluefs_replay",
+					    &ReplayVerifier::worker, this));
+      }
+      for (unsigned i = 1; i < n; ++i) {
+	jobs.emplace_back([&slices, &crcs, i] {
+	  crcs[i] = slices[i].crc32c(0);
+	});
+      }
+      pending = n - 1;
+    }
+    cond.notify_all();
+    crcs[0] = slices[0].crc32c(0);
+    {
+      std::unique_lock l(lock);
+      done_cond.wait(l, [this] { return pending == 0; });
+    }
+    // crc(s, A) == crc(s, zeros(|A|)) ^ crc(0, A)
+    uint32_t crc = -1;
+    for (unsigned i = 0; i < n; ++i) {
+      crc = ceph_crc32c_zeros(crc, slices[i].length()) ^ crcs[i];
+    }
+    return crc;
+  }
+};
+
 class BlueFS::SocketHook : public AdminSocketHook {
   BlueFS* bluefs;
 public:
@@ -479,6 +570,8 @@ void BlueFS::_init_logger()
                 "Average allocation latency for primary/shared device",
                 "bsal",
                 PerfCountersBuilder::PRIO_USEFUL);
+  b.add_time_avg(l_bluefs_replay_lat, "replay_lat",
+                "Time taken to replay the bluefs log on mount");
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -1156,11 +1249,17 @@ int BlueFS::mount()
 
   _init_alloc();
 
-  r = _replay(false, false);
-  if (r < 0) {
-    derr << __func__ << " failed to replay log: " << cpp_strerror(r) << dendl;
-    _stop_alloc();
-    goto out;
+  {
+    auto t0 = mono_clock::now();
+    r = _replay(false, false);
+    auto replay_lat = mono_clock::now() - t0;
+    if (r < 0) {
+      derr << __func__ << " failed to replay log: " << cpp_strerror(r) << dendl;
+      _stop_alloc();
+      goto out;
+    }
+    logger->tinc(l_bluefs_replay_lat, replay_lat);
+    dout(1) << __func__ << " replayed log in " << replay_lat << dendl;
   }
   if (cct->_conf->bluefs_check_volume_selector_on_mount) {
     _check_vselector_LNF();
@@ -1462,6 +1561,7 @@ int BlueFS::_replay(bool noop, bool to_stdout)
     {.ignore_eof = true, .buffered = false});
 
   bool seen_recs = false;
+  ReplayVerifier verifier(cct->_conf->bluefs_replay_verify_threads);
 
   boost::dynamic_bitset<uint64_t> used_blocks[MAX_BDEV];
   bool check_allocations = cct->_conf->bluefs_log_replay_check_allocations;
@@ -1568,7 +1668,13 @@ int BlueFS::_replay(bool noop, bool to_stdout)
     bluefs_transaction_t t;
     try {
       auto p = bl.cbegin();
-      decode(t, p);
+      uint32_t crc;
+      t.decode_unverified(p, &crc);
+      uint32_t actual = verifier.crc32c(t.op_bl);
+      if (actual != crc) {
+	throw ceph::buffer::malformed_input("bad crc " + stringify(actual)
+					    + " expected " + stringify(crc));
+      }
       seen_recs = true;
     }
     catch (ceph::buffer::error& e) {
@@ -3076,6 +3182,14 @@ bool BlueFS::_should_start_compact_log_L_N()
 	   << " expected " << expected << std::dec
 	   << " ratio " << ratio
 	   << dendl;
+  // keep the tail replayed on top of the last metadata dump bounded,
+  // no matter how large the metadata itself is
+  uint64_t max_tail = cct->_conf->bluefs_log_compact_max_tail;
+  if (max_tail && current > expected + max_tail) {
+    dout(10) << __func__ << " tail exceeds 0x" << std::hex << max_tail
+	     << std::dec << dendl;
+    return true;
+  }
   if (current < cct->_conf->bluefs_log_compact_min_size ||
       ratio < cct->_conf->bluefs_log_compact_min_ratio) {
     return false;
@@ -4185,6 +4299,7 @@ uint64_t BlueFS::_flush_data(FileWriter *h, uint64_t end, bool buffered)
   bl.hexdump(*_dout);
   *_dout << dendl;
 
+  const std::array<bool, MAX_BDEV> dirty_before = h->dirty_devs;
   uint64_t bloff = 0;
   uint64_t bytes_written_slow = 0;
   while (length > 0) {
@@ -4214,6 +4329,13 @@ uint64_t BlueFS::_flush_data(FileWriter *h, uint64_t end, bool buffered)
   for (unsigned i = 0; i < MAX_BDEV; ++i) {
     if (bdev[i]) {
       if (h->iocv[i] && h->iocv[i]->has_pending_aios()) {
+        // The log is synced as soon as it is written, so let the device
+        // flush behind the writes if it can, rather than in _flush_bdev.
+        // Not if earlier writes may still be in flight.
+        if (h->file->fnode.ino == 1 && !dirty_before[i] &&
+            bdev[i]->aio_flush(h->iocv[i]) == 0) {
+          h->dirty_devs[i] = false;
+        }
         bdev[i]->aio_submit(h->iocv[i]);
       }
     }
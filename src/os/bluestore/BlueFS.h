@@ -88,6 +88,7 @@ enum {
   l_bluefs_wal_alloc_lat,
   l_bluefs_db_alloc_lat,
   l_bluefs_slow_alloc_lat,
+  l_bluefs_replay_lat,
   l_bluefs_last,
 };
 
@@ -143,6 +143,7 @@ const string PREFIX_DEFERRED = "L";    // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";       // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b";// (see BitmapFreelistManager)
 const string PREFIX_SHARED_BLOB = "X"; // u64 SB id -> shared_blob_t
+const string PREFIX_COMPRESSION_DICT = "D"; // u32 id -> compression_dict_t
 
 const string BLUESTORE_GLOBAL_STATFS_KEY = "bluestore_statfs";
 
@@ -1192,9 +1193,14 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
 	ceph_assert(num);
         --num;
         o->clear_cached();
+        // queue for the compact tier, unless we are flushing the cache
+        if (new_size && compact_enabled()) {
+          o->c->onode_space._add_compact(o);
+        }
         o->c->onode_space._remove(o->oid);
       }
     }
+    _trim_compact();
   }
   void _move_pinned(OnodeCacheShard *to, BlueStore::Onode *o) override
   {
@@ -1231,6 +1237,54 @@ BlueStore::OnodeCacheShard *BlueStore::OnodeCacheShard::create(
   return c;
 }
 
+void BlueStore::OnodeCacheShard::_add_compact(CompactOnode *c)
+{
+  compact_lru.push_front(*c);
+  compact_bytes += c->get_bytes();
+}
+
+void BlueStore::OnodeCacheShard::_rm_compact(CompactOnode *c)
+{
+  compact_lru.erase(compact_lru.iterator_to(*c));
+  ceph_assert(compact_bytes >= c->get_bytes());
+  compact_bytes -= c->get_bytes();
+}
+
+void BlueStore::OnodeCacheShard::_trim_compact()
+{
+  while (compact_bytes > compact_max_bytes && !compact_lru.empty()) {
+    CompactOnode *c = &compact_lru.back();
+    c->space->_drop_compact(*c->oid);
+  }
+}
+
+void BlueStore::OnodeCacheShard::encode_compact()
+{
+  std::vector<std::pair<CollectionRef, OnodeRef>> pending;
+  {
+    std::lock_guard l(lock);
+    pending.swap(compact_pending);
+  }
+  // The onodes are out of onode_map and we hold the only reference, so
+  // nothing can modify them while they are encoded.
+  for (auto& [c, o] : pending) {
+    bufferlist v;
+    o->encode_value(v, c->store->segment_size != 0);
+    v.reassign_to_mempool(mempool::mempool_bluestore_cache_meta);
+    std::lock_guard l(lock);
+    c->onode_space._set_compact(o.get(), std::move(v));
+  }
+  std::lock_guard l(lock);
+  _trim_compact();
+}
+
+void BlueStore::OnodeCacheShard::drop_compact_pending()
+{
+  std::vector<std::pair<CollectionRef, OnodeRef>> pending;
+  std::lock_guard l(lock);
+  pending.swap(compact_pending);
+}
+
 // LruBufferCacheShard
 struct LruBufferCacheShard : public BlueStore::BufferCacheShard {
   typedef boost::intrusive::list<
@@ -2074,6 +2128,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
     return p.first->second;
   }
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
+  _drop_compact(oid);
   cache->_add(o.get(), 1);
   cache->_trim_some();
   return o;
@@ -2085,6 +2140,75 @@ void BlueStore::OnodeSpace::_remove(const ghobject_t& oid)
   onode_map.erase(oid);
 }
 
+void BlueStore::OnodeSpace::_add_compact(Onode *o)
+{
+  if (!o->exists || !o->is_clean()) {
+    return;
+  }
+  // Only leave a placeholder here; the onode is encoded by
+  // OnodeCacheShard::encode_compact() outside of the shard lock.
+  ldout(cache->cct, 20) << __func__ << " " << o->oid << dendl;
+  _drop_compact(o->oid);
+  auto p = compact_map.emplace(
+    std::piecewise_construct,
+    std::forward_as_tuple(o->oid),
+    std::forward_as_tuple(this, o)).first;
+  p->second.oid = &p->first;
+  cache->compact_pending.emplace_back(o->c, o);
+}
+
+void BlueStore::OnodeSpace::_set_compact(Onode *o, bufferlist&& v)
+{
+  auto p = compact_map.find(o->oid);
+  if (p == compact_map.end() || p->second.pending != o) {
+    // looked up, renamed or split away since it was trimmed
+    return;
+  }
+  ldout(cache->cct, 20) << __func__ << " " << o->oid << " " << v.length()
+			<< " bytes" << dendl;
+  p->second.pending = nullptr;
+  p->second.v = std::move(v);
+  cache->_add_compact(&p->second);
+}
+
+void BlueStore::OnodeSpace::_drop_compact(const ghobject_t& oid)
+{
+  auto p = compact_map.find(oid);
+  if (p == compact_map.end()) {
+    return;
+  }
+  if (!p->second.pending) {
+    cache->_rm_compact(&p->second);
+  }
+  compact_map.erase(p);
+}
+
+void BlueStore::OnodeSpace::_clear_compact()
+{
+  for (auto& [oid, c] : compact_map) {
+    if (!c.pending) {
+      cache->_rm_compact(&c);
+    }
+  }
+  compact_map.clear();
+}
+
+bool BlueStore::OnodeSpace::take_compact(const ghobject_t& oid, bufferlist *v)
+{
+  std::lock_guard l(cache->lock);
+  auto p = compact_map.find(oid);
+  if (p == compact_map.end() || p->second.pending) {
+    // a pending entry is dropped once the caller adds the onode again
+    return false;
+  }
+  ldout(cache->cct, 30) << __func__ << " " << oid << " hit" << dendl;
+  cache->_rm_compact(&p->second);
+  *v = std::move(p->second.v);
+  compact_map.erase(p);
+  cache->logger->inc(l_bluestore_onode_compact_hits);
+  return true;
+}
+
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
   ldout(cache->cct, 30) << __func__ << dendl;
@@ -2120,6 +2244,7 @@ void BlueStore::OnodeSpace::clear()
     cache->_rm(p.second.get());
   }
   onode_map.clear();
+  _clear_compact();
 }
 
 bool BlueStore::OnodeSpace::empty()
@@ -2157,6 +2282,7 @@ void BlueStore::OnodeSpace::rename(
   // add at new position and fix oid, key.
   // This will pin 'o' and implicitly touch cache
   // when it will eventually become unpinned
+  _drop_compact(new_oid);
   onode_map.insert(make_pair(new_oid, o));
 
   o->oid = new_oid;
@@ -4989,6 +5115,53 @@ BlueStore::Onode* BlueStore::Onode::create_decode(
   return on;
 }
 
+void BlueStore::Onode::encode_value(bufferlist& bl,
+				    bool use_onode_segmentation,
+				    unsigned *parts)
+{
+  // bound encode
+  size_t bound = 0;
+  uint64_t flag = use_onode_segmentation ? 0 : bluestore_onode_t::FLAG_DEBUG_FORCE_V2;
+  denc(onode, bound, flag);
+  extent_map.bound_encode_spanning_blobs(bound);
+  if (onode.extent_map_shards.empty()) {
+    denc(extent_map.inline_bl, bound);
+  }
+
+  // encode
+  unsigned onode_part, blob_part;
+  auto p = bl.get_contiguous_appender(bound, true);
+  denc(onode, p, flag);
+  onode_part = p.get_logical_offset();
+  extent_map.encode_spanning_blobs(p);
+  blob_part = p.get_logical_offset() - onode_part;
+  if (onode.extent_map_shards.empty()) {
+    denc(extent_map.inline_bl, p);
+  }
+  if (parts) {
+    parts[0] = onode_part;
+    parts[1] = blob_part;
+    parts[2] = p.get_logical_offset() - onode_part - blob_part;
+  }
+}
+
+bool BlueStore::Onode::is_clean() const
+{
+  if (extent_map.needs_reshard()) {
+    return false;
+  }
+  if (onode.extent_map_shards.empty()) {
+    // an empty inline_bl means the extent map has not been encoded yet
+    return extent_map.inline_bl.length() > 0 || extent_map.extent_map.empty();
+  }
+  for (auto& s : extent_map.shards) {
+    if (s.dirty) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void BlueStore::Onode::flush()
 {
   if (flushing_count.load()) {
@@ -5415,8 +5588,13 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   int r = -ENOENT;
   Onode *on;
   if (!is_createop) {
-    r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
-    ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    if (onode_space.take_compact(oid, &v)) {
+      r = 0;
+      ldout(store->cct, 20) << " compact v.len " << v.length() << dendl;
+    } else {
+      r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+      ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    }
   }
   if (v.length() == 0) {
     ceph_assert(r == -ENOENT);
@@ -5452,6 +5630,10 @@ void BlueStore::Collection::split_cache(
   bool is_pg = dest->cid.is_pg(&destpg);
   ceph_assert(is_pg);
 
+  // objects are changing hands, just drop the compact tier of both
+  onode_space._clear_compact();
+  dest->onode_space._clear_compact();
+
   auto p = onode_space.onode_map.begin();
   while (p != onode_space.onode_map.end()) {
     OnodeRef o = p->second;
@@ -5575,6 +5757,9 @@ void *BlueStore::MempoolThread::entry()
     if (binned_kv_onode_cache != nullptr) {
       pcm->insert("kv_onode", binned_kv_onode_cache, true);
     }
+    for (auto& [name, cache] : external_caches) {
+      pcm->insert(name, cache, true);
+    }
   }
 
   utime_t next_balance = ceph_clock_now();
@@ -5666,8 +5851,20 @@ void *BlueStore::MempoolThread::entry()
     // Now Resize the shards 
     _resize_shards(interval_stats_trim);
     interval_stats_trim = false;
+    for (auto i : store->onode_cache_shards) {
+      i->encode_compact();
+    }
 
     store->refresh_perf_counters();
+    uint64_t defrag_period =
+      store->cct->_conf.get_val<uint64_t>("bluestore_alloc_defrag_free_period");
+    if (defrag_period != 0 && store->alloc) {
+      auto now = mono_clock::now();
+      if (now - last_free_defrag > make_timespan(defrag_period)) {
+        last_free_defrag = now;
+        store->alloc->defrag_free_space();
+      }
+    }
     uint64_t period = store->cct->_conf.get_val<uint64_t>("bluestore_fragmentation_check_period");
     if (period != 0 && store->alloc) {
       auto now = mono_clock::now();
@@ -5747,21 +5944,51 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
                    << " data_used: " << data_used << dendl;
   }
 
+  // carve the compact onode tier out of the meta allocation
+  double compact_ratio = store->cct->_conf->bluestore_onode_cache_compact_ratio;
+  int64_t compact_alloc = static_cast<int64_t>(meta_alloc * compact_ratio);
+  meta_alloc -= compact_alloc;
+
   uint64_t max_shard_onodes = static_cast<uint64_t>(
       (meta_alloc / (double) onode_shards) / meta_cache->get_bytes_per_onode());
+  uint64_t max_shard_compact = static_cast<uint64_t>(compact_alloc / onode_shards);
   uint64_t max_shard_buffer = static_cast<uint64_t>(data_alloc / buffer_shards);
 
   dout(30) << __func__ << " max_shard_onodes: " << max_shard_onodes
+                 << " max_shard_compact: " << max_shard_compact
                  << " max_shard_buffer: " << max_shard_buffer << dendl;
 
   for (auto i : store->onode_cache_shards) {
     i->set_max(max_shard_onodes);
+    i->set_compact_max(max_shard_compact);
   }
   for (auto i : store->buffer_cache_shards) {
     i->set_max(max_shard_buffer);
   }
 }
 
+void BlueStore::MempoolThread::add_external_cache(
+  const std::string& name,
+  std::shared_ptr<PriorityCache::PriCache> cache)
+{
+  std::lock_guard l{lock};
+  external_caches[name] = cache;
+  if (pcm != nullptr) {
+    pcm->insert(name, cache, true);
+  }
+  dout(5) << __func__ << " " << name << " autotuned: " << (pcm != nullptr)
+          << dendl;
+}
+
+void BlueStore::MempoolThread::remove_external_cache(const std::string& name)
+{
+  std::lock_guard l{lock};
+  external_caches.erase(name);
+  if (pcm != nullptr) {
+    pcm->erase(name);
+  }
+}
+
 void BlueStore::MempoolThread::_update_cache_settings()
 {
   // Nothing to do if pcm is not used.
@@ -5831,8 +6058,11 @@ BlueStore::BlueStore(CephContext *cct,
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    defrag_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(std::countr_zero(_min_alloc_size)),
+    compression_ddicts(cct->_conf->bluestore_compression_dict_cache_size),
+    compression_dict_finisher(cct, "compression_dict_finisher", "bstore_dict"),
     mempool_thread(this)
 {
   _init_logger();
@@ -6515,6 +6745,9 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_deferred_merged_batches,
+		    "deferred_merged_batches",
+		    "Deferred batches submitted merged with other sequencers");
 
   b.add_u64_counter(l_bluestore_write_big_skipped_blobs,
       "write_big_skipped_blobs",
@@ -6551,6 +6784,14 @@ void BlueStore::_init_logger()
 	    "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
 	    "Sum for compress ops rejected due to low net gain of space");
+  b.add_u64_counter(l_bluestore_compress_attempted_count, "compress_attempted_count",
+	    "Sum for compress ops attempted");
+  b.add_u64_counter(l_bluestore_compress_skipped_count, "compress_skipped_count",
+	    "Sum for compress ops skipped as predicted to be rejected");
+  b.add_u64_counter(l_bluestore_compress_dict_count, "compress_dict_count",
+	    "Sum for compress ops that used a trained dictionary");
+  b.add_u64_counter(l_bluestore_compress_dict_trained, "compress_dict_trained",
+	    "Compression dictionaries trained");
   //****************************************
 
   // onode cache stats
@@ -6570,6 +6811,12 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_shard_misses,
 		    "onode_shard_misses",
 		    "Count of onode shard cache lookups misses");
+  b.add_u64(l_bluestore_onodes_compact, "onodes_compact",
+	    "Number of encoded onodes in the compact cache tier");
+  b.add_u64(l_bluestore_onode_compact_bytes, "onode_compact_bytes",
+	    "Bytes held by the compact onode cache tier");
+  b.add_u64_counter(l_bluestore_onode_compact_hits, "onode_compact_hits",
+		    "Count of onode cache misses served from the compact tier");
   b.add_u64(l_bluestore_extents, "onode_extents",
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "onode_blobs",
@@ -6731,6 +6978,12 @@ void BlueStore::_init_logger()
     "Latency of static fragmentation measurement during scrub",
     "sfl",
     PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_bluestore_defrag_scanned, "defrag_scanned",
+    "Objects examined by defrag");
+  b.add_u64_counter(l_bluestore_defrag_rewritten, "defrag_rewritten",
+    "Objects rewritten by defrag");
+  b.add_u64_counter(l_bluestore_defrag_bytes, "defrag_bytes",
+    "Bytes rewritten by defrag", NULL, 0, unit_t(UNIT_BYTES));
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -8894,6 +9147,7 @@ int BlueStore::mkfs()
     }
 
     ondisk_format = latest_ondisk_format;
+    compression_dict_in_use = false;
     _prepare_ondisk_format_super(t);
     db->submit_transaction_sync(t);
   }
@@ -9706,6 +9960,7 @@ int BlueStore::_mount()
   }
 
   mempool_thread.init();
+  compression_dict_finisher.start();
 
   if ((!per_pool_stat_collection || per_pool_omap != OMAP_PER_PG) &&
     cct->_conf->bluestore_fsck_quick_fix_on_mount == true) {
@@ -9733,6 +9988,12 @@ int BlueStore::umount()
 {
   dout(5) << __func__ << dendl;
   ceph_assert(_kv_only || mounted);
+  _defrag_stop();
+  if (!_kv_only) {
+    // a training in flight may still queue its dictionary txc
+    compression_dict_finisher.wait_for_empty();
+    compression_dict_finisher.stop();
+  }
   _osr_drain_all();
 
   if (bluefs) {
@@ -9955,7 +10216,8 @@ void BlueStore::_fsck_check_statfs(
 
 void BlueStore::_fsck_foreach_shared_blob(
   std::function< bool (coll_t, ghobject_t, uint64_t, const bluestore_blob_t&)> cb) {
-  auto it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+  auto it = db->get_iterator(PREFIX_OBJ,
+                             KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
   if (it) {
     CollectionRef c;
     spg_t pgid;
@@ -10254,6 +10516,18 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
       res_statfs->data_compressed_original +=
         i.first->get_referenced_bytes();
     }
+    if (uint32_t dict_id = blob.get_compression_dict(); dict_id) {
+      std::shared_lock l(compression_dict_lock);
+      auto p = compression_dict_ids.find(dict_id);
+      if (p == compression_dict_ids.end()) {
+        derr << "fsck error: " << oid << " blob " << blob
+          << " refers to missing compression dictionary " << dict_id
+          << dendl;
+        ++errors;
+      } else {
+        p->second.referenced = true;
+      }
+    }
     if (depth != FSCK_SHALLOW && repairer) {
       for (auto e : blob.get_extents()) {
 	if (!e.is_valid())
@@ -10773,7 +11047,8 @@ void BlueStore::_fsck_check_objects(
 
   size_t processed_myself = 0;
 
-  auto it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+  auto it = db->get_iterator(PREFIX_OBJ,
+                             KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
   mempool::bluestore_fsck::list<string> expecting_shards;
   if (it) {
     const size_t thread_count = cct->_conf->bluestore_fsck_quick_fix_threads;
@@ -11312,6 +11587,21 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
 	 << dendl;
   }
 
+  // the newest dictionary of a pool may be in use by writes, or not yet
+  // be referenced when its training just completed
+  std::set<uint32_t> newest_compression_dicts;
+  {
+    std::shared_lock l(compression_dict_lock);
+    std::map<int64_t, uint32_t> newest;
+    for (auto& [id, info] : compression_dict_ids) {
+      info.referenced = false;
+      newest[info.pool] = id;
+    }
+    for (auto& [pool, id] : newest) {
+      newest_compression_dicts.insert(id);
+    }
+  }
+
   if (g_conf()->bluestore_debug_fsck_abort) {
     dout(1) << __func__ << " debug abort" << dendl;
     goto out_scan;
@@ -11502,7 +11792,8 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
     dout(1) << __func__ << " sorting out misreferenced extents" << dendl;
     auto& misref_extents = repairer.get_misreferences();
     interval_set<uint64_t> to_release;
-    it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+    it = db->get_iterator(PREFIX_OBJ,
+                          KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
     if (it) {
       // fill global if not overriden below
       auto expected_statfs = &expected_store_statfs;
@@ -11700,12 +11991,37 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
   sb_info.clear();
   sb_ref_counts.reset();
 
+  dout(1) << __func__ << " checking compression dictionaries" << dendl;
+  {
+    std::unique_lock l(compression_dict_lock);
+    for (auto p = compression_dict_ids.begin();
+	 p != compression_dict_ids.end();) {
+      if (p->second.referenced || newest_compression_dicts.count(p->first)) {
+	++p;
+	continue;
+      }
+      derr << "fsck warning: compression dictionary " << p->first
+	   << " of pool " << p->second.pool
+	   << " is superseded and no longer referenced" << dendl;
+      ++warnings;
+      if (repair) {
+	string key;
+	_key_encode_u32(p->first, &key);
+	repairer.remove_key(db, PREFIX_COMPRESSION_DICT, key);
+	p = compression_dict_ids.erase(p);
+      } else {
+	++p;
+      }
+    }
+  }
+
   dout(1) << __func__ << " checking pool_statfs" << dendl;
   _fsck_check_statfs(expected_store_statfs, expected_pool_statfs,
     errors, warnings, repair ? &repairer : nullptr);
   if (depth != FSCK_SHALLOW) {
     dout(1) << __func__ << " checking for stray omap data " << dendl;
-    it = db->get_iterator(PREFIX_OMAP, KeyValueDB::ITERATOR_NOCACHE);
+    it = db->get_iterator(PREFIX_OMAP,
+                          KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
     if (it) {
       uint64_t last_omap_head = 0;
       for (it->lower_bound(string()); it->valid(); it->next()) {
@@ -11727,7 +12043,8 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
         }
       }
     }
-    it = db->get_iterator(PREFIX_PGMETA_OMAP, KeyValueDB::ITERATOR_NOCACHE);
+    it = db->get_iterator(PREFIX_PGMETA_OMAP,
+                          KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
     if (it) {
       uint64_t last_omap_head = 0;
       pool_fsck_stats_t& ppfs = per_pool_fsck_stats[META_POOL_ID];
@@ -11751,7 +12068,8 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
         }
       }
     }
-    it = db->get_iterator(PREFIX_PERPOOL_OMAP, KeyValueDB::ITERATOR_NOCACHE);
+    it = db->get_iterator(PREFIX_PERPOOL_OMAP,
+                          KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
     if (it) {
       uint64_t last_omap_head = 0;
       for (it->lower_bound(string()); it->valid(); it->next()) {
@@ -11784,7 +12102,8 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
         }
       }
     }
-    it = db->get_iterator(PREFIX_PERPG_OMAP, KeyValueDB::ITERATOR_NOCACHE);
+    it = db->get_iterator(PREFIX_PERPG_OMAP,
+                          KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
     if (it) {
       uint64_t last_omap_head = 0;
       for (it->lower_bound(string()); it->valid(); it->next()) {
@@ -12649,8 +12968,11 @@ void BlueStore::refresh_perf_counters()
   uint64_t num_blobs = 0;
   uint64_t num_buffers = 0;
   uint64_t num_buffer_bytes = 0;
+  uint64_t num_compact_onodes = 0;
+  uint64_t num_compact_bytes = 0;
   for (auto c : onode_cache_shards) {
     c->add_stats(&num_onodes, &num_pinned_onodes);
+    c->add_compact_stats(&num_compact_onodes, &num_compact_bytes);
   }
   for (auto c : buffer_cache_shards) {
     c->add_stats(&num_extents, &num_blobs,
@@ -12658,6 +12980,8 @@ void BlueStore::refresh_perf_counters()
   }
   logger->set(l_bluestore_onodes, num_onodes);
   logger->set(l_bluestore_pinned_onodes, num_pinned_onodes);
+  logger->set(l_bluestore_onodes_compact, num_compact_onodes);
+  logger->set(l_bluestore_onode_compact_bytes, num_compact_bytes);
   logger->set(l_bluestore_extents, num_extents);
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
@@ -13090,7 +13414,8 @@ int BlueStore::_generate_read_result_bl(
         return -EIO;
       }
       bufferlist raw_bl;
-      auto r = _decompress(compressed_bl, &raw_bl);
+      auto r = _decompress(compressed_bl, &raw_bl,
+			   bptr->get_blob().get_compression_dict());
       if (r < 0)
         return r;
       if (buffered) {
@@ -13202,6 +13527,272 @@ void BlueStore::_measure_static_frag(
   logger->tinc_with_max(l_bluestore_static_frag_lat, finish - start);
 }
 
+// ---------------
+// defrag
+
+int BlueStore::defrag_start(const string& coll, std::ostream& ss)
+{
+  std::optional<coll_t> cid;
+  if (!coll.empty()) {
+    coll_t c;
+    if (!c.parse(coll)) {
+      ss << "Cannot parse collection" << std::endl;
+      return -EINVAL;
+    }
+    cid = c;
+  }
+  if (!mounted || db_was_opened_read_only) {
+    ss << "store is not mounted read-write" << std::endl;
+    return -EROFS;
+  }
+  std::lock_guard l(defrag_lock);
+  if (defrag_running) {
+    ss << "defrag is already running" << std::endl;
+    return -EBUSY;
+  }
+  if (defrag_thread.is_started()) {
+    // previous pass is done and no longer needs defrag_lock
+    defrag_thread.join();
+  }
+  dout(1) << __func__ << " " << (cid ? stringify(*cid) : "all collections")
+	  << dendl;
+  defrag_cid = cid;
+  defrag_stop = false;
+  defrag_running = true;
+  defrag_pos_cid = coll_t();
+  defrag_pos = ghobject_t();
+  defrag_scanned = defrag_rewritten = defrag_bytes = 0;
+  defrag_thread.create("bstore_defrag");
+  return 0;
+}
+
+void BlueStore::_defrag_stop()
+{
+  {
+    std::lock_guard l(defrag_lock);
+    defrag_stop = true;
+    defrag_cond.notify_all();
+  }
+  if (defrag_thread.is_started()) {
+    defrag_thread.join();
+  }
+}
+
+void BlueStore::defrag_dump(Formatter *f)
+{
+  std::lock_guard l(defrag_lock);
+  f->open_object_section("defrag");
+  f->dump_bool("running", defrag_running);
+  if (defrag_cid) {
+    f->dump_stream("collection") << *defrag_cid;
+  }
+  f->dump_stream("position_collection") << defrag_pos_cid;
+  f->dump_stream("position") << defrag_pos;
+  f->dump_unsigned("objects_scanned", defrag_scanned);
+  f->dump_unsigned("objects_rewritten", defrag_rewritten);
+  f->dump_unsigned("bytes_rewritten", defrag_bytes);
+  f->close_section();
+}
+
+void BlueStore::_defrag_thread()
+{
+  vector<CollectionRef> colls;
+  {
+    std::shared_lock l(coll_lock);
+    for (auto& [cid, c] : coll_map) {
+      if (!defrag_cid || cid == *defrag_cid) {
+        colls.push_back(c);
+      }
+    }
+  }
+  dout(5) << __func__ << " start, " << colls.size() << " collections" << dendl;
+  for (auto& c : colls) {
+    if (!_defrag_collection(c)) {
+      break;
+    }
+  }
+  std::lock_guard l(defrag_lock);
+  dout(5) << __func__ << " finish, scanned " << defrag_scanned
+	  << " rewritten " << defrag_rewritten
+	  << " (" << byte_u_t(defrag_bytes) << ")" << dendl;
+  defrag_running = false;
+}
+
+/// walk the objects of c, returns false if asked to stop
+bool BlueStore::_defrag_collection(CollectionRef& c)
+{
+  ghobject_t pos;
+  while (true) {
+    vector<ghobject_t> ls;
+    ghobject_t next;
+    {
+      std::shared_lock l(c->lock);
+      if (!c->exists) {
+        return true;
+      }
+      int r = _collection_list(c.get(), pos, ghobject_t::get_max(),
+			       cct->_conf->bluestore_defrag_list_batch,
+			       false, &ls, &next);
+      if (r < 0) {
+        return true;
+      }
+    }
+    for (auto& oid : ls) {
+      uint64_t bytes = _defrag_object(c, oid);
+      if (bytes) {
+        logger->inc(l_bluestore_defrag_rewritten);
+        logger->inc(l_bluestore_defrag_bytes, bytes);
+      }
+      logger->inc(l_bluestore_defrag_scanned);
+      std::lock_guard l(defrag_lock);
+      ++defrag_scanned;
+      defrag_pos_cid = c->cid;
+      defrag_pos = oid;
+      if (bytes) {
+        ++defrag_rewritten;
+        defrag_bytes += bytes;
+      }
+      if (defrag_stop) {
+        return false;
+      }
+    }
+    if (ls.empty() || next.is_max()) {
+      return true;
+    }
+    pos = next;
+  }
+}
+
+/*
+ * Rewrite oid contiguously if its data maps to many more physical
+ * segments than logical ones. Returns the number of bytes rewritten.
+ */
+uint64_t BlueStore::_defrag_object(CollectionRef& c, const ghobject_t& oid)
+{
+  // an object written while we read it is looked at again from scratch
+  const unsigned max_tries = 3;
+  for (unsigned i = 0; i < max_tries; ++i) {
+    int64_t r = _defrag_try_object(c, oid);
+    if (r != -EAGAIN) {
+      return r > 0 ? r : 0;
+    }
+    dout(10) << __func__ << " " << c->cid << " " << oid
+	     << " changed while reading, retrying" << dendl;
+  }
+  return 0;
+}
+
+/*
+ * The data is read in chunks of bluestore_defrag_chunk_size under the
+ * shared collection lock, which is dropped in between. Onode::write_seq
+ * tells whether the object changed meanwhile, in which case we return
+ * -EAGAIN. The exclusive lock is only taken to queue the rewrite, an
+ * ordinary transaction on the collection's sequencer.
+ */
+int64_t BlueStore::_defrag_try_object(CollectionRef& c, const ghobject_t& oid)
+{
+  OnodeRef o;
+  uint64_t seq;
+  interval_set<uint64_t> runs;
+  {
+    std::shared_lock l(c->lock);
+    if (!c->exists) {
+      return 0;
+    }
+    o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      return 0;
+    }
+    o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+    for (auto& e : o->extent_map.extent_map) {
+      if (e.blob->get_blob().is_shared()) {
+        // rewriting would unshare the data of clones
+        return 0;
+      }
+      runs.insert(e.logical_offset, e.length);
+    }
+    if (runs.empty()) {
+      return 0;
+    }
+    uint64_t segments = o->get_fragmentation_score();
+    if (segments <
+	runs.num_intervals() * cct->_conf->bluestore_defrag_min_ratio) {
+      return 0;
+    }
+    dout(10) << __func__ << " " << c->cid << " " << oid
+	     << " segments " << segments << " runs " << runs << dendl;
+    seq = o->write_seq;
+  }
+  auto unchanged = [&] {
+    return c->exists && o->exists && o->c == c.get() && o->oid == oid &&
+      o->write_seq == seq;
+  };
+
+  uint64_t chunk = cct->_conf->bluestore_defrag_chunk_size;
+  map<uint64_t, bufferlist> data;
+  for (auto [off, len] : runs) {
+    auto& bl = data[off];
+    for (uint64_t pos = off; pos < off + len; pos += chunk) {
+      uint64_t l = std::min(chunk, off + len - pos);
+      if (!_defrag_throttle(l)) {
+        return 0;
+      }
+      std::shared_lock cl(c->lock);
+      if (!unchanged()) {
+        return -EAGAIN;
+      }
+      bufferlist t;
+      int r = _do_read(c.get(), o, pos, l, t,
+		       CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+      if (r < 0) {
+        derr << __func__ << " " << c->cid << " " << oid << " read 0x"
+             << std::hex << pos << "~" << l << std::dec
+             << " failed: " << cpp_strerror(r) << dendl;
+        return r;
+      }
+      bl.claim_append(t);
+    }
+  }
+
+  std::lock_guard sl(c->submit_lock);
+  TransContext *txc = nullptr;
+  uint64_t bytes = 0;
+  {
+    std::unique_lock l(c->lock);
+    if (!unchanged()) {
+      return -EAGAIN;
+    }
+    txc = _txc_create(c.get(), c->osr.get(), nullptr);
+    for (auto& [off, bl] : data) {
+      uint64_t len = bl.length();
+      // punch first so that the data gets new allocations rather than
+      // being overwritten in place
+      int r = _zero(txc, c, o, off, len);
+      if (r == 0) {
+        r = _write(txc, c, o, off, len, bl, CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+      }
+      ceph_assert(r == 0);
+      txc->bytes += len;
+      bytes += len;
+    }
+  }
+  _txc_finalize_and_start(txc, nullptr);
+  return bytes;
+}
+
+/// pace defrag reads to bluestore_defrag_max_bytes_per_sec, returns false
+/// if asked to stop
+bool BlueStore::_defrag_throttle(uint64_t bytes)
+{
+  std::unique_lock l(defrag_lock);
+  uint64_t rate = cct->_conf->bluestore_defrag_max_bytes_per_sec;
+  if (rate) {
+    defrag_cond.wait_for(l, ceph::make_timespan((double)bytes / rate),
+                         [this] { return defrag_stop; });
+  }
+  return !defrag_stop;
+}
+
 int BlueStore::_do_read(
   Collection *c,
   OnodeRef& o,
@@ -13415,7 +14006,8 @@ int BlueStore::_verify_csum(OnodeRef& o,
   return r;
 }
 
-int BlueStore::_decompress(bufferlist& source, bufferlist* result)
+int BlueStore::_decompress(bufferlist& source, bufferlist* result,
+			   uint32_t dict_id)
 {
   int r = 0;
   auto start = mono_clock::now();
@@ -13442,7 +14034,18 @@ int BlueStore::_decompress(bufferlist& source, bufferlist* result)
     }
   } else {
     ceph_assert((int)cp->get_type() == alg);
-    r = cp->decompress(i, chdr.length, *result, chdr.compressor_message);
+    if (dict_id) {
+      Compressor::DictionaryRef dict = _get_compression_ddict(dict_id);
+      if (dict) {
+	r = cp->decompress(i, chdr.length, *result, *dict);
+      } else {
+	derr << __func__ << " missing compression dictionary " << dict_id
+	     << dendl;
+	r = -ENOENT;
+      }
+    } else {
+      r = cp->decompress(i, chdr.length, *result, chdr.compressor_message);
+    }
     if (r < 0) {
       derr << __func__ << " decompression failed with exit code " << r << dendl;
       r = -EIO;
@@ -13455,33 +14058,509 @@ int BlueStore::_decompress(bufferlist& source, bufferlist* result)
   return r;
 }
 
-// this stores fiemap into interval_set, other variations
-// use it internally
-int BlueStore::_fiemap(
-  CollectionHandle &c_,
-  const ghobject_t& oid,
-  uint64_t offset,
-  size_t length,
-  interval_set<uint64_t>& destset)
+static double entropy_of(const uint32_t (&counts)[2][256], uint64_t total)
 {
-  Collection *c = static_cast<Collection *>(c_.get());
-  if (!c->exists)
-    return -ENOENT;
-  {
-    std::shared_lock l(c->lock);
-
-    OnodeRef o = c->get_onode(oid, false);
-    if (!o || !o->exists) {
-      return -ENOENT;
+  double entropy = 0;
+  for (unsigned b = 0; b < 256; ++b) {
+    uint32_t n = counts[0][b] + counts[1][b];
+    if (n) {
+      double f = double(n) / total;
+      entropy -= f * std::log2(f);
     }
-    _dump_onode<30>(cct, *o);
-
-    dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
-	     << " size 0x" << o->onode.size << std::dec << dendl;
+  }
+  return entropy;
+}
 
-    boost::intrusive::set<Extent>::iterator ep, eend;
-    if (offset >= o->onode.size)
-      goto out;
+// Estimated bits per byte an entropy coder needs for bl, from chunks
+// totalling about sample_size bytes.  Both the bytes and the deltas
+// between neighbouring bytes are counted, so that runs and ramps, which
+// have a flat byte histogram but compress well, are not mistaken for
+// noise.
+//
+// *repeated is the share of sampled 8 byte windows that occur more than
+// once, which catches data that LZ matching compresses regardless of its
+// histogram, e.g. a random block written over and over.  The chunks are
+// jittered within their stride: evenly spaced ones could all miss the
+// period of such repeats.
+static double sampled_entropy(const bufferlist& bl, uint64_t sample_size,
+			      double *repeated)
+{
+  constexpr uint64_t chunk = 64;
+  constexpr uint64_t window = sizeof(uint64_t);
+  constexpr unsigned seen_bits = 12;
+  // two tables each, so that runs of equal values don't serialize on
+  // a single counter
+  uint32_t bytes[2][256] = {};
+  uint32_t deltas[2][256] = {};
+  // fingerprints of the windows seen, by hash; odd so that 0 is empty
+  uint32_t seen[1 << seen_bits] = {};
+  uint64_t stride = std::max(chunk, bl.length() * chunk / sample_size);
+  auto chunk_start = [&](uint64_t k) {
+    uint64_t x = (k + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 31)) * 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 29;
+    return k * stride + (x >> 32) % (stride - chunk + 1);
+  };
+  uint64_t pos = 0, k = 0, next = chunk_start(0);
+  uint64_t total = 0, total_deltas = 0, windows = 0, matches = 0;
+  for (auto& p : bl.buffers()) {
+    auto d = reinterpret_cast<const unsigned char*>(p.c_str());
+    uint64_t end = pos + p.length();
+    for (; next < end; next = chunk_start(++k)) {
+      uint64_t from = next - pos;
+      uint64_t to = std::min(from + chunk, uint64_t(p.length()));
+      for (uint64_t i = from; i + window <= to; ++i) {
+	uint64_t v;
+	memcpy(&v, d + i, window);
+	uint64_t h = v * 0x9E3779B97F4A7C15ull;
+	uint32_t fp = uint32_t(h) | 1;
+	auto& s = seen[h >> (64 - seen_bits)];
+	if (s == fp) {
+	  ++matches;
+	} else {
+	  s = fp;
+	}
+	++windows;
+      }
+      ++bytes[0][d[from]];
+      uint64_t i = from + 1;
+      for (; i + 2 <= to; i += 2) {
+	++bytes[1][d[i]];
+	++bytes[0][d[i + 1]];
+	++deltas[0][uint8_t(d[i] - d[i - 1])];
+	++deltas[1][uint8_t(d[i + 1] - d[i])];
+      }
+      if (i < to) {
+	++bytes[1][d[i]];
+	++deltas[0][uint8_t(d[i] - d[i - 1])];
+      }
+      total += to - from;
+      total_deltas += to - from - 1;
+    }
+    pos = end;
+  }
+  double entropy = entropy_of(bytes, total);
+  if (total_deltas) {
+    entropy = std::min(entropy, entropy_of(deltas, total_deltas));
+  }
+  *repeated = windows ? double(matches) / windows : 0;
+  return entropy;
+}
+
+bool BlueStore::_compression_skip(
+  Collection *c,
+  const bufferlist& bl,
+  double crr)
+{
+  if (!cct->_conf->bluestore_compression_predict || bl.length() == 0) {
+    return false;
+  }
+  // after repeated rejections back off exponentially, still retrying now
+  // and then in case the collection's data changes
+  auto& h = c->compression_history;
+  if (h.rejected >= 4 &&
+      h.skipped < (1u << std::min<uint32_t>(h.rejected, 8))) {
+    ++h.skipped;
+    logger->inc(l_bluestore_compress_skipped_count);
+    return true;
+  }
+  h.skipped = 0;
+
+  // an entropy coder gets about entropy/8 of the size, so data close to
+  // 8 bits per byte (already compressed or encrypted) is not worth a try,
+  // unless it repeats itself: in noise, equal sampled windows are all but
+  // impossible, so even a few percent of them means LZ matching will do
+  // better than that
+  double repeated;
+  double entropy = sampled_entropy(
+    bl, cct->_conf->bluestore_compression_predict_sample_size, &repeated);
+  if (entropy / 8 > crr && repeated < 0.02) {
+    dout(20) << __func__ << " 0x" << std::hex << bl.length() << std::dec
+	     << " entropy " << entropy << " bits/byte, repeated " << repeated
+	     << ", skipping" << dendl;
+    logger->inc(l_bluestore_compress_skipped_count);
+    return true;
+  }
+  return false;
+}
+
+void BlueStore::_compression_feedback(Collection *c, bool met_ratio)
+{
+  // judged on the compressed size alone: rejections caused by rounding
+  // up to min_alloc_size say nothing about the data
+  auto& h = c->compression_history;
+  if (met_ratio) {
+    h.rejected = 0;
+  } else if (h.rejected < std::numeric_limits<uint16_t>::max()) {
+    ++h.rejected;
+  }
+}
+
+int BlueStore::_compress(
+  const WriteContext *wctx,
+  const bufferlist& in,
+  bufferlist& out,
+  std::optional<int32_t>& compressor_message,
+  uint32_t *dict_id)
+{
+  auto& cp = wctx->compressor;
+  logger->inc(l_bluestore_compress_attempted_count);
+  *dict_id = 0;
+  if (wctx->pool < 0 ||
+      !cp->supports_dictionary() ||
+      !cct->_conf->bluestore_compression_dict ||
+      in.length() > cct->_conf->bluestore_compression_dict_max_blob_size) {
+    return cp->compress(in, out, compressor_message);
+  }
+
+  // does the pool want more data for (re)training its dictionary?
+  uint64_t target = cct->_conf->bluestore_compression_dict_sample_bytes;
+  auto wants_samples = [&](const compression_dict_pool_t& pd) {
+    if (pd.training || pd.sample_bytes >= target) {
+      return false;
+    }
+    if (pd.stamp == utime_t() || (pd.id && pd.type != cp->get_type())) {
+      return true;
+    }
+    auto max_age = cct->_conf.get_val<std::chrono::seconds>(
+      "bluestore_compression_dict_max_age").count();
+    return max_age > 0 && pd.stamp + max_age < ceph_clock_now();
+  };
+
+  Compressor::DictionaryRef dict;
+  uint32_t id = 0;
+  bool sample = true;
+  {
+    std::shared_lock l(compression_dict_lock);
+    auto p = compression_dict_pools.find(wctx->pool);
+    if (p != compression_dict_pools.end()) {
+      auto& pd = p->second;
+      if (pd.id && pd.type == cp->get_type()) {
+	id = pd.id;
+	dict = pd.dict;
+      }
+      sample = wants_samples(pd);
+    }
+  }
+  if (sample) {
+    std::unique_lock l(compression_dict_lock);
+    auto& pd = compression_dict_pools[wctx->pool];
+    if (wants_samples(pd)) {
+      if (pd.sample_type != cp->get_type()) {
+	pd.samples.clear();
+	pd.sample_bytes = 0;
+	pd.sample_type = cp->get_type();
+      }
+      // copy, so the sample does not pin the write's buffers
+      bufferptr bp = buffer::create(in.length());
+      in.cbegin().copy(in.length(), bp.c_str());
+      pd.samples.emplace_back();
+      pd.samples.back().append(std::move(bp));
+      pd.sample_bytes += in.length();
+      if (pd.sample_bytes >= target) {
+	pd.training = true;
+	int64_t pool = wctx->pool;
+	compression_dict_finisher.queue(make_lambda_context(
+	  [this, pool](int) {
+	    _compression_dict_train(pool);
+	  }));
+      }
+    }
+  }
+
+  if (dict) {
+    int r = cp->compress(in, out, *dict);
+    if (r == 0) {
+      *dict_id = id;
+      logger->inc(l_bluestore_compress_dict_count);
+      return 0;
+    }
+    dout(5) << __func__ << " dictionary " << id << " failed: "
+	    << cpp_strerror(r) << dendl;
+    out.clear();
+  }
+  return cp->compress(in, out, compressor_message);
+}
+
+int BlueStore::_open_compression_dicts()
+{
+  std::unique_lock l(compression_dict_lock);
+  compression_dict_ids.clear();
+  compression_dict_pools.clear();
+  compression_dict_last_id = 0;
+  compression_ddicts.set_size(0);
+  compression_ddicts.set_size(
+    cct->_conf->bluestore_compression_dict_cache_size);
+
+  // only the newest dictionary of each pool is loaded for compression;
+  // the others are loaded on demand by reads
+  std::map<int64_t, bufferlist> newest;
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_COMPRESSION_DICT);
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    uint32_t id;
+    _key_decode_u32(it->key().c_str(), &id);
+    bluestore_compression_dict_t d;
+    bufferlist bl = it->value();
+    auto p = bl.cbegin();
+    try {
+      decode(d, p);
+    } catch (ceph::buffer::error& e) {
+      derr << __func__ << " failed to decode compression dictionary " << id
+	   << dendl;
+      return -EIO;
+    }
+    compression_dict_last_id = std::max(compression_dict_last_id, id);
+    compression_dict_ids[id].pool = d.pool;
+    // ids only grow, so the last one seen for a pool is its newest
+    auto& pd = compression_dict_pools[d.pool];
+    pd.id = id;
+    pd.type = d.type;
+    pd.stamp = d.stamp;
+    newest[d.pool] = std::move(d.dict);
+  }
+  for (auto& [pool, dict] : newest) {
+    auto& pd = compression_dict_pools[pool];
+    CompressorRef cp =
+      pd.type < compressors.size() ? compressors[pd.type] : CompressorRef();
+    if (cp) {
+      pd.dict = cp->load_dictionary(dict, true);
+    }
+    if (!pd.dict) {
+      // new writes go without a dictionary until the pool is retrained
+      derr << __func__ << " unable to load compression dictionary " << pd.id
+	   << " for " << Compressor::get_comp_alg_name(pd.type) << dendl;
+      pd.id = 0;
+    }
+  }
+  dout(10) << __func__ << " found " << compression_dict_ids.size()
+	   << " dictionaries for " << compression_dict_pools.size() << " pools"
+	   << dendl;
+  return 0;
+}
+
+Compressor::DictionaryRef BlueStore::_get_compression_ddict(uint32_t id)
+{
+  Compressor::DictionaryRef dict;
+  if (compression_ddicts.lookup(id, &dict)) {
+    return dict;
+  }
+  string key;
+  _key_encode_u32(id, &key);
+  bufferlist bl;
+  int r = db->get(PREFIX_COMPRESSION_DICT, key, &bl);
+  if (r < 0) {
+    return dict;
+  }
+  bluestore_compression_dict_t d;
+  auto p = bl.cbegin();
+  try {
+    decode(d, p);
+  } catch (ceph::buffer::error& e) {
+    derr << __func__ << " failed to decode compression dictionary " << id
+	 << dendl;
+    return dict;
+  }
+  CompressorRef cp =
+    d.type < compressors.size() ? compressors[d.type] : CompressorRef();
+  if (cp) {
+    dict = cp->load_dictionary(d.dict, false);
+  }
+  if (!dict) {
+    // blobs compressed with it fail to read, as they would without the
+    // compressor plugin
+    const char* alg_name = Compressor::get_comp_alg_name(d.type);
+    derr << __func__ << " unable to load compression dictionary " << id
+	 << " for " << alg_name << dendl;
+    _set_compression_alert(false, alg_name);
+    return dict;
+  }
+  // a concurrent reader may have loaded it too; keep a single copy cached
+  std::unique_lock l(compression_dict_lock);
+  Compressor::DictionaryRef cached;
+  if (compression_ddicts.lookup(id, &cached)) {
+    return cached;
+  }
+  compression_ddicts.add(id, dict);
+  return dict;
+}
+
+void BlueStore::_compression_dict_train(int64_t pool)
+{
+  uint8_t type = Compressor::COMP_ALG_NONE;
+  std::vector<bufferlist> samples;
+  {
+    std::unique_lock l(compression_dict_lock);
+    auto p = compression_dict_pools.find(pool);
+    if (p == compression_dict_pools.end()) {
+      // removed with its pool
+      return;
+    }
+    type = p->second.sample_type;
+    samples.swap(p->second.samples);
+  }
+  // a failed attempt counts as a training, so the pool is retried once
+  // its dictionary would age
+  auto fail = [&](utime_t stamp) {
+    std::unique_lock l(compression_dict_lock);
+    auto p = compression_dict_pools.find(pool);
+    if (p != compression_dict_pools.end()) {
+      p->second.stamp = stamp;
+      p->second.sample_bytes = 0;
+      p->second.training = false;
+    }
+  };
+  if (!cct->_conf->bluestore_compression_dict) {
+    fail(utime_t());
+    return;
+  }
+
+  auto start = mono_clock::now();
+  auto& cp = compressors[type];
+  bufferlist dict;
+  Compressor::DictionaryRef d;
+  int r = cp->train_dictionary(
+    samples, cct->_conf->bluestore_compression_dict_size, dict);
+  if (r == 0) {
+    d = cp->load_dictionary(dict, true);
+    if (!d) {
+      r = -EINVAL;
+    }
+  }
+  utime_t now = ceph_clock_now();
+  if (r < 0) {
+    // e.g. samples too alike or too few
+    dout(5) << __func__ << " pool " << pool << " training from "
+	    << samples.size() << " samples failed: " << cpp_strerror(r)
+	    << dendl;
+    fail(now);
+    return;
+  }
+
+  // the dictionary goes through a txc of the pool, so that it is ordered
+  // against the removal of the pool's collections
+  CollectionRef c;
+  {
+    std::shared_lock l(coll_lock);
+    for (auto& [cid, coll] : coll_map) {
+      spg_t pgid;
+      if (cid.is_pg(&pgid) && (int64_t)pgid.pool() == pool) {
+	c = coll;
+	break;
+      }
+    }
+  }
+  if (!c) {
+    fail(now);
+    return;
+  }
+  std::lock_guard sl(c->submit_lock);
+  if (!c->exists) {
+    fail(now);
+    return;
+  }
+  uint32_t id;
+  bool raise_compat;
+  {
+    std::unique_lock l(compression_dict_lock);
+    id = ++compression_dict_last_id;
+    compression_dict_ids[id].pool = pool;
+    raise_compat = !compression_dict_in_use;
+    compression_dict_in_use = true;
+  }
+  bluestore_compression_dict_t rec;
+  rec.type = type;
+  rec.pool = pool;
+  rec.stamp = now;
+  rec.dict = dict;
+  bufferlist bl;
+  encode(rec, bl);
+  string key;
+  _key_encode_u32(id, &key);
+
+  // blobs refer to it only once it is durable
+  list<Context*> on_commits;
+  on_commits.push_back(make_lambda_context(
+    [this, pool, id, type, now, d, start,
+     len = dict.length(), n = samples.size()](int) {
+      {
+	std::unique_lock l(compression_dict_lock);
+	auto p = compression_dict_pools.find(pool);
+	if (p == compression_dict_pools.end() ||
+	    !compression_dict_ids.count(id)) {
+	  return;
+	}
+	auto& pd = p->second;
+	pd.id = id;
+	pd.type = type;
+	pd.stamp = now;
+	// drops the compression state of the superseded dictionary
+	pd.dict = d;
+	pd.sample_bytes = 0;
+	pd.training = false;
+      }
+      logger->inc(l_bluestore_compress_dict_trained);
+      dout(5) << "_compression_dict_train pool " << pool << " dictionary " << id
+	      << " 0x" << std::hex << len << std::dec << " bytes from "
+	      << n << " samples in "
+	      << ceph::to_seconds<double>(mono_clock::now() - start) << "s"
+	      << dendl;
+    }));
+  TransContext *txc = _txc_create(c.get(), c->osr.get(), &on_commits);
+  txc->t->set(PREFIX_COMPRESSION_DICT, key, bl);
+  if (raise_compat) {
+    // older versions can not decode blobs that refer to a dictionary
+    dout(1) << __func__ << " raising min_compat_ondisk_format to "
+	    << compression_dict_compat_ondisk_format << dendl;
+    _prepare_ondisk_format_super(txc->t);
+  }
+  _txc_finalize_and_start(txc, nullptr);
+}
+
+void BlueStore::_compression_dict_rm_pool(TransContext *txc, int64_t pool)
+{
+  std::unique_lock l(compression_dict_lock);
+  for (auto p = compression_dict_ids.begin();
+       p != compression_dict_ids.end();) {
+    if (p->second.pool == pool) {
+      string key;
+      _key_encode_u32(p->first, &key);
+      txc->t->rmkey(PREFIX_COMPRESSION_DICT, key);
+      p = compression_dict_ids.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  // samples of a training in flight are dropped with it
+  compression_dict_pools.erase(pool);
+}
+
+// this stores fiemap into interval_set, other variations
+// use it internally
+int BlueStore::_fiemap(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length,
+  interval_set<uint64_t>& destset)
+{
+  Collection *c = static_cast<Collection *>(c_.get());
+  if (!c->exists)
+    return -ENOENT;
+  {
+    std::shared_lock l(c->lock);
+
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      return -ENOENT;
+    }
+    _dump_onode<30>(cct, *o);
+
+    dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
+	     << " size 0x" << o->onode.size << std::dec << dendl;
+
+    boost::intrusive::set<Extent>::iterator ep, eend;
+    if (offset >= o->onode.size)
+      goto out;
 
     if (offset + length > o->onode.size) {
       length = o->onode.size - offset;
@@ -13587,6 +14666,17 @@ int BlueStore::readv(
       goto out;
     }
 
+    // As with read(), and the default ObjectStore::readv(), drop whatever
+    // lies past the end of the object; the caller may have worked out the
+    // intervals before the object was truncated.
+    if (!m.empty() && m.range_end() > o->onode.size) {
+      interval_set<uint64_t> object_extent;
+      if (o->onode.size > 0) {
+        object_extent.insert(0, o->onode.size);
+      }
+      m.intersection_of(object_extent);
+    }
+
     if (m.empty()) {
       r = 0;
       goto out;
@@ -14394,7 +15484,9 @@ void BlueStore::_prepare_ondisk_format_super(KeyValueDB::Transaction& t)
   }
   {
     bufferlist bl;
-    encode(min_compat_ondisk_format, bl);
+    encode(compression_dict_in_use ?
+	   compression_dict_compat_ondisk_format : min_compat_ondisk_format,
+	   bl);
     t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
   }
 }
@@ -14491,6 +15583,8 @@ int BlueStore::_open_super_meta()
 	 << latest_ondisk_format << dendl;
     return -EPERM;
   }
+  compression_dict_in_use =
+    compat_ondisk_format >= compression_dict_compat_ondisk_format;
 
   {
     if(cct->_conf->bluestore_debug_enforce_min_alloc_size == 0) {
@@ -14530,6 +15624,11 @@ int BlueStore::_open_super_meta()
   _set_blob_size();
   _update_allocator_lookup_policy();
 
+  int r = _open_compression_dicts();
+  if (r < 0) {
+    return r;
+  }
+
   _validate_bdev();
   return 0;
 }
@@ -14583,6 +15682,13 @@ int BlueStore::_upgrade_super()
       ceph_assert(r == 0);
       ondisk_format = 4;
     }
+    if (ondisk_format == 4) {
+      // changes:
+      // - blob has FLAG_COMPRESSION_DICT.  min_compat_ondisk_format is
+      //   raised to 5 only when the first dictionary is written, so older
+      //   versions can still mount us until then.
+      ondisk_format = 5;
+    }
     // This to be the last operation
     _prepare_ondisk_format_super(t);
     int r = db->submit_transaction_sync(t);
@@ -15318,6 +16424,11 @@ void BlueStore::_kv_start()
   finisher.start();
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
+  // kv_sync_thread acts as the first lane itself
+  for (uint64_t i = 1; i < cct->_conf->bluestore_kv_sync_lanes; ++i) {
+    kv_submit_lanes.emplace_back(std::make_unique<KVSubmitLane>(this));
+    kv_submit_lanes.back()->create("bstore_kv_lane");
+  }
 }
 
 void BlueStore::_kv_stop()
@@ -15341,6 +16452,15 @@ void BlueStore::_kv_stop()
   }
   kv_sync_thread.join();
   kv_finalize_thread.join();
+  for (auto& lane : kv_submit_lanes) {
+    {
+      std::lock_guard l(lane->lock);
+      lane->stop = true;
+      lane->cond.notify_all();
+    }
+    lane->join();
+  }
+  kv_submit_lanes.clear();
   ceph_assert(removed_collections.empty());
   {
     std::lock_guard l(kv_lock);
@@ -15491,18 +16611,28 @@ void BlueStore::_kv_sync_thread()
 	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
       }
 
-      for (auto txc : kv_committing) {
-	throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
-	if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
-	  ++kv_submitted;
-	  _txc_apply_kv(txc, false);
-	  --txc->osr->kv_committing_serially;
-	} else {
-	  ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+      if (kv_submit_lanes.empty()) {
+	for (auto txc : kv_committing) {
+	  throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
+	  if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
+	    ++kv_submitted;
+	    _txc_apply_kv(txc, false);
+	    --txc->osr->kv_committing_serially;
+	  } else {
+	    ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+	  }
+	  if (txc->had_ios) {
+	    --txc->osr->txc_with_unstable_io;
+	  }
 	}
-	if (txc->had_ios) {
-	  --txc->osr->txc_with_unstable_io;
+      } else {
+	for (auto txc : kv_committing) {
+	  throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
+	  if (txc->had_ios) {
+	    --txc->osr->txc_with_unstable_io;
+	  }
 	}
+	kv_submitted += _kv_submit_to_lanes(kv_committing);
       }
 
       // release throttle *before* we commit.  this allows new ops
@@ -15630,6 +16760,91 @@ void BlueStore::_kv_sync_thread()
   kv_sync_started = false;
 }
 
+/* Submit the queued txcs of a kv sync cycle through the submit lanes and
+ * wait for all of them.  Each osr is routed to a single lane, so its txcs
+ * are still submitted in order; txcs of different osrs have no ordering
+ * requirement until the sync which follows, just as with
+ * bluestore_sync_submit_transaction.  kv_committing_serially stays raised
+ * until a txc is submitted, so later txcs of the osr cannot overtake it.
+ */
+size_t BlueStore::_kv_submit_to_lanes(const deque<TransContext*>& committing)
+{
+  const size_t num_lanes = kv_submit_lanes.size() + 1;
+  std::vector<std::vector<TransContext*>> lanes(num_lanes);
+  size_t submitting = 0;
+  for (auto txc : committing) {
+    if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
+      lanes[txc->osr->get_sequencer_id() % num_lanes].push_back(txc);
+      ++submitting;
+    } else {
+      ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+    }
+  }
+
+  unsigned pending = 0;
+  for (size_t i = 1; i < num_lanes; ++i) {
+    pending += !lanes[i].empty();
+  }
+  {
+    std::lock_guard l(kv_submit_lock);
+    ceph_assert(kv_submit_pending == 0);
+    kv_submit_pending = pending;
+  }
+  for (size_t i = 1; i < num_lanes; ++i) {
+    if (lanes[i].empty()) {
+      continue;
+    }
+    auto& lane = *kv_submit_lanes[i - 1];
+    std::lock_guard l(lane.lock);
+    ceph_assert(lane.txcs.empty());
+    lane.txcs.swap(lanes[i]);
+    lane.cond.notify_one();
+  }
+  dout(20) << __func__ << " submitting " << submitting
+	   << " across " << (pending + !lanes[0].empty()) << " lanes" << dendl;
+
+  for (auto txc : lanes[0]) {
+    _txc_apply_kv(txc, false);
+    --txc->osr->kv_committing_serially;
+  }
+
+  std::unique_lock l(kv_submit_lock);
+  kv_submit_cond.wait(l, [this] { return kv_submit_pending == 0; });
+  return submitting;
+}
+
+void BlueStore::_kv_submit_lane(KVSubmitLane *lane)
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::vector<TransContext*> txcs;
+  std::unique_lock l(lane->lock);
+  while (true) {
+    if (lane->txcs.empty()) {
+      if (lane->stop)
+	break;
+      lane->cond.wait(l);
+      continue;
+    }
+    txcs.swap(lane->txcs);
+    l.unlock();
+
+    for (auto txc : txcs) {
+      _txc_apply_kv(txc, false);
+      --txc->osr->kv_committing_serially;
+    }
+    txcs.clear();
+    {
+      std::lock_guard sl(kv_submit_lock);
+      if (--kv_submit_pending == 0) {
+	kv_submit_cond.notify_one();
+      }
+    }
+
+    l.lock();
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
 void BlueStore::_kv_finalize_thread()
 {
   deque<TransContext*> kv_committed;
@@ -15770,11 +16985,20 @@ void BlueStore::deferred_try_submit()
     }
   }
 
+  // with several sequencers ready, take all of their batches and submit
+  // them as one LBA-ordered group instead of one interleaved stream each
+  bool merge = cct->_conf->bluestore_deferred_merge_sequencers &&
+    osrs.size() > 1;
+  vector<DeferredBatch*> batches;
   for (auto& osr : osrs) {
     osr->deferred_lock.lock();
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
-	_deferred_submit_unlock(osr.get());
+	if (merge) {
+	  batches.push_back(_deferred_take_pending_unlock(osr.get()));
+	} else {
+	  _deferred_submit_unlock(osr.get());
+	}
       } else {
 	osr->deferred_lock.unlock();
 	dout(20) << __func__ << "  osr " << osr << " already has running"
@@ -15785,6 +17009,12 @@ void BlueStore::deferred_try_submit()
       dout(20) << __func__ << "  osr " << osr << " has no pending" << dendl;
     }
   }
+  if (batches.size() == 1) {
+    _deferred_aio_write(batches.front(), &batches.front()->ioc);
+    bdev->aio_submit(&batches.front()->ioc);
+  } else if (!batches.empty()) {
+    _deferred_submit_group(batches);
+  }
 
   {
     std::lock_guard l(deferred_lock);
@@ -15792,7 +17022,8 @@ void BlueStore::deferred_try_submit()
   }
 }
 
-void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+BlueStore::DeferredBatch *BlueStore::_deferred_take_pending_unlock(
+  OpSequencer *osr)
 {
   dout(10) << __func__ << " osr " << osr
 	   << " " << osr->deferred_pending->iomap.size() << " ios pending "
@@ -15812,6 +17043,54 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   for (auto& txc : b->txcs) {
     throttle.log_state_latency(txc, logger, l_bluestore_state_deferred_queued_lat);
   }
+  return b;
+}
+
+void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+{
+  auto b = _deferred_take_pending_unlock(osr);
+  _deferred_aio_write(b, &b->ioc);
+  bdev->aio_submit(&b->ioc);
+}
+
+void BlueStore::_deferred_submit_group(std::vector<DeferredBatch*>& batches)
+{
+  auto g = new DeferredGroup(cct);
+  g->batches = batches;
+
+  // replay the ios in deferred seq order so that where two sequencers
+  // overwrite the same range the newer data wins, as it would have had
+  // the batches been submitted one after another
+  std::vector<std::pair<uint64_t, std::pair<uint64_t, bufferlist*>>> ios;
+  for (auto b : batches) {
+    for (auto& [offset, io] : b->iomap) {
+      ios.emplace_back(io.seq, std::make_pair(offset, &io.bl));
+    }
+  }
+  std::stable_sort(ios.begin(), ios.end(),
+		   [](const auto& a, const auto& b) {
+		     return a.first < b.first;
+		   });
+  for (auto& [seq, io] : ios) {
+    auto p = io.second->cbegin();
+    g->merged.prepare_write(cct, seq, io.first, io.second->length(), p);
+  }
+  dout(10) << __func__ << " " << batches.size() << " batches, "
+	   << ios.size() << " ios -> " << g->merged.iomap.size() << dendl;
+  logger->inc(l_bluestore_deferred_merged_batches, batches.size());
+
+  _deferred_aio_write(&g->merged, &g->ioc);
+  if (g->ioc.has_pending_aios()) {
+    bdev->aio_submit(&g->ioc);
+  } else {
+    // nothing to write (e.g. bluestore_debug_omit_block_device_write):
+    // no completion will arrive, so finish the batches here
+    g->aio_finish(this);
+  }
+}
+
+void BlueStore::_deferred_aio_write(DeferredBatch *b, IOContext *ioc)
+{
   uint64_t start = 0, pos = 0;
   bufferlist bl;
   auto i = b->iomap.begin();
@@ -15824,7 +17103,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
 	  logger->inc(l_bluestore_submitted_deferred_writes);
 	  logger->inc(l_bluestore_submitted_deferred_write_bytes, bl.length());
-	  int r = bdev->aio_write(start, bl, &b->ioc, false);
+	  int r = bdev->aio_write(start, bl, ioc, false);
 	  ceph_assert(r == 0);
 	}
       }
@@ -15845,8 +17124,6 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     bl.claim_append(i->second.bl);
     ++i;
   }
-
-  bdev->aio_submit(&b->ioc);
 }
 
 struct C_DeferredTrySubmit : public Context {
@@ -16063,6 +17340,8 @@ int BlueStore::queue_transactions(
   OpSequencer *osr = c->osr.get();
   dout(10) << __func__ << " ch " << c << " " << c->cid << dendl;
 
+  std::unique_lock sl(c->submit_lock);
+
   // prepare
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
 				  &on_commit, op);
@@ -16071,6 +17350,38 @@ int BlueStore::queue_transactions(
     txc->bytes += (*p).get_num_bytes();
     _txc_add_transaction(txc, &(*p));
   }
+  _txc_finalize_and_start(txc, handle);
+  sl.unlock();
+
+  // we're immediately readable (unlike FileStore)
+  for (auto c : on_applied_sync) {
+    c->complete(0);
+  }
+  if (!on_applied.empty()) {
+    if (c->commit_queue) {
+      c->commit_queue->queue(on_applied);
+    } else {
+      finisher.queue(on_applied);
+    }
+  }
+
+#ifdef WITH_BLKIN
+  if (txc->trace) {
+    txc->trace.event("txc applied");
+  }
+#endif
+
+  log_latency("submit_transact",
+    l_bluestore_submit_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  return 0;
+}
+
+void BlueStore::_txc_finalize_and_start(
+  TransContext *txc,
+  ThreadPool::TPHandle *handle)
+{
   _txc_calc_cost(txc);
 
   _txc_write_nodes(txc, txc->t);
@@ -16125,36 +17436,13 @@ int BlueStore::queue_transactions(
 
   logger->inc(l_bluestore_txc);
 
-  // execute (start)
-  _txc_state_proc(txc);
-
-  // we're immediately readable (unlike FileStore)
-  for (auto c : on_applied_sync) {
-    c->complete(0);
-  }
-  if (!on_applied.empty()) {
-    if (c->commit_queue) {
-      c->commit_queue->queue(on_applied);
-    } else {
-      finisher.queue(on_applied);
-    }
-  }
-
-#ifdef WITH_BLKIN
-  if (txc->trace) {
-    txc->trace.event("txc applied");
-  }
-#endif
-
-  log_latency("submit_transact",
-    l_bluestore_submit_lat,
-    mono_clock::now() - start,
-    cct->_conf->bluestore_log_op_age);
   log_latency("throttle_transact",
     l_bluestore_throttle_lat,
     tend - tstart,
     cct->_conf->bluestore_log_op_age);
-  return 0;
+
+  // execute (start)
+  _txc_state_proc(txc);
 }
 
 void BlueStore::_txc_aio_submit(TransContext *txc)
@@ -17352,6 +18640,34 @@ void BlueStore::_do_write_big(
   }
 }
 
+/*
+ * Physical offset right past the data that logically precedes offset in
+ * the object, so that appends can be placed contiguously with it. Only
+ * looks at extents already in memory; returns 0 when there is no usable
+ * predecessor.
+ */
+uint64_t BlueStore::_get_append_alloc_hint(OnodeRef& o, uint64_t offset)
+{
+  if (offset == 0) {
+    return 0;
+  }
+  auto ep = o->extent_map.seek_lextent(offset - 1);
+  if (ep == o->extent_map.extent_map.end() ||
+      ep->logical_offset > offset - 1 ||
+      ep->logical_end() != offset) {
+    return 0;
+  }
+  const bluestore_blob_t& b = ep->blob->get_blob();
+  uint64_t b_off = ep->blob_offset + ep->length - 1;
+  if (b.is_compressed() || !b.is_allocated(b_off, 1)) {
+    return 0;
+  }
+  uint64_t hint = p2roundup(b.calc_offset(b_off, nullptr) + 1, min_alloc_size);
+  dout(20) << __func__ << " 0x" << std::hex << offset
+	   << " -> 0x" << hint << std::dec << dendl;
+  return hint;
+}
+
 int BlueStore::_do_alloc_write(
   TransContext *txc,
   CollectionRef coll,
@@ -17384,7 +18700,8 @@ int BlueStore::_do_alloc_write(
 
   auto max_bsize = std::max(wctx->target_blob_size, min_alloc_size);
   for (auto& wi : wctx->writes) {
-    if (wctx->compressor && wi.blob_length > min_alloc_size) {
+    if (wctx->compressor && wi.blob_length > min_alloc_size &&
+	!_compression_skip(coll.get(), wi.bl, wctx->crr)) {
       auto start = mono_clock::now();
 
       // compress
@@ -17394,11 +18711,13 @@ int BlueStore::_do_alloc_write(
       // FIXME: memory alignment here is bad
       bufferlist t;
       std::optional<int32_t> compressor_message;
-      int r = wctx->compressor->compress(wi.bl, t, compressor_message);
+      uint32_t dict_id;
+      int r = _compress(wctx, wi.bl, t, compressor_message, &dict_id);
       uint64_t want_len_raw = wi.blob_length * wctx->crr;
       uint64_t want_len = p2roundup(want_len_raw, min_alloc_size);
       bool rejected = false;
       uint64_t compressed_len = t.length();
+      _compression_feedback(coll.get(), r == 0 && compressed_len <= want_len_raw);
       // do an approximate (fast) estimation for resulting blob size
       // that doesn't take header overhead  into account
       uint64_t result_len = p2roundup(compressed_len, min_alloc_size);
@@ -17417,6 +18736,7 @@ int BlueStore::_do_alloc_write(
 	  // pad out to min_alloc_size
 	  wi.compressed_bl.append_zero(result_len - compressed_len);
 	  wi.compressed_len = compressed_len;
+	  wi.compression_dict = dict_id;
 	  wi.compressed = true;
 	  logger->inc(l_bluestore_write_pad_bytes, result_len - compressed_len);
 	  dout(20) << __func__ << std::hex << "  compressed 0x" << wi.blob_length
@@ -17470,10 +18790,17 @@ int BlueStore::_do_alloc_write(
   PExtentVector prealloc;
   prealloc.reserve(2 * wctx->writes.size());
   int64_t prealloc_left = 0;
+  int64_t hint = use_last_allocator_lookup_position ? -1 : 0;
+  if (cct->_conf->bluestore_alloc_append_hint) {
+    uint64_t h = _get_append_alloc_hint(o, wctx->writes.front().logical_offset);
+    if (h) {
+      hint = h;
+    }
+  }
   auto start = mono_clock::now();
   prealloc_left = alloc->allocate(
     need, min_alloc_size, need,
-    use_last_allocator_lookup_position ? -1 : 0,
+    hint,
     &prealloc);
   log_latency("allocator@_do_alloc_write",
     l_bluestore_allocator_lat,
@@ -17509,6 +18836,7 @@ int BlueStore::_do_alloc_write(
       unsigned csum_order = std::countr_zero(csum_length);
       l = &wi.compressed_bl;
       dblob.set_compressed(wi.blob_length, wi.compressed_len);
+      dblob.set_compression_dict(wi.compression_dict);
       if (csum != Checksummer::CSUM_NONE) {
         dout(20) << __func__
 		 << " initialize csum setting for compressed blob " << *wi.b
@@ -17846,6 +19174,10 @@ void BlueStore::_choose_write_options(
     wctx->compressor = c->compression_algorithm.has_value() ?
       compressors[*(c->compression_algorithm)]:
       compressors[def_compressor_alg];
+    spg_t pgid;
+    if (c->cid.is_pg(&pgid)) {
+      wctx->pool = pgid.pool();
+    }
     wctx->crr = c->compression_req_ratio.has_value() ?
       *(c->compression_req_ratio) :
       cct->_conf->bluestore_compression_required_ratio;
@@ -18042,7 +19374,7 @@ int BlueStore::_do_write_v2(
 
   WriteContext wctx;
   _choose_write_options(c, o, fadvise_flags, &wctx);
-  if (wctx.compressor) {
+  if (wctx.compressor && !_compression_skip(c.get(), bl, wctx.crr)) {
     uint32_t end = offset + length;
     uint32_t segment_size = o->onode.segment_size;
     if (segment_size) {
@@ -18130,11 +19462,18 @@ int BlueStore::_do_write_v2_compressed(
     int32_t disk_for_raw;
     uint32_t au_size = min_alloc_size;
     disk_for_compressed = estimator->split_and_compress(data_bl, bd);
+    uint32_t compressed_len = 0;
+    for (const auto& b : bd) {
+      compressed_len += b.compressed_length;
+    }
+    _compression_feedback(c.get(), compressed_len <= i.length * wctx.crr);
     disk_for_raw = p2roundup(i.offset + i.length, au_size) - p2align(i.offset, au_size);
     BlueStore::Writer wr(this, txc, &wctx, o);
     if (disk_for_compressed < disk_for_raw) {
+      logger->inc(l_bluestore_compress_success_count);
       wr.do_write_with_blobs(i.offset, i.offset + i.length, i.offset + i.length, bd);
     } else {
+      logger->inc(l_bluestore_compress_rejected_count);
       wr.do_write(i.offset, data_bl);
     }
   }
@@ -19089,6 +20428,16 @@ void BlueStore::_do_remove_collection(TransContext *txc,
   (*c)->exists = false;
   _osr_register_zombie((*c)->osr.get());
   txc->t->rmkey(PREFIX_COLL, stringify((*c)->cid));
+  spg_t pgid;
+  if ((*c)->cid.is_pg(&pgid) &&
+      std::none_of(coll_map.begin(), coll_map.end(), [&](auto& p) {
+	spg_t other;
+	return p.first.is_pg(&other) && other.pool() == pgid.pool();
+      })) {
+    // the last collection of the pool is gone and with it every blob
+    // that could refer to its compression dictionaries
+    _compression_dict_rm_pool(txc, pgid.pool());
+  }
   c->reset();
 }
 
@@ -19630,6 +20979,10 @@ void BlueStore::_shutdown_cache()
     i->flush();
     ceph_assert(i->empty());
   }
+  for (auto i : onode_cache_shards) {
+    // drop the collection refs of onodes still waiting for the compact tier
+    i->drop_compact_pending();
+  }
   for (auto& p : coll_map) {
     // Clear deferred write buffers before clearing up Onodes
     std::unique_lock l(p.second->lock);
@@ -19699,34 +21052,14 @@ void BlueStore::_record_onode(OnodeRef& o, KeyValueDB::Transaction &txn)
     logger->inc(l_bluestore_onode_reshard);
   }
 
-  // bound encode
-  size_t bound = 0;
-  uint64_t flag = segment_size != 0 ? 0 : bluestore_onode_t::FLAG_DEBUG_FORCE_V2;
-  denc(o->onode, bound, flag);
-  o->extent_map.bound_encode_spanning_blobs(bound);
-  if (o->onode.extent_map_shards.empty()) {
-    denc(o->extent_map.inline_bl, bound);
-  }
-
-  // encode
   bufferlist bl;
-  unsigned onode_part, blob_part, extent_part;
-  {
-    auto p = bl.get_contiguous_appender(bound, true);
-    denc(o->onode, p, flag);
-    onode_part = p.get_logical_offset();
-    o->extent_map.encode_spanning_blobs(p);
-    blob_part = p.get_logical_offset() - onode_part;
-    if (o->onode.extent_map_shards.empty()) {
-      denc(o->extent_map.inline_bl, p);
-    }
-    extent_part = p.get_logical_offset() - onode_part - blob_part;
-  }
+  unsigned parts[3];
+  o->encode_value(bl, segment_size != 0, parts);
 
   dout(20) << __func__  << " onode " << o->oid << " is " << bl.length()
-	    << " (" << onode_part << " bytes onode + "
-	    << blob_part << " bytes spanning blobs + "
-	    << extent_part << " bytes inline extents)"
+	    << " (" << parts[0] << " bytes onode + "
+	    << parts[1] << " bytes spanning blobs + "
+	    << parts[2] << " bytes inline extents)"
 	    << dendl;
 
 
@@ -20962,7 +22295,8 @@ int BlueStore::read_allocation_from_onodes(SimpleBitmap *sbmap, read_alloc_stats
     }
   }
 
-  it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
+  it = db->get_iterator(PREFIX_OBJ,
+                        KeyValueDB::ITERATOR_NOCACHE | KeyValueDB::ITERATOR_PREFETCH);
   if (!it) {
     derr << "failed getting onode's iterator" << dendl;
     return -ENOENT;
@@ -47,6 +47,7 @@
 #include "include/mempool.h"
 #include "include/hash.h"
 #include "common/bloom_filter.hpp"
+#include "common/simple_cache.hpp"
 #include "common/Finisher.h"
 #include "common/ceph_mutex.h"
 #include "common/Throttle.h"
@@ -157,6 +158,7 @@ enum {
   l_bluestore_issued_deferred_write_bytes,
   l_bluestore_submitted_deferred_writes,
   l_bluestore_submitted_deferred_write_bytes,
+  l_bluestore_deferred_merged_batches,
 
   l_bluestore_write_big_skipped_blobs,
   l_bluestore_write_big_skipped_bytes,
@@ -173,6 +175,10 @@ enum {
   l_bluestore_decompress_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
+  l_bluestore_compress_attempted_count,
+  l_bluestore_compress_skipped_count,
+  l_bluestore_compress_dict_count,
+  l_bluestore_compress_dict_trained,
   //****************************************
 
   // onode cache stats
@@ -183,6 +189,9 @@ enum {
   l_bluestore_onode_misses,
   l_bluestore_onode_shard_hits,
   l_bluestore_onode_shard_misses,
+  l_bluestore_onodes_compact,
+  l_bluestore_onode_compact_bytes,
+  l_bluestore_onode_compact_hits,
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_spanning_blobs,
@@ -249,6 +258,9 @@ enum {
   //****************************************
   l_bluestore_runtime_frag_lat,
   l_bluestore_static_frag_lat,
+  l_bluestore_defrag_scanned,
+  l_bluestore_defrag_rewritten,
+  l_bluestore_defrag_bytes,
   //****************************************
   l_bluestore_last
 };
@@ -273,6 +285,9 @@ public:
 
   void _set_csum();
   void _set_compression();
+  int _open_compression_dicts();
+  void _compression_dict_train(int64_t pool);
+  Compressor::DictionaryRef _get_compression_ddict(uint32_t id);
   void _set_throttle_params();
   int _set_cache_sizes();
   void _set_max_defer_interval() {
@@ -1395,6 +1410,9 @@ public:
                               /// (it can be pinned and hence physically out
                               /// of it at the moment though)
     uint16_t prev_spanning_cnt = 0; /// spanning blobs count
+    /// bumped under Collection::lock by every transaction changing the
+    /// object, so that a reader which dropped the lock can spot changes
+    uint64_t write_seq = 0;
     ExtentMap extent_map;
     BufferSpace bc;             ///< buffer cache
 
@@ -1453,6 +1471,14 @@ public:
       bool allow_empty,
       bool use_onode_segmentation);
 
+    /// encode the value stored under key; extent map shards, if any, are
+    /// stored under their own keys.  parts, if given, gets the sizes of the
+    /// onode, spanning blobs and inline extent map.
+    void encode_value(ceph::buffer::list& bl, bool use_onode_segmentation,
+                      unsigned *parts = nullptr);
+    /// true if the onode matches what was last written to the kv store
+    bool is_clean() const;
+
     void dump(ceph::Formatter* f) const;
 
     void flush();
@@ -1516,6 +1542,22 @@ public:
     }
   };
 
+  /// encoded value of an onode trimmed from the onode cache, held in
+  /// OnodeSpace::compact_map
+  struct CompactOnode {
+    OnodeSpace *space;
+    const ghobject_t *oid = nullptr;  ///< key of our compact_map entry
+    Onode *pending = nullptr;         ///< trimmed onode not yet encoded
+    ceph::buffer::list v;
+    boost::intrusive::list_member_hook<> lru_item;
+
+    CompactOnode(OnodeSpace *s, Onode *o) : space(s), pending(o) {}
+
+    uint64_t get_bytes() const {
+      return sizeof(ghobject_t) + sizeof(*this) + v.length();
+    }
+  };
+
   /// A generic Cache Shard
   struct CacheShard {
     CephContext *cct;
@@ -1610,11 +1652,47 @@ public:
   struct OnodeCacheShard : public CacheShard {
     std::array<std::pair<ghobject_t, ceph::mono_clock::time_point>, 64> dumped_onodes;
 
+    /// compact tier: encoded values of onodes trimmed from the cache, which
+    /// are decoded again on the next lookup instead of read from the kv store
+    typedef boost::intrusive::list<
+      CompactOnode,
+      boost::intrusive::member_hook<
+        CompactOnode,
+        boost::intrusive::list_member_hook<>,
+        &CompactOnode::lru_item> > compact_list_t;
+    compact_list_t compact_lru;
+    uint64_t compact_bytes = 0;
+    std::atomic<uint64_t> compact_max_bytes = {0};
+    /// trimmed onodes waiting for encode_compact(); the collection ref
+    /// keeps Onode::c valid until then
+    std::vector<std::pair<CollectionRef, OnodeRef>> compact_pending;
+
   public:
     OnodeCacheShard(CephContext* cct) : CacheShard(cct) {}
     static OnodeCacheShard *create(CephContext* cct, std::string type,
                                    PerfCounters *logger);
 
+    void _add_compact(CompactOnode *c);
+    void _rm_compact(CompactOnode *c);
+    void _trim_compact();
+    /// encode the onodes trimmed since the last call into the compact
+    /// tier, without holding the shard lock while encoding
+    void encode_compact();
+    void drop_compact_pending();
+    void set_compact_max(uint64_t max_bytes) {
+      compact_max_bytes = max_bytes;
+      std::lock_guard l(lock);
+      _trim_compact();
+    }
+    bool compact_enabled() const {
+      return compact_max_bytes > 0;
+    }
+    void add_compact_stats(uint64_t *onodes, uint64_t *bytes) {
+      std::lock_guard l(lock);
+      *onodes += compact_lru.size();
+      *bytes += compact_bytes;
+    }
+
     //The following methods prefixed with '_' to be called under
     // Shard's lock
     virtual void _add(Onode* o, int level) = 0;
@@ -1684,11 +1762,21 @@ public:
   private:
     /// forward lookups
     mempool::bluestore_cache_meta::unordered_map<ghobject_t,OnodeRef> onode_map;
+    /// compact tier entries, never for an oid in onode_map
+    mempool::bluestore_cache_meta::unordered_map<ghobject_t,CompactOnode> compact_map;
 
     friend struct Collection; // for split_cache()
     friend struct Onode; // for put()
     friend struct LruOnodeCacheShard;
+    friend struct OnodeCacheShard; // for _drop_compact(), _set_compact()
     void _remove(const ghobject_t& oid);
+    /// queue a clean onode being trimmed from the cache for the compact tier
+    void _add_compact(Onode *o);
+    /// store the encoded value of an onode queued by _add_compact(), unless
+    /// its oid was looked up again in the meantime
+    void _set_compact(Onode *o, ceph::buffer::list&& v);
+    void _drop_compact(const ghobject_t& oid);
+    void _clear_compact();
   public:
     OnodeSpace(OnodeCacheShard *c) : cache(c) {}
     ~OnodeSpace() {
@@ -1697,6 +1785,8 @@ public:
 
     OnodeRef add_onode(const ghobject_t& oid, OnodeRef& o);
     OnodeRef lookup(const ghobject_t& o);
+    /// remove oid from the compact tier, returning its encoded value
+    bool take_compact(const ghobject_t& oid, ceph::buffer::list *v);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_meta::string& new_okey);
@@ -1720,6 +1810,14 @@ public:
     bluestore_cnode_t cnode;
     ceph::shared_mutex lock =
       ceph::make_shared_mutex("BlueStore::Collection::lock", true, false);
+    /// held from txc creation to its start, so that internal writers
+    /// (defrag) do not interleave with transactions queued on us.  A txc
+    /// applied after a later created one would have its onode encoded in
+    /// the wrong order.  Uncontended on the OSD path, where the PG lock
+    /// already serializes submissions; defrag holds it only while queueing
+    /// a rewrite, not while reading.
+    ceph::mutex submit_lock =
+      ceph::make_mutex("BlueStore::Collection::submit_lock");
 
     bool exists;
 
@@ -1741,6 +1839,12 @@ public:
     ContextQueue *commit_queue;
     std::unique_ptr<Estimator> estimator;
 
+    /// recent compression outcomes, see _compression_skip()
+    struct compression_history_t {
+      uint16_t rejected = 0;  ///< attempts rejected in a row
+      uint16_t skipped = 0;   ///< attempts skipped since the last one
+    } compression_history;
+
     std::atomic<uint64_t> runtime_frag_count{0};
     std::atomic<uint64_t> runtime_read_samples{0};
     std::atomic<uint64_t> static_frag_score{0};
@@ -2043,6 +2147,7 @@ public:
     }
 
     void write_onode(OnodeRef& o) {
+      ++o->write_seq;
       onodes.insert(o);
     }
     void write_shared_blob(const SharedBlobRef &sb) {
@@ -2058,6 +2163,7 @@ public:
       modified_objects.insert(o);
     }
     void note_removed_object(OnodeRef& o) {
+      ++o->write_seq;
       modified_objects.insert(o);
       onodes.erase(o);
     }
@@ -2228,6 +2334,23 @@ public:
     }
   };
 
+  /// pending batches of several sequencers, merged and submitted as one
+  struct DeferredGroup final : public AioContext {
+    std::vector<DeferredBatch*> batches; ///< batches (each now running)
+    DeferredBatch merged;                ///< union of batches, newest seq wins
+    IOContext ioc;                       ///< our aios
+
+    DeferredGroup(CephContext *cct)
+      : merged(cct, nullptr), ioc(cct, this) {}
+
+    void aio_finish(BlueStore *store) override {
+      for (auto b : batches) {
+	store->_deferred_aio_finish(b->osr);
+      }
+      delete this;
+    }
+  };
+
   class OpSequencer : public RefCountedObject {
   public:
     ceph::mutex qlock = ceph::make_mutex("BlueStore::OpSequencer::qlock");
@@ -2382,6 +2505,28 @@ public:
       return NULL;
     }
   };
+  /// helper of kv_sync_thread, submitting the txcs of a subset of osrs
+  struct KVSubmitLane : public Thread {
+    BlueStore *store;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::KVSubmitLane::lock");
+    ceph::condition_variable cond;
+    std::vector<TransContext*> txcs; ///< to submit, in per-osr order
+    bool stop = false;
+    explicit KVSubmitLane(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_kv_submit_lane(this);
+      return NULL;
+    }
+  };
+
+  struct DefragThread : public Thread {
+    BlueStore *store;
+    explicit DefragThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_defrag_thread();
+      return NULL;
+    }
+  };
 
   struct BigDeferredWriteContext {
     uint64_t off = 0;     // original logical offset
@@ -2484,6 +2629,23 @@ private:
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  std::vector<std::unique_ptr<KVSubmitLane>> kv_submit_lanes;
+  ceph::mutex kv_submit_lock = ceph::make_mutex("BlueStore::kv_submit_lock");
+  ceph::condition_variable kv_submit_cond;
+  unsigned kv_submit_pending = 0; ///< lanes still submitting this kv cycle
+
+  DefragThread defrag_thread;
+  ceph::mutex defrag_lock = ceph::make_mutex("BlueStore::defrag_lock");
+  ceph::condition_variable defrag_cond;
+  bool defrag_running = false;
+  bool defrag_stop = false;
+  std::optional<coll_t> defrag_cid;  ///< restrict the pass to this collection
+  coll_t defrag_pos_cid;             ///< progress of the current pass
+  ghobject_t defrag_pos;
+  uint64_t defrag_scanned = 0;
+  uint64_t defrag_rewritten = 0;
+  uint64_t defrag_bytes = 0;
+
   PerfCounters *logger = nullptr;
 
   std::list<CollectionRef> removed_collections;
@@ -2536,6 +2698,31 @@ private:
   std::atomic<uint64_t> comp_min_blob_size = {0};
   std::atomic<uint64_t> comp_max_blob_size = {0};
 
+  /// per pool state of trained compression dictionaries
+  struct compression_dict_pool_t {
+    uint32_t id = 0;      ///< dictionary in use, 0 if none
+    uint8_t type = Compressor::COMP_ALG_NONE; ///< its algorithm
+    utime_t stamp;        ///< when it was trained
+    Compressor::DictionaryRef dict; ///< id loaded for compression
+    std::vector<ceph::buffer::list> samples; ///< data for the next training
+    uint64_t sample_bytes = 0;
+    uint8_t sample_type = Compressor::COMP_ALG_NONE; ///< algorithm sampled for
+    bool training = false; ///< queued to compression_dict_finisher
+  };
+  /// every dictionary in the DB
+  struct compression_dict_info_t {
+    int64_t pool = -1;
+    std::atomic<bool> referenced = false; ///< by some blob, as seen by fsck
+  };
+  ceph::shared_mutex compression_dict_lock =
+    ceph::make_shared_mutex("BlueStore::compression_dict_lock");
+  std::map<uint32_t, compression_dict_info_t> compression_dict_ids;
+  std::map<int64_t, compression_dict_pool_t> compression_dict_pools;
+  uint32_t compression_dict_last_id = 0;
+  /// dictionaries loaded for decompression, by id
+  SimpleLRU<uint32_t, Compressor::DictionaryRef> compression_ddicts;
+  Finisher compression_dict_finisher; ///< trains dictionaries
+
   std::atomic<uint64_t> max_blob_size = {0};  ///< maximum blob size
   std::atomic<uint32_t> segment_size = {0}; ///< snapshot of conf value "bluestore_onode_segment_size"
                                             /// When 0 onode_bluestore_t v2 is in force, otherwise v3 is used.
@@ -2602,6 +2789,8 @@ private:
     std::shared_ptr<PriorityCache::PriCache> binned_kv_cache = nullptr;
     std::shared_ptr<PriorityCache::PriCache> binned_kv_onode_cache = nullptr;
     std::shared_ptr<PriorityCache::Manager> pcm = nullptr;
+    // caches owned by the store's user, see add_priority_cache()
+    std::map<std::string, std::shared_ptr<PriorityCache::PriCache>> external_caches;
 
     struct MempoolCache : public PriorityCache::PriCache {
       BlueStore *store;
@@ -2758,8 +2947,20 @@ private:
             mempool::bluestore_cache_onode::allocated_items();
         return (2 > onode_num) ? 2 : onode_num;
       }
+      uint64_t _get_compact_bytes() const {
+        uint64_t onodes = 0, bytes = 0;
+        for (auto i : store->onode_cache_shards) {
+          i->add_compact_stats(&onodes, &bytes);
+        }
+        return bytes;
+      }
       double get_bytes_per_onode() const {
-        return (double)_get_used_bytes() / (double)_get_num_onodes();
+        // the compact tier is accounted in the meta mempools but is
+        // budgeted separately, see _resize_shards()
+        uint64_t used = _get_used_bytes();
+        uint64_t compact = _get_compact_bytes();
+        used = used > compact ? used - compact : 0;
+        return (double)used / (double)_get_num_onodes();
       }
     };
     std::shared_ptr<MetaCache> meta_cache;
@@ -2817,13 +3018,18 @@ private:
       cond.notify_all();
       lock.unlock();
       join();
+      external_caches.clear();
     }
+    void add_external_cache(const std::string& name,
+                            std::shared_ptr<PriorityCache::PriCache> cache);
+    void remove_external_cache(const std::string& name);
 
   private:
     void _update_cache_settings();
     void _resize_shards(bool interval_stats);
 
     mono_clock::time_point last_fragmentation_check;
+    mono_clock::time_point last_free_defrag;
   } mempool_thread;
 
 #ifdef WITH_BLKIN
@@ -2961,6 +3167,8 @@ private:
   void _txc_add_transaction(TransContext *txc, Transaction *t);
   void _txc_calc_cost(TransContext *txc);
   void _txc_write_nodes(TransContext *txc, KeyValueDB::Transaction t);
+  void _txc_finalize_and_start(TransContext *txc,
+			       ThreadPool::TPHandle *handle);
   void _txc_state_proc(TransContext *txc);
   void _txc_aio_submit(TransContext *txc);
 public:
@@ -2984,6 +3192,8 @@ private:
   void _kv_start();
   void _kv_stop();
   void _kv_sync_thread();
+  size_t _kv_submit_to_lanes(const std::deque<TransContext*>& committing);
+  void _kv_submit_lane(KVSubmitLane *lane);
   void _kv_finalize_thread();
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, uint64_t len);
@@ -2992,6 +3202,9 @@ public:
   void deferred_try_submit();
 private:
   void _deferred_submit_unlock(OpSequencer *osr);
+  DeferredBatch *_deferred_take_pending_unlock(OpSequencer *osr);
+  void _deferred_aio_write(DeferredBatch *b, IOContext *ioc);
+  void _deferred_submit_group(std::vector<DeferredBatch*>& batches);
   void _deferred_aio_finish(OpSequencer *osr);
   int _deferred_replay();
   bool _eliminate_outdated_deferred(bluestore_deferred_transaction_t* deferred_txn,
@@ -3109,12 +3322,15 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 4;        ///< our version
+  const int32_t latest_ondisk_format = 5;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 3;    ///< who can read us
+  /// who can read us once blobs refer to compression dictionaries
+  const int32_t compression_dict_compat_ondisk_format = 5;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
+  bool compression_dict_in_use = false; ///< compat raised for dictionaries
   bool    m_fast_shutdown = false;
   int _upgrade_super();  ///< upgrade (called during open_super)
   uint64_t _get_ondisk_reserved() const;
@@ -3209,6 +3425,14 @@ public:
   }
 
   void set_cache_shards(unsigned num) override;
+  void add_priority_cache(
+    const std::string& name,
+    std::shared_ptr<PriorityCache::PriCache> cache) override {
+    mempool_thread.add_external_cache(name, cache);
+  }
+  void remove_priority_cache(const std::string& name) override {
+    mempool_thread.remove_external_cache(name);
+  }
   void dump_cache_stats(ceph::Formatter *f) override {
     int onode_count = 0, buffers_bytes = 0;
     for (auto i: onode_cache_shards) {
@@ -3263,6 +3487,10 @@ public:
   int expand_devices(std::ostream& out);
   std::string get_device_path(unsigned id);
 
+  /// start a background pass rewriting fragmented objects
+  int defrag_start(const std::string& coll, std::ostream& ss);
+  void defrag_dump(ceph::Formatter *f);
+
   bool get_db_sharding(std::string& res_sharding);
 
   int dump_bluefs_sizes(std::ostream& out);
@@ -3376,6 +3604,13 @@ private:
 
   void _measure_static_frag(Collection *c, const OnodeRef& o);
 
+  void _defrag_thread();
+  bool _defrag_collection(CollectionRef& c);
+  uint64_t _defrag_object(CollectionRef& c, const ghobject_t& oid);
+  int64_t _defrag_try_object(CollectionRef& c, const ghobject_t& oid);
+  bool _defrag_throttle(uint64_t bytes);
+  void _defrag_stop();
+
   int _do_read(
     Collection *c,
     OnodeRef& o,
@@ -3760,7 +3995,8 @@ private:
     uint64_t blob_xoffset,
     const ceph::buffer::list& bl,
     uint64_t logical_offset);
-  int _decompress(ceph::buffer::list& source, ceph::buffer::list* result);
+  int _decompress(ceph::buffer::list& source, ceph::buffer::list* result,
+		  uint32_t dict_id = 0);
 
 
   // --------------------------------------------------------
@@ -3770,6 +4006,7 @@ private:
     bool buffered = false;          ///< buffered write
     bool compress = false;          ///< compressed write
     CompressorRef compressor;       ///< effective compression engine
+    int64_t pool = -1;              ///< pool, selects the compression dictionary
     double crr = 0.0;               ///< compression required ratio
     uint8_t csum_type = 0;          ///< checksum type for new blobs
     unsigned csum_order = 0;        ///< target checksum chunk order
@@ -3793,6 +4030,7 @@ private:
       bool compressed = false;
       ceph::buffer::list compressed_bl;
       size_t compressed_len = 0;
+      uint32_t compression_dict = 0; ///< dictionary compressed_bl needs
 
       write_item(
 	uint64_t logical_offs,
@@ -3853,6 +4091,18 @@ private:
       uint64_t min_alloc_size);
   };
   private:
+  bool _compression_skip(
+    Collection *c,
+    const ceph::buffer::list& bl,
+    double crr);
+  void _compression_feedback(Collection *c, bool met_ratio);
+  int _compress(
+    const WriteContext *wctx,
+    const ceph::buffer::list& in,
+    ceph::buffer::list& out,
+    std::optional<int32_t>& compressor_message,
+    uint32_t *dict_id);
+  void _compression_dict_rm_pool(TransContext *txc, int64_t pool);
   BlueStore::extent_map_t::iterator _punch_hole_2(
     Collection* c,
     OnodeRef& o,
@@ -3888,6 +4138,7 @@ private:
     CollectionRef c,
     OnodeRef& o,
     WriteContext *wctx);
+  uint64_t _get_append_alloc_hint(OnodeRef& o, uint64_t offset);
   void _wctx_finish(
     TransContext *txc,
     CollectionRef& c,
@@ -149,6 +149,22 @@ void Btree2Allocator::_shutdown()
   range_tree.clear();
 }
 
+void Btree2Allocator::_defrag_free_space()
+{
+  if (!cache) {
+    return;
+  }
+  uint64_t count = 0;
+  cache->drain([&](uint64_t offset, uint64_t length) {
+    // accounted in num_free when cached, _add_to_tree accounts it again
+    num_free -= length;
+    _add_to_tree(offset, length);
+    ++count;
+  });
+  ldout(cct, 10) << __func__ << " merged " << count << " cached extents"
+    << dendl;
+}
+
 void Btree2Allocator::_dump(bool full) const
 {
   if (full) {
@@ -201,12 +217,36 @@ int64_t Btree2Allocator::_allocate(
   uint64_t want,
   uint64_t unit,
   uint64_t max_alloc_size,
-  int64_t  hint, // unused and likely unneeded
+  int64_t  hint, // positive: offset the caller would like to continue at
   PExtentVector* extents)
 {
   uint64_t allocated = 0;
   while (allocated < want) {
     auto want_now = std::min(max_alloc_size, want - allocated);
+    size_t bucket0 = myTraits._get_bucket(want_now);
+    bool from_top = size_classes &&
+      bucket0 < myTraits._get_bucket(weight_center);
+    uint64_t* cursor =
+      size_classes && !from_top ? &class_cursor[bucket0] : nullptr;
+    if (hint > 0) {
+      uint64_t l = _allocate_at(hint, want_now, unit, unit, extents);
+      if (l) {
+        allocated += l;
+        hint += l;
+        continue;
+      }
+      hint = 0;
+    }
+    if (cursor && *cursor) {
+      // only when it fits whole, a partial one would just split the
+      // allocation in two
+      uint64_t l = _allocate_at(*cursor, want_now, want_now, unit, extents);
+      if (l) {
+        allocated += l;
+        *cursor += l;
+        continue;
+      }
+    }
     if (cache && want_now != want) {
       uint64_t cached_chunk_offs = 0;
       if (cache->try_get(&cached_chunk_offs, want_now)) {
@@ -216,14 +256,16 @@ int64_t Btree2Allocator::_allocate(
         continue;
       }
     }
-    size_t bucket0 = myTraits._get_bucket(want_now);
     int64_t r = __allocate(bucket0, want_now,
-      unit, extents);
+      unit, from_top, extents);
     if (r < 0) {
       // Allocation failed.
       break;
     }
     allocated += r;
+    if (cursor) {
+      *cursor = extents->back().offset + extents->back().length;
+    }
   }
   return allocated ? allocated : -ENOSPC;
 }
@@ -338,6 +380,7 @@ int64_t Btree2Allocator::__allocate(
   size_t bucket0,
   uint64_t size,
   uint64_t unit,
+  bool from_top,
   PExtentVector* extents)
 {
   int64_t allocated = 0;
@@ -412,6 +455,9 @@ found:
     auto l = std::min(size, rs_p->length());
     auto rt_p = range_tree.find(o);
     ceph_assert(rt_p != range_tree.end());
+    if (from_top && p2align(rs_p->end, unit) >= o + l) {
+      o = p2align(rs_p->end, unit) - l;
+    }
     _remove_from_tree(rs_tree, rs_p, rt_p, o, o + l);
     extents->emplace_back(o, l);
     allocated += l;
@@ -422,6 +468,42 @@ found:
   return -EFAULT;
 }
 
+/*
+ * Carve up to size bytes, and no less than min_size, out of the free range
+ * containing offset, if any, so that data appended to an existing extent
+ * stays contiguous with it rather than landing wherever the size class
+ * search would put it.
+ */
+uint64_t Btree2Allocator::_allocate_at(
+  uint64_t offset,
+  uint64_t size,
+  uint64_t min_size,
+  uint64_t unit,
+  PExtentVector* extents)
+{
+  if (p2phase(offset, unit)) {
+    return 0;
+  }
+  auto rt_p = range_tree.upper_bound(offset);
+  if (rt_p == range_tree.begin()) {
+    return 0;
+  }
+  --rt_p;
+  if (rt_p->second <= offset) {
+    return 0;
+  }
+  uint64_t l = std::min(size, p2align(rt_p->second - offset, unit));
+  if (l < min_size) {
+    return 0;
+  }
+  ldout(cct, 20) << __func__ << std::hex
+    << " 0x" << offset << "~" << l
+    << std::dec << dendl;
+  _remove_from_tree(rt_p, offset, offset + l);
+  extents->emplace_back(offset, l);
+  return l;
+}
+
 Btree2Allocator::range_size_tree_t::iterator
 Btree2Allocator::_pick_block(int dir,
                               Btree2Allocator::range_size_tree_t* tree,
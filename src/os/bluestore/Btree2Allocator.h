@@ -123,6 +123,10 @@ public:
     std::lock_guard l(lock);
     _foreach(notify);
   }
+  void defrag_free_space() override {
+    std::lock_guard l(lock);
+    _defrag_free_space();
+  }
   void shutdown() override {
     std::lock_guard l(lock);
     _shutdown();
@@ -168,6 +172,17 @@ private:
   uint64_t lsum = 0;
   uint64_t rsum = 0;
   double rweight_factor = 0;
+
+  //
+  // With size classes on, allocations below weight_center are carved from
+  // the top of the free range they land in and larger ones from the
+  // bottom, so that the two fill a shared range from opposite ends rather
+  // than interleaving. Each size class (the bucket of the requested
+  // length) from weight_center up also keeps carving where its previous
+  // allocation ended, while that fits whole.
+  //
+  bool size_classes = false;
+  std::vector<uint64_t> class_cursor;  ///< per size class, 0 - none
   uint64_t left_weight() const {
     return lsum + _get_spilled_over();
   }
@@ -181,6 +196,10 @@ protected:
   void set_weight_factor(double _rweight_factor) {
     rweight_factor = _rweight_factor;
   }
+  void set_size_classes(bool enable) {
+    size_classes = enable;
+    class_cursor.assign(enable ? myTraits.num_buckets : 0, 0);
+  }
 
   CephContext* get_context() {
     return cct;
@@ -216,6 +235,7 @@ protected:
   }
 
   void _shutdown();
+  void _defrag_free_space();
 
   void _dump(bool full = true) const;
   void _foreach(std::function<void(uint64_t offset, uint64_t length)>);
@@ -283,6 +303,12 @@ private:
   int64_t __allocate(size_t bucket0,
     uint64_t size,
     uint64_t unit,
+    bool from_top,
+    PExtentVector* extents);
+  uint64_t _allocate_at(uint64_t offset,
+    uint64_t size,
+    uint64_t min_size,
+    uint64_t unit,
     PExtentVector* extents);
 
   inline range_size_tree_t::iterator _pick_block(int distance,
@@ -207,7 +207,8 @@ int32_t Estimator::split_and_compress(
     // FIXME: memory alignment here is bad
     bufferlist t;
     std::optional<int32_t> compressor_message;
-    int r = wctx->compressor->compress(bd.back().object_data, t, compressor_message);
+    int r = bluestore->_compress(wctx, bd.back().object_data, t, compressor_message,
+                                 &bd.back().compression_dict);
     ceph_assert(r == 0);
     bluestore_compression_header_t chdr;
     chdr.type = wctx->compressor->get_type();
@@ -233,6 +234,11 @@ void Estimator::finish()
   dout(25) << "new_size=" << new_size
           << " unc_size=" << total_uncompressed_size
           << " comp_cost=" << total_compressed_size << dendl;
+  if (actual_compressed == 0) {
+    // nothing got compressed, nothing to learn from
+    cleanup();
+    return;
+  }
   uint32_t sum = new_size + total_uncompressed_size + total_compressed_size;
   double expected =
     (new_size + total_uncompressed_size) * expected_compression_factor +
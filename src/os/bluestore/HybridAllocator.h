@@ -146,6 +146,7 @@ public:
     int64_t _block_size,
     uint64_t max_mem,
     double weight_factor,
+    bool size_classes,
     std::string_view name) :
       HybridAllocatorBase<Btree2Allocator>(cct,
 					  device_size,
@@ -153,6 +154,7 @@ public:
 					  max_mem,
 					  name) {
     set_weight_factor(weight_factor);
+    set_size_classes(size_classes);
   }
   const char* get_type() const override;
 
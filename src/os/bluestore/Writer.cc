@@ -620,6 +620,7 @@ void BlueStore::Writer::_maybe_meld_with_prev_extent(exmp_it it)
 BlueStore::BlobRef BlueStore::Writer::_blob_create_full_compressed(
   bufferlist& disk_data,
   uint32_t compressed_length,
+  uint32_t compression_dict,
   bufferlist& object_data)
 {
   uint32_t disk_length = disk_data.length();
@@ -635,6 +636,7 @@ BlueStore::BlobRef BlueStore::Writer::_blob_create_full_compressed(
     bblob.calc_csum(0, disk_data);
   }
   bblob.set_compressed(object_length, compressed_length);
+  bblob.set_compression_dict(compression_dict);
   blob->dirty_blob_use_tracker().init_and_ref_compressed(object_length);
   PExtentVector blob_allocs;
   _get_disk_space(disk_length, blob_allocs);
@@ -1076,7 +1078,8 @@ void BlueStore::Writer::_do_put_new_blobs(
     } else {
       // compressed
       BlobRef new_blob = _blob_create_full_compressed(
-        bd_it->disk_data, bd_it->compressed_length, bd_it->object_data);
+        bd_it->disk_data, bd_it->compressed_length, bd_it->compression_dict,
+        bd_it->object_data);
       le = new Extent(
         logical_offset, 0, bd_it->real_length, new_blob);
       dout(20) << __func__ << " new compressed extent+blob " << le->print(pp_mode) << dendl;
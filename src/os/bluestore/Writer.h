@@ -31,6 +31,7 @@ public:
     bufferlist disk_data;       // Bitstream to got o disk. Its either same as object_data,
                                 // or contains compressed data. Block aligned.
     bufferlist object_data;     // Object data. Needed to put into caches.
+    uint32_t compression_dict = 0; // Dictionary disk_data is compressed with, if any.
     bool is_compressed() const {return compressed_length != 0;}
     blob_data_t()
       : real_length(0), compressed_length(0) {}
@@ -194,6 +195,7 @@ private:
   BlobRef _blob_create_full_compressed(
     bufferlist& disk_data,
     uint32_t compressed_length,
+    uint32_t compression_dict,
     bufferlist& object_data);
 
   void _try_reuse_allocated_l(
@@ -396,16 +396,22 @@ void bluefs_transaction_t::encode(bufferlist& bl) const
 void bluefs_transaction_t::decode(bufferlist::const_iterator& p)
 {
   uint32_t crc;
+  decode_unverified(p, &crc);
+  uint32_t actual = op_bl.crc32c(-1);
+  if (actual != crc)
+    throw ceph::buffer::malformed_input("bad crc " + stringify(actual)
+				  + " expected " + stringify(crc));
+}
+
+void bluefs_transaction_t::decode_unverified(bufferlist::const_iterator& p,
+					     uint32_t *crc)
+{
   DECODE_START(1, p);
   decode(uuid, p);
   decode(seq, p);
   decode(op_bl, p);
-  decode(crc, p);
+  decode(*crc, p);
   DECODE_FINISH(p);
-  uint32_t actual = op_bl.crc32c(-1);
-  if (actual != crc)
-    throw ceph::buffer::malformed_input("bad crc " + stringify(actual)
-				  + " expected " + stringify(crc));
 }
 
 void bluefs_transaction_t::dump(Formatter *f) const
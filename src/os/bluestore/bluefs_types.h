@@ -439,6 +439,8 @@ struct bluefs_transaction_t {
   void bound_encode(size_t &s) const;
   void encode(ceph::buffer::list& bl) const;
   void decode(ceph::buffer::list::const_iterator& p);
+  /// decode without verifying op_bl, return the crc it was encoded with
+  void decode_unverified(ceph::buffer::list::const_iterator& p, uint32_t *crc);
   void dump(ceph::Formatter *f) const;
   static std::list<bluefs_transaction_t> generate_test_instances();
 };
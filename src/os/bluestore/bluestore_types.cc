@@ -808,6 +808,11 @@ string bluestore_blob_t::get_flags_string(unsigned flags)
       s += '+';
     s += "shared";
   }
+  if (flags & FLAG_COMPRESSION_DICT) {
+    if (s.length())
+      s += '+';
+    s += "compression_dict";
+  }
 
   return s;
 }
@@ -849,6 +854,7 @@ void bluestore_blob_t::dump(Formatter *f) const
   f->close_section();
   f->dump_unsigned("logical_length", logical_length);
   f->dump_unsigned("compressed_length", compressed_length);
+  f->dump_unsigned("compression_dict", get_compression_dict());
   f->dump_unsigned("flags", flags);
   f->dump_unsigned("csum_type", csum_type);
   f->dump_unsigned("csum_chunk_order", csum_chunk_order);
@@ -876,6 +882,10 @@ list<bluestore_blob_t> bluestore_blob_t::generate_test_instances()
   ls.back().allocated_test(
     bluestore_pextent_t(bluestore_pextent_t::INVALID_OFFSET, 0x1000));
   ls.back().allocated_test(bluestore_pextent_t(0x40120000, 0x10000));
+  ls.emplace_back();
+  ls.back().allocated_test(bluestore_pextent_t(0x40130000, 0x1000));
+  ls.back().set_compressed(0x4000, 0x1000);
+  ls.back().set_compression_dict(7);
   return ls;
 }
 
@@ -888,6 +898,9 @@ ostream& operator<<(ostream& out, const bluestore_blob_t& o)
 	<< " -> 0x"
 	<< o.get_compressed_payload_length()
 	<< std::dec;
+    if (o.get_compression_dict()) {
+      out << " dict " << o.get_compression_dict();
+    }
   } else {
     out << " llen=0x" << std::hex << o.get_logical_length() << std::dec;
   }
@@ -1376,6 +1389,7 @@ void bluestore_blob_t::dup(const bluestore_blob_t& from)
   extents = from.extents;
   logical_length = from.logical_length;
   compressed_length = from.compressed_length;
+  compression_dict = from.compression_dict;
   flags = from.flags;
   unused = from.unused;
   csum_type = from.csum_type;
@@ -1592,6 +1606,26 @@ list<bluestore_compression_header_t> bluestore_compression_header_t::generate_te
   return o;
 }
 
+void bluestore_compression_dict_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("type", type);
+  f->dump_int("pool", pool);
+  f->dump_stream("stamp") << stamp;
+  f->dump_unsigned("length", dict.length());
+}
+
+list<bluestore_compression_dict_t> bluestore_compression_dict_t::generate_test_instances()
+{
+  list<bluestore_compression_dict_t> o;
+  o.emplace_back();
+  o.emplace_back();
+  o.back().type = Compressor::COMP_ALG_ZSTD;
+  o.back().pool = 3;
+  o.back().stamp = utime_t(1, 2);
+  o.back().dict.append("dictionary");
+  return o;
+}
+
 // adds more salt to build a hash func input
 shared_blob_2hash_tracker_t::hash_input_t
   shared_blob_2hash_tracker_t::build_hash_input(
@@ -509,6 +509,7 @@ private:
   PExtentVector extents;              ///< raw data position on device
   uint32_t logical_length = 0;        ///< original length of data stored in the blob
   uint32_t compressed_length = 0;     ///< compressed length if any
+  uint32_t compression_dict = 0;      ///< compression dictionary id if any
 
 public:
   enum {
@@ -517,6 +518,7 @@ public:
     FLAG_CSUM = 4,            ///< blob has checksums
     FLAG_HAS_UNUSED = 8,      ///< blob has unused std::map
     FLAG_SHARED = 16,         ///< blob is shared; see external SharedBlob
+    FLAG_COMPRESSION_DICT = 32, ///< compressed with a trained dictionary
   };
   static std::string get_flags_string(unsigned flags);
 
@@ -551,6 +553,7 @@ public:
     denc_varint(flags, p);
     denc_varint_lowz(logical_length, p);
     denc_varint_lowz(compressed_length, p);
+    denc_varint(compression_dict, p);
     denc(csum_type, p);
     denc(csum_chunk_order, p);
     denc_varint(csum_data.length(), p);
@@ -565,6 +568,9 @@ public:
     if (is_compressed()) {
       denc_varint_lowz(logical_length, p);
       denc_varint_lowz(compressed_length, p);
+      if (has_flag(FLAG_COMPRESSION_DICT)) {
+	denc_varint(compression_dict, p);
+      }
     }
     if (has_csum()) {
       denc(csum_type, p);
@@ -587,6 +593,9 @@ public:
     if (is_compressed()) {
       denc_varint_lowz(logical_length, p);
       denc_varint_lowz(compressed_length, p);
+      if (has_flag(FLAG_COMPRESSION_DICT)) {
+	denc_varint(compression_dict, p);
+      }
     } else {
       logical_length = get_ondisk_capacity();
     }
@@ -638,6 +647,19 @@ public:
     logical_length = clen_orig;
     compressed_length = clen;
   }
+  /// only valid for a compressed blob; 0 means no dictionary
+  void set_compression_dict(uint32_t id) {
+    ceph_assert(is_compressed());
+    if (id) {
+      set_flag(FLAG_COMPRESSION_DICT);
+    } else {
+      clear_flag(FLAG_COMPRESSION_DICT);
+    }
+    compression_dict = id;
+  }
+  uint32_t get_compression_dict() const {
+    return has_flag(FLAG_COMPRESSION_DICT) ? compression_dict : 0;
+  }
   bool is_mutable() const {
     return !is_compressed() && !is_shared();
   }
@@ -1402,6 +1424,26 @@ struct bluestore_compression_header_t {
 };
 WRITE_CLASS_DENC(bluestore_compression_header_t)
 
+/// trained compression dictionary, referenced from blobs by its id
+struct bluestore_compression_dict_t {
+  uint8_t type = Compressor::COMP_ALG_NONE; ///< algorithm it was trained for
+  int64_t pool = -1;        ///< pool whose data it was trained on
+  utime_t stamp;            ///< when it was trained
+  ceph::buffer::list dict;  ///< compressor specific dictionary
+
+  DENC(bluestore_compression_dict_t, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.type, p);
+    denc(v.pool, p);
+    denc(v.stamp, p);
+    denc(v.dict, p);
+    DENC_FINISH(p);
+  }
+  void dump(ceph::Formatter *f) const;
+  static std::list<bluestore_compression_dict_t> generate_test_instances();
+};
+WRITE_CLASS_DENC(bluestore_compression_dict_t)
+
 template <template <typename> typename V, class COUNTER_TYPE = int32_t>
 class ref_counter_2hash_tracker_t {
   size_t num_non_zero = 0;
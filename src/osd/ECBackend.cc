@@ -95,6 +95,8 @@ ECBackend::ECBackend(
    */
   ceph_assert((ec_impl->get_data_chunk_count() *
     ec_impl->get_chunk_size(stripe_width)) == stripe_width);
+
+  ec_omap_journal.set_logger(get_parent()->get_logger());
 }
 
 PGBackend::RecoveryHandle *ECBackend::open_recovery_op() {
@@ -539,22 +541,53 @@ void ECBackend::handle_sub_read(
         dout(20) << __func__ << " case2: going to do fragmented read;"
 		 << " subchunk_size=" << subchunk_size
 		 << " chunk_size=" << sinfo.get_chunk_size() << dendl;
-        bool error = false;
-        for (int m = 0; m < (int)len && !error;
-             m += sinfo.get_chunk_size()) {
-          for (auto &&k: subchunks) {
-            bufferlist bl0;
-            r = switcher->store->read(
-              switcher->ch,
-              ghobject_t(hoid, ghobject_t::NO_GEN, shard),
-              offset + m + (k.first) * subchunk_size,
-              (k.second) * subchunk_size,
-              bl0, flags);
-            if (r < 0) {
-              error = true;
-              break;
+        /* Repair (e.g. clay) needs the same few sub-chunks from every
+         * chunk. Ask the store for all of them in one vectored read, rather
+         * than one read per sub-chunk range per chunk. readv returns the
+         * data in offset order, so this is only possible if the sub-chunk
+         * ranges are in ascending order.
+         */
+        bool ascending = true;
+        for (auto k = subchunks.begin(); k != subchunks.end(); ++k) {
+          auto next = std::next(k);
+          if (next != subchunks.end() &&
+              k->first + k->second > next->first) {
+            ascending = false;
+            break;
+          }
+        }
+        if (ascending) {
+          interval_set<uint64_t> m;
+          for (uint64_t c = 0; c < len; c += sinfo.get_chunk_size()) {
+            for (auto &&k: subchunks) {
+              m.union_insert(offset + c + k.first * subchunk_size,
+                             k.second * subchunk_size);
+            }
+          }
+          // The last chunk of a shard may be short; like read, readv trims
+          // the ranges to the object size.
+          r = switcher->store->readv(
+            switcher->ch,
+            ghobject_t(hoid, ghobject_t::NO_GEN, shard),
+            m, bl, flags);
+        } else {
+          bool error = false;
+          for (int m = 0; m < (int)len && !error;
+               m += sinfo.get_chunk_size()) {
+            for (auto &&k: subchunks) {
+              bufferlist bl0;
+              r = switcher->store->read(
+                switcher->ch,
+                ghobject_t(hoid, ghobject_t::NO_GEN, shard),
+                offset + m + (k.first) * subchunk_size,
+                (k.second) * subchunk_size,
+                bl0, flags);
+              if (r < 0) {
+                error = true;
+                break;
+              }
+              bl.claim_append(bl0);
             }
-            bl.claim_append(bl0);
           }
         }
       }
@@ -1665,6 +1698,8 @@ int ECBackend::omap_iterate (
   if (!start_from.seek_position.empty()) {
     journal_it = update_map.lower_bound(start_from.seek_position);
   }
+  // Store keys arrive in order, so walk the removed ranges alongside them
+  ECOmapJournal::UpdateCursor cursor(update_map, removed_ranges);
 
   auto wrapper = [&](const std::string_view store_key, const std::string_view store_value) {
     bool found_store_key_in_journal = false;
@@ -1692,7 +1727,7 @@ int ECBackend::omap_iterate (
       return ObjectStore::omap_iter_ret_t::NEXT;
     }
 
-    if (should_be_removed(removed_ranges, store_key)) {
+    if (cursor.is_removed(store_key)) {
       return ObjectStore::omap_iter_ret_t::NEXT;
     }
 
@@ -1732,19 +1767,19 @@ int ECBackend::omap_get_values(
   }
 
   auto [update_map, removed_ranges] = ec_omap_journal.get_value_updates(oid.hobj);
-  
+  ECOmapJournal::UpdateCursor cursor(update_map, removed_ranges);
+
   set<string> keys_still_to_get;
   for (auto &key : keys) {
-    if (auto it = update_map.find(key);
-      it != update_map.end()) {
-      if (!it->second.value.has_value()) {
+    if (const auto *update = cursor.find(key)) {
+      if (!update->value.has_value()) {
         continue;
       }
-      (*out)[key] = *(it->second.value);
-    } else if (should_be_removed(removed_ranges, key)) {
+      (*out)[key] = *(update->value);
+    } else if (cursor.is_removed(key)) {
       continue;
     } else {
-      keys_still_to_get.insert(key);
+      keys_still_to_get.insert(keys_still_to_get.end(), key);
     }
   }
   store->omap_get_values(c_, oid, keys_still_to_get, out);
@@ -1810,12 +1845,17 @@ int ECBackend::omap_get(
   // Remove keys in removed_ranges
   remove_keys_in_ranges(removed_ranges, out);
 
-  // Apply updates in update_map
+  // Apply updates in update_map. Both maps are sorted, so each insert can
+  // be hinted with the position following the previous one.
+  auto hint = out->begin();
   for (const auto &[key, val_opt] : update_map) {
     if (val_opt.value.has_value()) {
-      (*out)[key] = *(val_opt.value);
+      hint = std::next(out->insert_or_assign(hint, key, *(val_opt.value)));
     } else {
-      out->erase(key);
+      hint = out->lower_bound(key);
+      if (hint != out->end() && hint->first == key) {
+        hint = out->erase(hint);
+      }
     }
   }
 
@@ -1838,17 +1878,17 @@ int ECBackend::omap_check_keys(
   auto updated_header = ec_omap_journal.get_updated_header(oid.hobj);
 
   // First check keys in update_map and removed_ranges
+  ECOmapJournal::UpdateCursor cursor(update_map, removed_ranges);
   set<string> keys_to_check_on_disk;
   for (const auto &key : keys) {
-    if (auto it = update_map.find(key);
-      it != update_map.end()) {
-      if (it->second.value.has_value()) {
+    if (const auto *update = cursor.find(key)) {
+      if (update->value.has_value()) {
         out->insert(key);
       }
-    } else if (should_be_removed(removed_ranges, key)) {
+    } else if (cursor.is_removed(key)) {
       continue;
     } else {
-      keys_to_check_on_disk.insert(key);
+      keys_to_check_on_disk.insert(keys_to_check_on_disk.end(), key);
     }
   }
 
@@ -1857,33 +1897,6 @@ int ECBackend::omap_check_keys(
   return r;
 }
 
-bool ECBackend::should_be_removed(
-  const std::map<std::string, std::optional<std::string>>& removed_ranges,
-  const std::string_view key) {
-  if (removed_ranges.empty()) {
-    return false;
-  }
-  
-  // Find range that comes after this key
-  auto it = removed_ranges.upper_bound(std::string(key));
-
-  // If all ranges start after the key, it can't be in any range
-  if (it == removed_ranges.begin()) {
-    return false;
-  }
-
-  // Go back to the previous range
-  --it;
-  // If this range contains the key, return true
-  const auto& end_opt = it->second;
-  if (!end_opt || key < *end_opt) {
-    return true;
-  }
-
-  // No ranges contain the key, return false
-  return false;
-}
-
 void ECBackend::remove_keys_in_ranges(
   const std::map<std::string, std::optional<std::string>>& removed_ranges,
   std::map<std::string, ceph::buffer::list>* out) {
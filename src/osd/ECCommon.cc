@@ -68,10 +68,6 @@ static ostream &_prefix(std::ostream *_dout,
   return pgb->get_parent()->gen_dbg_prefix(*_dout);
 }
 
-static ostream &_prefix(std::ostream *_dout,
-                        struct ClientReadCompleter const *read_completer
-  );
-
 void ECCommon::ReadOp::dump(Formatter *f) const {
   f->dump_unsigned("tid", tid);
 #ifndef WITH_CRIMSON
@@ -96,11 +92,16 @@ void ECCommon::RecoveryBackend::RecoveryOp::dump(Formatter *f) const {
   f->dump_stream("recovery_progress") << recovery_progress;
   f->dump_stream("state") << tostr(state);
   f->dump_stream("waiting_on_pushes") << waiting_on_pushes;
+  f->dump_bool("read_ahead", read_ahead);
 }
 
 
 void ECCommon::ReadPipeline::complete_read_op(ReadOp &&rop) {
   dout(20) << __func__ << " completing " << rop << dendl;
+  // Nothing more may wait on this op once its reads are being completed
+  for (auto &&hoid : std::views::keys(rop.to_read)) {
+    unindex_coalesce_read(rop, hoid);
+  }
   auto req_iter = rop.to_read.begin();
   auto resiter = rop.complete.begin();
   ceph_assert(rop.to_read.size() == rop.complete.size());
@@ -108,6 +109,8 @@ void ECCommon::ReadPipeline::complete_read_op(ReadOp &&rop) {
     auto &hoid = req_iter->first;
     read_result_t &res = resiter->second;
     read_request_t &req = req_iter->second;
+    // The coalesced reads must see the buffers before they are decoded
+    complete_coalesced_reads(rop, hoid, &res, &req);
     rop.on_complete->finish_single_request(
       hoid, std::move(res), req);
   }
@@ -129,6 +132,7 @@ void ECCommon::ReadPipeline::on_change() {
   }
   tid_to_read_map.clear();
   shard_to_read_map.clear();
+  coalesce_read_map.clear();
   in_progress_client_reads.clear();
 }
 
@@ -500,7 +504,8 @@ void ECCommon::ReadPipeline::start_read_op(
     map<hobject_t, read_request_t> &to_read,
     const bool do_redundant_reads,
     const bool for_recovery,
-    std::unique_ptr<ReadCompleter> on_complete) {
+    std::unique_ptr<ReadCompleter> on_complete,
+    const bool coalesce) {
   ceph_tid_t tid = get_parent()->get_tid();
   ceph_assert(!tid_to_read_map.contains(tid));
   auto &op = tid_to_read_map.emplace(
@@ -512,6 +517,11 @@ void ECCommon::ReadPipeline::start_read_op(
       for_recovery,
       std::move(on_complete),
       std::move(to_read))).first->second;
+  if (coalesce) {
+    op.coalesce = true;
+    op.log_head = get_parent()->get_log().get_log().head;
+    index_coalesce_read(op);
+  }
   dout(10) << __func__ << ": starting " << op << dendl;
   if (op.op) {
 #ifndef WITH_CRIMSON
@@ -708,50 +718,7 @@ struct ClientReadCompleter final : ECCommon::ReadCompleter {
       const hobject_t &hoid,
       ECCommon::read_result_t &&res,
       ECCommon::read_request_t &req) override {
-#ifndef WITH_CRIMSON
-    auto *cct = read_pipeline.cct;
-#endif
-    dout(20) << __func__ << " completing hoid=" << hoid
-             << " res=" << res << " req=" << req << dendl;
-    extent_map result;
-    if (res.r == 0) {
-      ceph_assert(res.errors.empty());
-      dout(30) << __func__ << ": before decode: "
-               << res.buffers_read.debug_string(2048, 0)
-               << dendl;
-      /* Decode any missing buffers */
-      res.buffers_read.add_zero_padding_for_decode(req.zeros_for_decode);
-      int r = res.buffers_read.decode(read_pipeline.ec_impl,
-                                  req.shard_want_to_read,
-                                  req.object_size,
-                                  read_pipeline.get_parent()->get_dpp());
-      ceph_assert( r == 0 );
-      dout(30) << __func__ << ": after decode: "
-               << res.buffers_read.debug_string(2048, 0)
-               << dendl;
-
-      for (auto &&read: req.to_read) {
-        // Return a buffer containing both data and parity
-        // if the parity read inject is set
-#ifndef WITH_CRIMSON
-        if (cct->_conf->bluestore_debug_inject_read_err &&
-            ECInject::test_parity_read(hoid)) {
-          bufferlist data_and_parity;
-          read_pipeline.create_parity_read_buffer(res.buffers_read, read, &data_and_parity);
-          result.insert(read.offset, data_and_parity.length(), data_and_parity);
-        } else
-#endif
-        {
-          result.insert(read.offset, read.size,
-                        res.buffers_read.get_ro_buffer(read.offset, read.size));
-        }
-      }
-    }
-    dout(20) << __func__ << " calling complete_object with result="
-             << result << dendl;
-    status->complete_object(hoid, res.r, std::move(result),
-                            std::move(res.buffers_read));
-    read_pipeline.kick_reads();
+    read_pipeline.finish_client_read(hoid, std::move(res), req, status);
   }
 
   void finish(int priority) && override {
@@ -762,9 +729,193 @@ struct ClientReadCompleter final : ECCommon::ReadCompleter {
   ECCommon::ClientAsyncReadStatus *status;
 };
 
-static ostream &_prefix(std::ostream *_dout,
-                        ClientReadCompleter const *read_completer) {
-  return _prefix(_dout, &read_completer->read_pipeline);
+void ECCommon::ReadPipeline::finish_client_read(
+    const hobject_t &hoid,
+    read_result_t &&res,
+    read_request_t &req,
+    ClientAsyncReadStatus *status) {
+  dout(20) << __func__ << " completing hoid=" << hoid
+           << " res=" << res << " req=" << req << dendl;
+  extent_map result;
+  if (res.r == 0) {
+    ceph_assert(res.errors.empty());
+    dout(30) << __func__ << ": before decode: "
+             << res.buffers_read.debug_string(2048, 0)
+             << dendl;
+    /* Decode any missing buffers */
+    res.buffers_read.add_zero_padding_for_decode(req.zeros_for_decode);
+    int r = res.buffers_read.decode(ec_impl,
+                                    req.shard_want_to_read,
+                                    req.object_size,
+                                    get_parent()->get_dpp());
+    ceph_assert( r == 0 );
+    dout(30) << __func__ << ": after decode: "
+             << res.buffers_read.debug_string(2048, 0)
+             << dendl;
+
+    for (auto &&read: req.to_read) {
+      // Return a buffer containing both data and parity
+      // if the parity read inject is set
+#ifndef WITH_CRIMSON
+      if (cct->_conf->bluestore_debug_inject_read_err &&
+          ECInject::test_parity_read(hoid)) {
+        bufferlist data_and_parity;
+        create_parity_read_buffer(res.buffers_read, read, &data_and_parity);
+        result.insert(read.offset, data_and_parity.length(), data_and_parity);
+      } else
+#endif
+      {
+        result.insert(read.offset, read.size,
+                      res.buffers_read.get_ro_buffer(read.offset, read.size));
+      }
+    }
+  }
+  dout(20) << __func__ << " calling complete_object with result="
+           << result << dendl;
+  status->complete_object(hoid, res.r, std::move(result),
+                          std::move(res.buffers_read));
+  kick_reads();
+}
+
+/* True if the log has an entry for hoid newer than since, or has been
+ * trimmed past since so that there is no telling. Walks back from the head
+ * rather than looking hoid up, so that the log's object index is not built
+ * for every client read.
+ */
+bool ECCommon::ReadPipeline::object_modified_since(
+    const hobject_t &hoid,
+    const eversion_t &since) const {
+  const auto &log = get_parent()->get_log().get_log();
+  if (since < log.tail) {
+    return true;
+  }
+  for (auto p = log.log.rbegin();
+       p != log.log.rend() && p->version > since;
+       ++p) {
+    if (p->soid == hoid) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ECCommon::ReadPipeline::index_coalesce_read(const ReadOp &rop) {
+  ceph_assert(rop.coalesce);
+  for (auto &&hoid : std::views::keys(rop.to_read)) {
+    coalesce_read_map[hoid].insert(rop.tid);
+  }
+}
+
+void ECCommon::ReadPipeline::unindex_coalesce_read(
+    const ReadOp &rop,
+    const hobject_t &hoid) {
+  if (!rop.coalesce) {
+    return;
+  }
+  auto iter = coalesce_read_map.find(hoid);
+  if (iter == coalesce_read_map.end()) {
+    return;
+  }
+  iter->second.erase(rop.tid);
+  if (iter->second.empty()) {
+    coalesce_read_map.erase(iter);
+  }
+}
+
+/* True if every shard extent that req reads is also read by from, from the
+ * same OSD, so that the data returned for from can be used to satisfy req.
+ */
+static bool shard_reads_cover(
+    const ECCommon::read_request_t &from,
+    const ECCommon::read_request_t &req) {
+  if (from.flags != req.flags) {
+    return false;
+  }
+  for (auto &&[shard, shard_read] : req.shard_reads) {
+    if (!from.shard_reads.contains(shard)) {
+      return false;
+    }
+    const auto &from_read = from.shard_reads.at(shard);
+    if (from_read.pg_shard != shard_read.pg_shard ||
+        from_read.subchunk != shard_read.subchunk ||
+        !from_read.extents.contains(shard_read.extents)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Attach a client read to an in-flight client read of the same object if
+ * that is already reading all of the shard extents it needs. The object
+ * must not have been modified since the in-flight read was started.
+ */
+bool ECCommon::ReadPipeline::try_coalesce_read(
+    const hobject_t &hoid,
+    const read_request_t &req,
+    ClientAsyncReadStatus *status) {
+  if (req.shard_reads.empty()) {
+    return false;
+  }
+  auto index_iter = coalesce_read_map.find(hoid);
+  if (index_iter == coalesce_read_map.end()) {
+    return false;
+  }
+  for (auto tid : index_iter->second) {
+    auto &rop = tid_to_read_map.at(tid);
+    auto req_iter = rop.to_read.find(hoid);
+    ceph_assert(req_iter != rop.to_read.end());
+    if (object_modified_since(hoid, rop.log_head)) {
+      continue;
+    }
+    if (auto res_iter = rop.complete.find(hoid);
+        res_iter != rop.complete.end() && !res_iter->second.errors.empty()) {
+      continue;
+    }
+    if (!shard_reads_cover(req_iter->second, req)) {
+      continue;
+    }
+    dout(20) << __func__ << ": " << hoid << " " << req
+             << " waiting on tid " << tid << dendl;
+    rop.coalesced_reads[hoid].emplace_back(req, status);
+    return true;
+  }
+  return false;
+}
+
+/* Complete the client reads which were waiting on rop's reads of hoid. If
+ * rop failed, or ended up not reading everything that a waiting read
+ * needs, then that read is sent on its own. res and req are null if the
+ * read of hoid was cancelled.
+ */
+void ECCommon::ReadPipeline::complete_coalesced_reads(
+    ReadOp &rop,
+    const hobject_t &hoid,
+    const read_result_t *res,
+    const read_request_t *req) {
+  auto iter = rop.coalesced_reads.find(hoid);
+  if (iter == rop.coalesced_reads.end()) {
+    return;
+  }
+  auto waiting = std::move(iter->second);
+  rop.coalesced_reads.erase(iter);
+  for (auto &&[waiting_req, status] : waiting) {
+    if (res && res->r == 0 && shard_reads_cover(*req, waiting_req)) {
+      dout(20) << __func__ << ": " << hoid << " completing " << waiting_req
+               << " from tid " << rop.tid << dendl;
+      finish_client_read(hoid, read_result_t(*res), waiting_req, status);
+    } else {
+      dout(10) << __func__ << ": " << hoid << " reissuing " << waiting_req
+               << " from tid " << rop.tid << dendl;
+      map<hobject_t, read_request_t> to_read;
+      to_read.emplace(hoid, waiting_req);
+      start_read_op(
+        CEPH_MSG_PRIO_DEFAULT,
+        to_read,
+        false,
+        false,
+        std::make_unique<ClientReadCompleter>(*this, status));
+    }
+  }
 }
 
 void ECCommon::ReadPipeline::objects_read_and_reconstruct(
@@ -778,6 +929,10 @@ void ECCommon::ReadPipeline::objects_read_and_reconstruct(
     return;
   }
 
+  /* Redundant reads complete as soon as enough shards have replied, so
+   * there is no telling which of their shard reads will be available.
+   */
+  const bool coalesce = !fast_read && cct->_conf->osd_ec_coalesce_reads;
   map<hobject_t, read_request_t> for_read_op;
   for (auto &&[hoid, to_read]: reads) {
     ECUtil::shard_extent_set_t want_shard_reads(sinfo.get_k_plus_m());
@@ -809,16 +964,25 @@ void ECCommon::ReadPipeline::objects_read_and_reconstruct(
              << " subchunk_size=" << subchunk_size
              << " chunk_size=" << sinfo.get_chunk_size() << dendl;
 
+    if (coalesce &&
+        try_coalesce_read(hoid, read_request, &in_progress_client_reads.back())) {
+      continue;
+    }
     for_read_op.insert(make_pair(hoid, read_request));
   }
 
+  if (for_read_op.empty()) {
+    // Every object is being read by another op already
+    return;
+  }
   start_read_op(
     CEPH_MSG_PRIO_DEFAULT,
     for_read_op,
     fast_read,
     false,
     std::make_unique<ClientReadCompleter>(
-      *this, &(in_progress_client_reads.back())));
+      *this, &(in_progress_client_reads.back())),
+    coalesce);
 }
 
 void ECCommon::ReadPipeline::objects_read_and_reconstruct_for_rmw(
@@ -1234,6 +1398,28 @@ void ECCommon::RecoveryBackend::_failed_push(const hobject_t &hoid,
   get_parent()->on_failed_pull(fl, hoid, v);
 }
 
+/* A read ahead is issued while the pushes of the previous chunk are still
+ * in flight, so the op cannot be failed yet: the push replies would find it
+ * gone, or find a restarted op that is not waiting for them.  Drop the read
+ * ahead instead and let the op read the chunk again once the pushes have
+ * drained, which fails the op in the usual way if the error persists.
+ */
+void ECCommon::RecoveryBackend::_failed_read_ahead(
+  const hobject_t &hoid,
+  ECCommon::read_result_t &res,
+  RecoveryMessages *m) {
+  ceph_assert(recovery_ops.count(hoid));
+  RecoveryOp &op = recovery_ops[hoid];
+  dout(10) << __func__ << ": Read error " << hoid << " r="
+	   << res.r << " errors=" << res.errors
+	   << ", reading again once pushes complete " << op << dendl;
+  op.read_ahead = false;
+  ceph_assert(!op.returned_data);
+  if (op.waiting_on_pushes.empty()) {
+    continue_recovery_op(op, m);
+  }
+}
+
 void ECCommon::RecoveryBackend::handle_recovery_push(
   const PushOp &op,
   RecoveryMessages *m,
@@ -1433,6 +1619,7 @@ void ECCommon::RecoveryBackend::handle_recovery_read_complete(
   dout(10) << __func__ << ": returned " << hoid << " " << res << dendl;
   ceph_assert(recovery_ops.contains(hoid));
   RecoveryBackend::RecoveryOp &op = recovery_ops[hoid];
+  op.read_ahead = false;
 
   if (res.attrs) {
     op.xattrs.swap(*(res.attrs));
@@ -1508,7 +1695,12 @@ struct RecoveryReadCompleter : ECCommon::ReadCompleter {
       ECCommon::read_result_t &&res,
       ECCommon::read_request_t &req) override {
     if (!(res.r == 0 && res.errors.empty())) {
-      backend._failed_push(hoid, res);
+      auto it = backend.recovery_ops.find(hoid);
+      if (it != backend.recovery_ops.end() && it->second.read_ahead) {
+        backend._failed_read_ahead(hoid, res, &rm);
+      } else {
+        backend._failed_push(hoid, res);
+      }
       return;
     }
     ceph_assert(req.to_read.size() == 0);
@@ -1581,91 +1773,132 @@ void ECCommon::RecoveryBackend::dispatch_recovery_messages(
     std::make_unique<RecoveryReadCompleter>(*this));
 }
 
-void ECCommon::RecoveryBackend::continue_recovery_op(
+/* Plan the read for the next chunk of the object being recovered and queue
+ * it on m. Returns 0 if a read was queued, 1 if nothing needs to be read
+ * (op.returned_data is then already populated) or a negative error if
+ * there are no longer enough shards to recover from, in which case the
+ * recovery progress is left untouched.
+ */
+int ECCommon::RecoveryBackend::start_recovery_read(
   RecoveryBackend::RecoveryOp &op,
   RecoveryMessages *m) {
-  dout(10) << __func__ << ": continuing " << op << dendl;
-  using RecoveryOp = RecoveryBackend::RecoveryOp;
-  while (1) {
-    switch (op.state) {
-    case RecoveryOp::IDLE: {
-      ceph_assert(!op.recovery_progress.data_complete
-                  || !op.recovery_progress.omap_complete);
-      ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
+  ECUtil::shard_extent_set_t want(sinfo.get_k_plus_m());
 
-      op.state = RecoveryOp::READING;
-
-      /* When beginning recovery, the OI may not be known. As such the object
-       * size is not known. For the first read, attempt to read the default
-       * size.  If this is larger than the object sizes, then the OSD will
-       * return truncated reads.  If the object size is known, then attempt
-       * correctly sized reads.
-       */
-      uint64_t available = get_recovery_chunk_size();
-      uint64_t read_size = available;
-      if (op.obc) {
-        uint64_t aligned_size = ECUtil::align_next(op.obc->obs.oi.size);
-        uint64_t read_to_end = 0;
-
-        if (aligned_size > op.recovery_progress.data_recovered_to) {
-          read_to_end = aligned_size - op.recovery_progress.data_recovered_to;
-        }
+  /* When beginning recovery, the OI may not be known. As such the object
+   * size is not known. For the first read, attempt to read the default
+   * size.  If this is larger than the object sizes, then the OSD will
+   * return truncated reads.  If the object size is known, then attempt
+   * correctly sized reads.
+   */
+  const uint64_t recovered_to = op.recovery_progress.data_recovered_to;
+  uint64_t available = get_recovery_chunk_size();
+  uint64_t read_size = available;
+  if (op.obc) {
+    uint64_t aligned_size = ECUtil::align_next(op.obc->obs.oi.size);
+    uint64_t read_to_end = 0;
+
+    if (aligned_size > op.recovery_progress.data_recovered_to) {
+      read_to_end = aligned_size - op.recovery_progress.data_recovered_to;
+    }
 
-        if (read_to_end < read_size) {
-          read_size = read_to_end;
-        }
-      }
-      sinfo.ro_range_to_shard_extent_set_with_parity(
-        op.recovery_progress.data_recovered_to, read_size, want);
+    if (read_to_end < read_size) {
+      read_size = read_to_end;
+    }
+  }
+  sinfo.ro_range_to_shard_extent_set_with_parity(
+    op.recovery_progress.data_recovered_to, read_size, want);
 
-      op.recovery_progress.data_recovered_to += read_size;
-      available -= read_size;
+  op.recovery_progress.data_recovered_to += read_size;
+  available -= read_size;
 
-      // We only need to recover shards that are missing.
-      for (auto shard : shard_id_set::difference(sinfo.get_all_shards(), op.missing_on_shards)) {
-        want.erase(shard);
-      }
+  // We only need to recover shards that are missing.
+  for (auto shard : shard_id_set::difference(sinfo.get_all_shards(), op.missing_on_shards)) {
+    want.erase(shard);
+  }
 
-      if (op.recovery_progress.first && op.obc) {
-        op.xattrs = op.obc->attr_cache;
-      }
+  if (op.recovery_progress.first && op.obc) {
+    op.xattrs = op.obc->attr_cache;
+  }
 
-      const auto want_attrs = (
+  const auto want_attrs = (
 #ifdef WITH_CRIMSON
-        op.recovery_progress.first && op.xattrs.count(OI_ATTR) == 0
+    op.recovery_progress.first && op.xattrs.count(OI_ATTR) == 0
 #else
-        op.recovery_progress.first && !op.obc
+    op.recovery_progress.first && !op.obc
 #endif
-      ) ? WantAttrs::Yes : WantAttrs::No;
-      const auto want_omap_header = (op.recovery_progress.first && !op.recovery_progress.omap_complete)
-                                      ? WantOmapHeader::Yes
-                                      : WantOmapHeader::No;
-      if (want_omap_header == WantOmapHeader::Yes) {
-        ceph_assert(get_parent()->get_pool().supports_omap());
-      }
-      const auto want_omap_keys = !op.recovery_progress.omap_complete
-                                    ? WantOmapKeys::Yes
-                                    : WantOmapKeys::No;
-      if (want_omap_keys == WantOmapKeys::Yes) {
-        ceph_assert(get_parent()->get_pool().supports_omap());
-      }
-      const auto chunk_size = op.obc ? op.obc->obs.oi.size : get_recovery_chunk_size();
-      read_request_t read_request(
-        std::move(want),
-        want_attrs,
-        want_omap_header,
-        want_omap_keys,
-        op.recovery_progress.omap_recovered_to,
-        available,
-        chunk_size
-      );
+  ) ? WantAttrs::Yes : WantAttrs::No;
+  const auto want_omap_header = (op.recovery_progress.first && !op.recovery_progress.omap_complete)
+                                  ? WantOmapHeader::Yes
+                                  : WantOmapHeader::No;
+  if (want_omap_header == WantOmapHeader::Yes) {
+    ceph_assert(get_parent()->get_pool().supports_omap());
+  }
+  const auto want_omap_keys = !op.recovery_progress.omap_complete
+                                ? WantOmapKeys::Yes
+                                : WantOmapKeys::No;
+  if (want_omap_keys == WantOmapKeys::Yes) {
+    ceph_assert(get_parent()->get_pool().supports_omap());
+  }
+  const auto chunk_size = op.obc ? op.obc->obs.oi.size : get_recovery_chunk_size();
+  read_request_t read_request(
+    std::move(want),
+    want_attrs,
+    want_omap_header,
+    want_omap_keys,
+    op.recovery_progress.omap_recovered_to,
+    available,
+    chunk_size
+  );
 
-      int r = read_pipeline.get_min_avail_to_read_shards(
-        op.hoid, true, false, read_request);
+  int r = read_pipeline.get_min_avail_to_read_shards(
+    op.hoid, true, false, read_request);
 
-      if (r != 0) {
-        // we must have lost a recovery source
-        ceph_assert(!op.recovery_progress.first);
+  if (r != 0) {
+    // we must have lost a recovery source
+    ceph_assert(!op.recovery_progress.first);
+    op.recovery_progress.data_recovered_to = recovered_to;
+    return r;
+  }
+  r = read_pipeline.ensure_primary_shard_for_omap(
+    op.hoid, read_request, true, {});
+  if (r != 0) {
+    op.recovery_progress.data_recovered_to = recovered_to;
+    return r;
+  }
+  if (read_request.shard_reads.empty()) {
+    ceph_assert(op.obc);
+    /* This can happen for several reasons
+     * - A zero-sized object.
+     * - The missing shards have no data.
+     * - The previous recovery did not need the last data shard. In this
+     *   case, data_recovered_to may indicate that the last shard still
+     *   needs recovery, when it does not.
+     * We can just skip the read and fall through below.
+     */
+    dout(10) << __func__ << " No reads required " << op << dendl;
+    // Create an empty read result and fall through.
+    op.returned_data.emplace(&sinfo);
+    return 1;
+  }
+  m->recovery_read(
+    op.hoid,
+    read_request);
+  return 0;
+}
+
+void ECCommon::RecoveryBackend::continue_recovery_op(
+  RecoveryBackend::RecoveryOp &op,
+  RecoveryMessages *m) {
+  dout(10) << __func__ << ": continuing " << op << dendl;
+  using RecoveryOp = RecoveryBackend::RecoveryOp;
+  while (1) {
+    switch (op.state) {
+    case RecoveryOp::IDLE: {
+      ceph_assert(!op.recovery_progress.data_complete
+                  || !op.recovery_progress.omap_complete);
+      op.state = RecoveryOp::READING;
+      int r = start_recovery_read(op, m);
+      if (r < 0) {
         dout(10) << __func__ << ": canceling recovery op for obj " << op.hoid
                  << dendl;
         // in crimson
@@ -1673,30 +1906,7 @@ void ECCommon::RecoveryBackend::continue_recovery_op(
         recovery_ops.erase(op.hoid);
         return;
       }
-      int r2 = read_pipeline.ensure_primary_shard_for_omap(
-        op.hoid, read_request, true, {});
-      if (r2 != 0) {
-        get_parent()->cancel_pull(op.hoid);
-        recovery_ops.erase(op.hoid);
-        return;
-      }
-      if (read_request.shard_reads.empty()) {
-        ceph_assert(op.obc);
-        /* This can happen for several reasons
-         * - A zero-sized object.
-         * - The missing shards have no data.
-         * - The previous recovery did not need the last data shard. In this
-         *   case, data_recovered_to may indicate that the last shard still
-         *   needs recovery, when it does not.
-         * We can just skip the read and fall through below.
-         */
-        dout(10) << __func__ << " No reads required " << op << dendl;
-        // Create an empty read result and fall through.
-        op.returned_data.emplace(&sinfo);
-      } else {
-        m->recovery_read(
-          op.hoid,
-          read_request);
+      if (r == 0) {
         dout(10) << __func__ << ": IDLE return " << op << dendl;
         return;
       }
@@ -1780,6 +1990,19 @@ void ECCommon::RecoveryBackend::continue_recovery_op(
       op.returned_data.reset();
       op.waiting_on_pushes = op.missing_on;
       op.recovery_progress = after_progress;
+
+      /* Read the next chunk while the pushes are in flight, so that the
+       * read and decode overlap with the writes on the peers. The pushes
+       * for a chunk are still only sent once the previous ones have been
+       * acknowledged. Omap is recovered in lock-step with the data, so
+       * only read ahead once the omap is complete.
+       */
+      if (cct->_conf->osd_recovery_ec_read_ahead &&
+          !op.recovery_progress.data_complete &&
+          op.recovery_progress.omap_complete &&
+          start_recovery_read(op, m) == 0) {
+        op.read_ahead = true;
+      }
       dout(10) << __func__ << ": READING return " << op << dendl;
       return;
     }
@@ -1812,6 +2035,15 @@ void ECCommon::RecoveryBackend::continue_recovery_op(
           dout(10) << __func__ << ": WRITING return " << op << dendl;
           recovery_ops.erase(op.hoid);
           return;
+        } else if (op.read_ahead) {
+          dout(10) << __func__ << ": WRITING waiting for read ahead "
+                   << op << dendl;
+          return;
+        } else if (op.returned_data) {
+          op.state = RecoveryOp::READING;
+          dout(10) << __func__ << ": WRITING read ahead complete "
+                   << op << dendl;
+          continue;
         } else {
           op.state = RecoveryOp::IDLE;
           dout(10) << __func__ << ": WRITING continue " << op << dendl;
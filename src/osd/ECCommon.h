@@ -309,6 +309,16 @@ struct ECCommon {
     std::map<hobject_t, std::set<pg_shard_t>> obj_to_source;
     std::map<pg_shard_t, std::set<hobject_t>> source_to_obj;
 
+    // True if later client reads of the same objects may be served from
+    // this op's shard reads, see ReadPipeline::try_coalesce_read.
+    bool coalesce = false;
+    // Head of the PG log when the op was started, if coalesce
+    eversion_t log_head;
+    // Client reads waiting on this op's shard reads rather than their own
+    std::map<hobject_t,
+             std::list<std::pair<read_request_t, ClientAsyncReadStatus*>>>
+      coalesced_reads;
+
     void dump(ceph::Formatter *f) const;
 
     std::set<pg_shard_t> in_progress;
@@ -380,7 +390,33 @@ struct ECCommon {
         std::map<hobject_t, read_request_t> &to_read,
         bool do_redundant_reads,
         bool for_recovery,
-        std::unique_ptr<ReadCompleter> on_complete);
+        std::unique_ptr<ReadCompleter> on_complete,
+        bool coalesce = false);
+
+    void finish_client_read(
+        const hobject_t &hoid,
+        read_result_t &&res,
+        read_request_t &req,
+        ClientAsyncReadStatus *status);
+
+    bool object_modified_since(
+        const hobject_t &hoid,
+        const eversion_t &since) const;
+
+    void index_coalesce_read(const ReadOp &rop);
+
+    void unindex_coalesce_read(const ReadOp &rop, const hobject_t &hoid);
+
+    bool try_coalesce_read(
+        const hobject_t &hoid,
+        const read_request_t &req,
+        ClientAsyncReadStatus *status);
+
+    void complete_coalesced_reads(
+        ReadOp &rop,
+        const hobject_t &hoid,
+        const read_result_t *res,
+        const read_request_t *req);
 
     void do_read_op(ReadOp &rop);
 
@@ -394,6 +430,8 @@ struct ECCommon {
 
     std::map<ceph_tid_t, ReadOp> tid_to_read_map;
     std::map<pg_shard_t, std::set<ceph_tid_t>> shard_to_read_map;
+    // Coalescing read ops in tid_to_read_map, by the objects they read
+    std::map<hobject_t, std::set<ceph_tid_t>> coalesce_read_map;
     std::list<ClientAsyncReadStatus> in_progress_client_reads;
 
     CephContext *cct;
@@ -846,6 +884,8 @@ struct ECCommon {
       
       ObjectContextRef obc;
       std::set<pg_shard_t> waiting_on_pushes;
+      // the read of the next chunk is in flight while state == WRITING
+      bool read_ahead = false;
 
       void dump(ceph::Formatter *f) const;
 
@@ -866,6 +906,7 @@ struct ECCommon {
 #endif
             << " state=" << ECCommon::RecoveryBackend::RecoveryOp::tostr(state)
             << " waiting_on_pushes=" << waiting_on_pushes
+            << " read_ahead=" << read_ahead
             << ")";
       }
     };
@@ -891,6 +932,9 @@ struct ECCommon {
         eversion_t v,
         ObjectContextRef head,
         ObjectContextRef obc);
+    int start_recovery_read(
+        RecoveryBackend::RecoveryOp &op,
+        RecoveryMessages *m);
     void continue_recovery_op(
         RecoveryBackend::RecoveryOp &op,
         RecoveryMessages *m);
@@ -913,6 +957,9 @@ struct ECCommon {
         RecoveryMessages *m);
     friend struct RecoveryMessages;
     void _failed_push(const hobject_t &hoid, ECCommon::read_result_t &res);
+    void _failed_read_ahead(const hobject_t &hoid,
+                            ECCommon::read_result_t &res,
+                            RecoveryMessages *m);
   };
 
   static std::optional<object_info_t> get_object_info_from_obc(
@@ -1016,6 +1063,10 @@ void ECCommon::ReadPipeline::filter_read_op(
 
   for (auto hoid : to_cancel) {
     get_parent()->cancel_pull(hoid);
+    // Any client reads waiting on this object go back to reading it
+    // themselves.
+    unindex_coalesce_read(op, hoid);
+    complete_coalesced_reads(op, hoid, nullptr, nullptr);
 
     ceph_assert(op.to_read.contains(hoid));
     op.to_read.erase(hoid);
@@ -4,6 +4,7 @@
 #include "ECExtentCache.h"
 #include "ECUtil.h"
 
+#include <limits>
 #include <mutex>
 #include <ranges>
 
@@ -342,16 +343,18 @@ bool ECExtentCache::idle() const {
 }
 
 list<ECExtentCache::LRU::Key>::iterator ECExtentCache::LRU::erase(
+    Stripe &stripe,
     const list<Key>::iterator &it,
     bool do_update_mempool) {
-  uint64_t size_change = map.at(*it).second->size();
+  uint64_t size_change = stripe.map.at(*it).cache->size();
   if (do_update_mempool) {
     update_mempool(-1, 0 - size_change);
   }
+  stripe.size -= size_change;
   size -= size_change;
-  size_t removed = map.erase(*it);
+  size_t removed = stripe.map.erase(*it);
   ceph_assert(removed == 1);
-  return lru.erase(it);
+  return stripe.lru.erase(it);
 }
 
 void ECExtentCache::LRU::add(const Line &line) {
@@ -364,52 +367,187 @@ void ECExtentCache::LRU::add(const Line &line) {
 
   shared_ptr<shard_extent_map_t> cache = line.cache;
 
-  std::lock_guard lock{mutex};
-  ceph_assert(!map.contains(k));
-  auto i = lru.insert(lru.end(), k);
-  auto j = make_pair(std::move(i), std::move(cache));
-  map.insert(std::pair(std::move(k), std::move(j)));
-  size += line.size; // This is already accounted for in mempool.
-  free_maybe();
+  Stripe &stripe = get_stripe(k.oid);
+  {
+    std::lock_guard lock{stripe.mutex};
+    ceph_assert(!stripe.map.contains(k));
+    auto i = stripe.lru.insert(stripe.lru.end(), k);
+    stripe.map.emplace(k, Entry{std::move(i), std::move(cache), next_seq++});
+    stripe.size += line.size; // This is already accounted for in mempool.
+    size += line.size;
+  }
+  // Evict the least recently used lines of all stripes, never the line
+  // that is being added. This is done outside of the stripe lock to avoid
+  // lock nesting.
+  if (max_size < size) {
+    trim(&k);
+  }
 }
 
 shared_ptr<shard_extent_map_t> ECExtentCache::LRU::find(
     const hobject_t &oid, uint64_t offset) {
   shared_ptr<shard_extent_map_t> cache = nullptr;
-  std::lock_guard lock{mutex};
-  if (auto found = map.find({offset, oid}); found != map.end()) {
-    auto &&[lru_iter, c] = found->second;
-    cache = c;
-    auto it = lru_iter; // Intentional copy.
-    erase(it, false);
+  Stripe &stripe = get_stripe(oid);
+  std::lock_guard lock{stripe.mutex};
+  pool_stats_t &stats = stripe.pool_stats[oid.pool];
+  if (auto found = stripe.map.find({offset, oid}); found != stripe.map.end()) {
+    cache = found->second.cache;
+    auto it = found->second.lru_iter; // Intentional copy.
+    erase(stripe, it, false);
+    stats.hits++;
+  } else {
+    stats.misses++;
   }
   return cache;
 }
 
 void ECExtentCache::LRU::remove_object(const hobject_t &oid) {
-  std::lock_guard lock{mutex};
-  for (auto it = lru.begin(); it != lru.end();) {
+  Stripe &stripe = get_stripe(oid);
+  std::lock_guard lock{stripe.mutex};
+  for (auto it = stripe.lru.begin(); it != stripe.lru.end();) {
     if (it->oid == oid) {
-      it = erase(it, true);
+      it = erase(stripe, it, true);
     } else {
       ++it;
     }
   }
 }
 
-void ECExtentCache::LRU::free_maybe() {
+/* Must be called with the stripe mutex held. */
+list<ECExtentCache::LRU::Key>::iterator ECExtentCache::LRU::first_evictable(
+    Stripe &stripe,
+    const Key *keep) {
+  auto it = stripe.lru.begin();
+  if (keep && it != stripe.lru.end() && *it == *keep) {
+    ++it;
+  }
+  return it;
+}
+
+/* Evict lines, least recently used first across all stripes, until the LRU
+ * is within its limit. keep, if given, is never evicted. */
+void ECExtentCache::LRU::trim(const Key *keep) {
   while (max_size < size) {
-    auto it = lru.begin();
-    erase(it, true);
+    Stripe *victim = nullptr;
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (auto &stripe : stripes) {
+      std::lock_guard lock{stripe.mutex};
+      auto it = first_evictable(stripe, keep);
+      if (it != stripe.lru.end() && stripe.map.at(*it).seq < oldest) {
+        oldest = stripe.map.at(*it).seq;
+        victim = &stripe;
+      }
+    }
+    if (!victim) {
+      break;
+    }
+    std::lock_guard lock{victim->mutex};
+    auto it = first_evictable(*victim, keep);
+    if (it != victim->lru.end()) {
+      erase(*victim, it, true);
+    }
+  }
+}
+
+void ECExtentCache::LRU::set_max_size(uint64_t new_max_size) {
+  max_size = new_max_size;
+  trim();
+}
+
+void ECExtentCache::LRU::add_pool_stats(
+    map<int64_t, pool_stats_t> &stats) const {
+  for (auto &stripe : stripes) {
+    std::lock_guard lock{stripe.mutex};
+    for (auto &&[pool, s] : stripe.pool_stats) {
+      stats[pool].hits += s.hits;
+      stats[pool].misses += s.misses;
+    }
   }
 }
 
 void ECExtentCache::LRU::discard() {
-  std::lock_guard lock{mutex};
-  lru.clear();
-  update_mempool(0 - map.size(), 0 - size);
-  map.clear();
-  size = 0;
+  for (auto &stripe : stripes) {
+    std::lock_guard lock{stripe.mutex};
+    stripe.lru.clear();
+    update_mempool(0 - stripe.map.size(), 0 - stripe.size);
+    stripe.map.clear();
+    size -= stripe.size;
+    stripe.size = 0;
+  }
+}
+
+uint64_t ECExtentCache::LRUPriCache::get_used_bytes() const {
+  uint64_t used = 0;
+  for (auto lru : lrus) {
+    used += lru->get_size();
+  }
+  return used;
+}
+
+int64_t ECExtentCache::LRUPriCache::request_cache_bytes(
+    PriorityCache::Priority pri, uint64_t total_cache) const {
+  int64_t assigned = get_cache_bytes(pri);
+  int64_t request = 0;
+
+  switch (pri) {
+  case PriorityCache::Priority::PRI1:
+    request = min_size;
+    break;
+  case PriorityCache::Priority::LAST:
+    {
+      // Ask for everything in use beyond the guaranteed size. The chunk
+      // rounding in commit_cache_size() leaves head room for the LRUs to
+      // grow into, so demand is discovered over successive balances.
+      uint64_t used = get_used_bytes();
+      request = used > min_size ? used - min_size : 0;
+      break;
+    }
+  default:
+    break;
+  }
+  return (request > assigned) ? request - assigned : 0;
+}
+
+int64_t ECExtentCache::LRUPriCache::get_cache_bytes() const {
+  int64_t total = 0;
+
+  for (int i = 0; i < PriorityCache::Priority::LAST + 1; i++) {
+    PriorityCache::Priority pri = static_cast<PriorityCache::Priority>(i);
+    total += get_cache_bytes(pri);
+  }
+  return total;
+}
+
+int64_t ECExtentCache::LRUPriCache::commit_cache_size(uint64_t total_cache) {
+  committed_bytes = PriorityCache::get_chunk(get_cache_bytes(), total_cache);
+  if (!lrus.empty()) {
+    uint64_t per_lru = committed_bytes / lrus.size();
+    for (auto lru : lrus) {
+      lru->set_max_size(per_lru);
+    }
+  }
+  return committed_bytes;
+}
+
+void ECExtentCache::LRUPriCache::dump(ceph::Formatter *f) const {
+  map<int64_t, LRU::pool_stats_t> stats;
+  uint64_t max_size = 0;
+  for (auto lru : lrus) {
+    lru->add_pool_stats(stats);
+    max_size += lru->get_max_size();
+  }
+  f->dump_unsigned("size", get_used_bytes());
+  f->dump_unsigned("max_size", max_size);
+  f->dump_int("committed", committed_bytes);
+  f->open_array_section("pools");
+  for (auto &&[pool, s] : stats) {
+    f->open_object_section("pool");
+    f->dump_int("pool", pool);
+    f->dump_unsigned("hits", s.hits);
+    f->dump_unsigned("misses", s.misses);
+    f->close_section();
+  }
+  f->close_section();
 }
 
 const extent_set ECExtentCache::Op::get_pin_eset(uint64_t alignment) const {
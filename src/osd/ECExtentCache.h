@@ -25,13 +25,23 @@
  * The LRU
  *
  * The LRU is a per-OSD-shard (not to be confused with an EC shard). Since the
- * OSD-shard can have multiple threads, the LRU must have a mutex. This should
- * not be required for crimson-based pools, since each osd shard has a single
- * reactor. Some effort has been made to limit the frequency that this mutex is
- * taken.
+ * OSD-shard can have multiple threads, the LRU must be locked. The LRU is
+ * striped by object into a small number of independently locked stripes, so
+ * that IO to different objects rarely contends. All lines of an object live in
+ * the same stripe. This should not be required for crimson-based pools, since
+ * each osd shard has a single reactor. Some effort has been made to limit the
+ * frequency that the stripe mutexes are taken.
  *
  * The LRU has a maximum size (defined in the constructor) and will keep its
- * usage below this amount.
+ * usage below this amount, evicting the least recently used lines of all
+ * stripes first. A line that is being added is never evicted by its own
+ * insertion. If the object store runs a PriorityCache manager,
+ * the OSD registers an LRUPriCache covering all of its LRUs, so that the
+ * maximum size is autotuned against the other caches within
+ * osd_memory_target.
+ *
+ * The LRU counts line hits and misses per pool; these can be dumped with the
+ * "dump_ec_extent_cache" admin socket command.
  *
  * Cache Lines
  *
@@ -75,7 +85,11 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+
 #include "ECUtil.h"
+#include "common/PriorityCache.h"
 #include "include/Context.h"
 
 class ECExtentCache {
@@ -120,29 +134,120 @@ class ECExtentCache {
       }
     };
 
+    struct pool_stats_t {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+    };
+
    private:
     friend class Object;
     friend class ECExtentCache;
-    std::unordered_map<Key, std::pair<
-                         std::list<Key>::iterator, std::shared_ptr<
-                           ECUtil::shard_extent_map_t>>, KeyHash> map;
-    std::list<Key> lru;
-    uint64_t max_size = 0;
-    uint64_t size = 0;
-    ceph::mutex mutex = ceph::make_mutex("ECExtentCache::LRU");
-
-    void free_maybe();
+
+    struct Entry {
+      std::list<Key>::iterator lru_iter;
+      std::shared_ptr<ECUtil::shard_extent_map_t> cache;
+      /* A hit takes the line out of the LRU and the line is added back
+       * when released, so this is the time of last use. */
+      uint64_t seq;
+    };
+
+    struct Stripe {
+      std::unordered_map<Key, Entry, KeyHash> map;
+      std::list<Key> lru; // least recently used first
+      uint64_t size = 0;
+      std::map<int64_t, pool_stats_t> pool_stats;
+      mutable ceph::mutex mutex = ceph::make_mutex("ECExtentCache::LRU::Stripe");
+    };
+
+    static constexpr unsigned STRIPE_COUNT = 8;
+    std::array<Stripe, STRIPE_COUNT> stripes;
+    std::atomic<uint64_t> max_size = 0;
+    std::atomic<uint64_t> size = 0;
+    std::atomic<uint64_t> next_seq = 0;
+
+    Stripe &get_stripe(const hobject_t &oid) {
+      /* Objects in the same PG share the low bits of their hash, so use the
+       * high bits (which are the low bits of the reversed key) to pick the
+       * stripe. */
+      return stripes[oid.get_bitwise_key_u32() % STRIPE_COUNT];
+    }
+    std::list<Key>::iterator first_evictable(Stripe &stripe,
+                                             const Key *keep);
+    void trim(const Key *keep = nullptr);
     void discard();
     void add(const Line &line);
-    void erase(const Key &k);
-    std::list<Key>::iterator erase(const std::list<Key>::iterator &it,
+    std::list<Key>::iterator erase(Stripe &stripe,
+                                   const std::list<Key>::iterator &it,
                                    bool update_mempool);
     std::shared_ptr<ECUtil::shard_extent_map_t> find(
         const hobject_t &oid, uint64_t offset);
     void remove_object(const hobject_t &oid);
 
    public:
-    explicit LRU(uint64_t max_size) : map(), max_size(max_size) {}
+    explicit LRU(uint64_t max_size) : max_size(max_size) {}
+
+    uint64_t get_size() const { return size; }
+    uint64_t get_max_size() const { return max_size; }
+    void set_max_size(uint64_t new_max_size);
+    void add_pool_stats(std::map<int64_t, pool_stats_t> &stats) const;
+  };
+
+  /* Adapter allowing the LRUs of all OSD shards to take part in the object
+   * store's PriorityCache balancing. The committed cache size is shared
+   * equally between the LRUs. The configured ec_extent_cache_size is
+   * requested at high priority, so that the cache never tunes below its
+   * historical fixed size unless memory is very tight; anything beyond that is
+   * requested at the lowest priority. */
+  class LRUPriCache : public PriorityCache::PriCache {
+    std::vector<LRU*> lrus;
+    int64_t cache_bytes[PriorityCache::Priority::LAST+1] = {0};
+    int64_t committed_bytes = 0;
+    double cache_ratio = 0;
+    uint64_t min_size = 0;
+
+    uint64_t get_used_bytes() const;
+
+   public:
+    LRUPriCache(uint64_t min_size, double cache_ratio) :
+      cache_ratio(cache_ratio),
+      min_size(min_size) {}
+
+    void add_lru(LRU *lru) { lrus.push_back(lru); }
+    void set_min_size(uint64_t new_min_size) { min_size = new_min_size; }
+    void dump(ceph::Formatter *f) const;
+
+    int64_t request_cache_bytes(PriorityCache::Priority pri,
+                                uint64_t total_cache) const override;
+    int64_t get_cache_bytes(PriorityCache::Priority pri) const override {
+      return cache_bytes[pri];
+    }
+    int64_t get_cache_bytes() const override;
+    void set_cache_bytes(PriorityCache::Priority pri, int64_t bytes) override {
+      cache_bytes[pri] = bytes;
+    }
+    void add_cache_bytes(PriorityCache::Priority pri, int64_t bytes) override {
+      cache_bytes[pri] += bytes;
+    }
+    int64_t commit_cache_size(uint64_t total_cache) override;
+    int64_t get_committed_size() const override {
+      return committed_bytes;
+    }
+    double get_cache_ratio() const override {
+      return cache_ratio;
+    }
+    void set_cache_ratio(double ratio) override {
+      cache_ratio = ratio;
+    }
+    std::string get_cache_name() const override {
+      return "EC Extent Cache";
+    }
+    // The LRU does not age its lines into bins.
+    void shift_bins() override {}
+    void import_bins(const std::vector<uint64_t> &bins) override {}
+    void set_bins(PriorityCache::Priority pri, uint64_t end_bin) override {}
+    uint64_t get_bins(PriorityCache::Priority pri) const override {
+      return 0;
+    }
   };
 
   class Op {
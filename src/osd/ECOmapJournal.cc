@@ -16,6 +16,9 @@
 
 #include <utility>
 
+#include "common/perf_counters.h"
+#include "osd_perf_counters.h"
+
 ECOmapJournalEntry::ECOmapJournalEntry(
   const eversion_t version, const bool clear_omap, std::optional<ceph::buffer::list> omap_header,
   std::vector<std::pair<OmapUpdateType, ceph::buffer::list>> omap_updates)
@@ -71,6 +74,73 @@ void ECOmapHeader::update_header(const eversion_t new_version,
   this->header = std::move(new_header);
 }
 
+const ECOmapValue *ECOmapJournal::UpdateCursor::find(const std::string_view key) {
+  while (update_it != updates.end() && std::string_view(update_it->first) < key) {
+    ++update_it;
+  }
+  if (update_it != updates.end() && std::string_view(update_it->first) == key) {
+    return &update_it->second;
+  }
+  return nullptr;
+}
+
+bool ECOmapJournal::UpdateCursor::is_removed(const std::string_view key) {
+  // The ranges are disjoint and sorted, so skip any that end before key
+  while (range_it != removed_ranges.end() && range_it->second &&
+         std::string_view(*range_it->second) <= key) {
+    ++range_it;
+  }
+  return range_it != removed_ranges.end() &&
+         std::string_view(range_it->first) <= key;
+}
+
+ECOmapJournal::~ECOmapJournal() {
+  if (logger && depth) {
+    logger->dec(l_osd_ec_omap_journal_depth, depth);
+  }
+}
+
+void ECOmapJournal::inc_depth(const hobject_t &hoid, const eversion_t version) {
+  if (!depth_map[hoid].insert(version).second) {
+    return;
+  }
+  ++depth;
+  if (logger) {
+    logger->inc(l_osd_ec_omap_journal_depth);
+  }
+}
+
+void ECOmapJournal::dec_depth(const hobject_t &hoid, const eversion_t version) {
+  if (const auto it = depth_map.find(hoid);
+    it != depth_map.end() && it->second.erase(version)) {
+    if (it->second.empty()) {
+      depth_map.erase(it);
+    }
+    --depth;
+    if (logger) {
+      logger->dec(l_osd_ec_omap_journal_depth);
+    }
+  }
+}
+
+void ECOmapJournal::clear_depth(const hobject_t &hoid) {
+  if (const auto it = depth_map.find(hoid); it != depth_map.end()) {
+    depth -= it->second.size();
+    if (logger) {
+      logger->dec(l_osd_ec_omap_journal_depth, it->second.size());
+    }
+    depth_map.erase(it);
+  }
+}
+
+void ECOmapJournal::erase_object(const hobject_t &hoid) {
+  entries.erase(hoid);
+  key_map.erase(hoid);
+  removed_ranges_map.erase(hoid);
+  merged_ranges_map.erase(hoid);
+  header_map.erase(hoid);
+  clear_depth(hoid);
+}
 
 void ECOmapJournal::add_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry) {
   ldpp_dout(&dpp, 20) << __func__ << ": hoid=" << hoid
@@ -79,6 +149,7 @@ void ECOmapJournal::add_entry(const hobject_t &hoid, const ECOmapJournalEntry &e
                       << " header_size=" << (entry.omap_header ? entry.omap_header->length() : 0)
                       << dendl;
   entries[hoid].push_back(entry);
+  inc_depth(hoid, entry.version);
 }
 
 bool ECOmapJournal::remove_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry) {
@@ -96,6 +167,7 @@ bool ECOmapJournal::remove_entry(const hobject_t &hoid, const ECOmapJournalEntry
             header_it->second.version == entry.version) {
           header_map.erase(header_it);
         }
+        dec_depth(hoid, entry.version);
         return true;
       }
     }
@@ -103,7 +175,10 @@ bool ECOmapJournal::remove_entry(const hobject_t &hoid, const ECOmapJournalEntry
   ldpp_dout(&dpp, 20) << __func__ << ": hoid=" << hoid
                       << " version=" << entry.version << " found_unprocessed=false" << dendl;
 
-  // Attempt to remove entry from processed entries
+  // Attempt to remove entry from processed entries. The processed state
+  // may no longer reference the entry, so the depth drops only if the
+  // version was still outstanding.
+  dec_depth(hoid, entry.version);
   return remove_processed_entry(hoid, entry);
 }
 
@@ -120,20 +195,19 @@ bool ECOmapJournal::remove_entry_by_version(const hobject_t &hoid, const eversio
             header_it->second.version == version) {
           header_map.erase(header_it);
         }
+        dec_depth(hoid, version);
         return true;
       }
     }
   }
 
   // Attempt to remove entry from processed entries
+  dec_depth(hoid, version);
   return remove_processed_entry_by_version(hoid, version);
 }
 
 void ECOmapJournal::clear(const hobject_t &hoid) {
-  entries.erase(hoid);
-  key_map.erase(hoid);
-  removed_ranges_map.erase(hoid);
-  header_map.erase(hoid);
+  erase_object(hoid);
   object_state_map.erase(hoid);
 }
 
@@ -141,8 +215,14 @@ void ECOmapJournal::clear_all() {
   entries.clear();
   key_map.clear();
   removed_ranges_map.clear();
+  merged_ranges_map.clear();
   header_map.clear();
   object_state_map.clear();
+  depth_map.clear();
+  if (logger && depth) {
+    logger->dec(l_osd_ec_omap_journal_depth, depth);
+  }
+  depth = 0;
 }
 
 std::size_t ECOmapJournal::entries_size(const hobject_t &hoid) const {
@@ -213,20 +293,22 @@ std::optional<ceph::buffer::list> ECOmapJournal::get_updated_header(const hobjec
   return header_map[hoid].header;
 }
 
-std::tuple<ECOmapJournal::UpdateMapType, ECOmapJournal::RangeMapType>
+std::tuple<const ECOmapJournal::UpdateMapType&, const ECOmapJournal::RangeMapType&>
 ECOmapJournal::get_value_updates(const hobject_t &hoid) {
   process_entries(hoid);
   return {get_key_map(hoid), get_removed_ranges(hoid)};
 }
 
 void ECOmapJournal::process_entries(const hobject_t &hoid) {
-  auto entry_list = get_entries(hoid);
-  ldpp_dout(&dpp, 20) << __func__ << ": hoid=" << hoid
-                      << " processing " << entry_list.size() << " entries" << dendl;
   if (!has_unprocessed_entries(hoid)) {
     return;
   }
-  
+  const std::size_t num_entries = entries_size(hoid);
+  ldpp_dout(&dpp, 20) << __func__ << ": hoid=" << hoid
+                      << " processing " << num_entries << " entries" << dendl;
+  const auto start = ceph::mono_clock::now();
+  bool ranges_changed = false;
+
   for (auto entry_iter = begin_entries(hoid);
         entry_iter != end_entries(hoid); ++entry_iter) {
     ECOmapRemovedRanges removed_ranges(entry_iter->version);
@@ -330,9 +412,18 @@ void ECOmapJournal::process_entries(const hobject_t &hoid) {
     }
     if (!removed_ranges.ranges.empty()) {
       removed_ranges_map[hoid].emplace_back(removed_ranges);
+      ranges_changed = true;
     }
   }
   entries.erase(hoid);
+  if (ranges_changed) {
+    merged_ranges_map.erase(hoid);
+  }
+  if (logger) {
+    logger->inc(l_osd_ec_omap_journal_processed, num_entries);
+    logger->tinc(l_osd_ec_omap_journal_process_lat,
+                 ceph::mono_clock::now() - start);
+  }
 }
 
 bool ECOmapJournal::remove_processed_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry) {
@@ -402,6 +493,7 @@ bool ECOmapJournal::remove_processed_entry(const hobject_t &hoid, const ECOmapJo
     for (auto rr_it = removed_ranges_list.begin(); rr_it != removed_ranges_list.end(); ++rr_it) {
       if (rr_it->version == entry.version) {
         removed_ranges_list.erase(rr_it);
+        merged_ranges_map.erase(hoid);
         break;
       }
     }
@@ -438,6 +530,7 @@ bool ECOmapJournal::remove_processed_entry_by_version(const hobject_t &hoid, con
     for (auto rr_it = removed_ranges_list.begin(); rr_it != removed_ranges_list.end(); ++rr_it) {
       if (rr_it->version == version) {
         removed_ranges_list.erase(rr_it);
+        merged_ranges_map.erase(hoid);
         break;
       }
     }
@@ -448,55 +541,63 @@ bool ECOmapJournal::remove_processed_entry_by_version(const hobject_t &hoid, con
   return true;
 }
 
-ECOmapJournal::UpdateMapType ECOmapJournal::get_key_map(const hobject_t &hoid) const {
+const ECOmapJournal::UpdateMapType &ECOmapJournal::get_key_map(const hobject_t &hoid) const {
+  static const UpdateMapType empty;
   if (const auto it = key_map.find(hoid); it != key_map.end()) {
     return it->second;
   }
-  return {};
+  return empty;
 }
 
-ECOmapJournal::RangeMapType ECOmapJournal::get_removed_ranges(const hobject_t &hoid) const {
+const ECOmapJournal::RangeMapType &ECOmapJournal::get_removed_ranges(const hobject_t &hoid) const {
+  static const RangeMapType empty;
+  const auto it = removed_ranges_map.find(hoid);
+  if (it == removed_ranges_map.end()) {
+    return empty;
+  }
+  if (const auto cached = merged_ranges_map.find(hoid);
+    cached != merged_ranges_map.end()) {
+    return cached->second;
+  }
+
   // Merge all removed ranges for the object
-  RangeMapType merged_ranges;
-  if (const auto it = removed_ranges_map.find(hoid);
-    it != removed_ranges_map.end()) {
-    for (const auto &rr : it->second) {
-      for (const auto & [range_first, range_second] : rr.ranges) {
-        // Add range to merged_ranges, merging overlapping ranges
-        std::string start = range_first;
-        std::optional<std::string> end = range_second;
-
-        // Find the range that starts after the current start
-        auto map_it = merged_ranges.upper_bound(start);
-        if (map_it != merged_ranges.begin()) {
-          // Merge range to the left, if they overlap
-          if (const auto prev = std::prev(map_it);
-            !prev->second || *prev->second >= start) {
-            start = prev->first;
-            if (!end) {
-              // end is already open ended so cannot be extended
-            } else if (!prev->second) {
-              end = std::nullopt;
-            } else if (*prev->second > *end) {
-              end = *prev->second;
-            }
-            merged_ranges.erase(prev);
-          }
-        }
-        // Merge ranges to the right, if they overlap
-        while (map_it != merged_ranges.end() &&
-               (!end || map_it->first <= *end)) {
+  RangeMapType &merged_ranges = merged_ranges_map[hoid];
+  for (const auto &rr : it->second) {
+    for (const auto & [range_first, range_second] : rr.ranges) {
+      // Add range to merged_ranges, merging overlapping ranges
+      std::string start = range_first;
+      std::optional<std::string> end = range_second;
+
+      // Find the range that starts after the current start
+      auto map_it = merged_ranges.upper_bound(start);
+      if (map_it != merged_ranges.begin()) {
+        // Merge range to the left, if they overlap
+        if (const auto prev = std::prev(map_it);
+          !prev->second || *prev->second >= start) {
+          start = prev->first;
           if (!end) {
             // end is already open ended so cannot be extended
-          } else if (!map_it->second) {
+          } else if (!prev->second) {
             end = std::nullopt;
-          } else if (*map_it->second > *end) {
-            end = map_it->second;
+          } else if (*prev->second > *end) {
+            end = *prev->second;
           }
-          map_it = merged_ranges.erase(map_it);
+          merged_ranges.erase(prev);
+        }
+      }
+      // Merge ranges to the right, if they overlap
+      while (map_it != merged_ranges.end() &&
+             (!end || map_it->first <= *end)) {
+        if (!end) {
+          // end is already open ended so cannot be extended
+        } else if (!map_it->second) {
+          end = std::nullopt;
+        } else if (*map_it->second > *end) {
+          end = map_it->second;
         }
-        merged_ranges.emplace_hint(map_it, start, end);
+        map_it = merged_ranges.erase(map_it);
       }
+      merged_ranges.emplace_hint(map_it, start, end);
     }
   }
   return merged_ranges;
@@ -506,10 +607,7 @@ void ECOmapJournal::append_delete(
   const hobject_t &hoid,
   const version_t version,
   const bool lost_delete) {
-  entries.erase(hoid);
-  key_map.erase(hoid);
-  removed_ranges_map.erase(hoid);
-  header_map.erase(hoid);
+  erase_object(hoid);
   
   auto [it, inserted] = object_state_map.try_emplace(hoid, std::map<version_t, bool>{});
   it->second.insert({version, lost_delete});
@@ -524,17 +622,11 @@ void ECOmapJournal::append_delete(
 }
 
 void ECOmapJournal::append_create(const hobject_t &hoid) {
-  entries.erase(hoid);
-  key_map.erase(hoid);
-  removed_ranges_map.erase(hoid);
-  header_map.erase(hoid);
+  erase_object(hoid);
 }
 
 void ECOmapJournal::append_whiteout(const hobject_t &hoid) {
-  entries.erase(hoid);
-  key_map.erase(hoid);
-  removed_ranges_map.erase(hoid);
-  header_map.erase(hoid);
+  erase_object(hoid);
 }
 
 void ECOmapJournal::trim_delete(const hobject_t &hoid, const version_t version) {
@@ -38,8 +38,11 @@
 
 #pragma once
 
+#include <list>
 #include <map>
 #include <optional>
+#include <set>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -48,6 +51,7 @@
 #include "osd_types.h"
 
 struct eversion_t;
+class PerfCounters;
 
 class ECOmapJournalEntry {
  public:
@@ -104,9 +108,34 @@ class ECOmapHeader {
 };
 
 class ECOmapJournal {
+ public:
   using UpdateMapType = std::map<std::string, ECOmapValue>;
   using RangeMapType = std::map<std::string, std::optional<std::string>>;
   using const_iterator = std::list<ECOmapJournalEntry>::const_iterator;
+
+  /*
+   * Resolves a sorted sequence of keys (for example the keys returned by an
+   * ObjectStore omap iteration) against the journal updates of one object.
+   * The update map and removed ranges are walked in step with the keys, so
+   * each lookup is amortised O(1) rather than a search per key. Keys must be
+   * passed in non-decreasing order.
+   */
+  class UpdateCursor {
+    const UpdateMapType &updates;
+    const RangeMapType &removed_ranges;
+    UpdateMapType::const_iterator update_it;
+    RangeMapType::const_iterator range_it;
+   public:
+    UpdateCursor(const UpdateMapType &updates, const RangeMapType &removed_ranges)
+      : updates(updates), removed_ranges(removed_ranges),
+        update_it(updates.begin()), range_it(removed_ranges.begin()) {}
+
+    // The journal value for key, or nullptr if the journal did not update it
+    const ECOmapValue *find(std::string_view key);
+    // True if key falls in a range removed by the journal
+    bool is_removed(std::string_view key);
+  };
+
  private:
   // Unprocessed journal entries 
   std::map<hobject_t, std::list<ECOmapJournalEntry>> entries;
@@ -116,6 +145,17 @@ class ECOmapJournal {
   std::map<hobject_t, std::list<ECOmapRemovedRanges>> removed_ranges_map;
   std::map<hobject_t, ECOmapHeader> header_map;
 
+  // removed_ranges_map merged into disjoint ranges, built on demand and
+  // dropped whenever the removed ranges for the object change
+  mutable std::map<hobject_t, RangeMapType> merged_ranges_map;
+
+  // Versions of the journal entries not yet rolled forward, per object.
+  // The depth only drops for a version that is still outstanding, so a
+  // removal that matches nothing leaves the gauge alone.
+  std::map<hobject_t, std::set<eversion_t>> depth_map;
+  std::size_t depth = 0;
+  PerfCounters *logger = nullptr;
+
   // Contains the set of versions and lost object booleans corresponding to
   // outstanding deletes for that ob
   std::map<hobject_t, std::map<version_t, bool>> object_state_map;
@@ -129,11 +169,18 @@ class ECOmapJournal {
   void process_entries(const hobject_t &hoid);
   bool remove_processed_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry);
   bool remove_processed_entry_by_version(const hobject_t &hoid, const eversion_t version);
-  UpdateMapType get_key_map(const hobject_t &hoid) const;
-  RangeMapType get_removed_ranges(const hobject_t &hoid) const;
+  const UpdateMapType &get_key_map(const hobject_t &hoid) const;
+  const RangeMapType &get_removed_ranges(const hobject_t &hoid) const;
+  void inc_depth(const hobject_t &hoid, eversion_t version);
+  void dec_depth(const hobject_t &hoid, eversion_t version);
+  void clear_depth(const hobject_t &hoid);
+  void erase_object(const hobject_t &hoid);
 
  public:
   explicit ECOmapJournal(const DoutPrefixProvider& dpp_) : dpp(dpp_) {}
+  ~ECOmapJournal();
+
+  void set_logger(PerfCounters *l) { logger = l; }
 
   void add_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry);
   bool remove_entry(const hobject_t &hoid, const ECOmapJournalEntry &entry);
@@ -143,13 +190,16 @@ class ECOmapJournal {
   [[nodiscard]] std::size_t entries_size(const hobject_t &hoid) const;
   [[nodiscard]] bool has_unprocessed_entries(const hobject_t &hoid) const;
   [[nodiscard]] bool has_omap_updates(const hobject_t &hoid) const;
-  std::tuple<UpdateMapType, RangeMapType> get_value_updates(const hobject_t &hoid);
+  // The returned references remain valid until the journal for hoid is next
+  // modified.
+  std::tuple<const UpdateMapType&, const RangeMapType&> get_value_updates(const hobject_t &hoid);
   std::optional<ceph::buffer::list> get_updated_header(const hobject_t &hoid);
   void append_delete(const hobject_t &hoid, const version_t version, const bool lost_delete);
   void append_create(const hobject_t &hoid);
   void append_whiteout(const hobject_t &hoid);
   void trim_delete(const hobject_t &hoid, const version_t version);
   std::pair<gen_t, bool> get_generation(const hobject_t &hoid) const;
+  [[nodiscard]] std::size_t get_depth() const { return depth; }
 
   [[nodiscard]] const_iterator begin_entries(const hobject_t &hoid) const;
   [[nodiscard]] const_iterator end_entries(const hobject_t &hoid) const;
@@ -51,11 +51,58 @@ void debug(const hobject_t &oid, const std::string &str,
     << "EC_DEBUG_BUFFERS: " << map.debug_string(2048, 0) << dendl;
 }
 
+/* The client's parity can stand in for the encode only if the write is all
+ * that this transaction writes to the object: nothing else may have been
+ * overlaid, appended or planned outside of its stripes.
+ */
+bool ECTransaction::Generate::use_client_parity() const {
+  if (client_parity.length() == 0 || plan.do_parity_delta_write) {
+    return false;
+  }
+
+  // Stripe aligned, so the shard offset is the ro offset / k.
+  extent_set range;
+  range.insert(client_parity_off / sinfo.get_k(),
+               client_parity_len / sinfo.get_k());
+  for (auto shard : sinfo.get_data_shards()) {
+    if (to_write.get_extent_set(shard) != range) {
+      return false;
+    }
+  }
+  for (auto shard : sinfo.get_parity_shards()) {
+    if (to_write.contains_shard(shard)) {
+      return false;
+    }
+  }
+  for (auto &&[shard, eset] : plan.will_write) {
+    if (!eset.subset_of(range)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ECTransaction::Generate::encode_and_write() {
   ldpp_dout(dpp, 20)<< __func__ << dendl;
 
-  // For PDW, we already have necessary parity buffers.
-  if (!plan.do_parity_delta_write) {
+  const bool client_encoded = use_client_parity();
+  if (client_encoded) {
+    // The parity shards follow each other in raw shard order.
+    uint64_t shard_off = client_parity_off / sinfo.get_k();
+    uint64_t shard_len = client_parity_len / sinfo.get_k();
+    ceph_assert(client_parity.length() == shard_len * sinfo.get_m());
+    uint64_t pos = 0;
+    for (raw_shard_id_t raw(sinfo.get_k()); raw < (int)sinfo.get_k_plus_m();
+         ++raw) {
+      bufferlist bl;
+      bl.substr_of(client_parity, pos, shard_len);
+      to_write.insert_in_shard(sinfo.get_shard(raw), shard_off, bl);
+      pos += shard_len;
+    }
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid << " using client parity"
+                       << dendl;
+  } else if (!plan.do_parity_delta_write) {
+    // For PDW, we already have necessary parity buffers.
     to_write.insert_parity_buffers();
   }
 
@@ -73,13 +120,25 @@ void ECTransaction::Generate::encode_and_write() {
   }
 
   int r = 0;
-  if (plan.do_parity_delta_write) {
+  if (client_encoded) {
+    // Nothing to encode.
+  } else if (plan.do_parity_delta_write) {
     /* For parity delta writes, we remove any unwanted writes before calculating
      * the parity.
      */
     read_sem->zero_pad(plan.will_write);
     to_write.pad_with_other(plan.will_write, *read_sem);
     r = to_write.encode_parity_delta(ec_impl, *read_sem, dpp);
+  } else if (dpp && dpp->get_cct()->_conf->ms_crc_data) {
+    /* The sub writes will be checksummed by the messenger, so have the
+     * plugin calculate those crcs while it is encoding, rather than the
+     * messenger making another pass over the data later.
+     */
+    shard_id_set crc_shards;
+    for (auto &&[shard, _] : plan.will_write) {
+      crc_shards.insert(shard);
+    }
+    r = to_write.encode(ec_impl, dpp, nullptr, &crc_shards);
   } else {
     r = to_write.encode(ec_impl, dpp);
   }
@@ -92,6 +151,9 @@ void ECTransaction::Generate::encode_and_write() {
 	             << " plan " << plan
 	             << dendl;
 
+  const uint64_t elide_zeros_min = dpp ?
+    dpp->get_cct()->_conf->osd_ec_elide_zero_writes_min_size : 0;
+
   for (auto &&[shard, to_write_eset]: plan.will_write) {
     /* Zero pad, even if we are not writing.  The extent cache requires that
      * all shards are fully populated with write data, even if the OSDs are
@@ -117,9 +179,30 @@ void ECTransaction::Generate::encode_and_write() {
       for (auto &&[offset, len]: to_write_eset) {
         buffer::list bl;
         to_write.get_buffer(shard, offset, len, bl);
-        t.write(coll_t(spg_t(pgid, shard)),
-                ghobject_t(oid, ghobject_t::NO_GEN, shard),
-                offset, bl.length(), bl, fadvise_flags);
+        if (!elide_zeros_min) {
+          t.write(coll_t(spg_t(pgid, shard)),
+                  ghobject_t(oid, ghobject_t::NO_GEN, shard),
+                  offset, bl.length(), bl, fadvise_flags);
+          continue;
+        }
+
+        /* Send long runs of zeros (zero padding, zero client data and the
+         * parity of zero stripes) as zero ops, so they are neither sent to
+         * the shards nor written to disk.
+         */
+        std::map<uint64_t, buffer::list> writes;
+        extent_set zeros;
+        ECUtil::split_zero_runs(offset, bl, elide_zeros_min, writes, zeros);
+        for (auto &&[w_off, data] : writes) {
+          t.write(coll_t(spg_t(pgid, shard)),
+                  ghobject_t(oid, ghobject_t::NO_GEN, shard),
+                  w_off, data.length(), data, fadvise_flags);
+        }
+        for (auto &&[z_off, z_len] : zeros) {
+          t.zero(coll_t(spg_t(pgid, shard)),
+                 ghobject_t(oid, ghobject_t::NO_GEN, shard),
+                 z_off, z_len);
+        }
       }
     }
   }
@@ -984,6 +1067,11 @@ void ECTransaction::Generate::overlay_writes() {
       [&](const BufferUpdate::Write &wop) {
         bl = wop.buffer;
         fadvise_flags |= wop.fadvise_flags;
+        if (wop.parity.length()) {
+          client_parity = wop.parity;
+          client_parity_off = extent.get_off();
+          client_parity_len = extent.get_len();
+        }
       },
       [&](const BufferUpdate::Zero &) {
         bl.append_zero(extent.get_len());
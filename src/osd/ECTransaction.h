@@ -178,6 +178,11 @@ class Generate {
   std::vector<std::pair<uint64_t, uint64_t>> rollback_extents;
   std::vector<shard_id_set> rollback_shards;
   uint32_t fadvise_flags = 0;
+  /// parity shards encoded by the client (CEPH_OSD_OP_FLAG_EC_PARITY) for
+  /// the stripe-aligned ro range client_parity_off~client_parity_len
+  bufferlist client_parity;
+  uint64_t client_parity_off = 0;
+  uint64_t client_parity_len = 0;
   bool written_shards_final{false};
   ECOmapJournal &ec_omap_journal;
   const PGLog &pg_log;
@@ -188,6 +193,7 @@ class Generate {
   void delete_first();
   void zero_truncate_to_delete();
   void process_init();
+  bool use_client_parity() const;
   void encode_and_write();
   void truncate();
   void overlay_writes();
@@ -2,11 +2,13 @@
 
 #include "ECUtil.h"
 
+#include <bit>
 #include <sstream>
 
 #include <errno.h>
 #include "common/ceph_context.h"
 #include "global/global_context.h"
+#include "include/crc32c.h"
 #include "include/encoding.h"
 
 using namespace std;
@@ -482,14 +484,118 @@ slice_iterator shard_extent_map_t::begin_slice_iterator(
   return slice_iterator(extent_maps, out, dpp, dedup_zeros);
 }
 
+/* Consecutive slices of a shard usually come from the same buffer, so the
+ * crc32c of the buffers of crc_shards is chained across them and cached in
+ * that buffer, where a later bufferlist::crc32c() over it (such as the
+ * messenger's, when the sub write is sent) will find it. This returns the
+ * seed for each shard of the slice, extending the current run of the shard
+ * if the slice follows on from it.
+ */
+static shard_id_map<uint32_t> get_slice_crc_seeds(
+    const shard_id_map<bufferptr> &in,
+    const shard_id_map<bufferptr> &out,
+    const shard_id_set &crc_shards,
+    shard_id_map<std::pair<bufferptr, uint32_t>> &crc_runs) {
+  shard_id_map<uint32_t> crcs(crc_runs.max_size());
+
+  for (auto shard : crc_shards) {
+    const bufferptr *ptr;
+    if (in.contains(shard)) {
+      ptr = &in.at(shard);
+    } else if (out.contains(shard)) {
+      ptr = &out.at(shard);
+    } else {
+      continue;
+    }
+
+    if (crc_runs.contains(shard)) {
+      auto &&[run, crc] = crc_runs.at(shard);
+      if (run.raw_c_str() == ptr->raw_c_str() && run.end() == ptr->start()) {
+        run.set_length(run.length() + ptr->length());
+        crcs.emplace(shard, crc);
+        continue;
+      }
+    }
+    crc_runs[shard] = std::make_pair(*ptr, -1);
+    crcs.emplace(shard, -1);
+  }
+
+  return crcs;
+}
+
+static void set_slice_crcs(
+    const shard_id_map<uint32_t> &crcs,
+    shard_id_map<std::pair<bufferptr, uint32_t>> &crc_runs) {
+  for (auto &&[shard, crc] : crcs) {
+    auto &&[run, run_crc] = crc_runs.at(shard);
+    run_crc = crc;
+    run.set_crc32c(-1, run_crc);
+  }
+}
+
+/* Encode a single slice, with the plugin calculating the crc32c of the
+ * buffers of crc_shards as it goes.
+ */
+static int encode_slice_with_crcs(
+    const ErasureCodeInterfaceRef &ec_impl,
+    const shard_id_map<bufferptr> &in,
+    shard_id_map<bufferptr> &out,
+    const shard_id_set &crc_shards,
+    shard_id_map<std::pair<bufferptr, uint32_t>> &crc_runs) {
+  shard_id_map<uint32_t> crcs =
+    get_slice_crc_seeds(in, out, crc_shards, crc_runs);
+
+  if (int ret = ec_impl->encode_chunks_with_crcs(in, out, crcs)) {
+    return ret;
+  }
+
+  set_slice_crcs(crcs, crc_runs);
+  return 0;
+}
+
+/* A slice whose data is all zero has all zero parity, so the crc32c of each
+ * buffer of crc_shards is that of a run of zeros, which does not need the
+ * data to be read.
+ */
+static void zero_slice_crcs(
+    const shard_id_map<bufferptr> &in,
+    const shard_id_map<bufferptr> &out,
+    const shard_id_set &crc_shards,
+    uint64_t length,
+    shard_id_map<std::pair<bufferptr, uint32_t>> &crc_runs) {
+  shard_id_map<uint32_t> crcs =
+    get_slice_crc_seeds(in, out, crc_shards, crc_runs);
+
+  for (auto &&[_, crc] : crcs) {
+    crc = ceph_crc32c_zeros(crc, length);
+  }
+
+  set_slice_crcs(crcs, crc_runs);
+}
+
 /* Encode parity chunks, using the encode_chunks interface into the
  * erasure coding. This generates all parity using full stripe writes.
+ *
+ * Where possible, all the slices are collected and passed to the plugin in a
+ * single encode_chunks_batch call, rather than one call per slice, which
+ * matters for transactions touching many small, scattered extents. Zero
+ * dedup inspects the parity of each slice as the iterator moves past it, so
+ * in that case each slice must be encoded before advancing. Slices are also
+ * encoded one at a time if the crc32c of crc_shards is to be calculated.
+ *
+ * If the plugin guarantees that zero data encodes to zero parity, slices
+ * whose data is all zero skip the plugin and have their parity zeroed. The
+ * crc32c of crc_shards is then carried across the slice arithmetically.
  */
 int shard_extent_map_t::encode(const ErasureCodeInterfaceRef &ec_impl,
     DoutPrefixProvider *dpp,
-    shard_id_set *dedup_zeros) {
+    shard_id_set *dedup_zeros,
+    const shard_id_set *crc_shards) {
   shard_id_set out_set = sinfo->get_parity_shards();
   bool rebuild_req = false;
+  ErasureCodeInterface::encode_batch_t batch;
+  shard_id_map<std::pair<bufferptr, uint32_t>> crc_runs(sinfo->get_k_plus_m());
+  const bool zero_in_zero_out = sinfo->supports_zero_in_zero_out();
 
   for (auto iter = begin_slice_iterator(out_set, dpp, dedup_zeros); !iter.is_end(); ++iter) {
     if (!iter.is_page_aligned()) {
@@ -500,14 +606,42 @@ int shard_extent_map_t::encode(const ErasureCodeInterfaceRef &ec_impl,
     shard_id_map<bufferptr> &in = iter.get_in_bufferptrs();
     shard_id_map<bufferptr> &out = iter.get_out_bufferptrs();
 
-    if (int ret = ec_impl->encode_chunks(in, out)) {
-      return ret;
+    if (zero_in_zero_out &&
+        std::all_of(in.begin(), in.end(), [](const auto &i) {
+          return i.second.is_zero_fast() || i.second.is_zero();
+        })) {
+      for (auto &&[_, bp] : out) {
+        bp.zero();
+      }
+      if (crc_shards) {
+        zero_slice_crcs(in, out, *crc_shards, iter.get_length(), crc_runs);
+      }
+      continue;
+    }
+
+    if (crc_shards) {
+      if (int ret = encode_slice_with_crcs(ec_impl, in, out, *crc_shards,
+                                           crc_runs)) {
+        return ret;
+      }
+    } else if (dedup_zeros) {
+      if (int ret = ec_impl->encode_chunks(in, out)) {
+        return ret;
+      }
+    } else {
+      batch.emplace_back(in, out);
     }
   }
 
   if (rebuild_req) {
     pad_and_rebuild_to_ec_align();
-    return encode(ec_impl, dpp, dedup_zeros);
+    return encode(ec_impl, dpp, dedup_zeros, crc_shards);
+  }
+
+  if (batch.size() == 1) {
+    return ec_impl->encode_chunks(batch.front().first, batch.front().second);
+  } else if (!batch.empty()) {
+    return ec_impl->encode_chunks_batch(batch);
   }
 
   return 0;
@@ -556,6 +690,10 @@ int shard_extent_map_t::encode_parity_delta(
                               data_shards[shard_id_t(1)], &delta);
         shard_id_map<bufferptr> in(sinfo->get_k_plus_m());
         in.emplace(data_shard, delta);
+        // the parity is updated in place, invalidating any cached crc32c
+        for (auto &&[_, bp] : parity_shards) {
+          bp.invalidate_crc();
+        }
         ec_impl->apply_delta(in, parity_shards);
       }
     }
@@ -1150,6 +1288,121 @@ std::ostream &operator<<(std::ostream &out, const log_entry_t &rhs) {
 // require these keys.
 const string HINFO_KEY = "hinfo_key";
 
+extent_set get_zero_extents(uint64_t off, const bufferlist &bl,
+                            uint64_t min_len) {
+  extent_set zeros;
+  uint64_t run_off = 0;
+  uint64_t run_len = 0;
+
+  auto flush_run = [&]() {
+    if (run_len && run_len >= min_len) {
+      zeros.insert(run_off, run_len);
+    }
+    run_len = 0;
+  };
+  auto add_zeros = [&](uint64_t z_off, uint64_t z_len) {
+    if (run_len && run_off + run_len == z_off) {
+      run_len += z_len;
+    } else {
+      flush_run();
+      run_off = z_off;
+      run_len = z_len;
+    }
+  };
+
+  for (const auto &bp : bl.buffers()) {
+    uint64_t len = bp.length();
+    if (bp.is_zero_fast()) {
+      add_zeros(off, len);
+    } else {
+      const char *c_str = bp.c_str();
+      for (uint64_t pos = 0; pos < len; pos += EC_ALIGN_SIZE) {
+        uint64_t block = std::min<uint64_t>(EC_ALIGN_SIZE, len - pos);
+        if (mem_is_zero(c_str + pos, block)) {
+          add_zeros(off + pos, block);
+        }
+      }
+    }
+    off += len;
+  }
+  flush_run();
+
+  return zeros;
+}
+
+/* ceph_crc32c_zeros(crc, len) is linear in crc and invertible, so solve
+ * ceph_crc32c_zeros(x, len) == crc for x over GF(2), from the images of
+ * each bit of x.
+ */
+static uint32_t crc32c_remove_zeros(uint32_t crc, unsigned len) {
+  // basis[p] has its highest set bit at p; bits[p] is the x it is made of
+  uint32_t basis[32] = {};
+  uint32_t bits[32] = {};
+  for (unsigned i = 0; i < 32; ++i) {
+    uint32_t v = ceph_crc32c_zeros(1u << i, len);
+    uint32_t b = 1u << i;
+    while (v) {
+      unsigned p = 31 - std::countl_zero(v);
+      if (!basis[p]) {
+        basis[p] = v;
+        bits[p] = b;
+        break;
+      }
+      v ^= basis[p];
+      b ^= bits[p];
+    }
+  }
+
+  uint32_t x = 0;
+  while (crc) {
+    unsigned p = 31 - std::countl_zero(crc);
+    ceph_assert(basis[p]);
+    crc ^= basis[p];
+    x ^= bits[p];
+  }
+  return x;
+}
+
+void split_zero_runs(uint64_t off, const bufferlist &bl, uint64_t min_len,
+                     std::map<uint64_t, bufferlist> &writes,
+                     extent_set &zeros) {
+  zeros = get_zero_extents(off, bl, min_len);
+
+  /* A bufferptr with a cached crc32c, which the zero runs cut down to a
+   * single extent, keeps the crc32c of that extent instead. The leading
+   * zeros move the seed and the trailing zeros are removed from the crc.
+   */
+  uint64_t bp_off = off;
+  for (const auto &bp : bl.buffers()) {
+    const uint64_t bp_end = bp_off + bp.length();
+    uint32_t crc;
+    extent_set bp_data;
+    bp_data.insert(bp_off, bp.length());
+    bp_data.subtract(zeros);
+    if (bp_data.num_intervals() == 1 && bp_data.size() < bp.length() &&
+        bp.get_crc32c(-1, &crc)) {
+      const uint64_t d_off = bp_data.range_start();
+      const uint64_t d_len = bp_data.size();
+      const uint32_t seed = ceph_crc32c_zeros(-1, d_off - bp_off);
+      crc = crc32c_remove_zeros(crc, bp_end - d_off - d_len);
+      bufferptr(bp, d_off - bp_off, d_len).set_crc32c(seed, crc);
+    }
+    bp_off = bp_end;
+  }
+
+  uint64_t pos = off;
+  auto write_to = [&](uint64_t end) {
+    if (end > pos) {
+      writes[pos].substr_of(bl, pos - off, end - pos);
+    }
+  };
+  for (auto &&[z_off, z_len] : zeros) {
+    write_to(z_off);
+    pos = z_off + z_len;
+  }
+  write_to(off + bl.length());
+}
+
 bool is_hinfo_key_string(const string &key) {
   return key == HINFO_KEY;
 }
@@ -688,6 +688,11 @@ public:
             ErasureCodeInterface::FLAG_EC_PLUGIN_DIRECT_READS) != 0;
   }
 
+  bool supports_zero_in_zero_out() const {
+    return (plugin_flags &
+            ErasureCodeInterface::FLAG_EC_PLUGIN_ZERO_INPUT_ZERO_OUTPUT_OPTIMIZATION) != 0;
+  }
+
   uint64_t get_stripe_width() const {
     return stripe_width;
   }
@@ -1010,7 +1015,8 @@ public:
   extent_set get_extent_superset() const;
   int encode(const ErasureCodeInterfaceRef &ec_impl,
     DoutPrefixProvider *dpp = nullptr,
-    shard_id_set *dedup_zeros = nullptr);
+    shard_id_set *dedup_zeros = nullptr,
+    const shard_id_set *crc_shards = nullptr);
   int encode_parity_delta(const ErasureCodeInterfaceRef &ec_impl,
                           shard_extent_map_t &old_sem,
                           DoutPrefixProvider *dpp);
@@ -1166,6 +1172,23 @@ struct log_entry_t {
   friend std::ostream &operator<<(std::ostream &out, const log_entry_t &lhs);
 };
 
+/* Find the runs of zeros, at least min_len long, in a buffer which starts at
+ * off in shard address space.  Buffers are inspected in EC_ALIGN_SIZE blocks,
+ * so zero runs which are not block aligned within each bufferptr are only
+ * partially reported.
+ */
+extent_set get_zero_extents(uint64_t off, const bufferlist &bl,
+                            uint64_t min_len);
+
+/* Split bl, which starts at off in shard address space, into the extents to
+ * write and the runs of zeros, at least min_len long, to zero instead. A
+ * bufferptr that is cut down to a single extent to write keeps its cached
+ * crc32c, adjusted to that extent, so the messenger need not recalculate it.
+ */
+void split_zero_runs(uint64_t off, const bufferlist &bl, uint64_t min_len,
+                     std::map<uint64_t, bufferlist> &writes,
+                     extent_set &zeros);
+
 bool is_hinfo_key_string(const std::string &key);
 const std::string &get_hinfo_key();
 }
@@ -2992,6 +2992,12 @@ will start to track new ops received afterwards.";
     service.remote_reserver.dump(f);
     f->close_section();
     f->close_section();
+  } else if (prefix == "dump_ec_extent_cache") {
+    f->open_object_section("ec_extent_cache");
+    if (ec_extent_cache_pricache) {
+      ec_extent_cache_pricache->dump(f);
+    }
+    f->close_section();
   } else if (prefix == "dump_scrub_reservations") {
     f->open_object_section("scrub_reservations");
     service.get_scrub_services().dump_scrub_reservations(f);
@@ -3711,6 +3717,14 @@ int OSD::init()
   dout(2) << "journal looks like " << (journal_is_rotational ? "hdd" : "ssd")
           << dendl;
 
+  ec_extent_cache_pricache = std::make_shared<ECExtentCache::LRUPriCache>(
+    cct->_conf.get_val<uint64_t>("ec_extent_cache_size") * num_shards,
+    cct->_conf.get_val<double>("ec_extent_cache_ratio"));
+  for (auto shard : shards) {
+    ec_extent_cache_pricache->add_lru(&shard->ec_extent_cache_lru);
+  }
+  store->add_priority_cache("ec_extent", ec_extent_cache_pricache);
+
   enable_disable_fuse(false);
 
   dout(2) << "boot" << dendl;
@@ -4143,6 +4157,10 @@ void OSD::final_init()
 				     asok_hook,
 				     "show recovery reservations");
   ceph_assert(r == 0);
+  r = admin_socket->register_command("dump_ec_extent_cache",
+				     asok_hook,
+				     "show EC extent cache size and per-pool hits/misses");
+  ceph_assert(r == 0);
   r = admin_socket->register_command("dump_scrub_reservations",
 				     asok_hook,
 				     "show scrub reservations");
@@ -4675,6 +4693,7 @@ int OSD::shutdown()
     service.fast_shutdown();
     std::lock_guard lock(osd_lock);
     // TBD: assert in allocator that nothing is being add
+    store->remove_priority_cache("ec_extent");
     store->umount();
 
     utime_t end_time = ceph_clock_now();
@@ -4832,6 +4851,7 @@ int OSD::shutdown()
   service.shutdown();
 
   std::lock_guard lock(osd_lock);
+  store->remove_priority_cache("ec_extent");
   store->umount();
   store.reset();
   dout(10) << "Store synced" << dendl;
@@ -11076,9 +11096,22 @@ OSDShard::OSDShard(
       osd->store->get_type(), osd_op_queue, osd_op_queue_cut_off)),
     context_queue(sdata_wait_lock, sdata_cond),
     ec_extent_cache_lru(cct->_conf.get_val<uint64_t>(
-      "ec_extent_cache_size"))
+      "ec_extent_cache_size")),
+    lockless_enqueue(cct->_conf->osd_op_queue_lockless_enqueue)
 {
-  dout(0) << "using op scheduler " << *scheduler << dendl;
+  dout(0) << "using op scheduler " << *scheduler
+	  << (lockless_enqueue ? " (lockless enqueue)" : "") << dendl;
+}
+
+unsigned OSDShard::_drain_incoming()
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(shard_lock));
+  // per-producer order is preserved, and anything already in the
+  // scheduler (including items requeued at the front) is older than
+  // everything detached here.
+  return incoming.drain([this](OpSchedulerItem&& item) {
+    scheduler->enqueue(std::move(item));
+  });
 }
 
 
@@ -11125,19 +11158,31 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  sdata->_drain_incoming();
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
+    // count ourselves before looking at incoming: a lockless _enqueue
+    // pushes and only then checks waiting_threads, so either it sees us
+    // and notifies under sdata_wait_lock or we see its item here
+    ++sdata->waiting_threads;
     if (is_smallest_thread_index && !sdata->context_queue.empty()) {
       // we raced with a context_queue addition, don't wait
+      --sdata->waiting_threads;
+      wait_lock.unlock();
+    } else if (sdata->has_incoming()) {
+      // we raced with a lockless _enqueue; don't wait
+      --sdata->waiting_threads;
       wait_lock.unlock();
     } else if (!sdata->stop_waiting) {
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->waiting_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
+      sdata->_drain_incoming();
       if (sdata->scheduler->empty() &&
          !(is_smallest_thread_index && !sdata->context_queue.empty())) {
 	sdata->shard_lock.unlock();
@@ -11148,6 +11193,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
         timeout_interval.load(), suicide_interval.load());
     } else {
       dout(20) << __func__ << " need return immediately" << dendl;
+      --sdata->waiting_threads;
       wait_lock.unlock();
       sdata->shard_lock.unlock();
       return;
@@ -11161,6 +11207,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
 
   WorkItem work_item;
   while (!std::get_if<OpSchedulerItem>(&work_item)) {
+    sdata->_drain_incoming();
     if (sdata->scheduler->empty()) {
       if (osd->is_stopping()) {
         sdata->shard_lock.unlock();
@@ -11200,7 +11247,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
       ++sdata->waiting_threads;
-      sdata->sdata_cond.wait_until(wait_lock, future_time);
+      if (!sdata->has_incoming()) {
+	sdata->sdata_cond.wait_until(wait_lock, future_time);
+      }
       --sdata->waiting_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
@@ -11464,7 +11513,16 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   dout(20) << fmt::format("{} {}", __func__, item) << dendl;
 
   bool empty = true;
-  {
+  if (sdata->lockless_enqueue) {
+    // the next worker to take shard_lock moves it into the scheduler.
+    // a worker that is about to wait counts itself in waiting_threads
+    // before re-checking incoming, so if none is counted here the next
+    // one to go idle will find this item and we can skip the lock.
+    empty = sdata->incoming.push(std::move(item));
+    if (sdata->waiting_threads == 0) {
+      return;
+    }
+  } else {
     std::lock_guard l{sdata->shard_lock};
     empty = sdata->scheduler->empty();
     sdata->scheduler->enqueue(std::move(item));
@@ -11521,6 +11579,7 @@ void OSD::ShardedOpWQ::stop_for_fast_shutdown()
     auto& sdata = osd->shards[shard_index];
     ceph_assert(sdata);
     std::lock_guard l(sdata->shard_lock);
+    sdata->_drain_incoming();
     while (!sdata->scheduler->empty()) {
       sdata->scheduler->dequeue();
     }
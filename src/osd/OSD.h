@@ -41,6 +41,7 @@
 #include "Session.h"
 
 #include "osd/scheduler/OpScheduler.h"
+#include "osd/scheduler/OpSchedulerIncoming.h"
 
 #include <atomic>
 #include <map>
@@ -992,7 +993,10 @@ struct OSDShard {
   std::string sdata_wait_lock_name;
   ceph::mutex sdata_wait_lock;
   ceph::condition_variable sdata_cond;
-  int waiting_threads = 0;
+  /// threads waiting on sdata_cond.  atomic so that a lockless _enqueue
+  /// can skip sdata_wait_lock when nobody is waiting; waiters bump it
+  /// before their last look at incoming.
+  std::atomic<int> waiting_threads = 0;
 
   ceph::mutex osdmap_lock;  ///< protect shard_osdmap updates vs users w/o shard_lock
   OSDMapRef shard_osdmap;
@@ -1032,6 +1036,18 @@ struct OSDShard {
 
   bool stop_waiting = false;
 
+  /// items queued by _enqueue without taking shard_lock; moved into the
+  /// scheduler, in arrival order, by whoever next holds shard_lock.  see
+  /// _drain_incoming().
+  ceph::osd::scheduler::OpSchedulerIncoming incoming;
+  const bool lockless_enqueue;
+
+  bool has_incoming() const {
+    return !incoming.empty();
+  }
+  /// move incoming items into the scheduler; requires shard_lock
+  unsigned _drain_incoming();
+
   ContextQueue context_queue;
 
   //This is an extent cache for the erasure coding. Specifically, this acts as
@@ -1798,6 +1814,7 @@ protected:
 	ceph_assert(NULL != sdata);
 
 	std::scoped_lock l{sdata->shard_lock};
+	sdata->_drain_incoming();
 	f->open_object_section(queue_name);
 	sdata->scheduler->dump(*f);
 	f->close_section();
@@ -1808,6 +1825,7 @@ protected:
       auto &&sdata = osd->shards[shard_index];
       ceph_assert(sdata);
       std::lock_guard l(sdata->shard_lock);
+      sdata->_drain_incoming();
       if (thread_index < osd->num_shards) {
 	return sdata->scheduler->empty() && sdata->context_queue.empty();
       } else {
@@ -1944,6 +1962,9 @@ public:
   std::vector<OSDShard*> shards;
   uint32_t num_shards = 0;
 
+  // autotunes the EC extent cache LRUs of all shards, see init()
+  std::shared_ptr<ECExtentCache::LRUPriCache> ec_extent_cache_pricache;
+
   void inc_num_pgs() {
     ++num_pgs;
   }
@@ -25,6 +25,7 @@
 #include "osd_types.h"
 #include "os/ObjectStore.h"
 
+#include <functional>
 #include <iosfwd>
 #include <map>
 #include <memory>
@@ -169,8 +170,29 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable std::unordered_map<hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable std::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
+    // an index keyed by a field of the entry it points to (soid, reqid),
+    // which it refers to rather than copies.  see set_index().
+    template <typename K>
+    struct entry_key_hash {
+      size_t operator()(const std::reference_wrapper<const K>& k) const {
+        return std::hash<K>()(k.get());
+      }
+    };
+    template <typename K>
+    struct entry_key_equal {
+      bool operator()(const std::reference_wrapper<const K>& l,
+                      const std::reference_wrapper<const K>& r) const {
+        return l.get() == r.get();
+      }
+    };
+    template <typename K>
+    using entry_index_t = std::unordered_map<std::reference_wrapper<const K>,
+                                             pg_log_entry_t*,
+                                             entry_key_hash<K>,
+                                             entry_key_equal<K>>;
+
+    mutable entry_index_t<hobject_t> objects;  // ptrs into log.  be careful!
+    mutable entry_index_t<osd_reqid_t> caller_ops;
     mutable std::unordered_multimap<osd_reqid_t, pg_log_entry_t*> extra_caller_ops;
     mutable std::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
 
@@ -231,7 +253,9 @@ public:
 	++rollback_info_trimmed_to_riter;
     }
 
-    // indexes objects, caller ops and extra caller ops
+    // indexes objects, caller ops and extra caller ops.  the indexes are
+    // built on first use (see logged_object, get_request, get_objects),
+    // so logs that are never queried (e.g. on replicas) don't carry them.
   public:
     IndexedLog() :
       complete_to(log.end()),
@@ -249,7 +273,6 @@ public:
       rollback_info_trimmed_to_riter(log.rbegin())
     {
       reset_rollback_info_trimmed_to_riter();
-      index();
     }
 
     IndexedLog(const IndexedLog &rhs) :
@@ -263,12 +286,37 @@ public:
       index(rhs.indexed_data);
     }
 
+    // list nodes keep their addresses when moved, so the indexes can be
+    // taken as they are instead of copying the log and rebuilding them
+    IndexedLog(IndexedLog &&rhs) :
+      pg_log_t(std::move(rhs)),
+      objects(std::move(rhs.objects)),
+      caller_ops(std::move(rhs.caller_ops)),
+      extra_caller_ops(std::move(rhs.extra_caller_ops)),
+      dup_index(std::move(rhs.dup_index)),
+      complete_to(log.end()),
+      last_requested(rhs.last_requested),
+      indexed_data(rhs.indexed_data),
+      rollback_info_trimmed_to_riter(log.rbegin())
+    {
+      reset_rollback_info_trimmed_to_riter();
+      rhs.unindex();
+      rhs.complete_to = rhs.log.end();
+      rhs.rollback_info_trimmed_to_riter = rhs.log.rbegin();
+    }
+
     IndexedLog &operator=(const IndexedLog &rhs) {
       this->~IndexedLog();
       new (this) IndexedLog(rhs);
       return *this;
     }
 
+    IndexedLog &operator=(IndexedLog &&rhs) {
+      this->~IndexedLog();
+      new (this) IndexedLog(std::move(rhs));
+      return *this;
+    }
+
     void trim_rollback_info_to(eversion_t to, pg_info_t *info, LogEntryHandler *h) {
       advance_can_rollback_to(
 	to,
@@ -301,7 +349,7 @@ public:
 
     mempool::osd_pglog::list<pg_log_entry_t> rewind_from_head(eversion_t newhead, bool *dirty_log = nullptr) {
       auto divergent = pg_log_t::rewind_from_head(newhead, dirty_log);
-      index();
+      index(indexed_data);
       reset_rollback_info_trimmed_to_riter();
       return divergent;
     }
@@ -330,7 +378,6 @@ public:
       *this = IndexedLog(o);
 
       skip_can_rollback_to_to_head();
-      index();
     }
 
     void split_out_child(
@@ -381,6 +428,14 @@ public:
       last_requested = 0;
     }
 
+    /// latest log entry for each object; built on first use
+    const entry_index_t<hobject_t>& get_objects() const {
+      if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
+        index_objects();
+      }
+      return objects;
+    }
+
     bool logged_object(const hobject_t& oid) const {
       if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
          index_objects();
@@ -414,8 +469,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      auto p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
+      if (auto p = caller_ops.find(r); p != caller_ops.end()) {
 	*version = p->second->version;
 	*user_version = p->second->user_version;
 	*return_code = p->second->return_code;
@@ -428,7 +482,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	uint32_t idx = 0;
 	for (auto i = p->second->extra_reqids.begin();
@@ -537,13 +591,13 @@ public:
 	for (auto i = log.begin(); i != log.end(); ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      set_index(objects, i->soid, const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      set_index(caller_ops, i->reqid, const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -561,6 +615,20 @@ public:
       indexed_data |= to_index;
     }
 
+    /// map key, a field of *e, to e.  an existing mapping is rekeyed as
+    /// well, as its key belongs to the entry being replaced.
+    template <typename K>
+    static void set_index(entry_index_t<K>& idx, const K& key,
+                          pg_log_entry_t* e) {
+      auto [it, inserted] = idx.try_emplace(std::cref(key), e);
+      if (!inserted) {
+        auto node = idx.extract(it);
+        node.key() = std::cref(key);
+        node.mapped() = e;
+        idx.insert(std::move(node));
+      }
+    }
+
     void index_objects() const {
       index(PGLOG_INDEXED_OBJECTS);
     }
@@ -579,14 +647,14 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        auto it = objects.find(e.soid);
+        if (it == objects.end() || it->second->version < e.version)
+          set_index(objects, e.soid, &e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  set_index(caller_ops, e.reqid, &e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -678,11 +746,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        set_index(objects, log.back().soid, &(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  set_index(caller_ops, log.back().reqid, &(log.back()));
         }
       }
 
@@ -961,8 +1029,6 @@ public:
     }
     log.merge_from(slogs, last_update);
 
-    index();
-
     mark_log_for_rewrite();
   }
 
@@ -1195,8 +1261,9 @@ protected:
                        << " last_divergent_update: " << last_divergent_update
                        << dendl;
 
-    auto objiter = log.objects.find(hoid);
-    if (objiter != log.objects.end() && !entries.empty() &&
+    const auto& objects = log.get_objects();
+    auto objiter = objects.find(hoid);
+    if (objiter != objects.end() && !entries.empty() &&
         objiter->second->version >= first_divergent_update) {
       /// Case 1)
       ldpp_dout(dpp, 10) << __func__ << ": more recent entry found: "
@@ -155,6 +155,9 @@ public:
       struct Write {
 	ceph::buffer::list buffer;
 	uint32_t fadvise_flags;
+	/// parity shards computed by the client (CEPH_OSD_OP_FLAG_EC_PARITY),
+	/// only valid for the whole of buffer
+	ceph::buffer::list parity = {};
       };
       struct Zero {
 	uint64_t len;
@@ -181,6 +184,7 @@ public:
 	  [&](const BufferUpdate::Write &w) -> BufferUpdateType {
 	    ceph::buffer::list bl;
 	    bl.substr_of(w.buffer, offset, len);
+	    // client parity covers the whole write, so a piece has none
 	    return BufferUpdate::Write{bl, w.fadvise_flags};
 	  },
 	  [&](const BufferUpdate::Zero &) -> BufferUpdateType {
@@ -211,7 +215,8 @@ public:
 	  left,
 	  [&](const BufferUpdate::Write &w) -> bool {
 	    auto r = std::get_if<BufferUpdate::Write>(&right);
-	    return r != nullptr && (w.fadvise_flags == r->fadvise_flags);
+	    return r != nullptr && (w.fadvise_flags == r->fadvise_flags) &&
+	      w.parity.length() == 0 && r->parity.length() == 0;
 	  },
 	  [&](const BufferUpdate::Zero &) -> bool {
 	    return std::holds_alternative<BufferUpdate::Zero>(right);
@@ -408,7 +413,8 @@ public:
     uint64_t off,                  ///< [in] off at which to write
     uint64_t len,                  ///< [in] len to write from bl
     ceph::buffer::list &bl,                ///< [in] bl to write will be claimed to len
-    uint32_t fadvise_flags = 0     ///< [in] fadvise hint
+    uint32_t fadvise_flags = 0,    ///< [in] fadvise hint
+    ceph::buffer::list parity = {} ///< [in] client-computed EC parity, if any
     ) {
     auto &op = get_object_op_for_modify(hoid);
     ceph_assert(!op.updated_snaps);
@@ -417,7 +423,8 @@ public:
     op.buffer_updates.insert(
       off,
       len,
-      ObjectOperation::BufferUpdate::Write{bl, fadvise_flags});
+      ObjectOperation::BufferUpdate::Write{bl, fadvise_flags,
+                                           std::move(parity)});
   }
   void clone_range(
     const hobject_t &from,         ///< [in] from
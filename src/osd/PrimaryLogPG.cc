@@ -431,7 +431,7 @@ void PrimaryLogPG::on_local_recover(
   if (!is_delete && recovery_state.get_pg_log().get_missing().is_missing(recovery_info.soid) &&
       recovery_state.get_pg_log().get_missing().get_items().find(recovery_info.soid)->second.need > recovery_info.version) {
     ceph_assert(is_primary());
-    const pg_log_entry_t *latest = recovery_state.get_pg_log().get_log().objects.find(recovery_info.soid)->second;
+    const pg_log_entry_t *latest = recovery_state.get_pg_log().get_log().get_objects().find(recovery_info.soid)->second;
     if (latest->op == pg_log_entry_t::LOST_REVERT &&
 	latest->reverting_to == recovery_info.version) {
       dout(10) << " got old revert version " << recovery_info.version
@@ -5147,6 +5147,39 @@ int PrimaryLogPG::do_xattr_cmp_str(int op, string& v1s, bufferlist& xattr)
   return do_cmp_xattr(op, v1s, v2s);
 }
 
+/*
+ * A client may encode a stripe-aligned write itself and send the parity
+ * shards after the data (see ECSplitWrite), saving the primary the
+ * encode.  Split them off so that the op looks like a plain write; an OSD
+ * that does not know the flag fails the length check instead.
+ */
+int PrimaryLogPG::take_client_parity(OSDOp& osd_op, bufferlist *parity)
+{
+  ceph_osd_op& op = osd_op.op;
+  if (!(op.flags & CEPH_OSD_OP_FLAG_EC_PARITY)) {
+    return 0;
+  }
+  op.flags = op.flags & ~CEPH_OSD_OP_FLAG_EC_PARITY;
+  if (!pool.info.is_erasure() || !pool.info.allows_ecoptimizations()) {
+    return -EOPNOTSUPP;
+  }
+  uint64_t stripe_width = pool.info.get_stripe_width();
+  uint64_t k = pool.info.get_ec_data_shard_count();
+  uint64_t parity_length = op.extent.length / k * (pool.info.size - k);
+  if (op.extent.length == 0 ||
+      op.extent.offset % stripe_width != 0 ||
+      op.extent.length % stripe_width != 0 ||
+      osd_op.indata.length() != op.extent.length + parity_length) {
+    return -EINVAL;
+  }
+  dout(20) << __func__ << " " << parity_length << " bytes of parity" << dendl;
+  parity->substr_of(osd_op.indata, op.extent.length, parity_length);
+  bufferlist data;
+  data.substr_of(osd_op.indata, 0, op.extent.length);
+  osd_op.indata.swap(data);
+  return 0;
+}
+
 int PrimaryLogPG::do_writesame(OpContext *ctx, OSDOp& osd_op)
 {
   ceph_osd_op& op = osd_op.op;
@@ -6887,6 +6920,11 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       { // write
         __u32 seq = oi.truncate_seq;
 	tracepoint(osd, do_osd_op_pre_write, soid.oid.name.c_str(), soid.snap.val, oi.size, seq, op.extent.offset, op.extent.length, op.extent.truncate_size, op.extent.truncate_seq);
+	bufferlist parity;
+	result = take_client_parity(osd_op, &parity);
+	if (result < 0) {
+	  break;
+	}
 	if (op.extent.length != osd_op.indata.length()) {
 	  result = -EINVAL;
 	  break;
@@ -6921,6 +6959,7 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	  bufferlist t;
 	  t.substr_of(osd_op.indata, 0, op.extent.length);
 	  osd_op.indata.swap(t);
+	  parity.clear();
         }
 	if (op.extent.truncate_seq > seq) {
 	  // write arrives before trimtrunc
@@ -6977,7 +7016,8 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	  }
 	} else {
 	  t->write(
-	    soid, op.extent.offset, op.extent.length, osd_op.indata, op.flags);
+	    soid, op.extent.offset, op.extent.length, osd_op.indata, op.flags,
+	    std::move(parity));
 	}
 
 	if (op.extent.offset == 0 && op.extent.length >= oi.size
@@ -7005,6 +7045,11 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       { // write full object
 	tracepoint(osd, do_osd_op_pre_writefull, soid.oid.name.c_str(), soid.snap.val, oi.size, 0, op.extent.length);
 
+	bufferlist parity;
+	result = take_client_parity(osd_op, &parity);
+	if (result < 0) {
+	  break;
+	}
 	if (op.extent.length != osd_op.indata.length()) {
 	  result = -EINVAL;
 	  break;
@@ -7025,7 +7070,8 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	  t->truncate(soid, op.extent.length);
 	}
 	if (op.extent.length) {
-	  t->write(soid, 0, op.extent.length, osd_op.indata, op.flags);
+	  t->write(soid, 0, op.extent.length, osd_op.indata, op.flags,
+		   std::move(parity));
 	}
         if (!skip_data_digest) {
 	  obs.oi.set_data_digest(osd_op.indata.crc32c(-1));
@@ -12013,10 +12059,10 @@ void PrimaryLogPG::check_blocklisted_obc_watchers(ObjectContextRef obc)
 void PrimaryLogPG::populate_obc_watchers(ObjectContextRef obc)
 {
   ceph_assert(is_primary() && is_active());
-  auto it_objects = recovery_state.get_pg_log().get_log().objects.find(obc->obs.oi.soid);
+  auto it_objects = recovery_state.get_pg_log().get_log().get_objects().find(obc->obs.oi.soid);
   ceph_assert((recovering.count(obc->obs.oi.soid) ||
 	  !is_missing_object(obc->obs.oi.soid)) ||
-	 (it_objects != recovery_state.get_pg_log().get_log().objects.end() && // or this is a revert... see recover_primary()
+	 (it_objects != recovery_state.get_pg_log().get_log().get_objects().end() && // or this is a revert... see recover_primary()
 	  it_objects->second->op ==
 	    pg_log_entry_t::LOST_REVERT &&
 	  it_objects->second->reverting_to ==
@@ -12141,11 +12187,11 @@ ObjectContextRef PrimaryLogPG::get_object_context(
   bool can_create,
   const map<string, bufferlist, less<>> *attrs)
 {
-  auto it_objects = recovery_state.get_pg_log().get_log().objects.find(soid);
+  auto it_objects = recovery_state.get_pg_log().get_log().get_objects().find(soid);
   ceph_assert(
     attrs || !recovery_state.get_pg_log().get_missing().is_missing(soid) ||
     // or this is a revert... see recover_primary()
-    (it_objects != recovery_state.get_pg_log().get_log().objects.end() &&
+    (it_objects != recovery_state.get_pg_log().get_log().get_objects().end() &&
       it_objects->second->op ==
       pg_log_entry_t::LOST_REVERT));
   ObjectContextRef obc = object_contexts.lookup(soid);
@@ -13734,8 +13780,8 @@ uint64_t PrimaryLogPG::recover_primary(uint64_t max, ThreadPool::TPHandle &handl
     hobject_t soid;
     eversion_t v = p->first;
 
-    auto it_objects = recovery_state.get_pg_log().get_log().objects.find(p->second);
-    if (it_objects != recovery_state.get_pg_log().get_log().objects.end()) {
+    auto it_objects = recovery_state.get_pg_log().get_log().get_objects().find(p->second);
+    if (it_objects != recovery_state.get_pg_log().get_log().get_objects().end()) {
       latest = it_objects->second;
       ceph_assert(latest->is_update() || latest->is_delete());
       soid = latest->soid;
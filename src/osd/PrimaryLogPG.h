@@ -1473,6 +1473,7 @@ protected:
   int do_read(OpContext *ctx, OSDOp& osd_op);
   int do_sparse_read(OpContext *ctx, OSDOp& osd_op);
   int do_writesame(OpContext *ctx, OSDOp& osd_op);
+  int take_client_parity(OSDOp& osd_op, ceph::buffer::list *parity);
 
   bool pgls_filter(const PGLSFilter& filter, const hobject_t& sobj);
 
@@ -498,6 +498,16 @@ PerfCounters *build_osd_logger(CephContext *cct) {
       l_osd_scrub_ec_reserv_secondaries_num, "scrub_ec_replicas_in_reservation",
       "number of replicas to reserve EC");
 
+  osd_plb.add_u64(
+    l_osd_ec_omap_journal_depth, "ec_omap_journal_depth",
+    "EC omap journal entries not yet rolled forward to the object store");
+  osd_plb.add_u64_counter(
+    l_osd_ec_omap_journal_processed, "ec_omap_journal_processed",
+    "EC omap journal entries merged into the read view");
+  osd_plb.add_time_avg(
+    l_osd_ec_omap_journal_process_lat, "ec_omap_journal_process_latency",
+    "Time spent merging EC omap journal entries into the read view");
+
   return osd_plb.create_perf_counters();
 }
 
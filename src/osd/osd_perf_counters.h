@@ -218,6 +218,11 @@ enum osd_counter_idx_t {
   /// number of replicas
   l_osd_scrub_ec_reserv_secondaries_num,
 
+  // ----   EC omap journal
+  l_osd_ec_omap_journal_depth, ///< journal entries not yet rolled forward
+  l_osd_ec_omap_journal_processed, ///< journal entries merged for reads
+  l_osd_ec_omap_journal_process_lat, ///< time spent merging journal entries
+
   l_osd_last,
 };
 
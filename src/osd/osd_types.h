@@ -4324,7 +4324,10 @@ class ObjectCleanRegions {
 private:
   bool new_object;
   bool clean_omap;
-  interval_set<uint64_t> clean_offsets;
+  // every pg log entry carries one of these, with a few intervals at most:
+  // keep them in one small array rather than a tree node apiece
+  using offsets_t = interval_set<uint64_t, boost::container::flat_map>;
+  offsets_t clean_offsets;
   inline static std::atomic<uint32_t> max_num_intervals{10};
 
   /**
@@ -0,0 +1,85 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "osd/scheduler/OpSchedulerIncoming.h"
+
+namespace ceph::osd::scheduler {
+
+namespace {
+
+template <typename T>
+void delete_nodes(T *n)
+{
+  while (n) {
+    T *next = n->next;
+    delete n;
+    n = next;
+  }
+}
+
+}
+
+OpSchedulerIncoming::~OpSchedulerIncoming()
+{
+  delete_nodes(head.exchange(nullptr));
+  delete_nodes(free_nodes.exchange(nullptr));
+}
+
+OpSchedulerIncoming::node_t *OpSchedulerIncoming::get_node()
+{
+  // nodes taken off a free stack but not used yet.  this holds on to at
+  // most what was in flight at some point, and is freed at thread exit.
+  struct cache_t {
+    node_t *head = nullptr;
+    ~cache_t() {
+      delete_nodes(head);
+    }
+  };
+  static thread_local cache_t cache;
+
+  if (!cache.head) {
+    cache.head = free_nodes.exchange(nullptr, std::memory_order_acquire);
+    if (!cache.head) {
+      return new node_t;
+    }
+  }
+  node_t *n = cache.head;
+  cache.head = n->next;
+  n->next = nullptr;
+  return n;
+}
+
+void OpSchedulerIncoming::put_nodes(node_t *first, node_t *last)
+{
+  node_t *h = free_nodes.load(std::memory_order_relaxed);
+  do {
+    last->next = h;
+  } while (!free_nodes.compare_exchange_weak(h, first,
+					     std::memory_order_release,
+					     std::memory_order_relaxed));
+}
+
+bool OpSchedulerIncoming::push(OpSchedulerItem &&item)
+{
+  node_t *n = get_node();
+  n->item.emplace(std::move(item));
+  node_t *h = head.load(std::memory_order_relaxed);
+  do {
+    n->next = h;
+  } while (!head.compare_exchange_weak(h, n,
+				       std::memory_order_seq_cst,
+				       std::memory_order_relaxed));
+  return h == nullptr;
+}
+
+}
@@ -0,0 +1,89 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+#include "osd/scheduler/OpSchedulerItem.h"
+
+namespace ceph::osd::scheduler {
+
+/**
+ * OpSchedulerIncoming
+ *
+ * Lock-free multi-producer stack of items on their way into an
+ * OpScheduler.  Producers push() without holding the lock that guards
+ * the scheduler; whoever next holds it detaches the whole stack with
+ * drain() and hands the items over in the order they were pushed.
+ *
+ * Nodes are recycled rather than allocated per item: drain() puts the
+ * emptied nodes on a free stack that producers only ever detach as a
+ * whole (so neither stack suffers from ABA), into a per-thread cache.
+ */
+class OpSchedulerIncoming {
+  struct node_t {
+    std::optional<OpSchedulerItem> item;
+    node_t *next = nullptr;
+  };
+
+  std::atomic<node_t*> head = {nullptr};        ///< newest first
+  std::atomic<node_t*> free_nodes = {nullptr};  ///< emptied by drain()
+
+  node_t *get_node();
+  void put_nodes(node_t *first, node_t *last);
+
+public:
+  OpSchedulerIncoming() = default;
+  OpSchedulerIncoming(const OpSchedulerIncoming &) = delete;
+  OpSchedulerIncoming &operator=(const OpSchedulerIncoming &) = delete;
+  ~OpSchedulerIncoming();
+
+  /// push an item; returns true if the stack was empty
+  bool push(OpSchedulerItem &&item);
+
+  /// true if there are items to drain.  sequentially consistent, so that
+  /// a consumer that announces itself as waiting before checking is
+  /// either seen by the pusher or sees the pushed item.
+  bool empty() const {
+    return head.load() == nullptr;
+  }
+
+  /// detach all items and pass them to @p f, oldest first
+  template <typename F>
+  unsigned drain(F &&f) {
+    node_t *n = head.exchange(nullptr, std::memory_order_acquire);
+    if (!n) {
+      return 0;
+    }
+    node_t *last = n;
+    node_t *fifo = nullptr;
+    while (n) {
+      node_t *next = n->next;
+      n->next = fifo;
+      fifo = n;
+      n = next;
+    }
+    unsigned count = 0;
+    for (n = fifo; n; n = n->next) {
+      f(std::move(*n->item));
+      n->item.reset();
+      ++count;
+    }
+    put_nodes(fifo, last);
+    return count;
+  }
+};
+
+}
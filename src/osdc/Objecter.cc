@@ -2441,6 +2441,9 @@ void Objecter::_op_submit_with_budget(Op *op,
   ceph_assert(op->ops.size() == op->out_rval.size());
   ceph_assert(op->ops.size() == op->out_handler.size());
 
+  // client-side EC parity makes the op bigger, so budget it afterwards
+  ECSplitWrite::prepare(op, *this, cct);
+
   // throttle.  before we look at any state, because
   // _take_op_budget() may drop our lock while it blocks.
   if (!op->ctx_budgeted || (ctx_budget && (*ctx_budget == -1))) {
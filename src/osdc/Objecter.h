@@ -1702,6 +1702,7 @@ class Objecter : public md_config_obs_t, public Dispatcher {
   friend class SplitOp;
   friend class ECSplitOp;
   friend class ReplicaSplitOp;
+  friend class ECSplitWrite;
 
   using MOSDOp = _mosdop::MOSDOp<osdc_opvec>;
 public:
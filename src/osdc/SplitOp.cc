@@ -12,6 +12,7 @@
 #include "osdc/SplitOp.h"
 #include "osdc/Objecter.h"
 #include "osd/osd_types.h"
+#include "erasure-code/ErasureCodePlugin.h"
 
 using namespace std::literals;
 
@@ -377,6 +378,170 @@ void ReplicaSplitOp::init_read(OSDOp &op, bool sparse, int ops_index) {
   }
 }
 
+#undef dout_prefix
+#define dout_prefix *_dout << " ECSplitWrite::"
+
+/**
+ * @brief Check whether a write can be encoded client-side.
+ *
+ * @param pi Pool information
+ * @param offset Logical object offset of the write
+ * @param length Length of the write
+ * @return true if the write can be encoded client-side
+ */
+bool ECSplitWrite::is_eligible(const pg_pool_t *pi, uint64_t offset, uint64_t length) {
+  if (!pi->is_erasure() || !pi->allows_ecoptimizations()) {
+    return false;
+  }
+
+  uint64_t stripe_width = pi->get_stripe_width();
+  if (stripe_width == 0 || length == 0) {
+    return false;
+  }
+
+  return offset % stripe_width == 0 && length % stripe_width == 0;
+}
+
+/**
+ * @brief Encode the parity shards for a stripe-aligned write.
+ *
+ * Erasure codes are applied independently at each offset within a chunk, so
+ * encoding the data shards of every stripe of the write in one call produces
+ * the same parity as the primary's encode of the same range. The plugin needs
+ * a contiguous, page-aligned buffer per shard, so the payload is copied into
+ * that layout.
+ *
+ * @return 0 on success or a negative errno
+ */
+int ECSplitWrite::encode_parity(const pg_pool_t *pi,
+                                const ceph::ErasureCodeInterfaceRef &ec_impl,
+                                const bufferlist &data, bufferlist *parity) {
+  unsigned k = pi->get_ec_data_shard_count();
+  unsigned k_plus_m = ec_impl->get_chunk_count();
+  if (ec_impl->get_data_chunk_count() != k || k_plus_m != pi->size) {
+    return -EINVAL;
+  }
+  uint64_t chunk_size = pi->get_stripe_width() / k;
+  uint64_t shard_length = data.length() / k;
+
+  shard_id_map<bufferptr> in(k_plus_m);
+  shard_id_map<bufferptr> out(k_plus_m);
+  for (raw_shard_id_t raw; raw < (int)k_plus_m; ++raw) {
+    auto &shard_map = raw < (int)k ? in : out;
+    shard_map.emplace(pi->get_shard(raw),
+                      buffer::create_page_aligned(shard_length));
+  }
+
+  auto p = data.cbegin();
+  for (uint64_t shard_off = 0; shard_off < shard_length; shard_off += chunk_size) {
+    for (raw_shard_id_t raw; raw < (int)k; ++raw) {
+      p.copy(chunk_size, in.at(pi->get_shard(raw)).c_str() + shard_off);
+    }
+  }
+
+  int r = ec_impl->encode_chunks(in, out);
+  if (r < 0) {
+    return r;
+  }
+
+  for (raw_shard_id_t raw(k); raw < (int)k_plus_m; ++raw) {
+    parity->append(out.at(pi->get_shard(raw)));
+  }
+  return 0;
+}
+
+/**
+ * @brief Plugin instance for an erasure code profile.
+ *
+ * Instances are cached by profile, rather than by profile name, so that a
+ * profile that is removed and recreated with different parameters is never
+ * served a stale instance. Profiles whose plugin cannot be loaded are cached
+ * too, so that the plugin is not looked for on every write.
+ */
+ceph::ErasureCodeInterfaceRef ECSplitWrite::get_ec_impl(
+  const ceph::ErasureCodeProfile &profile, CephContext *cct) {
+  static ceph::mutex lock = ceph::make_mutex("ECSplitWrite::get_ec_impl");
+  static std::map<ceph::ErasureCodeProfile, ceph::ErasureCodeInterfaceRef> cache;
+
+  std::lock_guard l{lock};
+  auto it = cache.find(profile);
+  if (it != cache.end()) {
+    return it->second;
+  }
+
+  ceph::ErasureCodeInterfaceRef ec_impl;
+  auto plugin = profile.find("plugin");
+  if (plugin != profile.end()) {
+    ceph::ErasureCodeProfile p = profile;
+    std::stringstream ss;
+    int r = ceph::ErasureCodePluginRegistry::instance().factory(
+      plugin->second,
+      cct->_conf.get_val<std::string>("erasure_code_dir"),
+      p, &ec_impl, &ss);
+    if (r < 0) {
+      ldout(cct, 0) << __func__ << " cannot load plugin " << plugin->second
+                    << ", not encoding writes: " << ss.str() << dendl;
+      ec_impl.reset();
+    }
+  }
+  cache.emplace(profile, ec_impl);
+  return ec_impl;
+}
+
+/**
+ * @brief Append client-encoded parity to an eligible write.
+ *
+ * An OSD that predates CEPH_OSD_OP_FLAG_EC_PARITY would reject the op, as the
+ * payload is longer than the extent, so this waits for require_osd_release.
+ */
+bool ECSplitWrite::prepare(Objecter::Op *op, Objecter &objecter, CephContext *cct) {
+  if (!cct->_conf->objecter_ec_client_parity || op->ops.size() != 1) {
+    return false;
+  }
+
+  OSDOp &osd_op = op->ops[0];
+  if ((osd_op.op.op != CEPH_OSD_OP_WRITE &&
+       osd_op.op.op != CEPH_OSD_OP_WRITEFULL) ||
+      (osd_op.op.flags & CEPH_OSD_OP_FLAG_EC_PARITY) ||
+      osd_op.op.extent.length != osd_op.indata.length()) {
+    return false;
+  }
+
+  if (objecter.osdmap->require_osd_release < ceph_release_t::umbrella) {
+    return false;
+  }
+
+  const pg_pool_t *pi = objecter.osdmap->get_pg_pool(op->target.base_oloc.pool);
+  // A cache tier would take the write in a pool with a different layout.
+  if (!pi || pi->has_write_tier() ||
+      !is_eligible(pi, osd_op.op.extent.offset, osd_op.op.extent.length)) {
+    return false;
+  }
+
+  auto ec_impl = get_ec_impl(
+    objecter.osdmap->get_erasure_code_profile(pi->erasure_code_profile), cct);
+  if (!ec_impl ||
+      (ec_impl->get_supported_optimizations() &
+       ceph::ErasureCodeInterface::FLAG_EC_PLUGIN_REQUIRE_SUB_CHUNKS)) {
+    return false;
+  }
+
+  bufferlist parity;
+  int r = encode_parity(pi, ec_impl, osd_op.indata, &parity);
+  if (r < 0) {
+    ldout(cct, DBG_LVL) << __func__ << " REJECT: encode failed r=" << r << dendl;
+    return false;
+  }
+
+  ldout(cct, DBG_LVL) << __func__ << " object_id=" << op->target.base_oid
+                      << " extent=" << osd_op.op.extent.offset << "~"
+                      << osd_op.op.extent.length << " parity="
+                      << parity.length() << dendl;
+  osd_op.indata.claim_append(parity);
+  osd_op.op.flags = osd_op.op.flags | CEPH_OSD_OP_FLAG_EC_PARITY;
+  return true;
+}
+
 #undef dout_prefix
 #define dout_prefix *_dout << " SplitOp::"
 
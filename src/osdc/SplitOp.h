@@ -33,6 +33,7 @@
 #include "common/mini_flat_map.h"
 #include "common/shunique_lock.h"
 
+#include "erasure-code/ErasureCodeInterface.h"
 #include "osd/ECTypes.h"
 #include "osd/osd_types.h"
 
@@ -59,10 +60,12 @@
  * - Automatic fallback: Falls back to normal operation if splitting is not beneficial
  * - Error handling: Properly handles partial failures and version mismatches
  *
- * Currently optimized for read operations, with potential for future write support.
+ * Currently optimized for read operations. Writes to erasure-coded pools are
+ * not split, but ECSplitWrite lets the client encode their parity.
  *
  * @see ECSplitOp for erasure-coded pool implementation
  * @see ReplicaSplitOp for replicated pool implementation
+ * @see ECSplitWrite for client-side parity of erasure-coded writes
  */
 class SplitOp {
 
@@ -573,3 +576,75 @@ class ReplicaSplitOp : public SplitOp {
   }
 };
 
+/**
+ * @class ECSplitWrite
+ * @brief Client-side parity for stripe-aligned writes to erasure-coded pools.
+ *
+ * The write-side counterpart of ECSplitOp. Sending the shards of a write
+ * straight to the shard OSDs would need the primary to order shard data it
+ * never saw, so the write still goes to the primary. Instead, the client
+ * encodes the parity shards with the pool's erasure code plugin and sends them
+ * after the data, flagged with CEPH_OSD_OP_FLAG_EC_PARITY. The primary then
+ * distributes the shards and orders the log as usual, but skips the encode.
+ *
+ * Only whole stripes can be encoded without reading back the existing data,
+ * so the write must start and end on a stripe boundary. Plugins that need
+ * sub-chunks are not supported.
+ *
+ * Usage:
+ * @code
+ * ECSplitWrite::prepare(op, objecter, cct);  // before the op is budgeted
+ * @endcode
+ */
+class ECSplitWrite {
+ public:
+  /**
+   * @brief Check whether a write can be encoded client-side.
+   *
+   * The pool must be an erasure-coded pool with EC optimizations enabled, and
+   * the write must be non-empty and cover only whole stripes.
+   *
+   * @param pi Pool information
+   * @param offset Logical object offset of the write
+   * @param length Length of the write
+   * @return true if the write can be encoded client-side
+   */
+  static bool is_eligible(const pg_pool_t *pi, uint64_t offset, uint64_t length);
+
+  /**
+   * @brief Encode the parity shards for a stripe-aligned write.
+   *
+   * Produces exactly what the primary would: the data is laid out as the data
+   * shards store it and encoded with a single call into the plugin. The parity
+   * shards are appended to @p parity in raw shard order, data.length() / k
+   * bytes each.
+   *
+   * @param pi Pool information containing stripe geometry
+   * @param ec_impl Erasure code plugin instance for the pool's profile
+   * @param data Write payload (a whole number of stripes)
+   * @param parity Buffer the parity shards are appended to
+   * @return 0 on success or a negative errno
+   */
+  static int encode_parity(const pg_pool_t *pi,
+                           const ceph::ErasureCodeInterfaceRef &ec_impl,
+                           const bufferlist &data, bufferlist *parity);
+
+  /**
+   * @brief Append client-encoded parity to an eligible write.
+   *
+   * Does nothing unless objecter_ec_client_parity is set, every OSD
+   * understands CEPH_OSD_OP_FLAG_EC_PARITY and the op is a single
+   * stripe-aligned write or writefull.
+   *
+   * @param op Operation about to be submitted
+   * @param objecter Objecter instance
+   * @param cct CephContext for configuration and logging
+   * @return true if parity was appended to the op
+   */
+  static bool prepare(Objecter::Op *op, Objecter &objecter, CephContext *cct);
+
+ private:
+  /// Plugin instance for @p profile, or null if it cannot be loaded.
+  static ceph::ErasureCodeInterfaceRef get_ec_impl(
+    const ceph::ErasureCodeProfile &profile, CephContext *cct);
+};
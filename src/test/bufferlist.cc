@@ -2629,6 +2629,45 @@ TEST(BufferList, crc32c_zeros) {
   }
 }
 
+TEST(BufferList, crc32c_set_crc32c) {
+  bufferptr a(4096);
+  memset(a.c_str(), 'A', a.length());
+  bufferptr b(a, 1024, 2048);
+  uint32_t crc = ceph_crc32c(-1, (unsigned char*)b.c_str(), b.length());
+
+  buffer::track_cached_crc(true);
+  int base_cached = buffer::get_cached_crc();
+  int base_missed = buffer::get_missed_crc();
+  b.set_crc32c(-1, crc);
+  {
+    bufferlist bl;
+    bl.push_back(b);
+    EXPECT_EQ(crc, bl.crc32c(-1));
+    EXPECT_EQ(1 + base_cached, buffer::get_cached_crc());
+    EXPECT_EQ(0 + base_missed, buffer::get_missed_crc());
+  }
+  {
+    // a different range of the same raw is not a hit
+    bufferlist bl;
+    bl.push_back(a);
+    EXPECT_EQ(ceph_crc32c(-1, (unsigned char*)a.c_str(), a.length()),
+              bl.crc32c(-1));
+    EXPECT_EQ(1 + base_missed, buffer::get_missed_crc());
+  }
+  {
+    // writing through c_str() and invalidating drops the recorded crc
+    b.set_crc32c(-1, crc);
+    memset(b.c_str(), 'B', b.length());
+    b.invalidate_crc();
+    bufferlist bl;
+    bl.push_back(b);
+    EXPECT_EQ(ceph_crc32c(-1, (unsigned char*)b.c_str(), b.length()),
+              bl.crc32c(-1));
+    EXPECT_EQ(2 + base_missed, buffer::get_missed_crc());
+  }
+  buffer::track_cached_crc(false);
+}
+
 TEST(BufferList, crc32c_append_perf) {
   int len = 256 * 1024 * 1024;
   bufferptr a(len);
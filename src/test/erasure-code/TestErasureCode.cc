@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "erasure-code/ErasureCode.h"
+#include "erasure-code/ErasureCodeDecodeCache.h"
 #include "global/global_context.h"
 #include "common/config.h"
 #include "gtest/gtest.h"
@@ -173,6 +174,78 @@ TEST(ErasureCodeTest, encode_misaligned_non_contiguous)
   }
 }
 
+TEST(ErasureCodeDecodeCache, lru)
+{
+  // room for exactly two tables of 8 ints with a 2 byte signature
+  size_t table_bytes = 2 + 8 * sizeof(int);
+  ErasureCodeDecodeCache cache("test", 2 * table_bytes);
+
+  ASSERT_EQ(nullptr, cache.get("t1"));
+  EXPECT_EQ(1u, cache.get_misses());
+
+  ErasureCodeDecodeCache::table_t t1(8, 1);
+  ErasureCodeDecodeCache::table_ref_t r1 = cache.put("t1", std::move(t1));
+  ASSERT_EQ(8u, r1->size());
+  ASSERT_EQ(r1, cache.get("t1"));
+  EXPECT_EQ(1u, cache.get_hits());
+
+  // a second put of the same signature keeps the first table
+  ASSERT_EQ(r1, cache.put("t1", ErasureCodeDecodeCache::table_t(8, 2)));
+
+  cache.put("t2", ErasureCodeDecodeCache::table_t(8, 2));
+  EXPECT_EQ(2u, cache.get_count());
+  EXPECT_EQ(2 * table_bytes, cache.get_bytes());
+
+  // t1 is more recently used than t2, so t2 is evicted to make room for t3
+  ASSERT_NE(nullptr, cache.get("t1"));
+  cache.put("t3", ErasureCodeDecodeCache::table_t(8, 3));
+  EXPECT_EQ(1u, cache.get_evictions());
+  EXPECT_EQ(2u, cache.get_count());
+  EXPECT_EQ(nullptr, cache.get("t2"));
+  EXPECT_NE(nullptr, cache.get("t1"));
+  EXPECT_EQ(3, (*cache.get("t3"))[0]);
+
+  // evicted tables stay valid for as long as they are referenced
+  EXPECT_EQ(1, (*r1)[0]);
+}
+
+TEST(ErasureCodeDecodeCache, set_context)
+{
+  size_t table_bytes = 2 + 8 * sizeof(int);
+  ErasureCodeDecodeCache cache("test_set_context", 2 * table_bytes);
+  cache.put("t1", ErasureCodeDecodeCache::table_t(8, 1));
+  cache.put("t2", ErasureCodeDecodeCache::table_t(8, 2));
+  ASSERT_EQ(2u, cache.get_count());
+
+  // the configured size replaces the one the cache was built with
+  g_ceph_context->_conf.set_val_or_die("erasure_code_decode_cache_size",
+                                       std::to_string(table_bytes));
+  cache.set_context(g_ceph_context);
+  EXPECT_TRUE(cache.enabled());
+  EXPECT_EQ(1u, cache.get_count());
+  EXPECT_EQ(nullptr, cache.get("t1"));
+  EXPECT_NE(nullptr, cache.get("t2"));
+  g_ceph_context->_conf.rm_val("erasure_code_decode_cache_size");
+}
+
+TEST(ErasureCodeDecodeCache, disabled)
+{
+  g_ceph_context->_conf.set_val_or_die("erasure_code_decode_cache_size", "0");
+  ErasureCodeDecodeCache cache("test_disabled");
+  cache.set_context(g_ceph_context);
+  g_ceph_context->_conf.rm_val("erasure_code_decode_cache_size");
+  EXPECT_FALSE(cache.enabled());
+
+  // tables are still returned to the caller, but never kept
+  ErasureCodeDecodeCache::table_ref_t r1 =
+    cache.put("t1", ErasureCodeDecodeCache::table_t(8, 1));
+  ASSERT_NE(nullptr, r1);
+  EXPECT_EQ(1, (*r1)[0]);
+  EXPECT_EQ(nullptr, cache.get("t1"));
+  EXPECT_EQ(0u, cache.get_count());
+  EXPECT_EQ(0u, cache.get_bytes());
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "crush/CrushWrapper.h"
+#include "include/crc32c.h"
 #include "include/stringify.h"
 #include "erasure-code/isa/ErasureCodeIsa.h"
 #include "global/global_context.h"
@@ -367,6 +368,129 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, encode_chunks_batch)
+{
+  ErasureCodeIsaDefault Isa(tcache, "reed_sol_van");
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  Isa.init(profile, &cerr);
+  const unsigned k = 4;
+  const unsigned chunk_count = 6;
+
+  // stripes of different lengths, most of them missing some data shards
+  const vector<pair<unsigned, vector<int>>> stripes = {
+    {4096, {0}}, {8192, {1, 2}}, {4096, {0, 1, 2, 3}}, {12288, {3}}, {4096, {}}};
+  ErasureCodeInterface::encode_batch_t batch;
+  vector<shard_id_map<bufferptr>> expected;
+  unsigned seed = 1;
+  for (auto &&[length, data_shards] : stripes) {
+    shard_id_map<bufferptr> in(chunk_count);
+    shard_id_map<bufferptr> out(chunk_count);
+    shard_id_map<bufferptr> expected_out(chunk_count);
+    for (int shard : data_shards) {
+      bufferptr ptr = buffer::create_aligned(length, ErasureCode::SIMD_ALIGN);
+      for (unsigned i = 0; i < length; i++) {
+        ptr.c_str()[i] = (char)rand_r(&seed);
+      }
+      in.emplace(shard_id_t(shard), ptr);
+    }
+    for (unsigned shard = k; shard < chunk_count; shard++) {
+      out.emplace(shard_id_t(shard),
+                  buffer::create_aligned(length, ErasureCode::SIMD_ALIGN));
+      expected_out.emplace(shard_id_t(shard),
+                           buffer::create_aligned(length, ErasureCode::SIMD_ALIGN));
+    }
+    EXPECT_EQ(0, Isa.encode_chunks(in, expected_out));
+    expected.push_back(std::move(expected_out));
+    batch.emplace_back(std::move(in), std::move(out));
+  }
+
+  // the batch must produce exactly the parity of one call per stripe
+  EXPECT_EQ(0, Isa.encode_chunks_batch(batch));
+  for (unsigned i = 0; i < batch.size(); i++) {
+    for (auto &&[shard, ptr] : expected[i]) {
+      const bufferptr &got = batch[i].second.at(shard);
+      ASSERT_EQ(ptr.length(), got.length());
+      EXPECT_EQ(0, memcmp(ptr.c_str(), got.c_str(), ptr.length()))
+        << "stripe " << i << " shard " << shard;
+    }
+  }
+}
+
+TEST_F(IsaErasureCodeTest, encode_chunks_with_crcs)
+{
+  ErasureCodeIsaDefault Isa(tcache, "reed_sol_van");
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  Isa.init(profile, &cerr);
+  const unsigned k = 4;
+  const unsigned chunk_count = 6;
+
+  // lengths below, at and above EC_ISA_CRC_BLOCK_SIZE, including some that
+  // are not a multiple of it, each missing some data shards
+  const vector<pair<unsigned, vector<int>>> stripes = {
+    {4096, {0, 1, 2, 3}}, {32768, {1, 3}}, {36864, {0, 2, 3}},
+    {69632, {2}}, {131072, {0, 1, 2, 3}}};
+  unsigned seed = 1;
+  for (auto &&[length, data_shards] : stripes) {
+    shard_id_map<bufferptr> in(chunk_count);
+    shard_id_map<bufferptr> out(chunk_count);
+    shard_id_map<bufferptr> expected_out(chunk_count);
+    for (int shard : data_shards) {
+      bufferptr ptr = buffer::create_aligned(length, ErasureCode::SIMD_ALIGN);
+      for (unsigned i = 0; i < length; i++) {
+        ptr.c_str()[i] = (char)rand_r(&seed);
+      }
+      in.emplace(shard_id_t(shard), ptr);
+    }
+    for (unsigned shard = k; shard < chunk_count; shard++) {
+      bufferptr ptr = buffer::create_aligned(length, ErasureCode::SIMD_ALIGN);
+      // a crc32c cached for the old contents must not survive the encode
+      ptr.zero();
+      ptr.set_crc32c(-1, ceph_crc32c(-1, (unsigned char*)ptr.c_str(), length));
+      out.emplace(shard_id_t(shard), ptr);
+      expected_out.emplace(shard_id_t(shard),
+                           buffer::create_aligned(length, ErasureCode::SIMD_ALIGN));
+    }
+    EXPECT_EQ(0, Isa.encode_chunks(in, expected_out));
+
+    // crc every shard, present or not, chaining some from a previous crc
+    shard_id_map<uint32_t> crcs(chunk_count);
+    for (unsigned shard = 0; shard < chunk_count; shard++) {
+      crcs.emplace(shard_id_t(shard), shard % 2 ? -1 : 0x1234 + shard);
+    }
+    EXPECT_EQ(0, Isa.encode_chunks_with_crcs(in, out, crcs));
+
+    for (auto &&[shard, ptr] : expected_out) {
+      const bufferptr &got = out.at(shard);
+      ASSERT_EQ(ptr.length(), got.length());
+      EXPECT_EQ(0, memcmp(ptr.c_str(), got.c_str(), ptr.length()))
+        << "length " << length << " shard " << shard;
+    }
+    for (unsigned i = 0; i < chunk_count; i++) {
+      shard_id_t shard(i);
+      uint32_t crc_seed = i % 2 ? -1 : 0x1234 + i;
+      const bufferptr *ptr = in.contains(shard) ? &in.at(shard) :
+                             out.contains(shard) ? &out.at(shard) : nullptr;
+      if (!ptr) {
+        // missing shards are not crc'd
+        EXPECT_EQ(crc_seed, crcs.at(shard)) << "shard " << shard;
+        continue;
+      }
+      EXPECT_EQ(ceph_crc32c(crc_seed, (unsigned char*)ptr->c_str(), length),
+                crcs.at(shard)) << "length " << length << " shard " << shard;
+    }
+    for (auto &&[shard, ptr] : out) {
+      bufferlist bl;
+      bl.push_back(ptr);
+      EXPECT_EQ(ceph_crc32c(-1, (unsigned char*)ptr.c_str(), length),
+                bl.crc32c(-1)) << "length " << length << " shard " << shard;
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache, "reed_sol_van");
@@ -279,6 +279,57 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+TEST(ErasureCodeTest, encode_chunks_batch)
+{
+  ErasureCodeJerasureReedSolomonVandermonde jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["w"] = "8";
+  jerasure.init(profile, &cerr);
+  const unsigned k = 4;
+  const unsigned chunk_count = 6;
+
+  // stripes of different lengths, most of them missing some data shards
+  const vector<pair<unsigned, vector<int>>> stripes = {
+    {4096, {0}}, {8192, {1, 2}}, {4096, {0, 1, 2, 3}}, {12288, {3}}, {4096, {}}};
+  ErasureCodeInterface::encode_batch_t batch;
+  vector<shard_id_map<bufferptr>> expected;
+  unsigned seed = 1;
+  for (auto &&[length, data_shards] : stripes) {
+    shard_id_map<bufferptr> in(chunk_count);
+    shard_id_map<bufferptr> out(chunk_count);
+    shard_id_map<bufferptr> expected_out(chunk_count);
+    for (int shard : data_shards) {
+      bufferptr ptr = buffer::create_aligned(length, ErasureCode::SIMD_ALIGN);
+      for (unsigned i = 0; i < length; i++) {
+        ptr.c_str()[i] = (char)rand_r(&seed);
+      }
+      in.emplace(shard_id_t(shard), ptr);
+    }
+    for (unsigned shard = k; shard < chunk_count; shard++) {
+      out.emplace(shard_id_t(shard),
+                  buffer::create_aligned(length, ErasureCode::SIMD_ALIGN));
+      expected_out.emplace(shard_id_t(shard),
+                           buffer::create_aligned(length, ErasureCode::SIMD_ALIGN));
+    }
+    EXPECT_EQ(0, jerasure.encode_chunks(in, expected_out));
+    expected.push_back(std::move(expected_out));
+    batch.emplace_back(std::move(in), std::move(out));
+  }
+
+  // the batch must produce exactly the parity of one call per stripe
+  EXPECT_EQ(0, jerasure.encode_chunks_batch(batch));
+  for (unsigned i = 0; i < batch.size(); i++) {
+    for (auto &&[shard, ptr] : expected[i]) {
+      const bufferptr &got = batch[i].second.at(shard);
+      ASSERT_EQ(ptr.length(), got.length());
+      EXPECT_EQ(0, memcmp(ptr.c_str(), got.c_str(), ptr.length()))
+        << "stripe " << i << " shard " << shard;
+    }
+  }
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
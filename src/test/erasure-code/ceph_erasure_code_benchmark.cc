@@ -31,6 +31,8 @@
 #include "common/ceph_context.h"
 #include "common/config.h"
 #include "common/Clock.h"
+#include "common/JSONFormatter.h"
+#include "common/perf_counters_collection.h"
 #include "include/utime.h"
 #include "erasure-code/ErasureCodePlugin.h"
 #include "erasure-code/ErasureCode.h"
@@ -71,6 +73,19 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("extents,x", po::value<int>()->default_value(0),
+     "when encoding, split the buffer into this many extents and encode them "
+     "with encode_chunks, as the OSD does for a multi-extent write")
+    ("batch,b", "with --extents, encode all the extents with a single "
+     "encode_chunks_batch call rather than one encode_chunks call each")
+    ("extent-shards", po::value<int>()->default_value(1),
+     "with --extents, the number of data shards each extent writes; as with "
+     "a small write, the other data shards are left to the plugin as zeros")
+    ("stripes", po::value<int>()->default_value(1),
+     "when decoding, split the buffer into this many stripes and decode each "
+     "of them separately, as the OSD does for degraded reads")
+    ("perf-dump", "dump the perf counters (such as those of the plugin "
+     "decode cache) when done")
     ;
 
   po::variables_map vm;
@@ -123,6 +138,11 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
   erasures = vm["erasures"].as<int>();
+  extents = vm["extents"].as<int>();
+  extent_shards = vm["extent-shards"].as<int>();
+  batch = vm.count("batch") > 0;
+  stripes = vm["stripes"].as<int>();
+  perf_dump = vm.count("perf-dump") > 0;
   if (vm.count("erasures-generation") > 0 &&
       vm["erasures-generation"].as<string>() == "exhaustive")
     exhaustive_erasures = true;
@@ -156,10 +176,33 @@ int ErasureCodeBench::run() {
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
   instance.disable_dlclose = true;
 
-  if (workload == "encode")
-    return encode();
+  // load the plugin with the context, which configures its decode cache
+  stringstream messages;
+  int r = instance.preload(plugin,
+			   g_conf().get_val<std::string>("erasure_code_dir"),
+			   &messages, g_ceph_context);
+  if (r) {
+    cerr << messages.str() << std::endl;
+    return r;
+  }
+
+  if (workload == "encode" && extents > 0)
+    r = encode_extents();
+  else if (workload == "encode")
+    r = encode();
+  else if (stripes > 1)
+    r = decode_stripes();
   else
-    return decode();
+    r = decode();
+
+  if (perf_dump) {
+    ceph::JSONFormatter f(true);
+    g_ceph_context->get_perfcounters_collection()->dump_formatted(
+      &f, false, select_labeled_t::unlabeled);
+    f.flush(cout);
+    cout << std::endl;
+  }
+  return r;
 }
 
 int ErasureCodeBench::encode()
@@ -194,6 +237,79 @@ int ErasureCodeBench::encode()
   return 0;
 }
 
+int ErasureCodeBench::encode_extents()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << std::endl;
+    return code;
+  }
+
+  unsigned chunk_count = erasure_code->get_chunk_count();
+  unsigned data_count = erasure_code->get_data_chunk_count();
+  uint64_t extent_size = in_size / extents / data_count;
+  extent_size -= extent_size % ErasureCode::SIMD_ALIGN;
+  if (extent_size == 0) {
+    cerr << "--size " << in_size << " is too small for " << extents
+	 << " extents" << std::endl;
+    return -EINVAL;
+  }
+
+  if (extent_shards < 1 || extent_shards > (int)data_count) {
+    cerr << "--extent-shards must be between 1 and " << data_count << std::endl;
+    return -EINVAL;
+  }
+
+  const vector<shard_id_t> &mapping = erasure_code->get_chunk_mapping();
+  ErasureCodeInterface::encode_batch_t stripes;
+  for (int e = 0; e < extents; e++) {
+    shard_id_map<bufferptr> in(chunk_count);
+    shard_id_map<bufferptr> out(chunk_count);
+    // successive extents land on successive data shards
+    unsigned first = (e * extent_shards) % data_count;
+    for (raw_shard_id_t raw; raw < chunk_count; ++raw) {
+      shard_id_t shard = mapping.empty() ?
+	shard_id_t(int(raw)) : mapping[int(raw)];
+      if (raw < data_count &&
+	  (int(raw) + data_count - first) % data_count >= (unsigned)extent_shards) {
+	continue;
+      }
+      bufferptr ptr = buffer::create_aligned(extent_size, ErasureCode::SIMD_ALIGN);
+      if (raw < data_count) {
+	memset(ptr.c_str(), 'X', extent_size);
+	in.emplace(shard, ptr);
+      } else {
+	out.emplace(shard, ptr);
+      }
+    }
+    stripes.emplace_back(std::move(in), std::move(out));
+  }
+
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    if (batch) {
+      code = erasure_code->encode_chunks_batch(stripes);
+      if (code)
+	return code;
+      continue;
+    }
+    for (auto &&[in, out] : stripes) {
+      code = erasure_code->encode_chunks(in, out);
+      if (code)
+	return code;
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  uint64_t encoded_size = extents * extent_size * extent_shards;
+  cout << (end_time - begin_time) << "\t" << (max_iterations * (encoded_size / 1024)) << std::endl;
+  return 0;
+}
+
 static void display_chunks(const shard_id_map<bufferlist> &chunks,
 			   unsigned int chunk_count) {
   cout << "chunks ";
@@ -325,6 +441,67 @@ int ErasureCodeBench::decode()
   return 0;
 }
 
+int ErasureCodeBench::decode_stripes()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << std::endl;
+    return code;
+  }
+
+  shard_id_set want_to_encode;
+  for (shard_id_t i; i < k + m; ++i) {
+    want_to_encode.insert(i);
+  }
+  shard_id_set want_to_read = want_to_encode;
+
+  int stripe_size = in_size / stripes;
+  vector<shard_id_map<bufferlist>> encoded;
+  for (int s = 0; s < stripes; s++) {
+    bufferlist in;
+    in.append(string(stripe_size, 'X'));
+    in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+    encoded.emplace_back(erasure_code->get_chunk_count());
+    code = erasure_code->encode(want_to_encode, in, &encoded.back());
+    if (code)
+      return code;
+    for (auto i : erased) {
+      encoded.back().erase(shard_id_t(i));
+    }
+  }
+  if (erased.size() > 0)
+    display_chunks(encoded.front(), erasure_code->get_chunk_count());
+
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    // The same chunks are lost from every stripe, as when an OSD is down.
+    set<int> lost;
+    if (erased.empty()) {
+      while ((int)lost.size() < erasures) {
+	lost.insert(rand() % (k + m));
+      }
+    }
+    for (auto &&stripe : encoded) {
+      shard_id_map<bufferlist> chunks = stripe;
+      for (int erasure : lost) {
+	chunks.erase(shard_id_t(erasure));
+      }
+      shard_id_map<bufferlist> decoded(erasure_code->get_chunk_count());
+      code = erasure_code->decode(want_to_read, chunks, &decoded, 0);
+      if (code)
+	return code;
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  cout << (end_time - begin_time) << "\t" << (max_iterations * (stripes * (stripe_size / 1024))) << std::endl;
+  return 0;
+}
+
 int main(int argc, char** argv) {
   ErasureCodeBench ecbench;
   try {
@@ -37,6 +37,11 @@ class ErasureCodeBench {
   int erasures;
   int k;
   int m;
+  int extents;
+  int extent_shards;
+  bool batch;
+  int stripes;
+  bool perf_dump;
 
   std::string plugin;
 
@@ -57,7 +62,9 @@ public:
 		      unsigned want_erasures,
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
+  int decode_stripes();
   int encode();
+  int encode_extents();
 };
 
 #endif
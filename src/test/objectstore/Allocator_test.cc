@@ -583,6 +583,121 @@ TEST_P(AllocTest, test_alloc_contiguous)
   alloc->shutdown();
 }
 
+TEST_P(AllocTest, test_alloc_append_hint)
+{
+  if (GetParam() != string("hybrid_btree2")) {
+    GTEST_SKIP() << "only hybrid_btree2 allocates at the hint";
+  }
+  int64_t block_size = 0x1000;
+  int64_t capacity = 0x200000;
+  init_alloc(capacity, block_size);
+
+  // a best fit hole at the start, and a large range holding the hint
+  alloc->init_add_free(0, 4 * block_size);
+  alloc->init_add_free(0x100000, 0x100000);
+
+  PExtentVector extents;
+  uint64_t need = 4 * block_size;
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0, 0x180000, &extents));
+  EXPECT_EQ(1u, extents.size());
+  EXPECT_EQ(0x180000u, extents[0].offset);
+  EXPECT_EQ(need, extents[0].length);
+
+  // continues past the end of the free range elsewhere
+  extents.clear();
+  need = 8 * block_size;
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0,
+    0x200000 - 4 * block_size, &extents));
+  EXPECT_EQ(2u, extents.size());
+  EXPECT_EQ(0x200000u - 4 * block_size, extents[0].offset);
+  EXPECT_EQ(4u * block_size, extents[0].length);
+
+  // an unaligned hint is ignored, best fit applies
+  extents.clear();
+  need = 4 * block_size;
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0, 0x100001, &extents));
+  EXPECT_EQ(1u, extents.size());
+  EXPECT_NE(0x100001u, extents[0].offset);
+
+  alloc->shutdown();
+}
+
+TEST_P(AllocTest, test_alloc_size_classes)
+{
+  if (GetParam() != string("hybrid_btree2")) {
+    GTEST_SKIP() << "only hybrid_btree2 has size classes";
+  }
+  g_ceph_context->_conf.set_val("bluestore_btree2_alloc_size_classes", "true");
+  int64_t block_size = 0x1000;
+  int64_t capacity = 0x2000000;
+  init_alloc(capacity, block_size);
+  g_ceph_context->_conf.rm_val("bluestore_btree2_alloc_size_classes");
+
+  alloc->init_add_free(0x1000000, 0x1000000);
+
+  PExtentVector extents;
+  uint64_t need = 0x100000;
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0, 0, &extents));
+  EXPECT_EQ(1u, extents.size());
+  EXPECT_EQ(0x1000000u, extents[0].offset);
+
+  // a best fit hole elsewhere does not break the run of the size class
+  alloc->init_add_free(0, 0x100000);
+  extents.clear();
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0, 0, &extents));
+  EXPECT_EQ(1u, extents.size());
+  EXPECT_EQ(0x1100000u, extents[0].offset);
+
+  // small allocations are carved from the top of the range they pick
+  extents.clear();
+  need = 0x10000;
+  EXPECT_EQ(need, alloc->allocate(need, block_size, 0, 0, &extents));
+  EXPECT_EQ(1u, extents.size());
+  EXPECT_EQ(0x100000u - need, extents[0].offset);
+
+  alloc->shutdown();
+}
+
+TEST_P(AllocTest, test_alloc_defrag_free_space)
+{
+  if (GetParam() != string("hybrid_btree2")) {
+    GTEST_SKIP() << "only hybrid_btree2 keeps free extents aside";
+  }
+  int64_t block_size = 0x1000;
+  int64_t capacity = 0x100000;
+  init_alloc(capacity, block_size);
+  alloc->init_add_free(0, 0x10000);
+
+  PExtentVector extents;
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(block_size, alloc->allocate(block_size, block_size, 0, 0,
+      &extents));
+  }
+  EXPECT_EQ(0u, alloc->get_free());
+  // released one at a time, so that they go to the cache
+  for (auto& e : extents) {
+    release_set_t release_set;
+    release_set.insert(e.offset, e.length);
+    alloc->release(release_set);
+  }
+  EXPECT_EQ(0x10000u, alloc->get_free());
+  size_t ranges = 0;
+  alloc->foreach([&](uint64_t, uint64_t) { ++ranges; });
+  EXPECT_LT(1u, ranges);
+
+  alloc->defrag_free_space();
+  EXPECT_EQ(0x10000u, alloc->get_free());
+  ranges = 0;
+  alloc->foreach([&](uint64_t offset, uint64_t length) {
+    EXPECT_EQ(0u, offset);
+    EXPECT_EQ(0x10000u, length);
+    ++ranges;
+  });
+  EXPECT_EQ(1u, ranges);
+
+  alloc->shutdown();
+}
+
 TEST_P(AllocTest, test_alloc_47883)
 {
   if (!(GetParam() == string("stupid") ||
@@ -0,0 +1,127 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Heap allocations made while building and submitting RocksDB
+ * transactions shaped like those of a small BlueStore write.
+ */
+#include <iostream>
+#include <new>
+#include <boost/scoped_ptr.hpp>
+#include <gtest/gtest.h>
+#include <fmt/format.h>
+
+#include "common/ceph_context.h"
+#include "global/global_context.h"
+#include "include/buffer.h"
+#include "kv/KeyValueDB.h"
+
+using namespace std;
+
+// operator new is replaced below so that the allocations made by the
+// current thread can be counted while a measurement is running
+static thread_local bool count_allocs = false;
+static thread_local uint64_t allocs = 0;
+
+void* operator new(size_t size)
+{
+  if (count_allocs) {
+    ++allocs;
+  }
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+class RocksDBTransactionBench : public ::testing::Test {
+public:
+  static constexpr const char* dir = "kv_bench_temp_dir";
+  static constexpr unsigned num_txns = 10000;
+  boost::scoped_ptr<KeyValueDB> db;
+  bufferlist onode, shard, omap, deferred;
+
+  void SetUp() override {
+    ASSERT_EQ(0, ::system(fmt::format("rm -rf {0} && mkdir {0}", dir).c_str()));
+    db.reset(KeyValueDB::create(g_ceph_context, "rocksdb", dir));
+    ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+    ASSERT_EQ(0, db->create_and_open(
+      cout, g_conf().get_val<std::string>("bluestore_rocksdb_cfs")));
+
+    onode.append(string(300, 'o'));
+    shard.append(string(200, 's'));
+    omap.append(string(100, 'v'));
+    // a deferred write carries the data as a separate buffer
+    deferred.append(string(64, 'l'));
+    deferred.append(buffer::create(4096));
+  }
+  void TearDown() override {
+    db.reset();
+    int r = ::system(fmt::format("rm -rf {}", dir).c_str());
+    ASSERT_EQ(0, r);
+  }
+
+  // onode, extent shard, omap and deferred keys of a small overwrite
+  void build(KeyValueDB::Transaction t, unsigned i) {
+    string okey = fmt::format("\x7f\x80\x01\x8f\x4f\x21!rbd_data.1234.{:016x}!='"
+                              "\xfe\xff\xff\xffo", i);
+    t->set("O", okey.c_str(), okey.size(), onode);
+    string skey = okey;
+    skey.append(fmt::format("{:08x}x", (i % 4) * 0x10000));
+    t->set("O", skey, shard);
+    t->set("p", fmt::format("{:016x}{:08x}{:016x}.snapset", 1, i, i), omap);
+    t->set("L", fmt::format("{:016x}", i), deferred);
+    if (i) {
+      t->rmkey("L", fmt::format("{:016x}", i - 1));
+    }
+  }
+
+  // average allocations per transaction: {build, submit}
+  std::pair<double, double> run() {
+    uint64_t build_allocs = 0, submit_allocs = 0;
+    for (unsigned i = 0; i < num_txns; i++) {
+      allocs = 0;
+      count_allocs = true;
+      KeyValueDB::Transaction t = db->get_transaction();
+      build(t, i);
+      count_allocs = false;
+      build_allocs += allocs;
+
+      allocs = 0;
+      count_allocs = true;
+      db->submit_transaction(t);
+      count_allocs = false;
+      submit_allocs += allocs;
+    }
+    return {(double)build_allocs / num_txns, (double)submit_allocs / num_txns};
+  }
+};
+
+TEST_F(RocksDBTransactionBench, allocations_per_write)
+{
+  g_conf().set_val_or_die("rocksdb_write_batch_reserve_max", "0");
+  g_conf().apply_changes(nullptr);
+  auto unreserved = run();
+  g_conf().rm_val("rocksdb_write_batch_reserve_max");
+  g_conf().apply_changes(nullptr);
+  auto reserved = run();
+
+  cout << "allocations per transaction (build / submit), "
+       << "write batch not reserved: "
+       << unreserved.first << " / " << unreserved.second << std::endl;
+  cout << "allocations per transaction (build / submit), "
+       << "write batch reserved: "
+       << reserved.first << " / " << reserved.second << std::endl;
+  ASSERT_LE(reserved.first, unreserved.first);
+}
@@ -1573,6 +1573,58 @@ TEST_P(StoreTest, CompressionTest) {
   doCompressionTest();
 }
 
+TEST_P(StoreTest, ReadvPastEnd) {
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    bufferlist bl;
+    bl.append(std::string(10000, 'a'));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    // intervals worked out before a truncate are trimmed to the object
+    ObjectStore::Transaction t;
+    t.truncate(cid, hoid, 5000);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+
+    interval_set<uint64_t> m;
+    m.insert(0, 100);
+    m.insert(4900, 1000);
+    m.insert(8000, 100);
+    bufferlist bl;
+    r = store->readv(ch, hoid, m, bl, 0);
+    ASSERT_EQ(200, r);
+    ASSERT_EQ(200u, bl.length());
+    interval_set<uint64_t> expected;
+    expected.insert(0, 100);
+    expected.insert(4900, 100);
+    ASSERT_EQ(expected, m);
+  }
+  {
+    interval_set<uint64_t> m;
+    m.insert(6000, 100);
+    bufferlist bl;
+    r = store->readv(ch, hoid, m, bl, 0);
+    ASSERT_EQ(0, r);
+    ASSERT_EQ(0u, bl.length());
+    ASSERT_TRUE(m.empty());
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, SimpleObjectTest) {
   int r;
   coll_t cid;
@@ -6125,6 +6177,158 @@ INSTANTIATE_TEST_SUITE_P(
   }))
 );
 
+TEST_P(StoreTestSpecificAUSize, KvSyncLanesOrdering) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // Keep txcs off the inline submit path, so that kv_sync_thread submits
+  // every one of them through the lanes
+  SetVal(g_conf(), "bluestore_sync_submit_transaction", "false");
+  SetVal(g_conf(), "bluestore_kv_sync_lanes", "1");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  const int num_colls = 8;
+  const int num_txcs = 200;
+  std::vector<coll_t> cids;
+  for (int c = 0; c < num_colls; ++c) {
+    cids.emplace_back(spg_t(pg_t(c, 7), shard_id_t::NO_SHARD));
+    auto ch = store->create_new_collection(cids.back());
+    ObjectStore::Transaction t;
+    t.create_collection(cids.back(), 0);
+    ASSERT_EQ(0, queue_transaction(store, ch, std::move(t)));
+  }
+  const ghobject_t meta(hobject_t(sobject_t("meta", CEPH_NOSNAP)));
+  auto object = [](int i) {
+    return ghobject_t(hobject_t(sobject_t(
+      "Object " + stringify(i % 16), CEPH_NOSNAP)));
+  };
+  auto data = [](unsigned lanes, int c, int i) {
+    bufferlist bl;
+    bl.append(std::string(4096, 'a' + (lanes + c + i) % 26));
+    return bl;
+  };
+
+  // Each collection is its own sequencer, and a sequencer's txcs are all
+  // submitted by the same lane. Interleave small writes across the
+  // collections, each also overwriting the same omap key of one object, so
+  // that the key ends up with the last value only if the lane submitted the
+  // sequencer's txcs in order.
+  auto run = [&](unsigned lanes) {
+    SetVal(g_conf(), "bluestore_kv_sync_lanes", stringify(lanes).c_str());
+    g_conf().apply_changes(nullptr);
+    ASSERT_EQ(0, store->umount());
+    ASSERT_EQ(0, store->mount());
+
+    std::vector<ObjectStore::CollectionHandle> chs;
+    std::set<uint32_t> lanes_used;
+    for (auto &cid : cids) {
+      chs.push_back(store->open_collection(cid));
+      auto c = static_cast<BlueStore::Collection*>(chs.back().get());
+      lanes_used.insert(c->osr->get_sequencer_id() % lanes);
+    }
+    ASSERT_EQ(std::min<size_t>(lanes, num_colls), lanes_used.size());
+
+    ceph::mutex lock = ceph::make_mutex("KvSyncLanesOrdering");
+    ceph::condition_variable cond;
+    std::vector<std::vector<int>> committed(num_colls);
+    int done = 0;
+    for (int i = 0; i < num_txcs; ++i) {
+      for (int c = 0; c < num_colls; ++c) {
+        ObjectStore::Transaction t;
+        bufferlist bl = data(lanes, c, i);
+        t.write(cids[c], object(i), (i / 16) * 4096, bl.length(), bl);
+        map<string, bufferlist> km;
+        km["last"].append(stringify(i));
+        t.touch(cids[c], meta);
+        t.omap_setkeys(cids[c], meta, km);
+        t.register_on_commit(make_lambda_context([&, c, i](int) {
+          std::lock_guard l{lock};
+          committed[c].push_back(i);
+          if (++done == num_colls * num_txcs) {
+            cond.notify_all();
+          }
+        }));
+        ASSERT_EQ(0, store->queue_transaction(chs[c], std::move(t)));
+      }
+    }
+    {
+      std::unique_lock l{lock};
+      cond.wait(l, [&] { return done == num_colls * num_txcs; });
+    }
+    for (int c = 0; c < num_colls; ++c) {
+      ASSERT_EQ((size_t)num_txcs, committed[c].size());
+      for (int i = 0; i < num_txcs; ++i) {
+        ASSERT_EQ(i, committed[c][i]) << "collection " << c;
+      }
+    }
+
+    // Read everything back from the db rather than the caches
+    chs.clear();
+    ASSERT_EQ(0, store->umount());
+    ASSERT_EQ(0, store->mount());
+    for (int c = 0; c < num_colls; ++c) {
+      auto ch = store->open_collection(cids[c]);
+      for (int i = 0; i < num_txcs; ++i) {
+        bufferlist expected = data(lanes, c, i);
+        bufferlist bl;
+        ASSERT_EQ(4096, store->read(ch, object(i), (i / 16) * 4096, 4096, bl));
+        ASSERT_TRUE(bl_eq(expected, bl))
+          << "collection " << c << " txc " << i;
+      }
+      map<string, bufferlist> km;
+      ASSERT_EQ(0, store->omap_get_values(ch, meta, {"last"}, &km));
+      ASSERT_EQ(1u, km.size());
+      ASSERT_EQ(stringify(num_txcs - 1), km["last"].to_str())
+        << "collection " << c;
+    }
+  };
+  run(1);
+  run(4);
+  run(8);
+}
+
+class SyntheticMatrixKvSyncLanes: public MatrixTest {};
+TEST_P(SyntheticMatrixKvSyncLanes, Test)
+{
+  SyntheticTest();
+};
+
+INSTANTIATE_TEST_SUITE_P(
+  BlueStore,
+  SyntheticMatrixKvSyncLanes,
+  ::testing::ValuesIn(MatrixTest::Expand({
+    { "bluestore_min_alloc_size", "4096" },
+    { "max_write", "65536" },
+    { "max_size", "1048576" },
+    { "alignment", "4096" },
+    { "bluestore_kv_sync_lanes", "4" },
+    { "bluestore_prefer_deferred_size", "0", "65536" },
+    { "bluestore_sync_submit_transaction", "true", "false" }
+  }))
+);
+
+class SyntheticMatrixCompactOnodes: public MatrixTest {};
+TEST_P(SyntheticMatrixCompactOnodes, Test)
+{
+  SyntheticTest();
+};
+
+INSTANTIATE_TEST_SUITE_P(
+  BlueStore,
+  SyntheticMatrixCompactOnodes,
+  ::testing::ValuesIn(MatrixTest::Expand({
+    { "bluestore_min_alloc_size", "4096" },
+    { "max_write", "65536" },
+    { "max_size", "1048576" },
+    { "alignment", "4096" },
+    { "bluestore_cache_autotune", "false" },
+    { "bluestore_cache_size", "4194304" },
+    { "bluestore_onode_cache_compact_ratio", "0.5" },
+    { "bluestore_onode_segment_size", "0", "65536" }
+  }))
+);
+
 class SyntheticMatrixPreferDeferred: public MatrixTest {};
 TEST_P(SyntheticMatrixPreferDeferred, Test)
 {
@@ -8242,6 +8446,511 @@ TEST_P(StoreTestSpecificAUSize, OnodeSizeTracking) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, CompactOnodeTier) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_cache_autotune", "false");
+  SetVal(g_conf(), "bluestore_cache_size", "4194304");
+  SetVal(g_conf(), "bluestore_onode_cache_compact_ratio", "0.5");
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid;
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // far more objects than the decoded onode cache holds
+  const unsigned num_objects = 4000;
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t("compact_" + stringify(i), "", CEPH_NOSNAP,
+                                0, -1, ""));
+  };
+  {
+    bufferlist bl, attr;
+    bl.append(std::string(4096, 'a'));
+    attr.append(std::string(64, 'b'));
+    for (unsigned i = 0; i < num_objects; ++i) {
+      ObjectStore::Transaction t;
+      t.write(cid, make_oid(i), 0, bl.length(), bl);
+      t.setattr(cid, make_oid(i), "attr", attr);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  // wait for the mempool thread to encode the trimmed onodes
+  for (unsigned i = 0;
+       i < 600 && logger->get(l_bluestore_onodes_compact) == 0;
+       ++i) {
+    usleep(100000);
+  }
+
+  uint64_t compact_onodes = logger->get(l_bluestore_onodes_compact);
+  uint64_t compact_bytes = logger->get(l_bluestore_onode_compact_bytes);
+  uint64_t onodes = logger->get(l_bluestore_onodes);
+  ASSERT_GT(compact_onodes, 0u);
+  ASSERT_GT(onodes, 0u);
+  // The compact map lives in the meta pool, so leave that pool out: the
+  // decoded onodes then come out smaller than they are, never larger.
+  uint64_t decoded_bytes =
+    mempool::bluestore_cache_onode::allocated_bytes() +
+    mempool::bluestore_extent::allocated_bytes() +
+    mempool::bluestore_blob::allocated_bytes() +
+    mempool::bluestore_shared_blob::allocated_bytes() +
+    mempool::bluestore_cache_other::allocated_bytes();
+  // an encoded onode, with its key and bookkeeping, takes at most a third
+  // of the memory of the decoded one
+  ASSERT_LE(compact_bytes * 3 * onodes, decoded_bytes * compact_onodes);
+
+  // the most recently trimmed onodes come back from the compact tier
+  uint64_t hits = logger->get(l_bluestore_onode_compact_hits);
+  for (unsigned i = num_objects; i-- > 0; ) {
+    struct stat st;
+    ASSERT_EQ(0, store->stat(ch, make_oid(i), &st));
+    ASSERT_EQ(4096, st.st_size);
+    bufferptr bp;
+    ASSERT_EQ(0, store->getattr(ch, make_oid(i), "attr", bp));
+    ASSERT_EQ(64u, bp.length());
+  }
+  ASSERT_GT(logger->get(l_bluestore_onode_compact_hits), hits);
+}
+
+TEST_P(StoreTestSpecificAUSize, DefragRewritesFragmentedObjects) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  SetVal(g_conf(), "bluestore_alloc_append_hint", "false");
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", "0");
+  SetVal(g_conf(), "bluestore_defrag_max_bytes_per_sec", "0");
+  StartDeferred(block_size);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid1(hobject_t("defrag1", "", CEPH_NOSNAP, 0, -1, ""));
+  ghobject_t hoid2(hobject_t("defrag2", "", CEPH_NOSNAP, 0, -1, ""));
+
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // append to both objects in turns so that their extents interleave
+  bufferlist expected;
+  const unsigned num_blocks = 32;
+  for (unsigned i = 0; i < num_blocks; ++i) {
+    bufferlist bl;
+    bl.append(std::string(block_size, 'a' + i % 26));
+    expected.append(bl);
+    for (auto& hoid : { hoid1, hoid2 }) {
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, i * block_size, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_NE(nullptr, bstore);
+  std::stringstream ss;
+  ASSERT_EQ(0, bstore->defrag_start("", ss));
+  for (int i = 0; i < 100 && logger->get(l_bluestore_defrag_scanned) < 2; ++i) {
+    usleep(100000);
+  }
+  ASSERT_EQ(2u, logger->get(l_bluestore_defrag_scanned));
+  ASSERT_EQ(2u, logger->get(l_bluestore_defrag_rewritten));
+  ASSERT_EQ(2u * num_blocks * block_size, logger->get(l_bluestore_defrag_bytes));
+
+  for (auto& hoid : { hoid1, hoid2 }) {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, num_blocks * block_size, bl);
+    ASSERT_EQ((int)(num_blocks * block_size), r);
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  ch.reset();
+  store->umount();
+  ASSERT_EQ(0, store->fsck(false));
+  store->mount();
+  ch = store->open_collection(cid);
+  for (auto& hoid : { hoid1, hoid2 }) {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, num_blocks * block_size, bl);
+    ASSERT_EQ((int)(num_blocks * block_size), r);
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid1);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, DeferredMergeAcrossCollections) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t alloc_size = 65536;
+  size_t block_size = 4096;
+  SetVal(g_conf(), "bluestore_deferred_merge_sequencers", "true");
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", stringify(alloc_size).c_str());
+  // keep deferred writes pending until umount drains all sequencers at once
+  SetVal(g_conf(), "bluestore_max_defer_interval", "0");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "1000");
+  StartDeferred(alloc_size);
+
+  int r;
+  const unsigned num_colls = 4;
+  const unsigned num_blocks = 4;
+  ghobject_t hoid(hobject_t("deferred", "", CEPH_NOSNAP, 0, -1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+
+  vector<coll_t> cids;
+  vector<ObjectStore::CollectionHandle> chs;
+  for (unsigned c = 0; c < num_colls; ++c) {
+    cids.emplace_back(spg_t(pg_t(c, 0), shard_id_t::NO_SHARD));
+    chs.push_back(store->create_new_collection(cids.back()));
+    ObjectStore::Transaction t;
+    t.create_collection(cids.back(), 0);
+    t.touch(cids.back(), hoid);
+    r = queue_transaction(store, chs.back(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // small overwrites of the same object in every collection, with the
+  // last one in each collection rewriting the first block
+  auto expected_data = [&](unsigned c, unsigned i) {
+    return std::string(block_size, 'a' + (c * num_blocks + i) % 26);
+  };
+  for (unsigned i = 0; i <= num_blocks; ++i) {
+    for (unsigned c = 0; c < num_colls; ++c) {
+      ObjectStore::Transaction t;
+      bufferlist bl;
+      bl.append(expected_data(c, i));
+      t.write(cids[c], hoid, (i % num_blocks) * block_size, bl.length(), bl);
+      r = queue_transaction(store, chs[c], std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  ASSERT_EQ(0u, logger->get(l_bluestore_submitted_deferred_writes));
+
+  chs.clear();
+  store->umount();
+  ASSERT_EQ(num_colls, logger->get(l_bluestore_deferred_merged_batches));
+  ASSERT_EQ(0, store->fsck(false));
+  store->mount();
+
+  for (unsigned c = 0; c < num_colls; ++c) {
+    auto ch = store->open_collection(cids[c]);
+    bufferlist expected, bl;
+    expected.append(expected_data(c, num_blocks));
+    for (unsigned i = 1; i < num_blocks; ++i) {
+      expected.append(expected_data(c, i));
+    }
+    r = store->read(ch, hoid, 0, num_blocks * block_size, bl);
+    ASSERT_EQ((int)(num_blocks * block_size), r);
+    ASSERT_TRUE(bl_eq(expected, bl));
+
+    ObjectStore::Transaction t;
+    t.remove(cids[c], hoid);
+    t.remove_collection(cids[c]);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, CompressionSkipsIncompressible) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  size_t obj_size = 0x20000;
+  SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_compression_predict", "true");
+  StartDeferred(block_size);
+
+  int r;
+  coll_t cid;
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto attempted = logger->get(l_bluestore_compress_attempted_count);
+  auto skipped = logger->get(l_bluestore_compress_skipped_count);
+  auto success = logger->get(l_bluestore_compress_success_count);
+
+  // random data is skipped without a compression attempt
+  const unsigned num_objects = 8;
+  vector<bufferlist> datas(num_objects);
+  for (unsigned i = 0; i < num_objects; ++i) {
+    std::string s(obj_size, 0);
+    for (auto& c : s) {
+      c = rand();
+    }
+    datas[i].append(s);
+    ghobject_t hoid(hobject_t(fmt::format("random{}", i), "", CEPH_NOSNAP, 0, -1, ""));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, datas[i].length(), datas[i]);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(attempted, logger->get(l_bluestore_compress_attempted_count));
+  ASSERT_EQ(success, logger->get(l_bluestore_compress_success_count));
+  ASSERT_LE(skipped + num_objects, logger->get(l_bluestore_compress_skipped_count));
+
+  // runs have a flat byte histogram, but are still compressed
+  {
+    std::string s(obj_size, 0);
+    for (size_t i = 0; i < s.size(); ++i) {
+      s[i] = i / 256;
+    }
+    bufferlist bl;
+    bl.append(s);
+    ghobject_t hoid(hobject_t("runs", "", CEPH_NOSNAP, 0, -1, ""));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_LT(attempted, logger->get(l_bluestore_compress_attempted_count));
+  ASSERT_LT(success, logger->get(l_bluestore_compress_success_count));
+
+  // a random block written over and over has a flat histogram too, but
+  // LZ matching compresses it
+  bufferlist repeats;
+  {
+    std::string block(3000, 0);
+    for (auto& c : block) {
+      c = rand();
+    }
+    std::string s;
+    while (s.size() < obj_size) {
+      s += block;
+    }
+    s.resize(obj_size);
+    repeats.append(s);
+    attempted = logger->get(l_bluestore_compress_attempted_count);
+    success = logger->get(l_bluestore_compress_success_count);
+    ghobject_t hoid(hobject_t("repeats", "", CEPH_NOSNAP, 0, -1, ""));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, repeats.length(), repeats);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_LT(attempted, logger->get(l_bluestore_compress_attempted_count));
+  ASSERT_LT(success, logger->get(l_bluestore_compress_success_count));
+  {
+    ghobject_t hoid(hobject_t("repeats", "", CEPH_NOSNAP, 0, -1, ""));
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, obj_size, bl);
+    ASSERT_EQ((int)obj_size, r);
+    ASSERT_TRUE(bl_eq(repeats, bl));
+  }
+
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ghobject_t hoid(hobject_t(fmt::format("random{}", i), "", CEPH_NOSNAP, 0, -1, ""));
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, obj_size, bl);
+    ASSERT_EQ((int)obj_size, r);
+    ASSERT_TRUE(bl_eq(datas[i], bl));
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, CompressionDictionary) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  size_t obj_size = 16384;
+  SetVal(g_conf(), "bluestore_compression_algorithm", "zstd");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_compression_min_blob_size", stringify(obj_size).c_str());
+  SetVal(g_conf(), "bluestore_compression_dict", "true");
+  SetVal(g_conf(), "bluestore_compression_dict_size", "16384");
+  SetVal(g_conf(), "bluestore_compression_dict_sample_bytes",
+	 stringify(64 * obj_size).c_str());
+  StartDeferred(block_size);
+
+  int r;
+  coll_t cid(spg_t(pg_t(0, 5), shard_id_t::NO_SHARD));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // small, similar but not identical records
+  auto make_data = [&](unsigned i) {
+    bufferlist bl;
+    for (unsigned j = 0; bl.length() < obj_size; ++j) {
+      bl.append(fmt::format(
+	"{{\"object\": {}, \"line\": {}, \"status\": \"{}\", \"owner\": \"user{}\"}}\n",
+	i, j, (i + j) % 3 ? "active" : "idle", (i * 7 + j) % 13));
+    }
+    bufferlist res;
+    res.substr_of(bl, 0, obj_size);
+    return res;
+  };
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t(fmt::format("dict{}", i), "", CEPH_NOSNAP,
+				0, 5, ""));
+  };
+  auto write_objects = [&](unsigned from, unsigned to) {
+    for (unsigned i = from; i < to; ++i) {
+      ObjectStore::Transaction t;
+      bufferlist bl = make_data(i);
+      t.write(cid, make_oid(i), 0, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  };
+  auto remove_objects = [&](unsigned from, unsigned to) {
+    ObjectStore::Transaction t;
+    for (unsigned i = from; i < to; ++i) {
+      t.remove(cid, make_oid(i));
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  };
+  auto verify_objects = [&](unsigned from, unsigned to) {
+    for (unsigned i = from; i < to; ++i) {
+      bufferlist bl, expected = make_data(i);
+      r = store->read(ch, make_oid(i), 0, obj_size, bl);
+      ASSERT_EQ((int)obj_size, r);
+      ASSERT_TRUE(bl_eq(expected, bl));
+    }
+  };
+  auto wait_trained = [&](uint64_t n) {
+    for (int i = 0; i < 100 && logger->get(l_bluestore_compress_dict_trained) < n; ++i) {
+      usleep(100000);
+    }
+    ASSERT_EQ(n, logger->get(l_bluestore_compress_dict_trained));
+  };
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  // to be inline with BlueStore.cc
+  const string PREFIX_COMPRESSION_DICT = "D";
+  auto count_dicts = [&]() {
+    size_t cnt = 0;
+    auto it = bstore->get_kv()->get_iterator(PREFIX_COMPRESSION_DICT);
+    for (it->lower_bound(string()); it->valid(); it->next()) {
+      ++cnt;
+    }
+    return cnt;
+  };
+
+  const unsigned num_samples = 64, num_objects = 96;
+  write_objects(0, num_samples);
+  wait_trained(1);
+  ASSERT_EQ(0u, logger->get(l_bluestore_compress_dict_count));
+  ASSERT_EQ(1u, count_dicts());
+  {
+    // older versions can not read blobs that refer to a dictionary
+    bufferlist bl;
+    int32_t compat;
+    ASSERT_EQ(0, bstore->get_kv()->get("S", "min_compat_ondisk_format", &bl));
+    auto p = bl.cbegin();
+    decode(compat, p);
+    ASSERT_EQ(bstore->compression_dict_compat_ondisk_format, compat);
+  }
+
+  write_objects(num_samples, num_objects);
+  ASSERT_EQ(num_objects - num_samples,
+	    logger->get(l_bluestore_compress_dict_count));
+  verify_objects(0, num_objects);
+
+  // dictionaries are reloaded from the DB on mount
+  ch.reset();
+  store->umount();
+  ASSERT_EQ(0, store->fsck(true));
+  store->mount();
+  ch = store->open_collection(cid);
+  verify_objects(0, num_objects);
+
+  // retrain once the dictionary ages, then drop everything written with
+  // the first one
+  SetVal(g_conf(), "bluestore_compression_dict_max_age", "1");
+  g_conf().apply_changes(nullptr);
+  sleep(2);
+  write_objects(num_objects, num_objects + num_samples);
+  wait_trained(2);
+  SetVal(g_conf(), "bluestore_compression_dict_max_age", "0");
+  g_conf().apply_changes(nullptr);
+  const unsigned first = num_objects + num_samples, last = first + 32;
+  write_objects(first, last);
+  ASSERT_EQ(2u, count_dicts());
+  remove_objects(0, first);
+
+  // the superseded dictionary is only a warning, which repair removes
+  ch.reset();
+  store->umount();
+  ASSERT_EQ(0, store->fsck(false));
+  ASSERT_EQ(0, store->repair(false));
+  store->mount();
+  ch = store->open_collection(cid);
+  ASSERT_EQ(1u, count_dicts());
+  verify_objects(first, last);
+
+  // a blob whose dictionary is gone is an error
+  string key;
+  bufferlist dict;
+  {
+    auto it = bstore->get_kv()->get_iterator(PREFIX_COMPRESSION_DICT);
+    it->lower_bound(string());
+    ASSERT_TRUE(it->valid());
+    key = it->key();
+    dict = it->value();
+    auto t = bstore->get_kv()->get_transaction();
+    t->rmkey(PREFIX_COMPRESSION_DICT, key);
+    bstore->get_kv()->submit_transaction_sync(t);
+  }
+  ch.reset();
+  store->umount();
+  ASSERT_GT(store->fsck(false), 0);
+  store->mount();
+  {
+    auto t = bstore->get_kv()->get_transaction();
+    t->set(PREFIX_COMPRESSION_DICT, key, dict);
+    bstore->get_kv()->submit_transaction_sync(t);
+  }
+  store->umount();
+  store->mount();
+  ch = store->open_collection(cid);
+  verify_objects(first, last);
+
+  // dictionaries go away with their pool
+  remove_objects(first, last);
+  {
+    ObjectStore::Transaction t;
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(0u, count_dicts());
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwrite) {
 
   if (string(GetParam()) != "bluestore")
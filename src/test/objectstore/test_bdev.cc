@@ -13,6 +13,9 @@
 #include "common/errno.h"
 
 #include "blk/BlockDevice.h"
+#include "blk/kernel/KernelDevice.h"
+#include "common/ceph_mutex.h"
+#include "common/perf_counters_collection.h"
 
 using namespace std;
 
@@ -91,6 +94,257 @@ TEST(KernelDevice, Ticket45337) {
   b->close();
 }
 
+TEST(KernelDevice, RegisteredBuffersFallback) {
+  // Reads return the right data whether or not they land in the io_uring
+  // registered buffer pool. Without bdev_ioring nothing is registered; with
+  // it, the first reads take all the slots, one of them two slots, and the
+  // reads made while the slots are taken fall back to ordinary buffers.
+  // The data is written with a flush linked behind it where the ring
+  // supports that.
+  const uint64_t size = 1048576ull * 64;
+  bufferlist data;
+  for (auto i = 0; i < 64; i++) {
+    data.append(string(65536, 'a' + (i % 26)));
+  }
+  const std::vector<std::pair<uint64_t, uint64_t>> reads = {
+    {0, 4096}, {1048576, 131072}, {4096, 65536}, {131072, 65536},
+    {262144, 65536}, {393216, 65536}, {524288, 65536}, {655360, 65536},
+    {786432, 49152}, {1310720, 36864}
+  };
+
+  for (auto ioring : {"false", "true"}) {
+    g_ceph_context->_conf.set_val("bdev_ioring", ioring);
+    g_ceph_context->_conf.set_val("bdev_ioring_registered_buffers", "4");
+    g_ceph_context->_conf.set_val("bdev_ioring_registered_buffer_size", "65536");
+    g_ceph_context->_conf.apply_changes(nullptr);
+
+    TempBdev bdev{ size };
+    std::unique_ptr<BlockDevice> b(
+      BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+        [](void* handle, void* aio) {}, NULL));
+    int r = b->open(bdev.path);
+    if (r < 0) {
+      std::cerr << "open " << bdev.path << " failed" << std::endl;
+      break;
+    }
+
+    {
+      IOContext ioc(g_ceph_context, NULL);
+      ASSERT_EQ(0, b->aio_write(0, data, &ioc, false));
+      r = b->aio_flush(&ioc);
+      if (string(ioring) == "false") {
+        ASSERT_EQ(-EOPNOTSUPP, r);
+      } else {
+        ASSERT_TRUE(r == 0 || r == -EOPNOTSUPP);
+      }
+      if (ioc.has_pending_aios()) {
+        b->aio_submit(&ioc);
+        ioc.aio_wait();
+      }
+      ASSERT_EQ(0, ioc.get_return_value());
+      if (r < 0) {
+        ASSERT_EQ(0, b->flush());
+      }
+    }
+
+    // more 64K reads in flight at once than there are registered slots
+    std::vector<bufferlist> out(reads.size());
+    IOContext ioc(g_ceph_context, NULL);
+    for (size_t i = 0; i < reads.size(); i++) {
+      ASSERT_EQ(0, b->aio_read(reads[i].first, reads[i].second, &out[i], &ioc));
+    }
+    if (ioc.has_pending_aios()) {
+      b->aio_submit(&ioc);
+      ioc.aio_wait();
+    }
+    ASSERT_EQ(0, ioc.get_return_value());
+    for (size_t i = 0; i < reads.size(); i++) {
+      bufferlist expected;
+      expected.substr_of(data, reads[i].first, reads[i].second);
+      ASSERT_TRUE(expected.contents_equal(out[i]))
+        << "bdev_ioring=" << ioring << " read " << i;
+    }
+    out.clear();
+    b->close();
+  }
+
+  g_ceph_context->_conf.rm_val("bdev_ioring");
+  g_ceph_context->_conf.rm_val("bdev_ioring_registered_buffers");
+  g_ceph_context->_conf.rm_val("bdev_ioring_registered_buffer_size");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+// A file backed KernelDevice that claims to support discard, so that the
+// async discard threads run. The discards themselves fail on a plain file
+// and are ignored; the discard callback still sees every extent released.
+class DiscardTestDevice : public KernelDevice {
+public:
+  struct Released {
+    ceph::mutex lock = ceph::make_mutex("DiscardTestDevice::Released");
+    ceph::condition_variable cond;
+    std::vector<interval_set<uint64_t>> passes;
+    interval_set<uint64_t> all;
+  };
+
+  explicit DiscardTestDevice(Released *released)
+    : KernelDevice(g_ceph_context, nullptr, nullptr,
+        [](void* priv, void* p) {
+          auto r = static_cast<Released*>(priv);
+          auto extents = static_cast<interval_set<uint64_t>*>(p);
+          std::lock_guard l{r->lock};
+          r->passes.push_back(*extents);
+          r->all.union_of(*extents);
+          r->cond.notify_all();
+        }, released, "discard_test") {}
+
+  int open(const std::string& path) override {
+    int r = KernelDevice::open(path);
+    if (r == 0) {
+      support_discard = true;
+      g_ceph_context->_conf.set_val("bdev_enable_discard", "true");
+      g_ceph_context->_conf.set_val("bdev_async_discard_threads", "1");
+      g_ceph_context->_conf.apply_changes(nullptr);
+    }
+    return r;
+  }
+
+  static bool wait_for(Released &r, uint64_t off, uint64_t len) {
+    std::unique_lock l{r.lock};
+    return r.cond.wait_for(l, std::chrono::seconds(60),
+                           [&] { return r.all.contains(off, len); });
+  }
+
+  static uint64_t get_counter(const std::string &name) {
+    uint64_t value = 0;
+    g_ceph_context->get_perfcounters_collection()->with_counters(
+      [&](const auto &counter_map) {
+        auto it = counter_map.find("blk-kernel-device-discard_test." + name);
+        ceph_assert(it != counter_map.end());
+        value = it->second.data->u64.load();
+      });
+    return value;
+  }
+
+  // The discard thread sets the counters as it goes, and nothing else
+  // tells when it has got to a point, so poll them
+  static bool wait_for_counter(const std::string &name,
+                               std::function<bool(uint64_t)> done) {
+    auto until = ceph::mono_clock::now() + std::chrono::seconds(60);
+    while (!done(get_counter(name))) {
+      if (ceph::mono_clock::now() > until) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+  }
+};
+
+class KernelDeviceDiscard : public ::testing::Test {
+public:
+  static constexpr uint64_t size = 1048576ull * 64;
+  TempBdev bdev{ size };
+  DiscardTestDevice::Released released;
+  std::unique_ptr<DiscardTestDevice> b;
+
+  void SetUp() override {
+    b = std::make_unique<DiscardTestDevice>(&released);
+    if (b->open(bdev.path) < 0) {
+      b.reset();
+      GTEST_SKIP() << "open " << bdev.path << " failed";
+    }
+  }
+  void TearDown() override {
+    if (b) {
+      b->close();
+      b.reset();
+    }
+    for (auto opt : {"bdev_enable_discard", "bdev_async_discard_threads",
+                     "bdev_async_discard_coalesce_ms",
+                     "bdev_async_discard_max_bytes_per_sec",
+                     "bdev_async_discard_min_size",
+                     "bdev_async_discard_hold_ms"}) {
+      g_ceph_context->_conf.rm_val(opt);
+    }
+    g_ceph_context->_conf.apply_changes(nullptr);
+  }
+  void set(const char *opt, const char *val) {
+    g_ceph_context->_conf.set_val(opt, val);
+    g_ceph_context->_conf.apply_changes(nullptr);
+  }
+  void queue(uint64_t off, uint64_t len) {
+    interval_set<uint64_t> to_release;
+    to_release.insert(off, len);
+    BlockDevice *bdev = b.get();
+    ASSERT_TRUE(bdev->try_discard(to_release, true));
+  }
+};
+
+TEST_F(KernelDeviceDiscard, SmallExtentsCoalesce) {
+  set("bdev_async_discard_min_size", "65536");
+  set("bdev_async_discard_hold_ms", "600000");
+
+  // Too small to discard, so both are held back rather than released.
+  queue(0, 4096);
+  queue(1048576, 4096);
+  ASSERT_TRUE(DiscardTestDevice::wait_for_counter(
+    "discard_held_bytes", [](uint64_t held) { return held == 8192; }));
+  {
+    std::lock_guard l{released.lock};
+    ASSERT_TRUE(released.all.empty());
+  }
+
+  // A release next to the first one returns it to the queue, and the two
+  // go out as a single extent. The second is still held.
+  queue(4096, 61440);
+  ASSERT_TRUE(DiscardTestDevice::wait_for(released, 0, 65536));
+  {
+    std::lock_guard l{released.lock};
+    ASSERT_EQ(1u, released.passes.size());
+    ASSERT_EQ(1u, released.passes[0].num_intervals());
+    ASSERT_EQ(65536u, released.passes[0].size());
+    ASSERT_FALSE(released.all.intersects(1048576, 4096));
+  }
+  ASSERT_EQ(4096u, DiscardTestDevice::get_counter("discard_held_bytes"));
+
+  // Draining does not wait for the hold to expire.
+  b->discard_drain();
+  std::lock_guard l{released.lock};
+  ASSERT_TRUE(released.all.contains(1048576, 4096));
+}
+
+TEST_F(KernelDeviceDiscard, ThrottleIgnoresSkippedBytes) {
+  set("bdev_async_discard_min_size", "65536");
+  set("bdev_async_discard_hold_ms", "0");
+  // 4 KiB/s: a 256 KiB discard holds the next one back for a minute, and
+  // counting 2 MiB of fragments would hold it back for over eight
+  set("bdev_async_discard_max_bytes_per_sec", "4096");
+
+  // The fragments are released without a discard, and must not use up the
+  // rate budget of the discard behind them.
+  for (uint64_t off = 0; off < 4 * 1048576; off += 8192) {
+    queue(off, 4096);
+  }
+  queue(4 * 1048576, 262144);
+  ASSERT_TRUE(DiscardTestDevice::wait_for(released, 4 * 1048576, 262144));
+  ASSERT_EQ(0u, DiscardTestDevice::get_counter("discard_throttled"));
+  ASSERT_EQ(262144u, DiscardTestDevice::get_counter("discard_bytes"));
+
+  // The discard that was issued is held to the rate.
+  queue(8 * 1048576, 262144);
+  ASSERT_TRUE(DiscardTestDevice::wait_for_counter(
+    "discard_throttled", [](uint64_t n) { return n > 0; }));
+  {
+    std::lock_guard l{released.lock};
+    ASSERT_FALSE(released.all.intersects(8 * 1048576, 262144));
+  }
+
+  // Draining does not wait for the rate limit.
+  b->discard_drain();
+  std::lock_guard l{released.lock};
+  ASSERT_TRUE(released.all.contains(8 * 1048576, 262144));
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   map<string,string> defaults = {
@@ -798,6 +798,82 @@ TEST(BlueFS, test_replay) {
   fs.umount();
 }
 
+TEST(BlueFS, test_replay_parallel_verify) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_alloc_size", "4096");
+  conf.SetVal("bluefs_compact_log_sync", "true");
+  conf.SetVal("bluefs_replay_verify_threads", "4");
+  conf.ApplyChanges();
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  // enough long names for the compacted metadata dump to span several
+  // verification slices
+  const string dir = "dir";
+  const string prefix(200, 'f');
+  const int num_files = 20000;
+  ASSERT_EQ(0, fs.mkdir(dir));
+  for (int i = 0; i < num_files; i++) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write(dir, prefix + to_string(i), &h, false));
+    fs.close_writer(h);
+  }
+  fs.sync_metadata(false);
+  fs.compact_log();
+  fs.umount();
+
+  ASSERT_EQ(0, fs.mount());
+  vector<string> ls;
+  ASSERT_EQ(0, fs.readdir(dir, &ls));
+  ASSERT_EQ((size_t)num_files, ls.size() - 2); // "." and ".."
+  fs.umount();
+}
+
+TEST(BlueFS, test_log_compact_max_tail) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_alloc_size", "65536");
+  conf.SetVal("bluefs_compact_log_sync", "true");
+  // the metadata stays tiny, so only the tail bound can trigger compaction
+  conf.SetVal("bluefs_log_compact_min_ratio", "1000");
+  conf.SetVal("bluefs_log_compact_max_tail", "1048576");
+  conf.ApplyChanges();
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.mkdir("dir"));
+  const string name(200, 'f');
+  for (int i = 0;
+       i < 10000 && fs.get_perf_counters()->get(l_bluefs_log_compactions) == 0;
+       i++) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir", name, &h, false));
+    fs.close_writer(h);
+    ASSERT_EQ(0, fs.unlink("dir", name));
+    fs.sync_metadata(false);
+  }
+  ASSERT_GT(fs.get_perf_counters()->get(l_bluefs_log_compactions), 0u);
+  fs.umount();
+
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(1u, fs.get_perf_counters()->get_tavg_ns(l_bluefs_replay_lat).second);
+  vector<string> ls;
+  ASSERT_EQ(0, fs.readdir("dir", &ls));
+  ASSERT_EQ(2u, ls.size()); // "." and ".."
+  fs.umount();
+}
+
 TEST(BlueFS, test_replay_growth) {
   uint64_t size = 1048576LL * (2 * 1024 + 128);
   TempBdev bdev{size};
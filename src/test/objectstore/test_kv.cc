@@ -420,6 +420,46 @@ TEST_P(KVTest, ShardingRMRange) {
 }
 
 
+TEST_P(KVTest, RocksDBTombstoneCompaction) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+  g_conf().set_val_or_die("rocksdb_iterator_tombstone_compact_threshold", "100");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (size_t i = 0; i < 1000; i++) {
+      bufferlist value;
+      value.append("value");
+      t->set("prefix", fmt::format("key{:04}", i), value);
+    }
+    db->submit_transaction_sync(t);
+  }
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (size_t i = 0; i < 900; i++) {
+      t->rmkey("prefix", fmt::format("key{:04}", i));
+    }
+    t->rm_range_keys("prefix", "key0950", "key0960");
+    db->submit_transaction_sync(t);
+  }
+  PerfCounters *logger = db->get_perf_counters();
+  ASSERT_EQ(1u, logger->get(l_rocksdb_rm_range_keys));
+  {
+    size_t n = 0;
+    auto it = db->get_iterator("prefix");
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      ++n;
+    }
+    ASSERT_EQ(90u, n);
+  }
+  ASSERT_GE(logger->get(l_rocksdb_iter_tombstones_skipped), 900u);
+  ASSERT_GE(logger->get(l_rocksdb_tombstone_compact), 1u);
+  fini();
+  g_conf().rm_val("rocksdb_iterator_tombstone_compact_threshold");
+  g_conf().apply_changes(nullptr);
+}
+
 TEST_P(KVTest, RocksDBColumnFamilyTest) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -564,6 +604,62 @@ TEST_P(KVTest, RocksDBShardingIteratorTest) {
   fini();
 }
 
+TEST_P(KVTest, RocksDBShardingPrefetchIteratorTest) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  g_conf().set_val_or_die("rocksdb_iterator_prefetch_batch", "16");
+  g_conf().apply_changes(nullptr);
+  std::string cfs("A(6)");
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout, cfs));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (int v = 100; v <= 999; v++) {
+      std::string str = to_string(v);
+      bufferlist val;
+      val.append(str);
+      t->set("A", str, val);
+    }
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  {
+    KeyValueDB::Iterator it = db->get_iterator("A", KeyValueDB::ITERATOR_PREFETCH);
+    int pos = 0;
+    ASSERT_EQ(it->seek_to_first(), 0);
+    for (pos = 100; pos <= 999; pos++) {
+      ASSERT_EQ(it->valid(), true);
+      ASSERT_EQ(it->key(), to_string(pos));
+      ASSERT_EQ(it->value().to_str(), to_string(pos));
+      it->next();
+    }
+    ASSERT_EQ(it->valid(), false);
+    ASSERT_GT(db->get_perf_counters()->get(l_rocksdb_iter_prefetch_batches), 6u);
+
+    // moving backwards hands over to the plain merging iterator
+    ASSERT_EQ(it->prev(), 0);
+    ASSERT_EQ(it->key(), "999");
+    ASSERT_EQ(it->upper_bound("499"), 0);
+    ASSERT_EQ(it->key(), "500");
+    ASSERT_EQ(it->prev(), 0);
+    ASSERT_EQ(it->key(), "499");
+    ASSERT_EQ(it->prev(), 0);
+    ASSERT_EQ(it->key(), "498");
+    ASSERT_EQ(it->next(), 0);
+    ASSERT_EQ(it->key(), "499");
+    ASSERT_EQ(it->lower_bound("7"), 0);
+    for (pos = 700; pos <= 999; pos++) {
+      ASSERT_EQ(it->valid(), true);
+      ASSERT_EQ(it->key(), to_string(pos));
+      it->next();
+    }
+    ASSERT_EQ(it->valid(), false);
+  }
+  fini();
+  g_conf().rm_val("rocksdb_iterator_prefetch_batch");
+  g_conf().apply_changes(nullptr);
+}
+
 TEST_P(KVTest, RocksDBCFMerge) {
   if(string(GetParam()) != "rocksdb")
     return;
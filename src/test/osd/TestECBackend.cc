@@ -24,6 +24,7 @@
 #include "common/ceph_argparse.h"
 #include "erasure-code/ErasureCode.h"
 #include "test/osd/MockErasureCode.h"
+#include "osdc/SplitOp.h"
 
 using namespace std;
 
@@ -42,12 +43,12 @@ private:
   set<pg_shard_t> acting_recovery_backfill_shards;
   shard_id_set acting_recovery_backfill_shard_id_set;
   map<pg_shard_t, pg_info_t> shard_info;
-  PGLog pg_log;
   pg_info_t shard_pg_info;
   std::string dbg_prefix = "stub";
 
 public:
   set<pg_shard_t> acting_shards;
+  PGLog pg_log;
 
   ECListenerStub()
     : pg_log(NULL) {}
@@ -1056,6 +1057,208 @@ TEST(ECCommon, get_remaining_shards)
   }
 }
 
+TEST(ECCommon, try_coalesce_read)
+{
+  const uint64_t align_size = EC_ALIGN_SIZE;
+  const uint64_t swidth = 64*align_size;
+  const unsigned int k = 4;
+  const unsigned int m = 2;
+  const int nshards = 6;
+  const uint64_t chunk_size = swidth / k;
+  const uint64_t object_size = swidth * 1024;
+
+  ECUtil::stripe_info_t s(k, m, swidth, vector<shard_id_t>(0));
+  ECListenerStub listenerStub;
+  MockErasureCode *ecode = new MockErasureCode();
+  ErasureCodeInterfaceRef ec_impl(ecode);
+  ECCommon::ReadPipeline pipeline(g_ceph_context, ec_impl, s, &listenerStub);
+
+  for (int i = 0; i < nshards; i++) {
+    listenerStub.acting_shards.insert(pg_shard_t(i, shard_id_t(i)));
+  }
+
+  hobject_t hoid;
+  auto make_request = [&](uint64_t off, uint64_t len) {
+    ECUtil::shard_extent_set_t to_read(s.get_k_plus_m());
+    s.ro_range_to_shard_extent_set(off, len, to_read);
+    ECCommon::read_request_t read_request(
+      to_read, ECCommon::WantAttrs::No, ECCommon::WantOmapHeader::No,
+      ECCommon::WantOmapKeys::No, "", 0, object_size
+    );
+    pipeline.get_min_avail_to_read_shards(hoid, false, false, read_request);
+    return read_request;
+  };
+
+  // An in-flight read of the first two stripes.
+  std::map<hobject_t, ECCommon::read_request_t> to_read;
+  to_read.emplace(hoid, make_request(0, 2 * swidth));
+  const ceph_tid_t tid = 1;
+  auto &rop = pipeline.tid_to_read_map.emplace(
+    tid,
+    ECCommon::ReadOp(0, tid, false, false, nullptr,
+                     std::move(to_read))).first->second;
+  rop.coalesce = true;
+  pipeline.index_coalesce_read(rop);
+
+  ECCommon::ClientAsyncReadStatus status(1, nullptr);
+
+  // Contained in the in-flight read.
+  ASSERT_TRUE(pipeline.try_coalesce_read(
+    hoid, make_request(chunk_size, chunk_size), &status));
+  ASSERT_EQ(1u, rop.coalesced_reads.at(hoid).size());
+
+  // Extends beyond the in-flight read.
+  ASSERT_FALSE(pipeline.try_coalesce_read(
+    hoid, make_request(swidth, 2 * swidth), &status));
+
+  // A different object.
+  hobject_t other_hoid = hoid;
+  other_hoid.oid.name = "other";
+  ASSERT_FALSE(pipeline.try_coalesce_read(
+    other_hoid, make_request(0, chunk_size), &status));
+
+  // Another object was written since the read was started.
+  listenerStub.pg_log.add(pg_log_entry_t(
+    pg_log_entry_t::MODIFY, other_hoid, eversion_t(1, 1), eversion_t(),
+    0, osd_reqid_t(), utime_t(), 0));
+  ASSERT_TRUE(pipeline.try_coalesce_read(
+    hoid, make_request(0, chunk_size), &status));
+
+  // The object was written since the read was started.
+  listenerStub.pg_log.add(pg_log_entry_t(
+    pg_log_entry_t::MODIFY, hoid, eversion_t(1, 2), eversion_t(),
+    0, osd_reqid_t(), utime_t(), 0));
+  ASSERT_FALSE(pipeline.try_coalesce_read(
+    hoid, make_request(0, chunk_size), &status));
+  rop.log_head = eversion_t(1, 2);
+  ASSERT_TRUE(pipeline.try_coalesce_read(
+    hoid, make_request(0, chunk_size), &status));
+
+  // The in-flight read is being completed.
+  pipeline.unindex_coalesce_read(rop, hoid);
+  ASSERT_FALSE(pipeline.try_coalesce_read(
+    hoid, make_request(0, chunk_size), &status));
+}
+
+TEST(ECCommon, complete_coalesced_reads)
+{
+  const uint64_t align_size = EC_ALIGN_SIZE;
+  const uint64_t swidth = 64*align_size;
+  const unsigned int k = 4;
+  const unsigned int m = 2;
+  const int nshards = 6;
+  const uint64_t chunk_size = swidth / k;
+  const uint64_t object_size = swidth * 1024;
+
+  ECUtil::stripe_info_t s(k, m, swidth, vector<shard_id_t>(0));
+  ECListenerStub listenerStub;
+  MockErasureCode *ecode = new MockErasureCode();
+  ErasureCodeInterfaceRef ec_impl(ecode);
+  ECCommon::ReadPipeline pipeline(g_ceph_context, ec_impl, s, &listenerStub);
+
+  for (int i = 0; i < nshards; i++) {
+    listenerStub.acting_shards.insert(pg_shard_t(i, shard_id_t(i)));
+  }
+
+  hobject_t hoid;
+  auto make_request = [&](uint64_t off, uint64_t len) {
+    ECUtil::shard_extent_set_t to_read(s.get_k_plus_m());
+    s.ro_range_to_shard_extent_set(off, len, to_read);
+    ECCommon::read_request_t read_request(
+      std::list<ec_align_t>{ec_align_t(off, len, 0)}, to_read,
+      ECCommon::WantAttrs::No, ECCommon::WantOmapHeader::No,
+      ECCommon::WantOmapKeys::No, "", 0, object_size
+    );
+    pipeline.get_min_avail_to_read_shards(hoid, false, false, read_request);
+    return read_request;
+  };
+
+  // An in-flight read of the first two stripes. The stub hands out tid 0 to
+  // any read which is reissued.
+  std::map<hobject_t, ECCommon::read_request_t> to_read;
+  to_read.emplace(hoid, make_request(0, 2 * swidth));
+  const ceph_tid_t tid = 1;
+  auto &rop = pipeline.tid_to_read_map.emplace(
+    tid,
+    ECCommon::ReadOp(0, tid, false, false, nullptr,
+                     std::move(to_read))).first->second;
+  rop.coalesce = true;
+  pipeline.index_coalesce_read(rop);
+
+  // Data shard i is filled with 'a' + i.
+  ECCommon::read_result_t res(&s);
+  for (unsigned int i = 0; i < k; i++) {
+    buffer::list bl;
+    bl.append(std::string(2 * chunk_size, 'a' + i));
+    res.buffers_read.insert_in_shard(shard_id_t(i), 0, bl);
+  }
+
+  // Reads waiting on the in-flight read complete from its buffers, each
+  // with its own range.
+  {
+    ECCommon::ClientAsyncReadStatus status1(1, nullptr);
+    ECCommon::ClientAsyncReadStatus status2(1, nullptr);
+    ASSERT_TRUE(pipeline.try_coalesce_read(
+      hoid, make_request(chunk_size, chunk_size), &status1));
+    ASSERT_TRUE(pipeline.try_coalesce_read(
+      hoid, make_request(swidth + 2 * chunk_size, chunk_size), &status2));
+
+    pipeline.complete_coalesced_reads(rop, hoid, &res, &rop.to_read.at(hoid));
+    ASSERT_FALSE(rop.coalesced_reads.contains(hoid));
+    ASSERT_EQ(1u, pipeline.tid_to_read_map.size());
+
+    for (auto &&[status, off, c] :
+         {std::tuple(&status1, chunk_size, 'b'),
+          std::tuple(&status2, swidth + 2 * chunk_size, 'c')}) {
+      ASSERT_TRUE(status->is_complete());
+      auto &result = status->results.at(hoid);
+      ASSERT_EQ(0, result.err);
+      ASSERT_EQ(1u, result.emap.ext_count());
+      auto iter = result.emap.begin();
+      ASSERT_EQ(off, iter.get_off());
+      ASSERT_EQ(chunk_size, iter.get_len());
+      buffer::list expected;
+      expected.append(std::string(chunk_size, c));
+      ASSERT_TRUE(iter.get_val().contents_equal(expected));
+    }
+  }
+
+  // If the in-flight read fails, a waiting read is sent on its own, and
+  // nothing can coalesce with that.
+  {
+    ECCommon::ClientAsyncReadStatus status(1, nullptr);
+    ASSERT_TRUE(pipeline.try_coalesce_read(
+      hoid, make_request(chunk_size, chunk_size), &status));
+
+    res.r = -EIO;
+    pipeline.complete_coalesced_reads(rop, hoid, &res, &rop.to_read.at(hoid));
+    ASSERT_FALSE(rop.coalesced_reads.contains(hoid));
+    ASSERT_FALSE(status.is_complete());
+    ASSERT_TRUE(pipeline.tid_to_read_map.contains(0));
+    auto &reissued = pipeline.tid_to_read_map.at(0);
+    ASSERT_FALSE(reissued.coalesce);
+    ASSERT_EQ(make_request(chunk_size, chunk_size),
+              reissued.to_read.at(hoid));
+    ASSERT_EQ(std::set<ceph_tid_t>{tid}, pipeline.coalesce_read_map.at(hoid));
+    pipeline.tid_to_read_map.erase(0);
+  }
+
+  // Likewise if the in-flight read of the object is cancelled.
+  {
+    ECCommon::ClientAsyncReadStatus status(1, nullptr);
+    ASSERT_TRUE(pipeline.try_coalesce_read(
+      hoid, make_request(chunk_size, chunk_size), &status));
+
+    pipeline.unindex_coalesce_read(rop, hoid);
+    pipeline.complete_coalesced_reads(rop, hoid, nullptr, nullptr);
+    ASSERT_FALSE(status.is_complete());
+    ASSERT_TRUE(pipeline.tid_to_read_map.contains(0));
+    ASSERT_FALSE(pipeline.coalesce_read_map.contains(hoid));
+    ASSERT_FALSE(pipeline.try_coalesce_read(
+      hoid, make_request(chunk_size, chunk_size), &status));
+  }
+}
+
 TEST(ECCommon, encode)
 {
   const uint64_t align_size = EC_ALIGN_SIZE;
@@ -1083,6 +1286,149 @@ TEST(ECCommon, encode)
   semap.encode(ec_impl);
 }
 
+TEST(ECCommon, encode_zero_slices_with_crcs)
+{
+  // Counts the slices the plugin is asked to encode
+  class CountingErasureCode : public MockErasureCode {
+  public:
+    using MockErasureCode::MockErasureCode;
+    int slices = 0;
+    int encode_chunks(const shard_id_map<bufferptr> &in,
+                      shard_id_map<bufferptr> &out) override {
+      slices++;
+      for (auto &&[_, bp] : out) {
+        memset(bp.c_str(), 0x33, bp.length());
+      }
+      return 0;
+    }
+  };
+
+  const unsigned int k = 2;
+  const unsigned int m = 1;
+  const uint64_t chunk_size = EC_ALIGN_SIZE;
+  ECUtil::stripe_info_t s(k, m, k * chunk_size, vector<shard_id_t>(0));
+  CountingErasureCode *ecode = new CountingErasureCode(k, k + m);
+  ErasureCodeInterfaceRef ec_impl(ecode);
+
+  // Three stripes, of which only the first has data. Shard 0 and the parity
+  // are single buffers, so their crcs chain across the zero slices. Shard 1
+  // is one buffer per chunk, so the object is encoded a chunk at a time.
+  ECUtil::shard_extent_map_t semap(&s);
+  for (shard_id_t shard; shard < k + m; ++shard) {
+    bufferlist bl;
+    if (shard == shard_id_t(1)) {
+      for (int i = 0; i < 3; i++) {
+        bufferptr bp = buffer::create_page_aligned(chunk_size);
+        memset(bp.c_str(), i ? 0 : 0x11, chunk_size);
+        bl.append(bp);
+      }
+    } else {
+      bufferptr bp = buffer::create_page_aligned(3 * chunk_size);
+      memset(bp.c_str(), shard < k ? 0 : 0xff, 3 * chunk_size);
+      if (shard < k) {
+        memset(bp.c_str(), 0x22, chunk_size);
+      }
+      bl.append(bp);
+    }
+    semap.insert_in_shard(shard, 0, bl);
+  }
+
+  shard_id_set crc_shards;
+  crc_shards.insert_range(shard_id_t(0), k + m);
+  ASSERT_EQ(0, semap.encode(ec_impl, nullptr, nullptr, &crc_shards));
+
+  // Only the stripe with data reaches the plugin; the parity of the zero
+  // stripes is zeroed instead.
+  ASSERT_EQ(1, ecode->slices);
+  bufferlist parity;
+  semap.get_buffer(shard_id_t(k), chunk_size, 2 * chunk_size, parity);
+  ASSERT_TRUE(parity.is_zero());
+
+  // Every buffer still has a crc cached, and it matches the data.
+  for (shard_id_t shard; shard < k + m; ++shard) {
+    bufferlist bl;
+    semap.get_buffer(shard, 0, 3 * chunk_size, bl);
+    for (const auto &bp : bl.buffers()) {
+      uint32_t crc;
+      ASSERT_TRUE(bp.get_crc32c(-1, &crc)) << "shard " << shard;
+      ASSERT_EQ(ceph_crc32c(-1, (const unsigned char*)bp.c_str(),
+                            bp.length()), crc) << "shard " << shard;
+    }
+  }
+}
+
+TEST(ECCommon, client_parity_matches_encode)
+{
+  // A linear code, so that parity depends on every byte of every data shard
+  // at the same offset and nothing else, like the real plugins.
+  class LinearErasureCode : public MockErasureCode {
+  public:
+    using MockErasureCode::MockErasureCode;
+    int encode_chunks(const shard_id_map<bufferptr> &in,
+                      shard_id_map<bufferptr> &out) override {
+      for (auto &&[pshard, pbp] : out) {
+        for (unsigned i = 0; i < pbp.length(); i++) {
+          uint8_t p = 0;
+          for (auto &&[dshard, dbp] : in) {
+            p += (uint8_t)dbp.c_str()[i] * (1 + (int)dshard + 7 * (int)pshard);
+          }
+          pbp.c_str()[i] = p;
+        }
+      }
+      return 0;
+    }
+  };
+
+  const unsigned int k = 3;
+  const unsigned int m = 2;
+  const uint64_t chunk_size = EC_ALIGN_SIZE;
+  const uint64_t swidth = k * chunk_size;
+  // Remapped, so that raw shard order and shard order differ.
+  const vector<shard_id_t> mapping = {shard_id_t(1), shard_id_t(0),
+    shard_id_t(2), shard_id_t(4), shard_id_t(3)};
+
+  pg_pool_t pool;
+  pool.type = pg_pool_t::TYPE_ERASURE;
+  pool.size = k + m;
+  pool.stripe_width = swidth;
+  pool.ec_data_shard_count = k;
+  pool.set_flag(pg_pool_t::FLAG_EC_OPTIMIZATIONS);
+  pool.set_shard_mapping(vector<shard_id_t>(mapping));
+  ECUtil::stripe_info_t s(k, m, swidth, &pool, mapping);
+  ErasureCodeInterfaceRef ec_impl(new LinearErasureCode(k, k + m));
+
+  ASSERT_TRUE(ECSplitWrite::is_eligible(&pool, swidth, 3 * swidth));
+  ASSERT_FALSE(ECSplitWrite::is_eligible(&pool, chunk_size, 3 * swidth));
+  ASSERT_FALSE(ECSplitWrite::is_eligible(&pool, 0, swidth + chunk_size));
+  ASSERT_FALSE(ECSplitWrite::is_eligible(&pool, 0, 0));
+
+  // Three stripes, written at the second stripe of the object.
+  const uint64_t ro_offset = swidth;
+  const uint64_t length = 3 * swidth;
+  bufferlist data;
+  for (uint64_t i = 0; i < length; i++) {
+    data.append((char)(std::rand() & 0xff));
+  }
+
+  bufferlist parity;
+  ASSERT_EQ(0, ECSplitWrite::encode_parity(&pool, ec_impl, data, &parity));
+  ASSERT_EQ(length / k * m, parity.length());
+
+  // What the primary would have written.
+  ECUtil::shard_extent_map_t semap(&s);
+  s.ro_range_to_shard_extent_map(ro_offset, length, data, semap);
+  semap.insert_parity_buffers();
+  ASSERT_EQ(0, semap.encode(ec_impl));
+
+  const uint64_t shard_length = length / k;
+  for (raw_shard_id_t raw(k); raw < (int)(k + m); ++raw) {
+    bufferlist expected, actual;
+    semap.get_buffer(s.get_shard(raw), ro_offset / k, shard_length, expected);
+    actual.substr_of(parity, ((int)raw - k) * shard_length, shard_length);
+    ASSERT_TRUE(expected.contents_equal(actual)) << "raw shard " << (int)raw;
+  }
+}
+
 bufferlist create_buf(uint64_t len) {
   bufferlist bl;
 
@@ -14,6 +14,7 @@
  */
 
 #include <gtest/gtest.h>
+#include "common/Formatter.h"
 #include "test/osd/ECPeeringTestFixture.h"
 #include "test/osd/TestCommon.h"
 
@@ -42,6 +43,101 @@ public:
   void SetUp() override {
     ECPeeringTestFixture::SetUp();
   }
+
+  void TearDown() override {
+    g_ceph_context->_conf.rm_val("osd_recovery_max_chunk");
+    g_ceph_context->_conf.rm_val("osd_recovery_ec_read_ahead");
+    g_ceph_context->_conf.apply_changes(nullptr);
+    ECPeeringTestFixture::TearDown();
+  }
+
+  /**
+   * Recover one stripe per recovery read, with read ahead, and write an
+   * object of three stripes that target_osd misses. Returns the data the
+   * object should hold once it is recovered.
+   */
+  std::string setup_read_ahead_recovery(
+    const std::string& obj_name,
+    int target_osd)
+  {
+    set_config("osd_recovery_max_chunk", std::to_string(k * stripe_unit));
+    set_config("osd_recovery_ec_read_ahead", "true");
+
+    const size_t data_size = 3 * k * stripe_unit;
+    create_and_write_verify(obj_name, std::string(data_size, 'A'));
+    mark_osd_down(target_osd);
+    std::string data(data_size, 0);
+    for (size_t i = 0; i < data_size; i++) {
+      data[i] = 'a' + (i / stripe_unit) % 26;
+    }
+    write_verify(obj_name, 0, data, data_size);
+    mark_osd_up(target_osd);
+    return data;
+  }
+
+  /**
+   * Queue the recovery of obj_name to target_osd on the primary, without
+   * running the event loop.
+   */
+  void start_recovery(const std::string& obj_name, int target_osd) {
+    int primary = get_primary_shard_from_osdmap();
+    hobject_t hoid = make_test_object(obj_name);
+    event_loop->schedule_transaction(primary, [this, hoid, target_osd, primary]() {
+      pg_shard_t target(target_osd, shard_id_t(target_osd));
+      const pg_missing_t& missing =
+        get_peering_state(primary)->get_peer_missing().at(target);
+      ceph_assert(missing.is_missing(hoid));
+      ObjectContextRef obc = get_object_context(hoid, false);
+      ceph_assert(obc);
+
+      get_primary_listener()->recovery_tracker.reset();
+      PGBackend::RecoveryHandle *h = get_primary_backend()->open_recovery_op();
+      int r = get_primary_backend()->recover_object(
+        hoid, missing.get_items().at(hoid).need, ObjectContextRef(), obc, h);
+      ceph_assert(r == 0);
+      get_primary_backend()->run_recovery_op(h, 10);
+    });
+  }
+
+  /// The primary's recovery ops and reads, as compact JSON.
+  std::string dump_recovery() {
+    JSONFormatter f;
+    get_primary_backend()->dump_recovery_info(&f);
+    std::ostringstream out;
+    f.flush(out);
+    return out.str();
+  }
+
+  /// Step the event loop until the primary has a read ahead in flight.
+  bool run_until_read_ahead() {
+    while (event_loop->run_one()) {
+      if (dump_recovery().find("\"read_ahead\":true") != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void verify_recovered(
+    const std::string& obj_name,
+    int target_osd,
+    const std::string& data)
+  {
+    hobject_t hoid = make_test_object(obj_name);
+    pg_shard_t target(target_osd, shard_id_t(target_osd));
+    auto& tracker = get_primary_listener()->recovery_tracker;
+    EXPECT_EQ(1, tracker.on_global_recover_calls);
+    EXPECT_NE(std::find(tracker.on_peer_recover_objects.begin(),
+                        tracker.on_peer_recover_objects.end(),
+                        std::make_pair(target, hoid)),
+              tracker.on_peer_recover_objects.end())
+      << "on_peer_recover should be called for " << obj_name;
+
+    std::string info = dump_recovery();
+    EXPECT_NE(std::string::npos, info.find("\"recovery_ops\":[]")) << info;
+    EXPECT_NE(std::string::npos, info.find("\"read_ops\":[]")) << info;
+    verify_object(obj_name, data, 0, data.size());
+  }
 };
 
 TEST_P(TestECFailoverWithPeering, BasicPeeringCycle) {
@@ -1018,6 +1114,141 @@ TEST_P(TestECFailoverWithPeering, ScrubPartialWrite) {
   std::cout << "=== ScrubPartialWrite test completed ===" << std::endl;
 }
 
+/**
+ * RecoveryReadAheadBeforePushes - the read ahead of the next recovery chunk
+ * completes while the pushes of the previous chunk are still in flight, and
+ * its result is consumed once they are acknowledged.
+ */
+TEST_P(TestECFailoverWithPeering, RecoveryReadAheadBeforePushes) {
+  ASSERT_TRUE(all_shards_active()) << "Initial peering must complete";
+
+  const int target_osd = 1;
+  const std::string obj_name = "test_read_ahead_before_pushes";
+  std::string data = setup_read_ahead_recovery(obj_name, target_osd);
+
+  suspend_primary_to_osd(target_osd);
+  start_recovery(obj_name, target_osd);
+  event_loop->run_until_idle();
+
+  // The first chunk is being pushed and the second one has been read.
+  std::string info = dump_recovery();
+  EXPECT_NE(std::string::npos, info.find("\"state\":\"WRITING\"")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ahead\":false")) << info;
+  EXPECT_NE(std::string::npos,
+            info.find("data_recovered_to: " +
+                      std::to_string(2 * k * stripe_unit) + ",")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ops\":[]")) << info;
+
+  unsuspend_primary_to_osd(target_osd);
+  event_loop->run_until_idle();
+  verify_recovered(obj_name, target_osd, data);
+}
+
+/**
+ * RecoveryPushesBeforeReadAhead - the pushes of a recovery chunk are
+ * acknowledged while the read ahead of the next chunk is still in flight.
+ * The op waits in WRITING for the read to complete, then carries on.
+ */
+TEST_P(TestECFailoverWithPeering, RecoveryPushesBeforeReadAhead) {
+  ASSERT_TRUE(all_shards_active()) << "Initial peering must complete";
+
+  const int target_osd = 1;
+  const std::string obj_name = "test_pushes_before_read_ahead";
+  std::string data = setup_read_ahead_recovery(obj_name, target_osd);
+
+  start_recovery(obj_name, target_osd);
+  ASSERT_TRUE(run_until_read_ahead());
+
+  // Hold the replies to the read ahead, but not the push replies.
+  int primary = get_primary_shard_from_osdmap();
+  for (int osd = 0; osd < k + m; osd++) {
+    if (osd != target_osd) {
+      event_loop->suspend_from_to_osd(osd, primary);
+    }
+  }
+  event_loop->run_until_idle();
+
+  std::string info = dump_recovery();
+  EXPECT_NE(std::string::npos, info.find("\"state\":\"WRITING\"")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ahead\":true")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"waiting_on_pushes\":\"[]\""))
+    << info;
+
+  for (int osd = 0; osd < k + m; osd++) {
+    if (osd != target_osd) {
+      event_loop->unsuspend_from_to_osd(osd, primary);
+    }
+  }
+  event_loop->run_until_idle();
+  verify_recovered(obj_name, target_osd, data);
+}
+
+/**
+ * RecoveryReadAheadIntervalChange - an interval change while a read ahead
+ * is in flight discards the recovery op together with the read, and a new
+ * recovery of the object succeeds.
+ */
+TEST_P(TestECFailoverWithPeering, RecoveryReadAheadIntervalChange) {
+  ASSERT_TRUE(all_shards_active()) << "Initial peering must complete";
+
+  const int target_osd = 1;
+  const std::string obj_name = "test_read_ahead_interval_change";
+  std::string data = setup_read_ahead_recovery(obj_name, target_osd);
+
+  start_recovery(obj_name, target_osd);
+  ASSERT_TRUE(run_until_read_ahead());
+
+  // The sub reads of the read ahead are still queued; their replies arrive
+  // after the primary has moved to the new interval.
+  mark_osd_down(target_osd);
+  std::string info = dump_recovery();
+  EXPECT_NE(std::string::npos, info.find("\"recovery_ops\":[]")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ops\":[]")) << info;
+
+  mark_osd_up(target_osd);
+  run_recovery_and_verify_callbacks(obj_name, target_osd, data);
+}
+
+/**
+ * RecoveryReadAheadError - the read ahead of the next recovery chunk fails
+ * while the pushes of the previous chunk are still in flight. The op must
+ * survive until the push replies arrive, then read the chunk again.
+ */
+TEST_P(TestECFailoverWithPeering, RecoveryReadAheadError) {
+  ASSERT_TRUE(all_shards_active()) << "Initial peering must complete";
+
+  const int target_osd = 1;
+  const std::string obj_name = "test_read_ahead_error";
+  std::string data = setup_read_ahead_recovery(obj_name, target_osd);
+
+  suspend_primary_to_osd(target_osd);
+  start_recovery(obj_name, target_osd);
+  ASSERT_TRUE(run_until_read_ahead());
+
+  // Fail every shard the read ahead could use, so it cannot decode.
+  for (int osd = 0; osd < k + m; osd++) {
+    if (osd != target_osd) {
+      inject_read_error_for_shard(obj_name, osd, -EIO);
+    }
+  }
+  event_loop->run_until_idle();
+
+  // The op is still waiting for its pushes, without a read ahead.
+  std::string info = dump_recovery();
+  EXPECT_NE(std::string::npos, info.find("\"state\":\"WRITING\"")) << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ahead\":false")) << info;
+  EXPECT_EQ(std::string::npos, info.find("\"waiting_on_pushes\":\"[]\""))
+    << info;
+  EXPECT_NE(std::string::npos, info.find("\"read_ops\":[]")) << info;
+  EXPECT_EQ(0, get_primary_listener()->recovery_tracker.on_global_recover_calls);
+
+  // The push replies reach the op, which reads the chunk again.
+  store->clear_all_read_errors();
+  unsuspend_primary_to_osd(target_osd);
+  event_loop->run_until_idle();
+  verify_recovered(obj_name, target_osd, data);
+}
+
 // ---------------------------------------------------------------------------
 // Instantiate TestECFailoverWithPeering with EC configurations
 // ---------------------------------------------------------------------------
@@ -1616,3 +1616,81 @@ TEST(ECUtil, erase_after_ro_offset_single_byte)
   // Shard 1 should be empty
   ASSERT_FALSE(semap.contains_shard(shard_id_t(1)));
 }
+
+TEST(ECUtil, get_zero_extents)
+{
+  // data | 3 zero blocks | data | zero block, then 2 blocks of raw_zeros
+  bufferlist bl;
+  bufferptr bp = buffer::create_aligned(6 * EC_ALIGN_SIZE, EC_ALIGN_SIZE);
+  bp.zero();
+  bp.c_str()[0] = 1;
+  bp.c_str()[4 * EC_ALIGN_SIZE + 1] = 1;
+  bl.append(bp);
+  bl.append_zero2(2 * EC_ALIGN_SIZE);
+
+  uint64_t off = 8 * EC_ALIGN_SIZE;
+  extent_set ref;
+  ref.insert(off + EC_ALIGN_SIZE, 3 * EC_ALIGN_SIZE);
+  ref.insert(off + 5 * EC_ALIGN_SIZE, 3 * EC_ALIGN_SIZE);
+  ASSERT_EQ(ref, get_zero_extents(off, bl, EC_ALIGN_SIZE));
+
+  // The zero block and raw_zeros merge into one run of 3 blocks.
+  ASSERT_EQ(ref, get_zero_extents(off, bl, 3 * EC_ALIGN_SIZE));
+
+  // Runs shorter than min_len are not reported.
+  ref.clear();
+  ASSERT_EQ(ref, get_zero_extents(off, bl, 4 * EC_ALIGN_SIZE));
+}
+
+TEST(ECUtil, split_zero_runs)
+{
+  // 2 zero blocks | data | 3 zero blocks, in one buffer with a cached crc
+  bufferptr bp = buffer::create_aligned(6 * EC_ALIGN_SIZE, EC_ALIGN_SIZE);
+  bp.zero();
+  memset(bp.c_str() + 2 * EC_ALIGN_SIZE, 0x5a, EC_ALIGN_SIZE);
+  bufferlist bl;
+  bl.append(bp);
+  bl.crc32c(-1);
+
+  uint64_t off = 8 * EC_ALIGN_SIZE;
+  std::map<uint64_t, bufferlist> writes;
+  extent_set zeros;
+  split_zero_runs(off, bl, 2 * EC_ALIGN_SIZE, writes, zeros);
+
+  extent_set ref;
+  ref.insert(off, 2 * EC_ALIGN_SIZE);
+  ref.insert(off + 3 * EC_ALIGN_SIZE, 3 * EC_ALIGN_SIZE);
+  ASSERT_EQ(ref, zeros);
+  ASSERT_EQ(1u, writes.size());
+  ASSERT_EQ(off + 2 * EC_ALIGN_SIZE, writes.begin()->first);
+  bufferlist &data = writes.begin()->second;
+  ASSERT_EQ(EC_ALIGN_SIZE, data.length());
+
+  // The write keeps a cached crc, adjusted to its data
+  uint32_t crc;
+  ASSERT_TRUE(data.front().get_crc32c(-1, &crc));
+  ASSERT_EQ(ceph_crc32c(-1, (const unsigned char*)data.c_str(),
+                        data.length()), crc);
+
+  // data | 3 zero blocks | data: both extents are written
+  bufferptr bp2 = buffer::create_aligned(5 * EC_ALIGN_SIZE, EC_ALIGN_SIZE);
+  bp2.zero();
+  bp2.c_str()[0] = 1;
+  bp2.c_str()[4 * EC_ALIGN_SIZE] = 1;
+  bufferlist bl2;
+  bl2.append(bp2);
+  writes.clear();
+  split_zero_runs(off, bl2, 2 * EC_ALIGN_SIZE, writes, zeros);
+
+  ref.clear();
+  ref.insert(off + EC_ALIGN_SIZE, 3 * EC_ALIGN_SIZE);
+  ASSERT_EQ(ref, zeros);
+  ASSERT_EQ(2u, writes.size());
+  for (auto &&[w_off, w_bl] : writes) {
+    bufferlist expect;
+    expect.substr_of(bl2, w_off - off, EC_ALIGN_SIZE);
+    ASSERT_TRUE(expect.contents_equal(w_bl));
+  }
+  ASSERT_EQ(off, writes.begin()->first);
+  ASSERT_EQ(off + 4 * EC_ALIGN_SIZE, writes.rbegin()->first);
+}
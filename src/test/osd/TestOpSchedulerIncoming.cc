@@ -0,0 +1,202 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/common_init.h"
+
+#include "osd/scheduler/mClockScheduler.h"
+#include "osd/scheduler/OpSchedulerIncoming.h"
+#include "osd/scheduler/OpSchedulerItem.h"
+
+using namespace ceph::osd::scheduler;
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+using namespace std::literals;
+
+// Stands in for an OSDShard with osd_op_queue_lockless_enqueue: producers
+// push without the shard lock, consumers drain under it, and items that
+// cannot run yet are parked per PG and later requeued at the front, the
+// way _wake_pg_slot does.
+class OpSchedulerIncomingTest : public testing::Test {
+public:
+  static constexpr unsigned num_producers = 4;
+  static constexpr unsigned num_consumers = 3;
+  static constexpr unsigned num_items = 20000;
+
+  struct MockPGItem : public PGOpQueueable {
+    explicit MockPGItem(spg_t pg) : PGOpQueueable(pg) {}
+
+    ostream &print(ostream &rhs) const final { return rhs; }
+
+    std::string print() const final {
+      return std::string();
+    }
+
+    std::optional<OpRequestRef> maybe_get_op() const final {
+      return std::nullopt;
+    }
+
+    SchedulerClass get_scheduler_class() const final {
+      return SchedulerClass::immediate;
+    }
+
+    void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final {}
+  };
+
+  // one PG per producer; the owner names the producer and the epoch
+  // carries the sequence number
+  static OpSchedulerItem create_item(unsigned producer, epoch_t seq) {
+    return OpSchedulerItem(
+      std::make_unique<MockPGItem>(spg_t(pg_t(producer, 1))),
+      12, 1,
+      utime_t(), producer, seq);
+  }
+
+  struct slot_t {
+    std::deque<OpSchedulerItem> waiting;
+    std::vector<epoch_t> done;
+  };
+
+  std::mutex shard_lock;
+  mClockScheduler q;
+  OpSchedulerIncoming incoming;
+  std::vector<slot_t> slots;
+  std::atomic<unsigned> producing = num_producers;
+
+  OpSchedulerIncomingTest() :
+    q(g_ceph_context, 0, 1, 0, false, 12, 2ms, 2ms, 1ms, false),
+    slots(num_producers)
+  {}
+
+  void drain() {
+    incoming.drain([this](OpSchedulerItem&& item) {
+      q.enqueue(std::move(item));
+    });
+  }
+
+  bool idle() {
+    if (producing || !incoming.empty() || !q.empty()) {
+      return false;
+    }
+    for (auto& s : slots) {
+      if (!s.waiting.empty()) {
+	return false;
+      }
+    }
+    return true;
+  }
+};
+
+TEST_F(OpSchedulerIncomingTest, DrainOrder) {
+  ASSERT_TRUE(incoming.empty());
+  ASSERT_TRUE(incoming.push(create_item(0, 0)));
+  for (epoch_t i = 1; i < 10; ++i) {
+    ASSERT_FALSE(incoming.push(create_item(0, i)));
+  }
+  ASSERT_FALSE(incoming.empty());
+
+  std::vector<epoch_t> seen;
+  ASSERT_EQ(10u, incoming.drain([&seen](OpSchedulerItem&& item) {
+    seen.push_back(item.get_map_epoch());
+  }));
+  ASSERT_TRUE(incoming.empty());
+  ASSERT_EQ(0u, incoming.drain([](OpSchedulerItem&&) {}));
+  for (epoch_t i = 0; i < 10; ++i) {
+    ASSERT_EQ(i, seen[i]);
+  }
+
+  // recycled nodes carry nothing over
+  ASSERT_TRUE(incoming.push(create_item(1, 100)));
+  seen.clear();
+  incoming.drain([&seen](OpSchedulerItem&& item) {
+    seen.push_back(item.get_map_epoch());
+  });
+  ASSERT_EQ(1u, seen.size());
+  ASSERT_EQ(100u, seen[0]);
+}
+
+TEST_F(OpSchedulerIncomingTest, ConcurrentEnqueueRequeueOrder) {
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < num_producers; ++p) {
+    threads.emplace_back([this, p] {
+      for (epoch_t i = 0; i < num_items; ++i) {
+	incoming.push(create_item(p, i));
+      }
+      --producing;
+    });
+  }
+  for (unsigned c = 0; c < num_consumers; ++c) {
+    threads.emplace_back([this, c] {
+      std::mt19937 rng(c);
+      std::unique_lock l{shard_lock};
+      while (true) {
+	drain();
+	if (q.empty()) {
+	  if (idle()) {
+	    break;
+	  }
+	  l.unlock();
+	  std::this_thread::yield();
+	  l.lock();
+	  continue;
+	}
+	auto item = std::move(std::get<OpSchedulerItem>(q.dequeue()));
+	auto& slot = slots[item.get_owner()];
+	if (!slot.waiting.empty() || rng() % 8 == 0) {
+	  // blocked, like an op waiting for a map or for peering
+	  slot.waiting.push_back(std::move(item));
+	} else {
+	  slot.done.push_back(item.get_map_epoch());
+	}
+      }
+    });
+  }
+  std::atomic<bool> stop = false;
+  std::thread waker([this, &stop] {
+    std::mt19937 rng(num_consumers);
+    while (!stop) {
+      {
+	std::lock_guard l{shard_lock};
+	auto& slot = slots[rng() % num_producers];
+	// requeue the parked items at the front, newest first, so that they
+	// come out ahead of anything queued behind them
+	for (auto i = slot.waiting.rbegin(); i != slot.waiting.rend(); ++i) {
+	  q.enqueue_front(std::move(*i));
+	}
+	slot.waiting.clear();
+      }
+      std::this_thread::yield();
+    }
+  });
+  for (auto& t : threads) {
+    t.join();
+  }
+  stop = true;
+  waker.join();
+
+  ASSERT_TRUE(incoming.empty());
+  ASSERT_TRUE(q.empty());
+  for (auto& slot : slots) {
+    ASSERT_EQ(num_items, slot.done.size());
+    for (epoch_t i = 0; i < num_items; ++i) {
+      ASSERT_EQ(i, slot.done[i]);
+    }
+  }
+}
@@ -2266,7 +2266,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.at(oid);
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2280,7 +2280,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.at(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2293,7 +2293,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.at(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2301,6 +2301,44 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   EXPECT_EQ(del.reqid, entry->reqid);
 }
 
+TEST_F(PGLogTest, IndexOnDemand) {
+  hobject_t oid(object_t("objname"), "key", 123, 456, 0, "");
+  osd_reqid_t reqid(entity_name_t::CLIENT(777), 8, 2);
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
+  entries.push_back(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(6,3), eversion_t(3,4),
+		   2, reqid, utime_t(1,2), 0));
+
+  // a freshly loaded log carries no indexes
+  IndexedLog ilog(eversion_t(6,3), eversion_t(6,2), eversion_t(6,3),
+		  eversion_t(6,3), std::move(entries),
+		  mempool::osd_pglog::list<pg_log_dup_t>());
+  EXPECT_TRUE(ilog.objects.empty());
+  EXPECT_TRUE(ilog.caller_ops.empty());
+
+  EXPECT_TRUE(ilog.logged_req(reqid));
+  EXPECT_EQ(1u, ilog.caller_ops.size());
+  EXPECT_TRUE(ilog.objects.empty());
+
+  EXPECT_EQ(1u, ilog.get_objects().count(oid));
+  EXPECT_EQ(&ilog.log.back(), ilog.objects.at(oid));
+
+  // moving the log keeps the indexes pointing at the same entries
+  const pg_log_entry_t *entry = &ilog.log.back();
+  IndexedLog moved;
+  moved = std::move(ilog);
+  EXPECT_TRUE(ilog.objects.empty());
+  EXPECT_EQ(entry, &moved.log.back());
+  EXPECT_EQ(entry, moved.objects.at(oid));
+  EXPECT_EQ(entry, moved.caller_ops.at(reqid));
+
+  moved.add(
+    pg_log_entry_t(pg_log_entry_t::DELETE, oid, eversion_t(7,4), eversion_t(6,3),
+		   3, osd_reqid_t(entity_name_t::CLIENT(777), 8, 3),
+		   utime_t(10,2), 0));
+  EXPECT_EQ(&moved.log.back(), moved.get_objects().at(oid));
+}
+
 TEST_F(PGLogTest, split_into_preserves_may_include_deletes) {
   clear();
 
@@ -2777,6 +2815,32 @@ TEST_F(PGLogTrimTest, TestPartialTrim)
 }
 
 
+TEST_F(PGLogTrimTest, TestTrimIndexKeys)
+{
+  SetUp(20);
+  PGLog::IndexedLog log;
+  log.head = mk_evt(24, 0);
+  log.skip_can_rollback_to_to_head();
+  log.head = mk_evt(9, 0);
+  log.index();
+
+  hobject_t oid = mk_obj(1);
+  log.add(mk_ple_mod(oid, mk_evt(10, 100), mk_evt(8, 70)));
+  log.add(mk_ple_mod(oid, mk_evt(19, 160), mk_evt(10, 100)));
+
+  // the index key is the newest entry's object, not a copy of it
+  auto p = log.get_objects().find(oid);
+  ASSERT_NE(log.get_objects().end(), p);
+  EXPECT_EQ(&log.log.back(), p->second);
+  EXPECT_EQ(&log.log.back().soid, &p->first.get());
+
+  // so it outlives the older entry
+  log.trim(cct, mk_evt(10, 100), nullptr, nullptr, nullptr);
+  EXPECT_EQ(1u, log.log.size());
+  EXPECT_TRUE(log.logged_object(oid));
+  EXPECT_EQ(&log.log.back(), log.get_objects().at(oid));
+}
+
 TEST_F(PGLogTrimTest, TestTrimNoTrimmed) {
   SetUp(20);
   PGLog::IndexedLog log;
@@ -19,6 +19,8 @@
 #include "osd/ECOmapJournal.h"
 #include "osd/ECBackend.h"
 #include "common/dout.h"
+#include "common/perf_counters.h"
+#include "osd/osd_perf_counters.h"
 
 class MockDoutPrefixProvider : public DoutPrefixProvider {
 public:
@@ -205,6 +207,46 @@ TEST(ecomapjournal, remove_bad_entry_by_version)
   ASSERT_TRUE(journal.begin_entries(test_hoid)->version == entry1.version);
 }
 
+TEST(ecomapjournal, depth_gauge_returns_to_zero)
+{
+  MockDoutPrefixProvider dpp;
+  std::unique_ptr<PerfCounters> logger(build_osd_logger(g_ceph_context));
+  ECOmapJournal journal(dpp);
+  journal.set_logger(logger.get());
+  const hobject_t test_hoid("test_key8", CEPH_NOSNAP, 1, 0, "test_namespace");
+
+  ECOmapJournalEntry entry1(eversion_t(1, 1), false, std::nullopt, {});
+  ECOmapJournalEntry entry2(eversion_t(1, 2), false, std::nullopt, {});
+  ECOmapJournalEntry entry3(eversion_t(1, 3), false, std::nullopt, {});
+  journal.add_entry(test_hoid, entry1);
+  journal.add_entry(test_hoid, entry2);
+  ASSERT_EQ(2u, journal.get_depth());
+  ASSERT_EQ(2u, logger->get(l_osd_ec_omap_journal_depth));
+
+  // Removing an entry that was never added must not move the gauge
+  journal.remove_entry(test_hoid, entry3);
+  journal.remove_entry_by_version(test_hoid, entry3.version);
+  ASSERT_EQ(2u, journal.get_depth());
+  ASSERT_EQ(2u, logger->get(l_osd_ec_omap_journal_depth));
+
+  // Nor must removing the same entry twice, processed or not
+  journal.remove_entry(test_hoid, entry1);
+  journal.remove_entry(test_hoid, entry1);
+  ASSERT_EQ(1u, journal.get_depth());
+  journal.get_value_updates(test_hoid);
+  journal.remove_entry_by_version(test_hoid, entry2.version);
+  journal.remove_entry_by_version(test_hoid, entry2.version);
+  ASSERT_EQ(0u, journal.get_depth());
+  ASSERT_EQ(0u, logger->get(l_osd_ec_omap_journal_depth));
+
+  // Clearing the object drops whatever is still outstanding
+  journal.add_entry(test_hoid, entry3);
+  journal.clear(test_hoid);
+  journal.remove_entry(test_hoid, entry3);
+  ASSERT_EQ(0u, journal.get_depth());
+  ASSERT_EQ(0u, logger->get(l_osd_ec_omap_journal_depth));
+}
+
 TEST(ecomapjournal, get_value_updates_no_updates)
 {
   MockDoutPrefixProvider dpp;
@@ -256,7 +298,7 @@ TEST(ecomapjournal, get_value_updates_multiple_updates)
 
   // Removed ranges should contain the clear from entry2
   ASSERT_TRUE(removed_ranges.contains(""));
-  ASSERT_TRUE(!removed_ranges[""].has_value());
+  ASSERT_TRUE(!removed_ranges.at("").has_value());
 
   // Update map should contain key1 inserted in entry2
   auto it = update_map.find("key_1");
@@ -1478,3 +1520,92 @@ TEST(ecbackend_remove_keys_in_ranges, removes_contiguous_block)
   k05_bl.append("k05");
   EXPECT_TRUE(out["k05"].contents_equal(k05_bl));
 }
+
+// The cursor resolves keys in order against updates and removed ranges.
+TEST(ecomapjournal, update_cursor)
+{
+  MockDoutPrefixProvider dpp;
+  ECOmapJournal journal(dpp);
+  const hobject_t hoid("obj_update_cursor", CEPH_NOSNAP, 1, 0, "nspace");
+
+  journal.add_entry(hoid, create_insert_entry(eversion_t(1, 1), 10, 12));
+  std::vector<std::pair<OmapUpdateType, ceph::buffer::list>> rm_updates;
+  rm_updates.push_back({OmapUpdateType::RemoveRange, encode_range(make_key(20), make_key(30))});
+  rm_updates.push_back({OmapUpdateType::RemoveRange, encode_range(make_key(50), make_key(60))});
+  journal.add_entry(hoid, ECOmapJournalEntry(eversion_t(1, 2), false, std::nullopt, rm_updates));
+  journal.add_entry(hoid, create_insert_entry(eversion_t(1, 3), 25, 25));
+
+  auto [updates, ranges] = journal.get_value_updates(hoid);
+  ECOmapJournal::UpdateCursor cursor(updates, ranges);
+
+  EXPECT_EQ(nullptr, cursor.find(make_key(5)));
+  EXPECT_FALSE(cursor.is_removed(make_key(5)));
+  const ECOmapValue *v = cursor.find(make_key(11));
+  ASSERT_NE(nullptr, v);
+  EXPECT_TRUE(v->value.has_value());
+  EXPECT_EQ(nullptr, cursor.find(make_key(20)));
+  EXPECT_TRUE(cursor.is_removed(make_key(20)));
+  // Re-inserted after the range was removed
+  v = cursor.find(make_key(25));
+  ASSERT_NE(nullptr, v);
+  EXPECT_EQ(eversion_t(1, 3), v->version);
+  EXPECT_TRUE(cursor.is_removed(make_key(29)));
+  EXPECT_FALSE(cursor.is_removed(make_key(30)));
+  EXPECT_FALSE(cursor.is_removed(make_key(49)));
+  EXPECT_TRUE(cursor.is_removed(make_key(55)));
+  EXPECT_FALSE(cursor.is_removed(make_key(60)));
+  EXPECT_EQ(nullptr, cursor.find(make_key(99)));
+}
+
+// The merged ranges are rebuilt once the removing entry is rolled forward.
+TEST(ecomapjournal, removed_ranges_after_roll_forward)
+{
+  MockDoutPrefixProvider dpp;
+  ECOmapJournal journal(dpp);
+  const hobject_t hoid("obj_rm_range_rollforward", CEPH_NOSNAP, 1, 0, "nspace");
+
+  std::vector<std::pair<OmapUpdateType, ceph::buffer::list>> rm_updates;
+  rm_updates.push_back({OmapUpdateType::RemoveRange, encode_range(make_key(20), make_key(30))});
+  ECOmapJournalEntry rm_entry(eversion_t(1, 1), false, std::nullopt, rm_updates);
+  journal.add_entry(hoid, rm_entry);
+  {
+    auto [updates, ranges] = journal.get_value_updates(hoid);
+    EXPECT_EQ(1u, ranges.size());
+  }
+  EXPECT_EQ(1u, journal.get_depth());
+
+  journal.remove_entry(hoid, rm_entry);
+  auto [updates, ranges] = journal.get_value_updates(hoid);
+  EXPECT_TRUE(ranges.empty());
+  EXPECT_EQ(0u, journal.get_depth());
+}
+
+// The depth counts entries that have not been rolled forward yet.
+TEST(ecomapjournal, depth)
+{
+  MockDoutPrefixProvider dpp;
+  ECOmapJournal journal(dpp);
+  const hobject_t hoid1("obj_depth_1", CEPH_NOSNAP, 1, 0, "nspace");
+  const hobject_t hoid2("obj_depth_2", CEPH_NOSNAP, 2, 0, "nspace");
+
+  auto entry1 = create_insert_entry(eversion_t(1, 1), 1, 10);
+  journal.add_entry(hoid1, entry1);
+  journal.add_entry(hoid1, create_insert_entry(eversion_t(1, 2), 1, 10));
+  journal.add_entry(hoid2, create_insert_entry(eversion_t(1, 3), 1, 10));
+  EXPECT_EQ(3u, journal.get_depth());
+
+  // Processing the entries for a read does not change the depth
+  journal.get_value_updates(hoid1);
+  EXPECT_EQ(3u, journal.get_depth());
+
+  journal.remove_entry(hoid1, entry1);
+  EXPECT_EQ(2u, journal.get_depth());
+
+  // Entries dropped by a create are not rolled forward later
+  journal.append_create(hoid1);
+  EXPECT_EQ(1u, journal.get_depth());
+  journal.remove_entry_by_version(hoid1, eversion_t(1, 2));
+  EXPECT_EQ(1u, journal.get_depth());
+  journal.clear_all();
+  EXPECT_EQ(0u, journal.get_depth());
+}
@@ -693,4 +693,71 @@ TEST(ECExtentCache, test_invalidate_lru)
     cl.complete_write(*op5);
     op5.reset();
   }
-}
\ No newline at end of file
+}
+
+TEST(ECExtentCache, lru_pool_stats_and_resize)
+{
+  Client cl(32, 2, 1, 64);
+  auto to_write = iset_from_vector({{{0, 10}}, {{0, 10}}}, cl.get_stripe_info());
+
+  // The first op misses in the LRU, the second finds the line left behind.
+  for (int i = 0; i < 2; i++) {
+    optional op = cl.cache.prepare(cl.oid, nullopt, to_write, 10, 10, false,
+      [&cl](ECExtentCache::OpRef &op)
+      {
+        cl.cache_ready(op->get_hoid(), op->get_result());
+      });
+    cl.cache_execute(*op);
+    cl.complete_write(*op);
+    op.reset();
+  }
+
+  map<int64_t, ECExtentCache::LRU::pool_stats_t> stats;
+  cl.lru.add_pool_stats(stats);
+  ASSERT_EQ(1, stats.size());
+  ASSERT_EQ(1, stats.at(cl.oid.pool).hits);
+  ASSERT_EQ(1, stats.at(cl.oid.pool).misses);
+
+  // Shrinking the LRU evicts immediately.
+  ASSERT_LT(0, cl.lru.get_size());
+  cl.lru.set_max_size(0);
+  ASSERT_EQ(0, cl.lru.get_size());
+}
+
+TEST(ECExtentCache, lru_keeps_new_line)
+{
+  Client cl(32, 2, 1, 64);
+  auto to_write = iset_from_vector({{{0, 10}}, {{0, 10}}}, cl.get_stripe_info());
+  auto write = [&cl, &to_write](const hobject_t &oid) {
+    optional op = cl.cache.prepare(oid, nullopt, to_write, 10, 10, false,
+      [](ECExtentCache::OpRef &op) {});
+    cl.cache_execute(*op);
+    cl.complete_write(*op);
+    op.reset();
+  };
+
+  // Size the LRU to hold exactly one line.
+  write(cl.oid);
+  uint64_t line_size = cl.lru.get_size();
+  ASSERT_LT(0, line_size);
+  cl.lru.set_max_size(line_size);
+
+  // Adding a second line takes the LRU over capacity. The older line is
+  // evicted, whichever stripe it lives in, and the new one survives.
+  hobject_t oid2 = hobject_t().make_temp_hobject("My second object");
+  write(oid2);
+  ASSERT_EQ(line_size, cl.lru.get_size());
+
+  map<int64_t, ECExtentCache::LRU::pool_stats_t> stats;
+  write(oid2);
+  cl.lru.add_pool_stats(stats);
+  ASSERT_EQ(1, stats.at(cl.oid.pool).hits);
+
+  // The evicted line misses, and adding it back evicts the other.
+  write(cl.oid);
+  stats.clear();
+  cl.lru.add_pool_stats(stats);
+  ASSERT_EQ(1, stats.at(cl.oid.pool).hits);
+  ASSERT_EQ(3, stats.at(cl.oid.pool).misses);
+  ASSERT_EQ(line_size, cl.lru.get_size());
+}